@@ -35,4 +35,10 @@ extern void *fpx_arena_alloc(fpx_arena *ptr, size_t size);
 
 extern int fpx_arena_free(fpx_arena *arenaptr, void *data);
 
+/**
+ * Free everything that was allocated within the arena at once.
+ * Every pointer handed out by it before is invalid afterwards.
+ */
+extern int fpx_arena_reset(fpx_arena *ptr);
+
 #endif // FPX_ARENA_H
@@ -0,0 +1,42 @@
+#ifndef FPX_BUMP_H
+#define FPX_BUMP_H
+
+//
+//  "bump.h"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+#include "../fpx_types.h"
+
+typedef struct __fpx_bump fpx_bump;
+
+/**
+ * Create a bump allocator. Memory is handed out from chunks of at least
+ * `chunk_size` bytes; when one is full, a new chunk twice the size of the
+ * last one is chained on, so it never runs out like an fpx_arena does.
+ * Returns NULL/0 upon failure
+ */
+fpx_bump *fpx_bump_create(size_t chunk_size);
+
+/**
+ * Destroys a bump allocator and all of its chunks
+ */
+int fpx_bump_destroy(fpx_bump *);
+
+/**
+ * Allocate memory from the bump allocator pointed at by
+ * the first argument. Allocations are aligned to 8 bytes and
+ * can not be freed one by one.
+ * Returns NULL/0 upon failure
+ */
+void *fpx_bump_alloc(fpx_bump *, size_t size);
+
+/**
+ * Free everything that was allocated at once. The chunks are kept
+ * around to allocate from again.
+ * Every pointer handed out before is invalid afterwards.
+ */
+int fpx_bump_reset(fpx_bump *);
+
+#endif // FPX_BUMP_H
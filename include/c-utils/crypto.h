@@ -11,14 +11,14 @@
 
 typedef struct {
   uint32_t state[5];
-  uint32_t count;
+  uint64_t count; // message length so far, in bits
   uint8_t buffer[64];
 } SHA1_Context;
 
 typedef struct {
   uint32_t state[8];
-  uint32_t index;
-  uint8_t *buffer;
+  uint64_t count; // message length so far, in bits
+  uint8_t buffer[64];
 } SHA256_Context;
 
 /**
@@ -27,7 +27,7 @@ typedef struct {
 void fpx_sha1_init(SHA1_Context *);
 
 /**
- * SHA-1 transform function.
+ * SHA-1 transform function. Hashes one 64-byte block into the state.
  */
 void fpx_sha1_transform(SHA1_Context *, const uint8_t *);
 
@@ -51,33 +51,55 @@ void fpx_sha1_digest(const uint8_t *input, size_t lengthBytes, uint8_t *output,
                      uint8_t printable);
 
 /**
- * Creates a SHA-256 context to work with.
+ * SHA-1 digest function for many independent messages at once.
+ * Writes the raw digest of inputs[i] (lengths[i] bytes) to outputs[i].
+ * Without the SHA extensions, up to eight messages are hashed side by side
+ * with AVX2; that works best when they are about the same length.
  */
-void fpx_sha256_init(SHA256_Context *);
+void fpx_sha1_digest_many(const uint8_t *const inputs[],
+                          const size_t lengths[], size_t count,
+                          uint8_t outputs[][20]);
 
 /**
- * Fills Context->buffer with the input array
+ * Creates a SHA-256 context to work with.
  */
-void fpx_sha256_input(SHA256_Context *, uint8_t *, size_t);
+void fpx_sha256_init(SHA256_Context *);
 
 /**
- * SHA-256 padding function.
+ * SHA-256 update function. Only the last unfinished block is kept,
+ * so the message can be fed in pieces of any size.
  */
-void fpx_sha256_pad(SHA256_Context *);
+void fpx_sha256_update(SHA256_Context *, const uint8_t *, size_t);
 
 /**
- * SHA-256 transform function.
+ * SHA-256 transform function. Hashes one 64-byte block into the state.
  */
-void fpx_sha256_transform(SHA256_Context *, size_t);
+void fpx_sha256_transform(SHA256_Context *, const uint8_t *);
 
 /**
  * SHA-256 finalize function.
  */
-void fpx_sha256_final(SHA256_Context *);
+void fpx_sha256_final(SHA256_Context *, uint8_t[32]);
 
+/**
+ * SHA-256 digest function. Takes a [const uint8_t*] and length.
+ * Outputs result inside of third argument (uint8_t*).
+ * Last argument decides on whether or not it's printable (hex string
+ * representation) or not (pure bytes).
+ */
 void fpx_sha256_digest(const uint8_t *input, size_t lengthBytes,
                        uint8_t *output, uint8_t printable);
 
+/**
+ * SHA-256 digest function for many independent messages at once.
+ * Writes the raw digest of inputs[i] (lengths[i] bytes) to outputs[i].
+ * Without the SHA extensions, up to eight messages are hashed side by side
+ * with AVX2; that works best when they are about the same length.
+ */
+void fpx_sha256_digest_many(const uint8_t *const inputs[],
+                            const size_t lengths[], size_t count,
+                            uint8_t outputs[][32]);
+
 /**
  * Returns a (!HEAP ALLOCATED!) base64 string based on the input.
  * TODO:
@@ -0,0 +1,177 @@
+#ifndef FPX_DEFLATE_H
+#define FPX_DEFLATE_H
+
+//
+//  "deflate.h"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+#include "../fpx_types.h"
+
+typedef struct _fpx_deflate fpx_deflate_t;
+typedef struct _fpx_inflate fpx_inflate_t;
+
+/**
+ * Initializes a DEFLATE (RFC 1951) compressor
+ *
+ * Input:
+ * - Pointer to the compressor to initialize
+ * - Base-2 logarithm of the LZ77 window size (9 to 15)
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the window size is out of range
+ * - -3 if memory allocation fails
+ *
+ * Notes:
+ * - The compressor takes up about 6 times the window size, plus 48 KiB
+ */
+int fpx_deflate_init(fpx_deflate_t *, uint8_t window_bits);
+
+/**
+ * Compresses a message the way permessage-deflate (RFC 7692) wants it: raw
+ * DEFLATE data ending in a sync flush, without the final 4 bytes of it
+ *
+ * Input:
+ * - Pointer to the compressor
+ * - The data to compress
+ * - The length of the data
+ * - Boolean whether earlier messages may be referred to (context takeover)
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -3 if memory allocation fails
+ *
+ * Notes:
+ * - The output is in the `out` and `out_len` members of the compressor, and
+ * stays there until the next call
+ */
+int fpx_deflate_message(fpx_deflate_t *, const uint8_t *data, size_t length,
+                        uint8_t keep_context);
+
+/**
+ * Tells how much memory a compressor keeps allocated
+ *
+ * Input:
+ * - Base-2 logarithm of the LZ77 window size (9 to 15)
+ *
+ * Returns:
+ * - The bytes fpx_deflate_init() allocates for that window size, not counting
+ * the output, which grows with the messages; 0 if the size is out of range
+ */
+size_t fpx_deflate_memory(uint8_t window_bits);
+
+/**
+ * Frees all associated memory allocations to prepare for object destruction
+ *
+ * Input:
+ * - Pointer to the compressor
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ */
+int fpx_deflate_destroy(fpx_deflate_t *);
+
+/**
+ * Initializes a DEFLATE (RFC 1951) decompressor
+ *
+ * Input:
+ * - Pointer to the decompressor to initialize
+ * - Base-2 logarithm of the window to keep between messages (8 to 15), or 0
+ * to keep nothing (no context takeover)
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the window size is out of range
+ * - -3 if memory allocation fails
+ */
+int fpx_inflate_init(fpx_inflate_t *, uint8_t window_bits);
+
+/**
+ * Decompresses a message that was compressed for permessage-deflate
+ * (RFC 7692)
+ *
+ * Input:
+ * - Pointer to the decompressor
+ * - The compressed data, without the final 4 bytes of the sync flush
+ * - The length of the compressed data
+ * - The most bytes the output may take up (0 for no limit)
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -3 if memory allocation fails
+ * - -4 if the data is not valid DEFLATE data
+ * - -5 if the output would be longer than allowed
+ *
+ * Notes:
+ * - The output is in the `out` and `out_len` members of the decompressor,
+ * and stays there until the next call. The caller may take the buffer over
+ * by setting `out` to NULL and `out_allocated` to 0
+ * - After a failure, the window is no longer usable for context takeover
+ */
+int fpx_inflate_message(fpx_inflate_t *, const uint8_t *data, size_t length,
+                        size_t max_output);
+
+/**
+ * Frees all associated memory allocations to prepare for object destruction
+ *
+ * Input:
+ * - Pointer to the decompressor
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ */
+int fpx_inflate_destroy(fpx_inflate_t *);
+
+struct _fpx_deflate {
+  uint8_t window_bits;
+
+  // HEAP; two windows' worth of input. `window + strstart` is the next byte
+  // to be compressed, of which there are `lookahead`
+  uint8_t *window;
+  size_t strstart;
+  size_t lookahead;
+
+  // HEAP; hash chains over the window; 0 marks the end of a chain
+  uint16_t *head;
+  uint16_t *prev;
+
+  // HEAP; the block being collected. a literal has a distance of 0, and a
+  // match stores its length minus 3 in `lengths`
+  uint8_t *lengths;
+  uint16_t *distances;
+  size_t symbol_count;
+  int64_t block_start; // in `window`; negative once it has slid out of it
+  size_t block_bytes;
+
+  uint64_t bit_buffer;
+  uint8_t bit_count;
+
+  // HEAP; the compressed output
+  uint8_t *out;
+  size_t out_len;
+  size_t out_allocated;
+};
+
+struct _fpx_inflate {
+  uint8_t window_bits;
+
+  // HEAP; the last bytes of output, for messages that refer back to them
+  uint8_t *window;
+  size_t window_pos; // where the next byte goes
+  size_t window_fill;
+
+  // HEAP; the decompressed output
+  uint8_t *out;
+  size_t out_len;
+  size_t out_allocated;
+};
+
+#endif // FPX_DEFLATE_H
@@ -9,6 +9,9 @@
 
 #include "../fpx_types.h"
 
+#define FPX_INT64_MAX_LENGTH 20  /* "-9223372036854775808", no NULL-byte */
+#define FPX_DOUBLE_MAX_LENGTH 25 /* "-0.0000012345678901234567", the same */
+
 /**
  *  Converts a given input string to an integer
  *
@@ -23,6 +26,88 @@ int fpx_strint(const char *input);
  */
 int fpx_intstr(int input, char *output);
 
+/**
+ *  Formats a 64-bit integer in decimal
+ *
+ *  Input:
+ *  - The value to format
+ *  - The buffer to write the digits to
+ *  - The size of that buffer
+ *
+ *  Returns:
+ *  - The amount of characters written on success
+ *  - -1 if output is NULL
+ *  - -2 if the buffer is too small; FPX_INT64_MAX_LENGTH is always enough
+ *
+ *  Null-terminates the string if there is room, otherwise leaves it as is
+ */
+int fpx_int64str(int64_t value, char *output, size_t buflen);
+int fpx_uint64str(uint64_t value, char *output, size_t buflen);
+
+/**
+ *  Parses a decimal integer from the start of a string,
+ *  stopping at the first character that is not a digit
+ *
+ *  Input:
+ *  - The string to parse; the signed version takes a leading '-'
+ *  - The length of that string (parsing also stops at a NULL-byte)
+ *  - Pointer to store the value at
+ *  - Pointer to store the amount of characters used at (may be NULL)
+ *
+ *  Returns:
+ *  - 0 on success
+ *  - -1 if input or output is NULL
+ *  - -2 if the string does not start with a number
+ *  - -3 if the number does not fit; the value is clamped to the nearest limit
+ */
+int fpx_strint64(const char *input, size_t len, int64_t *output,
+                 size_t *used);
+int fpx_struint64(const char *input, size_t len, uint64_t *output,
+                  size_t *used);
+
+/**
+ *  Formats a double as the shortest decimal string that reads back as
+ *  exactly the same double
+ *
+ *  Input:
+ *  - The value to format
+ *  - The buffer to write the string to
+ *  - The size of that buffer
+ *
+ *  Returns:
+ *  - The amount of characters written on success
+ *  - -1 if output is NULL
+ *  - -2 if the buffer is too small; FPX_DOUBLE_MAX_LENGTH is always enough
+ *
+ *  Uses the same layout as JavaScript: plain notation for magnitudes from
+ *  1e-6 up to 1e21 ("0.001", "120"), exponent notation outside of that
+ *  ("1.5e+300"), and "NaN", "Infinity" and "-Infinity".
+ *  Null-terminates the string if there is room, otherwise leaves it as is
+ */
+int fpx_doublestr(double value, char *output, size_t buflen);
+
+/**
+ *  Parses a decimal floating point number from the start of a string,
+ *  rounding correctly to the nearest double
+ *
+ *  Input:
+ *  - The string to parse: an optional '-', digits with an optional fraction
+ *    and an optional exponent, or "inf", "infinity" or "nan" in any case
+ *  - The length of that string (parsing also stops at a NULL-byte)
+ *  - Pointer to store the value at
+ *  - Pointer to store the amount of characters used at (may be NULL)
+ *
+ *  Returns:
+ *  - 0 on success
+ *  - -1 if input or output is NULL
+ *  - -2 if the string does not start with a number
+ *  - -3 if memory allocation fails
+ *
+ *  Values too large for a double become an infinity, values too small
+ *  become zero. Unlike strtod(), the decimal point is always '.'
+ */
+int fpx_strdouble(const char *input, size_t len, double *output, size_t *used);
+
 /**
  *  Formats the value of a passed pointer into a hex-string
  *  Fails when:
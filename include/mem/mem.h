@@ -12,4 +12,31 @@
 extern void *fpx_memcpy(void *dst, const void *src, size_t count);
 extern void *fpx_memset(void *target, uint8_t value, size_t count);
 
+/**
+ * Copies bytes between two regions that may overlap
+ *
+ * Input:
+ * - Pointer to the destination
+ * - Pointer to the source
+ * - How many bytes to copy
+ *
+ * Returns:
+ * - The destination pointer
+ */
+extern void *fpx_memmove(void *dst, const void *src, size_t count);
+
+/**
+ * Compares two regions byte by byte, as unsigned values
+ *
+ * Input:
+ * - Pointers to the two regions
+ * - How many bytes to compare
+ *
+ * Returns:
+ * - A negative value if the first differing byte is lower in `a`
+ * - 0 if the regions are equal (or if either pointer is NULL)
+ * - A positive value if the first differing byte is higher in `a`
+ */
+extern int fpx_memcmp(const void *a, const void *b, size_t count);
+
 #endif // FPX_MEM_H
@@ -7,11 +7,40 @@
 //  Author: Erynn 'foorpyxof' Scholtes
 //
 
+#include "../../alloc/arena.h"
 #include "../../fpx_types.h"
+#include "../../string/string.h"
 #include "../netutils.h"
 
 typedef struct _fpx_httprequest fpx_httprequest_t;
 typedef struct _fpx_httpresponse fpx_httpresponse_t;
+typedef struct _fpx_httpparser fpx_httpparser_t;
+
+/* the amount of header fields a request or response indexes; any further
+ * ones are still kept, and found by going through them one by one */
+#define FPX_HTTP_MAX_HEADER_FIELDS 32
+
+/* slots in the per-object header hash index; keep at 2x the field maximum */
+#define FPX_HTTP_HEADER_INDEX_SIZE (FPX_HTTP_MAX_HEADER_FIELDS * 2)
+
+/* the maximum amount of path parameters a route can capture */
+#define FPX_HTTP_MAX_PARAMS 8
+
+/* headers that are looked up often enough to get a fixed slot */
+typedef enum {
+  HTTP_HEADER_CONNECTION = 0,
+  HTTP_HEADER_CONTENT_LENGTH,
+  HTTP_HEADER_CONTENT_TYPE,
+  HTTP_HEADER_HOST,
+  HTTP_HEADER_KEEP_ALIVE,
+  HTTP_HEADER_TRANSFER_ENCODING,
+  HTTP_HEADER_UPGRADE,
+  HTTP_HEADER_SEC_WEBSOCKET_KEY,
+  HTTP_HEADER_SEC_WEBSOCKET_VERSION,
+  HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS,
+
+  HTTP_HEADER_KNOWN_COUNT, // not a header
+} fpx_httpheader_t;
 
 typedef enum {
   HTTP_NONE = 0x000,
@@ -39,6 +68,27 @@ typedef enum {
  */
 int fpx_httprequest_init(fpx_httprequest_t *);
 
+/**
+ * Have an fpx_httprequest_t object take the memory for its headers and body
+ * from an arena, instead of from the heap
+ *
+ * Input:
+ * - Pointer to request object
+ * - Pointer to the arena to use (or NULL to go back to the heap)
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the request pointer is NULL
+ *
+ * Notes:
+ * - Only affects memory that is allocated after this call
+ * - Destroying the request does not give the memory back to the arena; that
+ * happens through fpx_arena_reset(), which must not be called before the
+ * request is done with
+ * - Whatever does not fit in the arena anymore comes from the heap still
+ */
+int fpx_httprequest_use_arena(fpx_httprequest_t *, fpx_arena *);
+
 /**
  * Set the HTTP method of an fpx_httprequest_t object
  *
@@ -155,6 +205,21 @@ int fpx_httprequest_get_version(fpx_httprequest_t *, char *, size_t);
  */
 int fpx_httprequest_add_header(fpx_httprequest_t *, const char *, const char *);
 
+/**
+ * Same as fpx_httprequest_add_header(), for a key and value that are already
+ * measured and need not be NULL-terminated
+ *
+ * Input:
+ * - Pointer to request object
+ * - View of the Header name
+ * - View of the Header value
+ *
+ * Returns:
+ * - The same as fpx_httprequest_add_header()
+ */
+int fpx_httprequest_add_header_view(fpx_httprequest_t *, fpx_strview_t,
+                                    fpx_strview_t);
+
 /**
  * Get the Header value attached to the first occurence of a key
  * in an fpx_httprequest_t object, and store it in
@@ -176,6 +241,50 @@ int fpx_httprequest_add_header(fpx_httprequest_t *, const char *, const char *);
 int fpx_httprequest_get_header(fpx_httprequest_t *, const char *, char *,
                                size_t);
 
+/**
+ * Get the value of one of the well-known Headers of an fpx_httprequest_t
+ * object without copying it
+ *
+ * Input:
+ * - Pointer to request object
+ * - Which Header to get (from enum)
+ * - Pointer to store the start of the value in
+ * - Pointer to store the length of the value in
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the Header is not present
+ *
+ * Notes:
+ * - The value is NOT null-terminated, and stays valid until the request object
+ * is modified or destroyed
+ */
+int fpx_httprequest_get_known_header(fpx_httprequest_t *, fpx_httpheader_t,
+                                     const char **, size_t *);
+
+/**
+ * Get the value of a path parameter that was captured by the route matching
+ * an fpx_httprequest_t object (e.g. "id" for a route "/users/:id")
+ *
+ * Input:
+ * - Pointer to request object
+ * - Name of the parameter (without the leading ':' or '*')
+ * - Pointer to store the start of the value in
+ * - Pointer to store the length of the value in
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the parameter was not captured
+ *
+ * Notes:
+ * - The value points into the request URI; it is NOT null-terminated and NOT
+ * percent-decoded
+ */
+int fpx_httprequest_get_param(const fpx_httprequest_t *, const char *name,
+                              const char **, size_t *);
+
 /**
  * Append to the body of an fpx_httprequest_t object
  *
@@ -266,6 +375,23 @@ int fpx_httprequest_destroy(fpx_httprequest_t *);
  */
 int fpx_httpresponse_init(fpx_httpresponse_t *);
 
+/**
+ * Have an fpx_httpresponse_t object take the memory for its headers and body
+ * from an arena, instead of from the heap
+ *
+ * Input:
+ * - Pointer to response object
+ * - Pointer to the arena to use (or NULL to go back to the heap)
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the response pointer is NULL
+ *
+ * Notes:
+ * - See fpx_httprequest_use_arena()
+ */
+int fpx_httpresponse_use_arena(fpx_httpresponse_t *, fpx_arena *);
+
 /**
  * Set the HTTP version of the response
  *
@@ -323,6 +449,21 @@ int fpx_httpresponse_get_version(fpx_httpresponse_t *, char *, size_t);
 int fpx_httpresponse_add_header(fpx_httpresponse_t *, const char *,
                                 const char *);
 
+/**
+ * Same as fpx_httpresponse_add_header(), for a key and value that are already
+ * measured and need not be NULL-terminated
+ *
+ * Input:
+ * - Pointer to response object
+ * - View of the Header name
+ * - View of the Header value
+ *
+ * Returns:
+ * - The same as fpx_httpresponse_add_header()
+ */
+int fpx_httpresponse_add_header_view(fpx_httpresponse_t *, fpx_strview_t,
+                                     fpx_strview_t);
+
 /**
  * Get the Header value attached to the first occurence of a key
  * in an fpx_httpresponse_t object, and store it in
@@ -344,6 +485,28 @@ int fpx_httpresponse_add_header(fpx_httpresponse_t *, const char *,
 int fpx_httpresponse_get_header(fpx_httpresponse_t *, const char *, char *,
                                 size_t);
 
+/**
+ * Get the value of one of the well-known Headers of an fpx_httpresponse_t
+ * object without copying it
+ *
+ * Input:
+ * - Pointer to response object
+ * - Which Header to get (from enum)
+ * - Pointer to store the start of the value in
+ * - Pointer to store the length of the value in
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the Header is not present
+ *
+ * Notes:
+ * - The value is NOT null-terminated, and stays valid until the response
+ * object is modified or destroyed
+ */
+int fpx_httpresponse_get_known_header(fpx_httpresponse_t *, fpx_httpheader_t,
+                                      const char **, size_t *);
+
 /**
  * Append to the body of an fpx_httpresponse_t object
  *
@@ -358,6 +521,21 @@ int fpx_httpresponse_get_header(fpx_httpresponse_t *, const char *, char *,
  */
 int fpx_httpresponse_append_body(fpx_httpresponse_t *, const char *, size_t);
 
+/**
+ * Same as fpx_httpresponse_append_body(), with the response passed as a void
+ * pointer; for code that writes through a (context, data, length) callback,
+ * like the Fpx_Json_Writer from serialize/json.h
+ *
+ * Input:
+ * - Pointer to response object
+ * - Body data to append
+ * - Length of that data
+ *
+ * Returns:
+ * - The same as fpx_httpresponse_append_body()
+ */
+int fpx_httpresponse_body_sink(void *, const char *, size_t);
+
 /**
  * Get the response body of an fpx_httpresponse_t object
  *
@@ -421,17 +599,174 @@ int fpx_httpresponse_copy(fpx_httpresponse_t *_dst,
  */
 int fpx_httpresponse_destroy(fpx_httpresponse_t *);
 
+/**
+ * Get the amount of heap allocations made for the headers and bodies of
+ * requests and responses, and for parser buffers, across all threads
+ *
+ * Returns:
+ * - The amount of allocations since the program started
+ *
+ * Notes:
+ * - Memory taken from an arena (see fpx_httprequest_use_arena()) is not
+ * counted
+ */
+uint64_t fpx_http_allocation_count(void);
+
+/**
+ * Initialize an incremental request parser
+ *
+ * Input:
+ * - Pointer to the parser object
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the provided pointer is NULL
+ *
+ * Notes:
+ * - `max_request` (the largest accepted body) and `max_header_bytes` (the
+ * largest accepted request line + header section) get defaults from the
+ * implementation file and may be changed at any point afterwards
+ */
+int fpx_httpparser_init(fpx_httpparser_t *);
+
+/**
+ * Get a pointer to free space at the end of the parser's buffer, so data can
+ * be read into it directly (e.g. with recv())
+ *
+ * Input:
+ * - Pointer to the parser object
+ * - The minimum amount of free bytes the caller needs
+ * - Pointer to store the actual amount of free bytes in
+ *
+ * Returns:
+ * - A pointer to write at most *[available] bytes to
+ * - NULL if any passed pointer is unexpectedly NULL or memory allocation fails
+ *
+ * Notes:
+ * - Follow up with fpx_httpparser_commit() to hand the written bytes over
+ * - This may move buffered data around, which invalidates any request that
+ * was previously returned by fpx_httpparser_execute()
+ */
+char *fpx_httpparser_reserve(fpx_httpparser_t *, size_t minimum,
+                             size_t *available);
+
+/**
+ * Mark bytes written into the space from fpx_httpparser_reserve() as received
+ *
+ * Input:
+ * - Pointer to the parser object
+ * - The amount of bytes that were written
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the provided pointer is NULL
+ * - -2 if the amount is larger than the reserved space
+ */
+int fpx_httpparser_commit(fpx_httpparser_t *, size_t);
+
+/**
+ * Copy data into the parser's buffer;
+ * shorthand for fpx_httpparser_reserve() + fpx_httpparser_commit()
+ *
+ * Input:
+ * - Pointer to the parser object
+ * - Pointer to the received data
+ * - Length of the received data
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if any memory allocation fails for any reason
+ */
+int fpx_httpparser_feed(fpx_httpparser_t *, const char *, size_t);
+
+/**
+ * Continue parsing the buffered data, and output the next complete request
+ *
+ * Input:
+ * - Pointer to the parser object
+ * - Pointer to an initialized request object to store the request in
+ *
+ * Returns:
+ * -  1 if a complete request was stored in the request object
+ * -  0 if more data is needed first
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the request is malformed
+ * - -3 if the request line and headers are larger than `max_header_bytes`
+ * - -4 if the URI is too long
+ * - -5 if the body is larger than `max_request`
+ * - -6 if the request uses a transfer-encoding (not supported)
+ *
+ * Notes:
+ * - Parsing picks up exactly where the previous call stopped, so data can be
+ * fed in arbitrarily small pieces
+ * - Pipelined requests are returned one per call; keep calling until 0
+ * - The headers and body of the returned request are NOT copied; they point
+ * into the parser's buffer and stay valid until the next call to any
+ * fpx_httpparser_* function. fpx_httprequest_copy() makes an owned copy
+ * - After a negative return value the connection should be closed;
+ * the parser does not try to recover
+ */
+int fpx_httpparser_execute(fpx_httpparser_t *, fpx_httprequest_t *);
+
+/**
+ * Free all the underlying memory contained within the parser object
+ *
+ * Input:
+ * - Pointer to the parser object
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the provided pointer is NULL
+ */
+int fpx_httpparser_destroy(fpx_httpparser_t *);
+
+struct _fpx_http_header {
+  // offsets into `headers` of the owning content
+  uint32_t key;
+  uint32_t key_len;
+  uint32_t value;
+  uint32_t value_len;
+
+  uint32_t hash; // of the lowercased key
+};
+
 struct _fpx_http_content {
   char version[16];
 
-  char *headers; // HEAP
-  char *body;    // HEAP
+  // HEAP; or borrowed from an fpx_httpparser_t when the matching
+  // `*_allocated` member is 0
+  char *headers;
+  char *body;
 
   size_t headers_len; // no null terminator included
   size_t body_len;    // no null terminator included
 
   size_t headers_allocated;
   size_t body_allocated;
+
+  struct _fpx_http_header fields[FPX_HTTP_MAX_HEADER_FIELDS];
+  uint16_t field_count;
+
+  // both hold (index into `fields`) + 1, or 0 for "not present";
+  // only the first occurence of a key is indexed
+  uint8_t index[FPX_HTTP_HEADER_INDEX_SIZE]; // open addressing, by hash
+  uint8_t known[HTTP_HEADER_KNOWN_COUNT];
+
+  // new buffers come from here when set; buffers that did are marked in
+  // `*_in_arena` and are never freed individually
+  fpx_arena *arena;
+  uint8_t headers_in_arena;
+  uint8_t body_in_arena;
+};
+
+struct _fpx_http_param {
+  const char *name; // borrowed from the route; NOT null-terminated
+  uint8_t name_len;
+
+  // span of the value within `uri` of the owning request
+  uint8_t value;
+  uint8_t value_len;
 };
 
 struct _fpx_httprequest {
@@ -439,6 +774,10 @@ struct _fpx_httprequest {
   char uri[256];
 
   struct _fpx_http_content content;
+
+  // filled in by the server's router before the endpoint callback runs
+  struct _fpx_http_param params[FPX_HTTP_MAX_PARAMS];
+  uint8_t param_count;
 };
 
 struct _fpx_httpresponse {
@@ -448,4 +787,34 @@ struct _fpx_httpresponse {
   struct _fpx_http_content content;
 };
 
+struct _fpx_httpparser {
+  char *buffer; // HEAP
+  size_t length;
+  size_t allocated;
+
+  size_t max_request;
+  size_t max_header_bytes;
+
+  // everything below is relative to `start`, the first byte of the request
+  // that is currently being parsed
+  size_t start;
+  size_t line; // start of the current line
+  size_t scan; // where to continue looking for the end of the current line
+
+  uint8_t state;
+  uint8_t seen_content_length;
+
+  uint32_t method, method_len;
+  uint32_t uri, uri_len;
+  uint32_t version, version_len;
+
+  size_t headers_start;
+  size_t headers_end;
+  size_t body_start;
+  size_t content_length;
+
+  struct _fpx_http_header fields[FPX_HTTP_MAX_HEADER_FIELDS];
+  uint16_t field_count;
+};
+
 #endif // FPX_HTTP_H
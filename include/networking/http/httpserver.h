@@ -28,6 +28,13 @@ enum fpx_httpserver_type {
 enum fpx_httpserver_opts {
   ManualWsUpgrade = 0x01, // this allows for upgrading the request within the
                           // HTTP endpoint callback instead of automatically
+  ReusePort = 0x02, // every HTTP thread accepts on its own SO_REUSEPORT socket
+                    // and the kernel balances new connections between them
+};
+
+enum fpx_httpserver_backend {
+  PollBackend = 0,  // portable poll() loop, level-triggered
+  EpollBackend = 1, // edge-triggered epoll loop (Linux only)
 };
 
 /**
@@ -37,7 +44,7 @@ enum fpx_httpserver_opts {
  * - Pointer to the server to initialize
  * - The amount of HTTP processing threads to use (> 0)
  * - The amount of WebSocket processing threads to use (> 0)
- * - The maximum amount of HTTP endpoints to handle
+ * - The maximum amount of HTTP endpoints to handle (up to 65535)
  *
  * Returns:
  * -  0 on success
@@ -48,9 +55,27 @@ enum fpx_httpserver_opts {
  * - Passing 0 for the processing threads or the endpoint count
  * will set it to the default instead. The default is specified
  * in the implementation file
+ * - The event backend is set to EpollBackend on Linux and PollBackend
+ * everywhere else. It can be changed through the `backend` member at any point
+ * before calling fpx_httpserver_listen()
+ * - `max_connections` caps the amount of open client connections across all
+ * threads (default in the implementation file; 0 disables the cap). Clients
+ * beyond it receive a 503 response
+ * - `max_ws_message` caps the size in bytes of a (reassembled) WebSocket
+ * message (default in the implementation file; 0 disables the cap). Clients
+ * that send a bigger one are disconnected with status 1009. For compressed
+ * messages this goes for the decompressed size as well
+ * - `ws_deflate_window_bits` is the base-2 logarithm of the window that
+ * messages to clients are compressed with (9 to 15), when clients offer the
+ * permessage-deflate extension (RFC 7692). 0 turns the extension off
+ * - `ws_deflate_memory` caps the bytes kept per client for permessage-deflate
+ * (default in the implementation file; 0 disables the cap): the window of its
+ * compressed messages, and the compressor that lets ours refer back to the
+ * earlier ones. Beyond it, smaller windows are used, and messages are
+ * compressed on their own instead
  */
 int fpx_httpserver_init(fpx_httpserver_t *, const uint8_t http_threads,
-                        const uint8_t ws_threads, uint8_t max_endpoints);
+                        const uint8_t ws_threads, uint16_t max_endpoints);
 
 /**
  * Set the default headers to be applied to every outgoing response\
@@ -163,10 +188,19 @@ int fpx_httpserver_set_default_http_endpoint(fpx_httpserver_t *,
  * - -2 if the server object is uninitialized
  * - -3 if the limit of endpoints is reached
  * - -4 if the given URI is too long to fit (maximum 255)
+ * - -5 if the URI is not a valid route, or conflicts with an existing one
  *
  * Notes:
  * - If the URI is missing a leading '/', this will be prepended.
  * - The URI will be processed first and any '.'s or '..'s will be removed.
+ * - A path segment of the form ":name" matches any one non-empty segment
+ * (e.g. "/users/:id"), and a final segment of the form "*name" matches the
+ * rest of the path, including nothing at all. What they matched is available
+ * to the callback through fpx_httprequest_get_param().
+ * - Routes without parameters win over routes with them, which win over
+ * wildcards. The query string is not part of the match.
+ * - At most FPX_HTTP_MAX_PARAMS parameters per route; two routes may not name
+ * the parameter at the same position differently.
  */
 int fpx_httpserver_create_endpoint(fpx_httpserver_t *, const char *uri,
                                    const uint16_t methods,
@@ -187,14 +221,166 @@ int fpx_httpserver_create_endpoint(fpx_httpserver_t *, const char *uri,
  * - -2 if the server object is uninitialized
  * - -3 if the limit of endpoints is reached
  * - -4 if the given URI is too long to fit (maximum 255)
+ * - -5 if the URI is not a valid route, or conflicts with an existing one
  *
  * Notes:
  * - If the URI is missing a leading '/', this will be prepended.
  * - The URI will be processed first and any '.'s or '..'s will be removed.
+ * - The URI may contain parameters, like for fpx_httpserver_create_endpoint()
  */
 int fpx_httpserver_create_ws_endpoint(fpx_httpserver_t *, const char *uri,
                                       fpx_websocketcallback_t callback);
 
+/**
+ * Append an endpoint that serves the files in a directory, to the current list
+ * of endpoints
+ *
+ * Input:
+ * - Pointer to the server to add an endpoint to
+ * - Null-terminated string to represent the URI prefix
+ * - Null-terminated path to the directory to serve files from
+ *
+ * Returns:
+ * - The index of the endpoint in the array on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the server object is uninitialized
+ * - -3 if the limit of endpoints is reached
+ * - -4 if the given URI is too long to fit (maximum 255)
+ * - -5 if the given directory path is too long to fit (maximum 255)
+ * - -6 if serving files is not supported on this platform
+ * - -7 if the URI is not a valid route, or conflicts with an existing one
+ *
+ * Notes:
+ * - If the URI is missing a leading '/', this will be prepended.
+ * - This registers the route "[uri]", plus a wildcard route "*path" below it.
+ * - A request for "[uri]/a/b.css" is answered with "[directory]/a/b.css", and
+ * a request for a directory with the "index.html" inside of it.
+ * - Only GET and HEAD are allowed. Requests with a ".." path segment get a
+ * 404.
+ * - Responses carry an ETag and Last-Modified header. If-None-Match and
+ * If-Modified-Since are answered with 304, and a single "bytes=" Range with
+ * 206.
+ * - File contents are sent straight from the file with sendfile() (or from a
+ * mapping of it), never through the response body.
+ */
+int fpx_httpserver_create_static_endpoint(fpx_httpserver_t *, const char *uri,
+                                          const char *directory);
+
+/**
+ * Subscribe a WebSocket client to a topic, so that it receives every message
+ * published to that topic from then on
+ *
+ * Input:
+ * - Pointer to the server the client is connected to
+ * - File descriptor of the client, as passed to the WebSocket callback
+ * - Null-terminated name of the topic
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the server object is uninitialized
+ * - -3 if the server object is not currently listening
+ * - -4 if the topic name is empty or too long (maximum 63)
+ * - -6 if no WebSocket client is connected on the file descriptor
+ * -  the value of `errno` on other failure
+ *
+ * Notes:
+ * - Called from the WebSocket callback of the client itself, this takes
+ * effect right away. Otherwise it is handed to the thread that owns the client
+ * and takes effect shortly after, but before anything published after this
+ * call. If the client disconnects in the meantime, nothing happens; not even
+ * to a new client that got the same file descriptor.
+ * - Subscribing to a topic twice has no further effect. Subscriptions end
+ * when the client disconnects.
+ */
+int fpx_httpserver_subscribe(fpx_httpserver_t *, int file_descriptor,
+                             const char *topic);
+
+/**
+ * Unsubscribe a WebSocket client from a topic
+ *
+ * Input:
+ * - Pointer to the server the client is connected to
+ * - File descriptor of the client, as passed to the WebSocket callback
+ * - Null-terminated name of the topic
+ *
+ * Returns:
+ * - The same as fpx_httpserver_subscribe()
+ */
+int fpx_httpserver_unsubscribe(fpx_httpserver_t *, int file_descriptor,
+                               const char *topic);
+
+/**
+ * Send a message to every WebSocket client that is subscribed to a topic
+ *
+ * Input:
+ * - Pointer to the server to publish on
+ * - Null-terminated name of the topic
+ * - The opcode of the message; WEBSOCKET_TEXT or WEBSOCKET_BINARY
+ * - The payload of the message
+ * - The length of the payload
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the server object is uninitialized
+ * - -3 if the server object is not currently listening
+ * - -4 if the topic name is empty or too long (maximum 63)
+ * - -5 if the opcode is not allowed
+ * -  the value of `errno` on other failure
+ *
+ * Notes:
+ * - The message is framed once, and every WebSocket thread sends that same
+ * copy to its own subscribers. This function returns without waiting for any
+ * of that to happen, and may be called from any thread.
+ * - A client that falls more than 4 MiB behind on its messages is
+ * disconnected.
+ * - Frames sent to a subscriber with fpx_websocketframe_send() may end up in
+ * the middle of a published message; use fpx_httpserver_ws_send() instead.
+ * - The message is compressed once as well, on its own, for the subscribers
+ * that negotiated permessage-deflate with the server's own window size.
+ */
+int fpx_httpserver_publish(fpx_httpserver_t *, const char *topic,
+                           enum websocket_opcode opcode, const uint8_t *payload,
+                           size_t payload_length);
+
+/**
+ * Send a complete message to a WebSocket client, compressed if the client
+ * negotiated permessage-deflate
+ *
+ * Input:
+ * - Pointer to the server the client is connected to
+ * - File descriptor of the client, as passed to the WebSocket callback
+ * - The opcode of the message; WEBSOCKET_TEXT or WEBSOCKET_BINARY
+ * - The payload of the message
+ * - The length of the payload
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the server object is uninitialized
+ * - -3 if the server object is not currently listening
+ * - -5 if the opcode is not allowed
+ * - -6 if no WebSocket client is connected on the file descriptor
+ * -  ENOBUFS if the client is too far behind on its messages
+ * -  the value of `errno` on other failure
+ *
+ * Notes:
+ * - Called from the WebSocket callback of the client itself, the message is
+ * sent right away, or queued behind published messages that are still being
+ * sent. Otherwise it is handed to the thread that owns the client, and this
+ * returns before it is sent; like fpx_httpserver_publish(), it may be called
+ * from any thread. A message for a client that disconnects before it is sent
+ * is dropped, even if a new client got the same file descriptor.
+ * - Unless the client asked for server_no_context_takeover, or its memory
+ * budget did not allow it, messages are compressed with a context kept per
+ * client, so that they can refer back to the ones sent before. Otherwise only
+ * payloads that are long enough to be worth it are compressed, on their own.
+ */
+int fpx_httpserver_ws_send(fpx_httpserver_t *, int file_descriptor,
+                           enum websocket_opcode opcode, const uint8_t *payload,
+                           size_t payload_length);
+
 /**
  * Start listening for HTTP requests on [ip]:[port]
  *
@@ -232,9 +418,10 @@ int fpx_httpserver_close(fpx_httpserver_t *);
 
 struct _fpx_httpserver {
   enum fpx_httpserver_type server_type;
+  enum fpx_httpserver_backend backend;
   uint8_t options;
 
-  uint8_t max_endpoints;
+  uint16_t max_endpoints;
 
   uint8_t http_thread_count;
   uint8_t ws_thread_count;
@@ -244,6 +431,12 @@ struct _fpx_httpserver {
   uint32_t keepalive_timeout;
   uint32_t websockets_timeout;
 
+  uint32_t max_connections; // 0 means unlimited
+  uint32_t max_ws_message;  // 0 means unlimited
+
+  uint8_t ws_deflate_window_bits; // 9 to 15; 0 turns permessage-deflate off
+  uint32_t ws_deflate_memory;     // per connection; 0 means unlimited
+
   struct _fpx_httpserver_metadata *_internal;
 };
 
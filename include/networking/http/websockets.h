@@ -10,6 +10,9 @@
 //  Author: Erynn 'foorpyxof' Scholtes
 //
 
+/* the most bytes a frame header can take up on the wire */
+#define FPX_WEBSOCKET_HEADER_MAX 14
+
 enum websocket_opcode {
   WEBSOCKET_CONTINUE = 0x0,
   WEBSOCKET_TEXT = 0x1,
@@ -59,6 +62,27 @@ struct _fpx_websocketframe {
 int fpx_websocket_send_close(int filedescriptor, int16_t, const uint8_t *,
                              uint8_t payload_length, uint8_t masked);
 
+/**
+ * Apply a websocket masking key to (part of) a payload, in place. Since
+ * masking is an XOR, this also removes it again
+ *
+ * Input:
+ * - Pointer to the payload bytes
+ * - The amount of bytes
+ * - The 4-byte masking key
+ * - The position of the first byte within the whole payload; this allows
+ * masking a payload in separate pieces
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ *
+ * Notes:
+ * - Uses AVX2 or SSE2 where the CPU supports it, picked on the first call
+ */
+int fpx_websocket_mask(uint8_t *payload, size_t length, const uint8_t key[4],
+                       uint64_t offset);
+
 /**
  * Initializes the websocket frame object to default values
  * WARNING: Will leak memory if allocations have been made on the frame object
@@ -87,19 +111,64 @@ int fpx_websocketframe_init(fpx_websocketframe_t *);
 int fpx_websocketframe_append_payload(fpx_websocketframe_t *, const uint8_t *,
                                       size_t);
 
+/**
+ * Encode the header of a websocket frame, as it goes on the wire in front of
+ * the payload
+ *
+ * Input:
+ * - Pointer to the websocket frame to encode the header of
+ * - Output buffer of at least FPX_WEBSOCKET_HEADER_MAX bytes
+ *
+ * Returns:
+ * - The length of the header in bytes on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ *
+ * Notes:
+ * - The length is taken from `payload_length`; the payload itself is not
+ * looked at. If `mask_set` is set, the masking key is included
+ */
+int fpx_websocketframe_write_header(const fpx_websocketframe_t *,
+                                    uint8_t *out);
+
 /**
  * Send the websocket frame over the wire
  *
  * Input:
- * - Pointer to the websocket frame to append
+ * - Pointer to the websocket frame to send
+ * - File descriptor of the socket to send the frame over
  *
  * Returns:
  * -  0 on success
  * - -1 if any passed pointer is unexpectedly NULL
  * -  errno if an error occurs while sending
+ *
+ * Notes:
+ * - An unmasked frame takes a single call to the kernel. A masked one is
+ * copied in chunks of 16 KiB, the first of which carries the header
  */
 int fpx_websocketframe_send(const fpx_websocketframe_t *, int filedescriptor);
 
+/**
+ * Send a number of websocket frames over the wire, in order
+ *
+ * Input:
+ * - Pointer to an array of websocket frames
+ * - The amount of frames in the array
+ * - File descriptor of the socket to send the frames over
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * -  errno if an error occurs while sending
+ *
+ * Notes:
+ * - Up to 64 unmasked frames go out per call to the kernel. Masked frames
+ * are sent by themselves, as with fpx_websocketframe_send()
+ * - On error, an unknown amount of the frames has been sent
+ */
+int fpx_websocketframe_send_batch(const fpx_websocketframe_t *, size_t count,
+                                  int filedescriptor);
+
 /**
  * Frees all associated memory allocations to prepare for object destruction
  *
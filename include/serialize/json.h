@@ -1,7 +1,7 @@
 #ifndef FPX_JSON_H
 #define FPX_JSON_H
 
-#include "../alloc/arena.h"
+#include "../alloc/bump.h"
 
 #include "../fpx_types.h"
 
@@ -11,6 +11,12 @@ typedef struct _fpx_json_value Fpx_Json_Value;
 typedef struct _fpx_json_string Fpx_Json_String;
 typedef struct _fpx_json_object Fpx_Json_Object;
 typedef struct _fpx_json_array Fpx_Json_Array;
+typedef struct _fpx_json_writer Fpx_Json_Writer;
+typedef struct _fpx_json_callbacks Fpx_Json_Callbacks;
+typedef struct _fpx_json_stream Fpx_Json_Stream;
+
+/* the deepest nesting Fpx_Json_Writer keeps track of */
+#define FPX_JSON_WRITER_MAX_DEPTH 64
 
 typedef enum _fpx_json_result {
   FPX_JSON_RESULT_SUCCESS = 0,
@@ -18,6 +24,7 @@ typedef enum _fpx_json_result {
   FPX_JSON_RESULT_SYNTAX_ERROR = -2,
   FPX_JSON_RESULT_MEMORY_ERROR = -3,
   FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR = -4,
+  FPX_JSON_RESULT_ABORTED = -5,
 } Fpx_Json_E_Result;
 
 typedef enum {
@@ -63,18 +70,340 @@ struct _fpx_json_value {
   };
 };
 
+/**
+ *  Where a writer sends its buffer once it is full, or once it finishes
+ *
+ *  Input:
+ *  - The context pointer the writer was set up with
+ *  - The data to take
+ *  - The length of that data
+ *
+ *  Returns:
+ *  - 0 on success, anything else makes the writer stop with
+ *    FPX_JSON_RESULT_MEMORY_ERROR
+ *
+ *  fpx_httpresponse_body_sink() has this shape, and appends to the body of
+ *  the fpx_httpresponse_t it gets as context
+ */
+typedef int (*Fpx_Json_Flush)(void *context, const char *data, size_t len);
+
+struct _fpx_json_writer {
+  char *buffer;
+  size_t capacity;
+  size_t length; // bytes in the buffer right now
+
+  Fpx_Json_Flush flush; // NULL when the buffer is all there is
+  void *context;
+
+  size_t written; // bytes handed to flush so far
+
+  unsigned int indent; // spaces per level; 0 writes everything on one line
+
+  size_t depth; // containers that are open right now
+  uint8_t levels[FPX_JSON_WRITER_MAX_DEPTH + 1]; // [0] is the top level
+
+  bool after_key;
+
+  Fpx_Json_E_Result error; // the first thing that went wrong
+};
+
+/**
+ *  What a streaming parser calls for everything it comes across; any of
+ *  them may be NULL. Returning anything other than 0 stops the parser with
+ *  FPX_JSON_RESULT_ABORTED
+ *
+ *  Keys and strings are unescaped, are NOT NULL-terminated, and are only
+ *  valid during the call
+ */
+struct _fpx_json_callbacks {
+  int (*start_object)(void *context);
+  int (*end_object)(void *context);
+  int (*start_array)(void *context);
+  int (*end_array)(void *context);
+
+  int (*key)(void *context, const char *key, size_t len);
+
+  int (*string)(void *context, const char *string, size_t len);
+  int (*number)(void *context, double number);
+  int (*boolean)(void *context, bool boolean);
+  int (*null)(void *context);
+};
+
+struct _fpx_json_stream {
+  const Fpx_Json_Callbacks *callbacks;
+  void *context;
+
+  size_t max_depth; // deepest nesting that is accepted
+  size_t max_token; // longest string or number that is accepted, in bytes
+
+  uint8_t *stack; // HEAP; one entry per open container
+  size_t depth;
+  size_t stack_capacity;
+
+  char *token; // HEAP; the string or number that the last chunk ended in
+  size_t token_len;
+  size_t token_capacity;
+
+  // where in the grammar the parser is; see json.c
+  uint8_t state;
+  uint8_t escape;
+  uint8_t hex_count;
+  uint8_t literal_matched;
+  const char *literal;
+  bool in_key;
+  bool gap; // whitespace came after the last top-level value
+  uint32_t code_unit;
+  uint32_t high_surrogate;
+
+  size_t offset; // bytes of input taken so far
+  size_t values; // top-level values completed so far
+
+  Fpx_Json_E_Result error; // the first thing that went wrong
+};
+
 struct _fpx_json_entity {
-  fpx_arena *arena;
+  fpx_bump *arena;
 
   Fpx_Json_Value root;
 
   bool isValid;
 };
 
+/**
+ *  Parses a complete JSON document into a tree
+ *
+ *  Input:
+ *  - The document, which need not be NULL-terminated
+ *  - The length of the document (at most 4 GiB)
+ *
+ *  Returns:
+ *  - An entity whose `isValid` is true, with the tree under `root`; it owns
+ *    everything in it, and is freed with fpx_json_destroy()
+ *  - An entity whose `isValid` is false if the document does not parse
+ *
+ *  The structure of the document is found 64 bytes at a time with SIMD
+ *  (stage 1), at about 2 GB/s. Building the tree from that (stage 2) takes
+ *  about two and a half times as long again, so a whole document parses at
+ *  roughly 400-700 MB/s, which is short of GB/s. That time is spread over
+ *  the work done per value: copying strings into the arena, converting
+ *  numbers, and walking into and out of every container
+ */
 Fpx_Json_Entity fpx_json_read(const char *json_data, size_t data_len);
 
 Fpx_Json_E_Result fpx_json_destroy(Fpx_Json_Entity *);
 
 void fpx_json_print(Fpx_Json_Entity *);
 
+/**
+ *  Looks up a member of an object by key
+ *
+ *  Input:
+ *  - Pointer to the entity the object is part of (may be NULL, see below)
+ *  - Pointer to the object
+ *  - The key, which need not be NULL-terminated
+ *  - The length of that key
+ *
+ *  Returns:
+ *  - Pointer to the value of the first member with that key
+ *  - NULL if there is no such member, or a pointer is NULL
+ *
+ *  Small objects are simply scanned. Bigger ones get a hash index the first
+ *  time they are looked in, which lives in the arena of the entity; without
+ *  an entity they are scanned as well. An object passed with an entity must
+ *  have been parsed into that entity. Building the index writes to the
+ *  arena, so lookups on one entity must not happen from several threads at
+ *  once
+ */
+Fpx_Json_Value *fpx_json_object_get(Fpx_Json_Entity *, Fpx_Json_Object *,
+                                    const char *key, size_t key_len);
+
+/**
+ *  Looks up a value by JSON Pointer (RFC 6901), like "/users/0/name"
+ *
+ *  Input:
+ *  - Pointer to the entity
+ *  - Pointer to the value to start from (or NULL for the root)
+ *  - The pointer, which need not be NULL-terminated; "" is the start itself
+ *  - The length of that pointer
+ *
+ *  Returns:
+ *  - Pointer to the value
+ *  - NULL if there is no such value, or the pointer is malformed
+ *
+ *  Objects along the way are looked in with fpx_json_object_get()
+ */
+Fpx_Json_Value *fpx_json_pointer_get(Fpx_Json_Entity *, Fpx_Json_Value *from,
+                                     const char *pointer, size_t len);
+
+/**
+ *  Serializes a parsed document as JSON text
+ *
+ *  Input:
+ *  - Pointer to the entity
+ *  - The buffer to write to
+ *  - The size of that buffer
+ *  - Pointer to store the amount of characters written at (may be NULL)
+ *  - Spaces per level of nesting; 0 leaves out all whitespace
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS on success
+ *  - FPX_JSON_RESULT_ARGUMENT_ERROR if a pointer is NULL or the entity is
+ *    not valid
+ *  - FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR if the buffer is too small
+ *
+ *  Null-terminates the string if there is room, otherwise leaves it as is
+ */
+Fpx_Json_E_Result fpx_json_serialize(const Fpx_Json_Entity *, char *output,
+                                     size_t buflen, size_t *written,
+                                     unsigned int indent);
+
+/**
+ *  Sets up a writer, which builds JSON text one token at a time
+ *
+ *  Input:
+ *  - Pointer to the writer
+ *  - The buffer to write to
+ *  - The size of that buffer
+ *  - Where to send the buffer whenever it fills up (or NULL, in which case
+ *    running out of buffer is an error)
+ *  - Context pointer to pass to that
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS on success
+ *  - FPX_JSON_RESULT_ARGUMENT_ERROR if the writer or buffer is NULL, or the
+ *    buffer size is 0
+ *
+ *  All of the fpx_json_writer_*() functions below return the first error
+ *  the writer ran into, and do nothing once there is one:
+ *  - FPX_JSON_RESULT_SYNTAX_ERROR if the call would make the text invalid,
+ *    like a value in an object without a key, or nesting deeper than
+ *    FPX_JSON_WRITER_MAX_DEPTH
+ *  - FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR if the buffer is full and there is
+ *    no flush function
+ *  - FPX_JSON_RESULT_MEMORY_ERROR if the flush function failed
+ */
+Fpx_Json_E_Result fpx_json_writer_init(Fpx_Json_Writer *, char *buffer,
+                                       size_t buflen, Fpx_Json_Flush flush,
+                                       void *context);
+
+/**
+ *  Makes the writer put every entry on its own line, `indent` spaces deeper
+ *  per level; 0 (the default) leaves out all whitespace
+ */
+Fpx_Json_E_Result fpx_json_writer_set_indent(Fpx_Json_Writer *,
+                                             unsigned int indent);
+
+Fpx_Json_E_Result fpx_json_writer_begin_object(Fpx_Json_Writer *);
+Fpx_Json_E_Result fpx_json_writer_end_object(Fpx_Json_Writer *);
+Fpx_Json_E_Result fpx_json_writer_begin_array(Fpx_Json_Writer *);
+Fpx_Json_E_Result fpx_json_writer_end_array(Fpx_Json_Writer *);
+
+/**
+ *  Writes the key of the next member of the current object; strings are
+ *  escaped as they are written, and need not be NULL-terminated
+ */
+Fpx_Json_E_Result fpx_json_writer_key(Fpx_Json_Writer *, const char *key,
+                                      size_t len);
+
+Fpx_Json_E_Result fpx_json_writer_string(Fpx_Json_Writer *, const char *,
+                                         size_t len);
+
+/**
+ *  Writes the shortest text that reads back as the same double;
+ *  NaN and the infinities have no JSON form, and are written as null
+ */
+Fpx_Json_E_Result fpx_json_writer_number(Fpx_Json_Writer *, double);
+Fpx_Json_E_Result fpx_json_writer_int(Fpx_Json_Writer *, int64_t);
+Fpx_Json_E_Result fpx_json_writer_bool(Fpx_Json_Writer *, bool);
+Fpx_Json_E_Result fpx_json_writer_null(Fpx_Json_Writer *);
+
+/**
+ *  Writes a parsed value, and everything inside of it
+ */
+Fpx_Json_E_Result fpx_json_writer_value(Fpx_Json_Writer *,
+                                        const Fpx_Json_Value *);
+
+/**
+ *  Sends whatever is still in the buffer to the flush function, or
+ *  null-terminates the buffer if there is no flush function and there is
+ *  room for it
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS if exactly one complete value was written
+ *  - FPX_JSON_RESULT_SYNTAX_ERROR if there is nothing yet, or a container
+ *    is still open
+ *  - The first error the writer ran into otherwise
+ *
+ *  The total length of the text is `written + length` afterwards
+ */
+Fpx_Json_E_Result fpx_json_writer_finish(Fpx_Json_Writer *);
+
+/**
+ *  Sets up a streaming (push) parser, which takes a document in chunks of
+ *  any size and calls back for every value in it, instead of building a tree
+ *
+ *  Input:
+ *  - Pointer to the parser
+ *  - The callbacks to call (must stay around while parsing)
+ *  - Context pointer to pass to them
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS on success
+ *  - FPX_JSON_RESULT_ARGUMENT_ERROR if a pointer is NULL
+ *
+ *  `max_depth` and `max_token` get defaults from the implementation file and
+ *  may be changed at any point afterwards. Memory use is bounded by those
+ *  two, not by the size of the document
+ */
+Fpx_Json_E_Result fpx_json_stream_init(Fpx_Json_Stream *,
+                                       const Fpx_Json_Callbacks *,
+                                       void *context);
+
+/**
+ *  Parses the next chunk of the document
+ *
+ *  Input:
+ *  - Pointer to the parser
+ *  - The chunk
+ *  - The length of that chunk
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS if everything so far is fine
+ *  - FPX_JSON_RESULT_ARGUMENT_ERROR if a pointer is NULL
+ *  - FPX_JSON_RESULT_SYNTAX_ERROR if the input is not valid JSON
+ *  - FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR if the input nests deeper than
+ *    `max_depth`, or has a string or number longer than `max_token`
+ *  - FPX_JSON_RESULT_MEMORY_ERROR if any memory allocation fails
+ *  - FPX_JSON_RESULT_ABORTED if a callback asked to stop
+ *
+ *  Errors stick: once there is one, every later call returns it, and
+ *  `offset` tells how far into the input it was found.
+ *  The input is strict JSON, except that it may hold any number of
+ *  top-level values separated by whitespace (like JSON Lines).
+ *  Strings are not checked for valid UTF-8
+ */
+Fpx_Json_E_Result fpx_json_stream_feed(Fpx_Json_Stream *, const char *chunk,
+                                       size_t len);
+
+/**
+ *  Tells the parser that there is no more input
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS if the input held at least one complete value
+ *  - FPX_JSON_RESULT_SYNTAX_ERROR if it held nothing but whitespace
+ *  - FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR if it ended in the middle of a
+ *    value
+ *  - The same as fpx_json_stream_feed() otherwise
+ */
+Fpx_Json_E_Result fpx_json_stream_finish(Fpx_Json_Stream *);
+
+/**
+ *  Frees the memory held by a streaming parser
+ *
+ *  Returns:
+ *  - FPX_JSON_RESULT_SUCCESS on success
+ *  - FPX_JSON_RESULT_ARGUMENT_ERROR if the pointer is NULL
+ */
+Fpx_Json_E_Result fpx_json_stream_destroy(Fpx_Json_Stream *);
+
 #endif // FPX_JSON_H
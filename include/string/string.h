@@ -7,6 +7,18 @@
 //  Author: Erynn 'foorpyxof' Scholtes
 //
 
+#include "../alloc/arena.h"
+#include "../fpx_types.h"
+
+typedef struct _fpx_strview fpx_strview_t;
+typedef struct _fpx_strbuf fpx_strbuf_t;
+
+/**
+ * Makes a view of a string literal, measured at compile time
+ */
+#define FPX_STRVIEW_LITERAL(literal)                                           \
+  ((fpx_strview_t){(literal), sizeof(literal) - 1})
+
 // _Generics don't seem to work :/
 /*
 #define fpx_string_to_upper(input) _Generic(    \
@@ -35,7 +47,8 @@ extern int fpx_getstringlength(const char *);
 extern char *fpx_strcpy(char *dst, const char *src);
 
 /**
- * Returns the index of a given substring within a string.
+ * Returns the index of the first occurence of a given substring within a
+ * string, or -1 if it does not occur. An empty substring is found at 0.
  */
 int fpx_substringindex(const char *haystack, const char *needle);
 
@@ -61,4 +74,240 @@ char *fpx_string_to_upper(const char *input, int doReturn);
  */
 char *fpx_string_to_lower(const char *input, int doReturn);
 
+/**
+ * Makes a view of a NULL-terminated string, measuring it once
+ *
+ * Input:
+ * - The string (may be NULL, which gives an empty view)
+ *
+ * Returns:
+ * - A view of the string, without the NULL-byte
+ */
+fpx_strview_t fpx_strview(const char *);
+
+/**
+ * Makes a view of part of another view
+ *
+ * Input:
+ * - The view to take a part of
+ * - Where the part starts
+ * - The length of the part
+ *
+ * Returns:
+ * - The part, cut short where it would go past the end of the view
+ */
+fpx_strview_t fpx_strview_slice(fpx_strview_t, size_t start, size_t len);
+
+/**
+ * Checks whether two views hold the same bytes
+ *
+ * Returns:
+ * - TRUE if they do
+ * - FALSE otherwise
+ */
+int fpx_strview_equals(fpx_strview_t, fpx_strview_t);
+
+/**
+ * Checks whether two views hold the same text, ignoring the case of ASCII
+ * letters
+ *
+ * Returns:
+ * - TRUE if they do
+ * - FALSE otherwise
+ */
+int fpx_strview_equals_nocase(fpx_strview_t, fpx_strview_t);
+
+/**
+ * Finds the first occurence of a substring
+ *
+ * Input:
+ * - The view to search in
+ * - The view to search for
+ *
+ * Returns:
+ * - The index of the substring (0 for an empty one)
+ * - -1 if it does not occur
+ */
+int64_t fpx_strview_find(fpx_strview_t haystack, fpx_strview_t needle);
+
+/**
+ * Writes a string to a buffer, with the first occurence of a substring
+ * replaced by another string
+ *
+ * Input:
+ * - The view to copy from
+ * - The view to replace
+ * - The view to replace it with
+ * - Pointer to the output buffer (must not overlap the views)
+ * - Size of the output buffer in bytes
+ * - Pointer to store the number of bytes written in (may be NULL)
+ *
+ * Returns:
+ * -  0 if the substring was replaced
+ * -  1 if it did not occur; the input is copied as is
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if the output buffer is too small
+ *
+ * Notes:
+ * - The output is not NULL-terminated
+ */
+int fpx_strview_replace(fpx_strview_t haystack, fpx_strview_t needle,
+                        fpx_strview_t replacement, char *output,
+                        size_t output_len, size_t *output_written);
+
+/**
+ * Writes the uppercase variant of a view to a buffer
+ *
+ * Input:
+ * - The view to convert
+ * - Pointer to the output buffer; it must hold at least as many bytes as the
+ * view, and may be the view's own data
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ */
+int fpx_strview_to_upper(fpx_strview_t, char *output);
+
+/**
+ * Writes the lowercase variant of a view to a buffer
+ *
+ * Input:
+ * - The view to convert
+ * - Pointer to the output buffer; it must hold at least as many bytes as the
+ * view, and may be the view's own data
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ */
+int fpx_strview_to_lower(fpx_strview_t, char *output);
+
+/**
+ * Initializes a string builder
+ *
+ * Input:
+ * - Pointer to the builder to initialize
+ * - Pointer to an arena to allocate from, or NULL for the heap
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the builder pointer is unexpectedly NULL
+ *
+ * Notes:
+ * - When the arena is full, the builder moves to the heap
+ * - Blocks taken from the arena stay there until the arena is reset
+ */
+int fpx_strbuf_init(fpx_strbuf_t *, fpx_arena *);
+
+/**
+ * Makes sure a number of bytes can be appended without allocating again
+ *
+ * Input:
+ * - Pointer to the builder
+ * - How many bytes will be appended
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the builder pointer is unexpectedly NULL
+ * - -2 if memory allocation fails
+ */
+int fpx_strbuf_reserve(fpx_strbuf_t *, size_t additional);
+
+/**
+ * Appends bytes to the builder
+ *
+ * Input:
+ * - Pointer to the builder
+ * - The bytes to append
+ * - How many bytes to append
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if memory allocation fails
+ */
+int fpx_strbuf_append(fpx_strbuf_t *, const char *data, size_t len);
+
+/**
+ * Appends a view to the builder
+ *
+ * Returns:
+ * - The same as fpx_strbuf_append()
+ */
+int fpx_strbuf_append_view(fpx_strbuf_t *, fpx_strview_t);
+
+/**
+ * Appends a single character to the builder
+ *
+ * Returns:
+ * - The same as fpx_strbuf_append()
+ */
+int fpx_strbuf_append_char(fpx_strbuf_t *, char);
+
+/**
+ * Appends the decimal form of an integer to the builder
+ *
+ * Returns:
+ * - The same as fpx_strbuf_append()
+ */
+int fpx_strbuf_append_int(fpx_strbuf_t *, int64_t);
+
+/**
+ * Appends printf-style formatted text to the builder
+ *
+ * Input:
+ * - Pointer to the builder
+ * - The format string
+ * - The arguments for the format string
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if any passed pointer is unexpectedly NULL
+ * - -2 if memory allocation fails
+ * - -3 if the text could not be formatted
+ */
+int fpx_strbuf_appendf(fpx_strbuf_t *, const char *format, ...);
+
+/**
+ * Makes a view of everything appended so far
+ *
+ * Returns:
+ * - The view; it is only valid until the builder changes
+ */
+fpx_strview_t fpx_strbuf_view(const fpx_strbuf_t *);
+
+/**
+ * Empties the builder, keeping its memory for reuse
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the builder pointer is unexpectedly NULL
+ */
+int fpx_strbuf_clear(fpx_strbuf_t *);
+
+/**
+ * Frees all associated memory allocations to prepare for object destruction
+ *
+ * Returns:
+ * -  0 on success
+ * - -1 if the builder pointer is unexpectedly NULL
+ */
+int fpx_strbuf_destroy(fpx_strbuf_t *);
+
+struct _fpx_strview {
+  const char *data; // not NULL-terminated
+  size_t len;
+};
+
+struct _fpx_strbuf {
+  // HEAP or ARENA; NULL-terminated whenever `allocated` is not 0
+  char *data;
+  size_t len;
+  size_t allocated;
+
+  fpx_arena *arena; // tried first whenever the builder grows
+  uint8_t in_arena;
+};
+
 #endif /* FPX_STRING_H */
@@ -0,0 +1,57 @@
+#ifndef FPX_TEST_BENCH_H
+#define FPX_TEST_BENCH_H
+
+//
+//  "bench.h"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+// Timing and reporting helpers shared by the benchmarks in src/*/test.c.
+// The correctness checks for the same code live in src/test/*.cpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_BYTES (1 << 28) /* bytes handled per measurement */
+
+// keeps the compiler from hoisting pure calls out of the timed loops
+#define BENCH_CLOBBER(ptr) __asm__ volatile("" : : "r"(ptr) : "memory")
+
+static inline double bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t bench_random(void) {
+  // xorshift64, so every run sees the same numbers
+  static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static inline void bench_report_header(const char *what, const char *old_name,
+                                       const char *new_name) {
+  printf("%-16s %14s %14s %8s\n", what, old_name, new_name, "speedup");
+}
+
+static inline void bench_report_bytes(size_t size, double bytes,
+                                      double old_time, double new_time) {
+  // `bytes` is the total amount handled by each of the two measurements
+  double mbytes = bytes / (1 << 20);
+  printf("%-16zu %9.0f MB/s %9.0f MB/s %7.2fx\n", size, mbytes / old_time,
+         mbytes / new_time, old_time / new_time);
+}
+
+static inline void bench_report_calls(const char *name, double calls,
+                                      double old_time, double new_time) {
+  printf("%-16s %11.1f ns %11.1f ns %7.2fx\n", name, old_time * 1e9 / calls,
+         new_time * 1e9 / calls, old_time / new_time);
+}
+
+#endif // FPX_TEST_BENCH_H
@@ -324,6 +324,22 @@ int fpx_arena_free(fpx_arena *arenaptr, void *data) {
   return 1;
 }
 
+int fpx_arena_reset(fpx_arena *ptr) {
+  if (NULL == ptr)
+    return -1;
+
+  // back to the single free region fpx_arena_create() starts out with
+  fpx_region *reg = ptr->__regions;
+  reg->__next_offset = reg->__prev_offset = UINT64_MAX;
+  reg->__data = (uint8_t *)ptr + FPX_ARENA_META_SPACE;
+  reg->__length = ptr->__size;
+  reg->__is_free = 0x1;
+
+  ptr->__region_count = 1;
+
+  return 0;
+}
+
 static int _fpx_arena_double_reg_cap(fpx_arena *ptr) {
   if (NULL == ptr)
     return -1;
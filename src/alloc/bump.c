@@ -0,0 +1,130 @@
+//
+//  "bump.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+#include "alloc/bump.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define BUMP_ALIGN 8          /* enough for pointers, size_t and double */
+#define BUMP_MIN_CHUNK 4096   /* no chunk is smaller than this */
+#define BUMP_MAX_CHUNK (64 << 20) /* doubling stops here */
+
+typedef struct __fpx_bump_chunk _bump_chunk;
+
+struct __fpx_bump_chunk {
+  _bump_chunk *next;
+  size_t size;
+  size_t used;
+
+  // the memory that is handed out follows right after
+};
+
+struct __fpx_bump {
+  _bump_chunk *first;
+  _bump_chunk *current;
+
+  size_t next_size; // size of the next chunk that gets chained on
+};
+
+#define CHUNK_HEADER                                                           \
+  ((sizeof(_bump_chunk) + BUMP_ALIGN - 1) & ~(size_t)(BUMP_ALIGN - 1))
+#define CHUNK_DATA(_chunk) ((uint8_t *)(_chunk) + CHUNK_HEADER)
+
+static _bump_chunk *_chunk_create(size_t size);
+
+fpx_bump *fpx_bump_create(size_t chunk_size) {
+  if (BUMP_MIN_CHUNK > chunk_size)
+    chunk_size = BUMP_MIN_CHUNK;
+
+  fpx_bump *bump = (fpx_bump *)malloc(sizeof(fpx_bump));
+  if (NULL == bump)
+    return NULL;
+
+  bump->first = bump->current = _chunk_create(chunk_size);
+  if (NULL == bump->first) {
+    free(bump);
+    return NULL;
+  }
+
+  bump->next_size = chunk_size;
+
+  return bump;
+}
+
+int fpx_bump_destroy(fpx_bump *bump) {
+  if (NULL == bump)
+    return -1;
+
+  _bump_chunk *chunk = bump->first;
+  while (NULL != chunk) {
+    _bump_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  free(bump);
+
+  return 0;
+}
+
+void *fpx_bump_alloc(fpx_bump *bump, size_t size) {
+  if (NULL == bump || 1 > size)
+    return NULL;
+
+  if (SIZE_MAX - BUMP_ALIGN - CHUNK_HEADER < size)
+    return NULL;
+
+  size = (size + BUMP_ALIGN - 1) & ~(size_t)(BUMP_ALIGN - 1);
+
+  _bump_chunk *chunk = bump->current;
+
+  // after a reset, the chunks that come after the current one are empty
+  while (chunk->size - chunk->used < size) {
+    if (NULL == chunk->next) {
+      if (BUMP_MAX_CHUNK > bump->next_size)
+        bump->next_size *= 2;
+
+      chunk->next =
+          _chunk_create((size > bump->next_size) ? size : bump->next_size);
+      if (NULL == chunk->next)
+        return NULL;
+    }
+
+    chunk = chunk->next;
+  }
+
+  bump->current = chunk;
+
+  void *data = CHUNK_DATA(chunk) + chunk->used;
+  chunk->used += size;
+
+  return data;
+}
+
+int fpx_bump_reset(fpx_bump *bump) {
+  if (NULL == bump)
+    return -1;
+
+  for (_bump_chunk *chunk = bump->first; NULL != chunk; chunk = chunk->next)
+    chunk->used = 0;
+
+  bump->current = bump->first;
+
+  return 0;
+}
+
+static _bump_chunk *_chunk_create(size_t size) {
+  _bump_chunk *chunk = (_bump_chunk *)malloc(CHUNK_HEADER + size);
+  if (NULL == chunk)
+    return NULL;
+
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
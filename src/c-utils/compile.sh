@@ -0,0 +1,15 @@
+#!/bin/bash
+
+CFLAGS="-g -O3"
+
+gcc \
+  test.c \
+  format.c \
+  crypto.c \
+  endian.c \
+  ../mem/mem.c \
+  ../math/math.c \
+  -I../../include \
+  $CFLAGS \
+  -o c.out \
+  -lm
@@ -14,14 +14,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#define SHL(value, bits) (value << bits)
-#define SHR(value, bits) (value >> bits)
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRYPTO_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
-#define ROL(value, bits, size) ((value << bits) | (value >> (size - bits)))
-#define ROR(value, bits, size) ((value >> bits) | (value << (size - bits)))
+#define SHA_BLOCK 64 /* SHA-1 and SHA-256 both work on 64-byte blocks */
+#define SHA_LENGTH_AT 56 /* where the padding puts the message length */
+#define MB_LANES 8 /* messages hashed side by side by the AVX2 code */
+#define CPUID_7_EBX_SHA (1u << 29)
 
-#define CH(x, y, z) ((x & y) ^ ((~x) & z))
-#define MAJ(x, y, z) ((x & y) ^ (x & z) ^ (y & z))
+#define SHL(value, bits) ((value) << (bits))
+#define SHR(value, bits) ((value) >> (bits))
+
+#define ROL(value, bits, size)                                                 \
+  (((value) << (bits)) | ((value) >> ((size) - (bits))))
+#define ROR(value, bits, size)                                                 \
+  (((value) >> (bits)) | ((value) << ((size) - (bits))))
+
+#define CH(x, y, z) (((x) & (y)) ^ ((~(x)) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
 
 #define SHA256_BSIG0(x, size)                                                  \
   (ROR(x, 2, size) ^ ROR(x, 13, size) ^ ROR(x, 22, size))
@@ -31,192 +44,107 @@
 #define SHA256_SSIG0(x, size) (ROR(x, 7, size) ^ ROR(x, 18, size) ^ SHR(x, 3))
 #define SHA256_SSIG1(x, size) (ROR(x, 17, size) ^ ROR(x, 19, size) ^ SHR(x, 10))
 
-void fpx_sha1_init(SHA1_Context *ctx_ptr) {
-  ctx_ptr->state[0] = 0x67452301;
-  ctx_ptr->state[1] = 0xEFCDAB89;
-  ctx_ptr->state[2] = 0x98BADCFE;
-  ctx_ptr->state[3] = 0x10325476;
-  ctx_ptr->state[4] = 0xC3D2E1F0;
-
-  ctx_ptr->count = 0;
-}
-
-static void _sha1_0to19(uint32_t *words, uint32_t *vals, int8_t debug) {
-  uint32_t temp;
-  uint32_t *a = &vals[0];
-  uint32_t *b = &vals[1];
-  uint32_t *c = &vals[2];
-  uint32_t *d = &vals[3];
-  uint32_t *e = &vals[4];
-
-  for (int i = 0; i < 20; i++) {
-    if (debug)
-      printf("%08x%08x%08x%08x%08x\n", *a, *b, *c, *d, *e);
-    if (debug)
-      printf("%08x | %08x\n", ((*b & *c) | ((~*b) & *d)), 0x5A827999);
-    if (debug)
-      printf("W[%d]%08x\n", i, words[i]);
-    temp = ROL(*a, 5, 32) + *e + words[i] + ((*b & *c) | ((~*b) & *d)) +
-           0x5A827999;
-    *e = *d;
-    *d = *c;
-    *c = ROL(*b, 30, 32);
-    *b = *a;
-    *a = temp;
+// hashes `blocks` consecutive 64-byte blocks into the state
+typedef void (*_sha_kernel)(uint32_t *state, const uint8_t *data,
+                            size_t blocks);
+
+// a message as the multi-buffer code sees it: whole blocks straight from the
+// input, followed by one or two padded blocks of its own
+typedef struct {
+  const uint8_t *data;
+  size_t full;
+  size_t total;
+  uint8_t tail[2 * SHA_BLOCK];
+} _sha_lane;
+
+static const uint32_t _sha1_initial[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+static const uint32_t _sha256_initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+static const uint32_t _sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t _load_be32(const uint8_t *);
+static void _store_be32(uint8_t *, uint32_t);
+static void _sha_update(uint32_t *state, uint64_t *count, uint8_t *buffer,
+                        const uint8_t *data, size_t len, _sha_kernel);
+static void _sha_finish(uint32_t *state, uint64_t count, uint8_t *buffer,
+                        _sha_kernel);
+static void _sha_lane_setup(_sha_lane *, const uint8_t *data, size_t len);
+static const uint8_t *_sha_lane_block(const _sha_lane *, size_t index);
+
+static void _sha1_generic(uint32_t *, const uint8_t *, size_t);
+static void _sha256_generic(uint32_t *, const uint8_t *, size_t);
+
+#if defined(CRYPTO_X86)
+static void _sha1_shani(uint32_t *, const uint8_t *, size_t);
+static void _sha256_shani(uint32_t *, const uint8_t *, size_t);
+static void _sha1_many_avx2(const uint8_t *const[], const size_t[], size_t,
+                            uint8_t[][20]);
+static void _sha256_many_avx2(const uint8_t *const[], const size_t[], size_t,
+                              uint8_t[][32]);
+
+static uint8_t _use_many_avx2 = FALSE;
+#endif
+
+// the plain C kernels until the CPU has been looked at
+static _sha_kernel _sha1_blocks = _sha1_generic;
+static _sha_kernel _sha256_blocks = _sha256_generic;
+
+#if defined(CRYPTO_X86)
+__attribute__((constructor)) static void _pick_kernels(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  __builtin_cpu_init();
+
+  uint8_t has_sha = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+                    (ebx & CPUID_7_EBX_SHA) &&
+                    __builtin_cpu_supports("sse4.1");
+
+  if (has_sha) {
+    _sha1_blocks = _sha1_shani;
+    _sha256_blocks = _sha256_shani;
   }
-}
 
-static void _sha1_20to39(uint32_t *words, uint32_t *vals, int8_t debug) {
-  uint32_t temp;
-  uint32_t *a = &vals[0];
-  uint32_t *b = &vals[1];
-  uint32_t *c = &vals[2];
-  uint32_t *d = &vals[3];
-  uint32_t *e = &vals[4];
-
-  for (int i = 20; i < 40; i++) {
-    if (debug)
-      printf("%08x%08x%08x%08x%08x\n", *a, *b, *c, *d, *e);
-    if (debug)
-      printf("%08x | %08x\n", (*b ^ *c ^ *d), 0x6ED9EBA1);
-    if (debug)
-      printf("W[%d]%08x\n", i, words[i]);
-    temp = ROL(*a, 5, 32) + *e + words[i] + (*b ^ *c ^ *d) + 0x6ED9EBA1;
-    *e = *d;
-    *d = *c;
-    *c = ROL(*b, 30, 32);
-    *b = *a;
-    *a = temp;
-  }
+  // one message at a time through the SHA extensions still beats eight
+  // side by side in AVX2 registers
+  _use_many_avx2 = !has_sha && __builtin_cpu_supports("avx2");
 }
+#endif
 
-static void _sha1_40to59(uint32_t *words, uint32_t *vals, int8_t debug) {
-  uint32_t temp;
-  uint32_t *a = &vals[0];
-  uint32_t *b = &vals[1];
-  uint32_t *c = &vals[2];
-  uint32_t *d = &vals[3];
-  uint32_t *e = &vals[4];
-
-  for (int i = 40; i < 60; i++) {
-    if (debug)
-      printf("%08x%08x%08x%08x%08x\n", *a, *b, *c, *d, *e);
-    if (debug)
-      printf("%08x | %08x\n", ((*b & *c) | (*b & *d) | (*c & *d)), 0x8F1BBCDC);
-    if (debug)
-      printf("W[%d]%08x\n", i, words[i]);
-    temp = ROL(*a, 5, 32) + *e + words[i] +
-           ((*b & *c) | (*b & *d) | (*c & *d)) + 0x8F1BBCDC;
-    *e = *d;
-    *d = *c;
-    *c = ROL(*b, 30, 32);
-    *b = *a;
-    *a = temp;
-  }
-}
+void fpx_sha1_init(SHA1_Context *ctx_ptr) {
+  fpx_memcpy(ctx_ptr->state, _sha1_initial, sizeof(ctx_ptr->state));
 
-static void _sha1_60to79(uint32_t *words, uint32_t *vals, int8_t debug) {
-  uint32_t temp;
-  uint32_t *a = &vals[0];
-  uint32_t *b = &vals[1];
-  uint32_t *c = &vals[2];
-  uint32_t *d = &vals[3];
-  uint32_t *e = &vals[4];
-
-  for (int i = 60; i < 80; i++) {
-    if (debug)
-      printf("%08x%08x%08x%08x%08x\n", *a, *b, *c, *d, *e);
-    if (debug)
-      printf("%08x | %08x\n", (*b ^ *c ^ *d), 0xCA62C1D6);
-    if (debug)
-      printf("W[%d]%08x\n", i, words[i]);
-    temp = ROL(*a, 5, 32) + *e + words[i] + (*b ^ *c ^ *d) + 0xCA62C1D6;
-    *e = *d;
-    *d = *c;
-    *c = ROL(*b, 30, 32);
-    *b = *a;
-    *a = temp;
-  }
+  ctx_ptr->count = 0;
 }
 
 void fpx_sha1_transform(SHA1_Context *ctx_ptr, const uint8_t *buffer) {
-  uint32_t vals[5];
-  uint32_t W[80];
-
-  for (int i = 0; i < 16; i++) {
-    W[i] = (buffer[i * 4] << 24) | (buffer[i * 4 + 1] << 16) |
-           (buffer[i * 4 + 2] << 8) | (buffer[i * 4 + 3]);
-    // fpx_endian_swap(&W[i], 4);
-  }
-
-  for (int i = 16; i < 80; i++) {
-    W[i] = ROL((W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16]), 1, 32);
-  }
-  // for (int i = 0; i<80; i++) {
-  //   printf("W[%d]: %08x\n", i, W[i]);
-  // }
-
-  vals[0] = ctx_ptr->state[0];
-  vals[1] = ctx_ptr->state[1];
-  vals[2] = ctx_ptr->state[2];
-  vals[3] = ctx_ptr->state[3];
-  vals[4] = ctx_ptr->state[4];
-
-  _sha1_0to19(W, vals, 0);
-  _sha1_20to39(W, vals, 0);
-  _sha1_40to59(W, vals, 0);
-  _sha1_60to79(W, vals, 0);
-
-  ctx_ptr->state[0] += vals[0];
-  ctx_ptr->state[1] += vals[1];
-  ctx_ptr->state[2] += vals[2];
-  ctx_ptr->state[3] += vals[3];
-  ctx_ptr->state[4] += vals[4];
+  _sha1_blocks(ctx_ptr->state, buffer, 1);
 }
 
 void fpx_sha1_update(SHA1_Context *ctx_ptr, const uint8_t *data, size_t len) {
-  size_t i, j;
-
-  j = (ctx_ptr->count >> 3) & 63;
-  ctx_ptr->count += (uint64_t)len << 3;
-
-  if ((j + len) > 63) {
-    fpx_memcpy(&ctx_ptr->buffer[j], data, (i = 64 - j));
-    fpx_sha1_transform(ctx_ptr, ctx_ptr->buffer);
-    for (; i + 63 < len; i += 64) {
-      fpx_sha1_transform(ctx_ptr, &data[i]);
-    }
-    j = 0;
-  } else {
-    i = 0;
-  }
-
-  fpx_memcpy(&ctx_ptr->buffer[j], &data[i], len - i);
+  _sha_update(ctx_ptr->state, &ctx_ptr->count, ctx_ptr->buffer, data, len,
+              _sha1_blocks);
 }
 
 void fpx_sha1_final(SHA1_Context *ctx_ptr, uint8_t digest[20]) {
-  uint64_t finalcount = (uint64_t)ctx_ptr->count;
-  uint8_t c;
-
-  short bigEndianChecker = 1;
-  char bigEndian = (!*(char *)&bigEndianChecker) ? 1 : 0;
-
-  if (!bigEndian)
-    fpx_endian_swap(&finalcount, sizeof(finalcount));
-
-  c = 0x80;
-  fpx_sha1_update(ctx_ptr, &c, 1);
-  while ((ctx_ptr->count % 512) != 448) {
-    c = 0x00;
-    fpx_sha1_update(ctx_ptr, &c, 1);
-  }
-
-  fpx_sha1_update(ctx_ptr, (uint8_t *)&finalcount, 8);
+  _sha_finish(ctx_ptr->state, ctx_ptr->count, ctx_ptr->buffer, _sha1_blocks);
 
-  for (int i = 0; i < 20; i++) {
-    digest[i] =
-        (uint8_t)((ctx_ptr->state[i >> 2] >> ((3 - (i & 3)) * 8)) & 255);
-  }
+  for (int i = 0; i < 5; i++)
+    _store_be32(&digest[i * 4], ctx_ptr->state[i]);
 }
 
 void fpx_sha1_digest(const uint8_t *input, size_t lengthBytes, uint8_t *output,
@@ -238,140 +166,81 @@ void fpx_sha1_digest(const uint8_t *input, size_t lengthBytes, uint8_t *output,
   return;
 }
 
-void fpx_sha256_init(SHA256_Context *ctx_ptr) {
-  fpx_memset(ctx_ptr, 0, sizeof(SHA256_Context));
-
-  ctx_ptr->state[0] = 0x6a09e667;
-  ctx_ptr->state[1] = 0xbb67ae85;
-  ctx_ptr->state[2] = 0x3c6ef372;
-  ctx_ptr->state[3] = 0xa54ff53a;
-  ctx_ptr->state[4] = 0x510e527f;
-  ctx_ptr->state[5] = 0x9b05688c;
-  ctx_ptr->state[6] = 0x1f83d9ab;
-  ctx_ptr->state[7] = 0x5be0cd19;
-}
-
-void fpx_sha256_input(SHA256_Context *ctx_ptr, uint8_t *buffer,
-                      size_t length_bytes) {
-  if (ctx_ptr->buffer != NULL &&
-      (ctx_ptr->index + length_bytes + 9) / 64 > (ctx_ptr->index + 9) / 64)
-    ctx_ptr->buffer = (uint8_t *)realloc(
-        ctx_ptr->buffer, ((ctx_ptr->index + length_bytes + 9) / 64 + 1) * 64);
-
-  else if (ctx_ptr->buffer == NULL)
-    ctx_ptr->buffer = (uint8_t *)malloc(((length_bytes + 9) / 64 + 1) * 64);
+void fpx_sha1_digest_many(const uint8_t *const inputs[],
+                          const size_t lengths[], size_t count,
+                          uint8_t outputs[][20]) {
+  if (NULL == inputs || NULL == lengths || NULL == outputs)
+    return;
 
-  fpx_memset(ctx_ptr->buffer + ctx_ptr->index, 0, length_bytes);
-  fpx_memcpy(ctx_ptr->buffer, buffer, length_bytes);
+#if defined(CRYPTO_X86)
+  if (_use_many_avx2) {
+    _sha1_many_avx2(inputs, lengths, count, outputs);
+    return;
+  }
+#endif
 
-  ctx_ptr->index += length_bytes;
+  for (size_t i = 0; i < count; ++i)
+    fpx_sha1_digest(inputs[i], lengths[i], outputs[i], FALSE);
 }
 
-void fpx_sha256_pad(SHA256_Context *ctx_ptr) {
-  uint32_t buffer_length = ((ctx_ptr->index + 9) / 64 + 1) * 64;
-  uint64_t length_bits = ctx_ptr->index * 8;
-
-  // pad with 0's
-  fpx_memset(ctx_ptr->buffer + ctx_ptr->index, 0,
-             buffer_length - ctx_ptr->index);
-
-  // add '1' to the end of message
-  ctx_ptr->buffer[ctx_ptr->index] = 0x80;
+void fpx_sha256_init(SHA256_Context *ctx_ptr) {
+  fpx_memcpy(ctx_ptr->state, _sha256_initial, sizeof(ctx_ptr->state));
 
-  // add size in bits to end
-  fpx_endian_swap_if_little(&length_bits, 8);
-  fpx_memcpy(&ctx_ptr->buffer[buffer_length - 8], &length_bits, 8);
+  ctx_ptr->count = 0;
 }
 
-void fpx_sha256_transform(SHA256_Context *ctx_ptr, size_t offset) {
-  static uint32_t K[64] = {
-      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
-      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
-      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
-      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
-      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
-      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
-
-  uint32_t vals[8];
-  uint32_t W[64];
-
-  uint32_t temp1, temp2;
-
-  // fpx_memcpy(W, ctx_ptr->buffer, 16 * sizeof(uint32_t));
-
-  uint8_t *offset_buffer = ctx_ptr->buffer + offset;
+void fpx_sha256_update(SHA256_Context *ctx_ptr, const uint8_t *data,
+                       size_t len) {
+  _sha_update(ctx_ptr->state, &ctx_ptr->count, ctx_ptr->buffer, data, len,
+              _sha256_blocks);
+}
 
-  for (int i = 0; i < 16; ++i) {
-    W[i] = (((uint32_t)offset_buffer[i * 4]) << 24) |
-           (((uint32_t)offset_buffer[i * 4 + 1]) << 16) |
-           (((uint32_t)offset_buffer[i * 4 + 2]) << 8) |
-           (((uint32_t)offset_buffer[i * 4 + 3]));
-  }
+void fpx_sha256_transform(SHA256_Context *ctx_ptr, const uint8_t *buffer) {
+  _sha256_blocks(ctx_ptr->state, buffer, 1);
+}
 
-  for (int i = 16; i < 64; ++i)
-    W[i] = SHA256_SSIG1(W[i - 2], 32) + W[i - 7] + SHA256_SSIG0(W[i - 15], 32) +
-           W[i - 16];
+void fpx_sha256_final(SHA256_Context *ctx_ptr, uint8_t digest[32]) {
+  _sha_finish(ctx_ptr->state, ctx_ptr->count, ctx_ptr->buffer,
+              _sha256_blocks);
 
   for (int i = 0; i < 8; ++i)
-    vals[i] = ctx_ptr->state[i];
-
-  for (int i = 0; i < 64; ++i) {
-    temp1 = vals[7] + SHA256_BSIG1(vals[4], 32) +
-            CH(vals[4], vals[5], vals[6]) + K[i] + W[i];
-    temp2 = SHA256_BSIG0(vals[0], 32) + MAJ(vals[0], vals[1], vals[2]);
-    vals[7] = vals[6];
-    vals[6] = vals[5];
-    vals[5] = vals[4];
-    vals[4] = vals[3] + temp1;
-    vals[3] = vals[2];
-    vals[2] = vals[1];
-    vals[1] = vals[0];
-    vals[0] = temp1 + temp2;
-  }
-
-  for (int i = 0; i < 8; ++i) {
-    ctx_ptr->state[i] += vals[i];
-  }
+    _store_be32(&digest[i * 4], ctx_ptr->state[i]);
 }
 
 void fpx_sha256_digest(const uint8_t *input, size_t lengthBytes,
                        uint8_t *output, uint8_t printable) {
   SHA256_Context ctx;
+  uint8_t digest[32];
 
   fpx_sha256_init(&ctx);
-  fpx_sha256_input(&ctx, (uint8_t *)input, lengthBytes);
-  fpx_sha256_pad(&ctx);
-
-  int iters = (ctx.index + 9) / 64 + 1;
-  for (int i = 0; i < iters; ++i) {
-    fpx_sha256_transform(&ctx, i * 64);
-  }
-
-  fpx_sha256_final(&ctx);
+  fpx_sha256_update(&ctx, input, lengthBytes);
+  fpx_sha256_final(&ctx, digest);
 
   if (printable == 0) {
-    fpx_memcpy(output, ctx.state, 32);
+    fpx_memcpy(output, digest, 32);
     return;
   }
 
   for (int i = 0; i < 32; ++i) {
-    fpx_hexstr(&((uint8_t *)ctx.state)[i], 1, (char *)output + i * 2, 2);
+    fpx_hexstr(&digest[i], 1, (char *)output + i * 2, 2);
   }
 }
 
-void fpx_sha256_final(SHA256_Context *ctx_ptr) {
-  if (ctx_ptr->buffer != NULL) {
-    free(ctx_ptr->buffer);
-  }
+void fpx_sha256_digest_many(const uint8_t *const inputs[],
+                            const size_t lengths[], size_t count,
+                            uint8_t outputs[][32]) {
+  if (NULL == inputs || NULL == lengths || NULL == outputs)
+    return;
 
-  for (int i = 0; i < 8; ++i) {
-    fpx_endian_swap_if_little(&ctx_ptr->state[i], 4);
+#if defined(CRYPTO_X86)
+  if (_use_many_avx2) {
+    _sha256_many_avx2(inputs, lengths, count, outputs);
+    return;
   }
+#endif
+
+  for (size_t i = 0; i < count; ++i)
+    fpx_sha256_digest(inputs[i], lengths[i], outputs[i], FALSE);
 }
 
 char *fpx_base64_encode(const uint8_t *input, int lengthBytes) {
@@ -418,62 +287,72 @@ char *fpx_base64_encode(const uint8_t *input, int lengthBytes) {
 
 void fpx_hmac(const uint8_t *key, size_t keyLengthBytes, const uint8_t *data,
               size_t dataLength, uint8_t *output, enum HashAlgorithms algo) {
-  size_t block_size = 0;
-  size_t digest_size = 0;
+  uint8_t key_block[SHA_BLOCK] = {0};
+  uint8_t inner[32];
+
+  // keys longer than a block are hashed down first
+  if (keyLengthBytes > SHA_BLOCK) {
+    if (SHA1 == algo)
+      fpx_sha1_digest(key, keyLengthBytes, key_block, 0);
+    else
+      fpx_sha256_digest(key, keyLengthBytes, key_block, 0);
+  } else if (0 < keyLengthBytes) {
+    fpx_memcpy(key_block, key, keyLengthBytes);
+  }
 
-  void (*hash_function)(const uint8_t *, size_t, uint8_t *, uint8_t) = NULL;
+  // first pass:
+  // we hash the key XOR-ed with a string of '0x36', followed by the message
+  // second pass:
+  // we hash the key XOR-ed with a string of '0x5c', followed by the first
+  // pass' output
+  // both are streamed through a context, so the message is never copied
+  for (size_t i = 0; i < SHA_BLOCK; ++i)
+    key_block[i] ^= 0x36;
 
   switch (algo) {
-  case SHA1:
-    block_size = 512 / 8;  // = 64 Bytes
-    digest_size = 160 / 8; // = 20 Bytes
-    hash_function = fpx_sha1_digest;
+  case SHA1: {
+    SHA1_Context ctx;
 
-    break;
+    fpx_sha1_init(&ctx);
+    fpx_sha1_update(&ctx, key_block, SHA_BLOCK);
+    fpx_sha1_update(&ctx, data, dataLength);
+    fpx_sha1_final(&ctx, inner);
 
-  case SHA256:
-    block_size = 512 / 8;  // = 64 Bytes
-    digest_size = 256 / 8; // = 32 Bytes
-    hash_function = fpx_sha256_digest;
+    for (size_t i = 0; i < SHA_BLOCK; ++i)
+      key_block[i] ^= 0x36 ^ 0x5c;
+
+    fpx_sha1_init(&ctx);
+    fpx_sha1_update(&ctx, key_block, SHA_BLOCK);
+    fpx_sha1_update(&ctx, inner, 20);
+    fpx_sha1_final(&ctx, output);
 
+    fpx_memset(&ctx, 0, sizeof(ctx));
     break;
   }
 
-  uint8_t *first_input = (uint8_t *)calloc(block_size + dataLength, 1);
-  uint8_t *second_input = (uint8_t *)calloc(block_size + digest_size, 1);
-
-  if (keyLengthBytes > block_size)
-    hash_function(key, keyLengthBytes, first_input, 0);
-  else if (keyLengthBytes < block_size)
-    fpx_memcpy(first_input, key, keyLengthBytes);
+  case SHA256: {
+    SHA256_Context ctx;
 
-  fpx_memcpy(second_input, first_input, block_size);
+    fpx_sha256_init(&ctx);
+    fpx_sha256_update(&ctx, key_block, SHA_BLOCK);
+    fpx_sha256_update(&ctx, data, dataLength);
+    fpx_sha256_final(&ctx, inner);
 
-  // first pass:
-  // we XOR the key_block with a string of '0x36'
-  // then we hash the result with the actual message appended
-  // and append that output to the XOR-ed key in 'second_input'
-
-  // XOR:
-  for (size_t i = 0; i < block_size; ++i) {
-    first_input[i] ^= 0x36;
-    second_input[i] ^= 0x5c;
-  }
-
-  // HASH:
-  fpx_memcpy(first_input + block_size, data, dataLength);
-  hash_function(first_input, block_size + dataLength, second_input + block_size,
-                0);
+    for (size_t i = 0; i < SHA_BLOCK; ++i)
+      key_block[i] ^= 0x36 ^ 0x5c;
 
-  // second pass:
-  // we hash the 'second_input'
-  hash_function(second_input, block_size + digest_size, output, 0);
+    fpx_sha256_init(&ctx);
+    fpx_sha256_update(&ctx, key_block, SHA_BLOCK);
+    fpx_sha256_update(&ctx, inner, 32);
+    fpx_sha256_final(&ctx, output);
 
-  fpx_memset(first_input, 0, block_size + dataLength);
-  fpx_memset(second_input, 0, block_size + digest_size);
+    fpx_memset(&ctx, 0, sizeof(ctx));
+    break;
+  }
+  }
 
-  free(first_input);
-  free(second_input);
+  fpx_memset(key_block, 0, sizeof(key_block));
+  fpx_memset(inner, 0, sizeof(inner));
 }
 
 void fpx_hkdf_extract(const uint8_t *salt, size_t salt_len, const uint8_t *ikm,
@@ -549,3 +428,540 @@ int fpx_hkdf_expand(const uint8_t *prk, const uint8_t *info, size_t info_len,
 
   return 0;
 }
+
+static uint32_t _load_be32(const uint8_t *bytes) {
+  return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+         ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static void _store_be32(uint8_t *bytes, uint32_t value) {
+  bytes[0] = (uint8_t)(value >> 24);
+  bytes[1] = (uint8_t)(value >> 16);
+  bytes[2] = (uint8_t)(value >> 8);
+  bytes[3] = (uint8_t)value;
+}
+
+static void _sha_update(uint32_t *state, uint64_t *count, uint8_t *buffer,
+                        const uint8_t *data, size_t len, _sha_kernel blocks) {
+  size_t used = (*count >> 3) & (SHA_BLOCK - 1);
+  *count += (uint64_t)len << 3;
+
+  if (0 < used) {
+    size_t missing = SHA_BLOCK - used;
+
+    if (len < missing) {
+      fpx_memcpy(&buffer[used], data, len);
+      return;
+    }
+
+    fpx_memcpy(&buffer[used], data, missing);
+    blocks(state, buffer, 1);
+    data += missing;
+    len -= missing;
+  }
+
+  // whole blocks are hashed right from the caller's memory
+  if (SHA_BLOCK <= len) {
+    blocks(state, data, len / SHA_BLOCK);
+    data += len & ~(size_t)(SHA_BLOCK - 1);
+    len &= SHA_BLOCK - 1;
+  }
+
+  if (0 < len)
+    fpx_memcpy(buffer, data, len);
+}
+
+static void _sha_finish(uint32_t *state, uint64_t count, uint8_t *buffer,
+                        _sha_kernel blocks) {
+  size_t used = (count >> 3) & (SHA_BLOCK - 1);
+
+  buffer[used++] = 0x80;
+
+  // no room left for the length; it goes in a block of its own
+  if (SHA_LENGTH_AT < used) {
+    fpx_memset(&buffer[used], 0, SHA_BLOCK - used);
+    blocks(state, buffer, 1);
+    used = 0;
+  }
+
+  fpx_memset(&buffer[used], 0, SHA_LENGTH_AT - used);
+  _store_be32(&buffer[SHA_LENGTH_AT], (uint32_t)(count >> 32));
+  _store_be32(&buffer[SHA_LENGTH_AT + 4], (uint32_t)count);
+  blocks(state, buffer, 1);
+}
+
+static void _sha_lane_setup(_sha_lane *lane, const uint8_t *data, size_t len) {
+  size_t rest = len % SHA_BLOCK;
+  size_t tail_blocks = (SHA_LENGTH_AT > rest) ? 1 : 2;
+  uint64_t bits = (uint64_t)len << 3;
+
+  lane->data = data;
+  lane->full = len / SHA_BLOCK;
+  lane->total = lane->full + tail_blocks;
+
+  fpx_memset(lane->tail, 0, sizeof(lane->tail));
+  if (0 < rest)
+    fpx_memcpy(lane->tail, data + lane->full * SHA_BLOCK, rest);
+  lane->tail[rest] = 0x80;
+
+  uint8_t *length_at = &lane->tail[tail_blocks * SHA_BLOCK - 8];
+  _store_be32(length_at, (uint32_t)(bits >> 32));
+  _store_be32(length_at + 4, (uint32_t)bits);
+}
+
+static const uint8_t *_sha_lane_block(const _sha_lane *lane, size_t index) {
+  if (index < lane->full)
+    return lane->data + index * SHA_BLOCK;
+
+  if (index < lane->total)
+    return lane->tail + (index - lane->full) * SHA_BLOCK;
+
+  return NULL;
+}
+
+static void _sha1_generic(uint32_t *state, const uint8_t *data,
+                          size_t blocks) {
+  for (; 0 < blocks; --blocks, data += SHA_BLOCK) {
+    uint32_t W[80];
+
+    for (int i = 0; i < 16; i++)
+      W[i] = _load_be32(&data[i * 4]);
+
+    for (int i = 16; i < 80; i++)
+      W[i] = ROL((W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16]), 1, 32);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+             e = state[4];
+
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+
+      if (i < 20) {
+        f = CH(b, c, d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = MAJ(b, c, d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+
+      uint32_t temp = ROL(a, 5, 32) + f + e + k + W[i];
+      e = d;
+      d = c;
+      c = ROL(b, 30, 32);
+      b = a;
+      a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
+}
+
+static void _sha256_generic(uint32_t *state, const uint8_t *data,
+                            size_t blocks) {
+  for (; 0 < blocks; --blocks, data += SHA_BLOCK) {
+    uint32_t vals[8];
+    uint32_t W[64];
+
+    uint32_t temp1, temp2;
+
+    for (int i = 0; i < 16; ++i)
+      W[i] = _load_be32(&data[i * 4]);
+
+    for (int i = 16; i < 64; ++i)
+      W[i] = SHA256_SSIG1(W[i - 2], 32) + W[i - 7] +
+             SHA256_SSIG0(W[i - 15], 32) + W[i - 16];
+
+    for (int i = 0; i < 8; ++i)
+      vals[i] = state[i];
+
+    for (int i = 0; i < 64; ++i) {
+      temp1 = vals[7] + SHA256_BSIG1(vals[4], 32) +
+              CH(vals[4], vals[5], vals[6]) + _sha256_k[i] + W[i];
+      temp2 = SHA256_BSIG0(vals[0], 32) + MAJ(vals[0], vals[1], vals[2]);
+      vals[7] = vals[6];
+      vals[6] = vals[5];
+      vals[5] = vals[4];
+      vals[4] = vals[3] + temp1;
+      vals[3] = vals[2];
+      vals[2] = vals[1];
+      vals[1] = vals[0];
+      vals[0] = temp1 + temp2;
+    }
+
+    for (int i = 0; i < 8; ++i)
+      state[i] += vals[i];
+  }
+}
+
+#if defined(CRYPTO_X86)
+// four of the 80 SHA-1 rounds; the message words are expanded in place,
+// `cur` holding the words for these rounds and `next` the ones after
+#define SHA1_NI_QUAD(j, e_this, e_next, cur, prev, prevprev, next)            \
+  do {                                                                         \
+    if (0 == (j))                                                              \
+      e_this = _mm_add_epi32(e_this, cur);                                     \
+    else                                                                       \
+      e_this = _mm_sha1nexte_epu32(e_this, cur);                               \
+    e_next = abcd;                                                             \
+    if (3 <= (j) && 18 >= (j))                                                 \
+      next = _mm_sha1msg2_epu32(next, cur);                                    \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_this, (j) / 5);                         \
+    if (1 <= (j) && 16 >= (j))                                                 \
+      prev = _mm_sha1msg1_epu32(prev, cur);                                    \
+    if (2 <= (j) && 17 >= (j))                                                 \
+      prevprev = _mm_xor_si128(prevprev, cur);                                 \
+  } while (0)
+
+__attribute__((target("sha,sse4.1"))) static void
+_sha1_shani(uint32_t *state, const uint8_t *data, size_t blocks) {
+  const __m128i byteswap =
+      _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+  __m128i abcd = _mm_loadu_si128((const __m128i *)state);
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+  __m128i e1;
+
+  for (; 0 < blocks; --blocks, data += SHA_BLOCK) {
+    __m128i abcd_save = abcd;
+    __m128i e_save = e0;
+
+    __m128i m0 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 0)), byteswap);
+    __m128i m1 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 16)), byteswap);
+    __m128i m2 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 32)), byteswap);
+    __m128i m3 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 48)), byteswap);
+
+    SHA1_NI_QUAD(0, e0, e1, m0, m3, m2, m1);
+    SHA1_NI_QUAD(1, e1, e0, m1, m0, m3, m2);
+    SHA1_NI_QUAD(2, e0, e1, m2, m1, m0, m3);
+    SHA1_NI_QUAD(3, e1, e0, m3, m2, m1, m0);
+    SHA1_NI_QUAD(4, e0, e1, m0, m3, m2, m1);
+    SHA1_NI_QUAD(5, e1, e0, m1, m0, m3, m2);
+    SHA1_NI_QUAD(6, e0, e1, m2, m1, m0, m3);
+    SHA1_NI_QUAD(7, e1, e0, m3, m2, m1, m0);
+    SHA1_NI_QUAD(8, e0, e1, m0, m3, m2, m1);
+    SHA1_NI_QUAD(9, e1, e0, m1, m0, m3, m2);
+    SHA1_NI_QUAD(10, e0, e1, m2, m1, m0, m3);
+    SHA1_NI_QUAD(11, e1, e0, m3, m2, m1, m0);
+    SHA1_NI_QUAD(12, e0, e1, m0, m3, m2, m1);
+    SHA1_NI_QUAD(13, e1, e0, m1, m0, m3, m2);
+    SHA1_NI_QUAD(14, e0, e1, m2, m1, m0, m3);
+    SHA1_NI_QUAD(15, e1, e0, m3, m2, m1, m0);
+    SHA1_NI_QUAD(16, e0, e1, m0, m3, m2, m1);
+    SHA1_NI_QUAD(17, e1, e0, m1, m0, m3, m2);
+    SHA1_NI_QUAD(18, e0, e1, m2, m1, m0, m3);
+    SHA1_NI_QUAD(19, e1, e0, m3, m2, m1, m0);
+
+    e0 = _mm_sha1nexte_epu32(e0, e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  _mm_storeu_si128((__m128i *)state, abcd);
+  state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+// four of the 64 SHA-256 rounds, expanding the message words in place
+#define SHA256_NI_QUAD(i, cur, prev, next)                                     \
+  do {                                                                         \
+    __m128i msg = _mm_add_epi32(                                               \
+        cur, _mm_loadu_si128((const __m128i *)&_sha256_k[(i) * 4]));           \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                       \
+    if (3 <= (i) && 14 >= (i))                                                 \
+      next = _mm_sha256msg2_epu32(                                             \
+          _mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)), cur);            \
+    msg = _mm_shuffle_epi32(msg, 0x0E);                                        \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);                       \
+    if (1 <= (i) && 12 >= (i))                                                 \
+      prev = _mm_sha256msg1_epu32(prev, cur);                                  \
+  } while (0)
+
+__attribute__((target("sha,sse4.1"))) static void
+_sha256_shani(uint32_t *state, const uint8_t *data, size_t blocks) {
+  const __m128i byteswap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+
+  // the instructions want the state as ABEF and CDGH
+  __m128i tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+  __m128i state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);
+  state1 = _mm_shuffle_epi32(state1, 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  for (; 0 < blocks; --blocks, data += SHA_BLOCK) {
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+
+    __m128i m0 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 0)), byteswap);
+    __m128i m1 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 16)), byteswap);
+    __m128i m2 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 32)), byteswap);
+    __m128i m3 = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(data + 48)), byteswap);
+
+    SHA256_NI_QUAD(0, m0, m3, m1);
+    SHA256_NI_QUAD(1, m1, m0, m2);
+    SHA256_NI_QUAD(2, m2, m1, m3);
+    SHA256_NI_QUAD(3, m3, m2, m0);
+    SHA256_NI_QUAD(4, m0, m3, m1);
+    SHA256_NI_QUAD(5, m1, m0, m2);
+    SHA256_NI_QUAD(6, m2, m1, m3);
+    SHA256_NI_QUAD(7, m3, m2, m0);
+    SHA256_NI_QUAD(8, m0, m3, m1);
+    SHA256_NI_QUAD(9, m1, m0, m2);
+    SHA256_NI_QUAD(10, m2, m1, m3);
+    SHA256_NI_QUAD(11, m3, m2, m0);
+    SHA256_NI_QUAD(12, m0, m3, m1);
+    SHA256_NI_QUAD(13, m1, m0, m2);
+    SHA256_NI_QUAD(14, m2, m1, m3);
+    SHA256_NI_QUAD(15, m3, m2, m0);
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+  _mm_storeu_si128((__m128i *)&state[0], state0);
+  _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+#define ROL_X8(x, bits)                                                        \
+  _mm256_or_si256(_mm256_slli_epi32(x, bits), _mm256_srli_epi32(x, 32 - (bits)))
+#define ROR_X8(x, bits)                                                        \
+  _mm256_or_si256(_mm256_srli_epi32(x, bits), _mm256_slli_epi32(x, 32 - (bits)))
+
+// loads block `i` of every lane, so that w[n] holds word n of all eight
+__attribute__((target("avx2"))) static void
+_sha_load_x8(__m256i w[16], const uint8_t *const blocks[MB_LANES]) {
+  const __m256i byteswap = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6,
+      5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+  for (int half = 0; half < 2; ++half) {
+    __m256i r[MB_LANES], t[MB_LANES], u[MB_LANES];
+
+    for (int l = 0; l < MB_LANES; ++l)
+      r[l] = _mm256_loadu_si256((const __m256i *)(blocks[l] + half * 32));
+
+    // 8x8 transpose of 32-bit words
+    for (int l = 0; l < MB_LANES; l += 4) {
+      __m256i lo0 = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+      __m256i hi0 = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+      __m256i lo1 = _mm256_unpacklo_epi32(r[l + 2], r[l + 3]);
+      __m256i hi1 = _mm256_unpackhi_epi32(r[l + 2], r[l + 3]);
+
+      t[l] = _mm256_unpacklo_epi64(lo0, lo1);
+      t[l + 1] = _mm256_unpackhi_epi64(lo0, lo1);
+      t[l + 2] = _mm256_unpacklo_epi64(hi0, hi1);
+      t[l + 3] = _mm256_unpackhi_epi64(hi0, hi1);
+    }
+
+    for (int n = 0; n < 4; ++n) {
+      u[n] = _mm256_permute2x128_si256(t[n], t[n + 4], 0x20);
+      u[n + 4] = _mm256_permute2x128_si256(t[n], t[n + 4], 0x31);
+    }
+
+    for (int n = 0; n < 8; ++n)
+      w[half * 8 + n] = _mm256_shuffle_epi8(u[n], byteswap);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+_sha1_block_x8(__m256i state[5], const uint8_t *const blocks[MB_LANES],
+               __m256i active) {
+  __m256i w[16];
+  _sha_load_x8(w, blocks);
+
+  __m256i a = state[0], b = state[1], c = state[2], d = state[3],
+          e = state[4];
+
+  for (int i = 0; i < 80; ++i) {
+    __m256i f, k;
+
+    if (16 <= i) {
+      __m256i x = _mm256_xor_si256(
+          _mm256_xor_si256(w[(i - 3) & 15], w[(i - 8) & 15]),
+          _mm256_xor_si256(w[(i - 14) & 15], w[i & 15]));
+      w[i & 15] = ROL_X8(x, 1);
+    }
+
+    if (i < 20) {
+      f = _mm256_xor_si256(_mm256_and_si256(b, c), _mm256_andnot_si256(b, d));
+      k = _mm256_set1_epi32(0x5A827999);
+    } else if (i < 40) {
+      f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+      k = _mm256_set1_epi32(0x6ED9EBA1);
+    } else if (i < 60) {
+      f = _mm256_or_si256(_mm256_and_si256(b, c),
+                          _mm256_and_si256(d, _mm256_or_si256(b, c)));
+      k = _mm256_set1_epi32((int)0x8F1BBCDC);
+    } else {
+      f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+      k = _mm256_set1_epi32((int)0xCA62C1D6);
+    }
+
+    __m256i temp = _mm256_add_epi32(
+        _mm256_add_epi32(ROL_X8(a, 5), f),
+        _mm256_add_epi32(_mm256_add_epi32(e, k), w[i & 15]));
+    e = d;
+    d = c;
+    c = ROL_X8(b, 30);
+    b = a;
+    a = temp;
+  }
+
+  __m256i vals[5] = {a, b, c, d, e};
+
+  // lanes that ran out of blocks keep their state
+  for (int i = 0; i < 5; ++i)
+    state[i] = _mm256_blendv_epi8(
+        state[i], _mm256_add_epi32(state[i], vals[i]), active);
+}
+
+__attribute__((target("avx2"))) static void
+_sha256_block_x8(__m256i state[8], const uint8_t *const blocks[MB_LANES],
+                 __m256i active) {
+  __m256i w[16];
+  _sha_load_x8(w, blocks);
+
+  __m256i vals[8];
+  for (int i = 0; i < 8; ++i)
+    vals[i] = state[i];
+
+  for (int i = 0; i < 64; ++i) {
+    if (16 <= i) {
+      __m256i w2 = w[(i - 2) & 15], w15 = w[(i - 15) & 15];
+      __m256i s0 = _mm256_xor_si256(
+          _mm256_xor_si256(ROR_X8(w15, 7), ROR_X8(w15, 18)),
+          _mm256_srli_epi32(w15, 3));
+      __m256i s1 = _mm256_xor_si256(
+          _mm256_xor_si256(ROR_X8(w2, 17), ROR_X8(w2, 19)),
+          _mm256_srli_epi32(w2, 10));
+      w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0),
+                                   _mm256_add_epi32(w[(i - 7) & 15], s1));
+    }
+
+    __m256i a = vals[0], e = vals[4];
+
+    __m256i bsig1 = _mm256_xor_si256(
+        _mm256_xor_si256(ROR_X8(e, 6), ROR_X8(e, 11)), ROR_X8(e, 25));
+    __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, vals[5]),
+                                  _mm256_andnot_si256(e, vals[6]));
+    __m256i temp1 = _mm256_add_epi32(
+        _mm256_add_epi32(vals[7], bsig1),
+        _mm256_add_epi32(
+            ch, _mm256_add_epi32(_mm256_set1_epi32((int)_sha256_k[i]),
+                                 w[i & 15])));
+
+    __m256i bsig0 = _mm256_xor_si256(
+        _mm256_xor_si256(ROR_X8(a, 2), ROR_X8(a, 13)), ROR_X8(a, 22));
+    __m256i maj = _mm256_or_si256(
+        _mm256_and_si256(a, vals[1]),
+        _mm256_and_si256(vals[2], _mm256_or_si256(a, vals[1])));
+    __m256i temp2 = _mm256_add_epi32(bsig0, maj);
+
+    vals[7] = vals[6];
+    vals[6] = vals[5];
+    vals[5] = vals[4];
+    vals[4] = _mm256_add_epi32(vals[3], temp1);
+    vals[3] = vals[2];
+    vals[2] = vals[1];
+    vals[1] = vals[0];
+    vals[0] = _mm256_add_epi32(temp1, temp2);
+  }
+
+  // lanes that ran out of blocks keep their state
+  for (int i = 0; i < 8; ++i)
+    state[i] = _mm256_blendv_epi8(
+        state[i], _mm256_add_epi32(state[i], vals[i]), active);
+}
+
+// hashes the messages eight at a time; `words` is 5 for SHA-1 and 8 for
+// SHA-256, and `outputs` holds `words * 4` bytes per message
+__attribute__((target("avx2"))) static void
+_sha_many_avx2(const uint8_t *const inputs[], const size_t lengths[],
+               size_t count, uint8_t *outputs, int words) {
+  _sha_lane lanes[MB_LANES];
+  __m256i state[8];
+  uint32_t lane_words[8][MB_LANES];
+
+  for (size_t first = 0; first < count; first += MB_LANES) {
+    size_t in_use = (MB_LANES < count - first) ? MB_LANES : count - first;
+    size_t most = 0;
+
+    for (size_t l = 0; l < in_use; ++l) {
+      _sha_lane_setup(&lanes[l], inputs[first + l], lengths[first + l]);
+      if (most < lanes[l].total)
+        most = lanes[l].total;
+    }
+
+    for (int i = 0; i < words; ++i)
+      state[i] = _mm256_set1_epi32(
+          (int)((5 == words) ? _sha1_initial[i] : _sha256_initial[i]));
+
+    for (size_t index = 0; index < most; ++index) {
+      const uint8_t *blocks[MB_LANES];
+      int32_t active[MB_LANES];
+
+      for (size_t l = 0; l < MB_LANES; ++l) {
+        const uint8_t *block =
+            (l < in_use) ? _sha_lane_block(&lanes[l], index) : NULL;
+
+        // finished lanes still need something to load
+        active[l] = (NULL != block) ? -1 : 0;
+        blocks[l] = (NULL != block) ? block : lanes[0].tail;
+      }
+
+      __m256i mask = _mm256_loadu_si256((const __m256i *)active);
+
+      if (5 == words)
+        _sha1_block_x8(state, blocks, mask);
+      else
+        _sha256_block_x8(state, blocks, mask);
+    }
+
+    for (int i = 0; i < words; ++i)
+      _mm256_storeu_si256((__m256i *)lane_words[i], state[i]);
+
+    for (size_t l = 0; l < in_use; ++l) {
+      uint8_t *digest = outputs + (first + l) * words * 4;
+
+      for (int i = 0; i < words; ++i)
+        _store_be32(&digest[i * 4], lane_words[i][l]);
+    }
+  }
+}
+
+static void _sha1_many_avx2(const uint8_t *const inputs[],
+                            const size_t lengths[], size_t count,
+                            uint8_t outputs[][20]) {
+  _sha_many_avx2(inputs, lengths, count, &outputs[0][0], 5);
+}
+
+static void _sha256_many_avx2(const uint8_t *const inputs[],
+                              const size_t lengths[], size_t count,
+                              uint8_t outputs[][32]) {
+  _sha_many_avx2(inputs, lengths, count, &outputs[0][0], 8);
+}
+#endif
@@ -0,0 +1,1383 @@
+//
+//  "deflate.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+#include "c-utils/deflate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define WORD_LOADS
+#endif
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MIN_LOOKAHEAD (MAX_MATCH + MIN_MATCH + 1)
+
+#define MAX_CHAIN 128 /* hash chain entries looked at per position */
+#define NICE_MATCH 128 /* stop searching once a match is this long */
+#define LAZY_MATCH 16 /* don't try the next position after a match this long */
+#define TOO_FAR 4096 /* 3-byte matches further back cost more than literals */
+
+#define SYMBOL_MAX 16384 /* symbols collected before a block is written */
+#define STORED_MAX 65535
+
+#define LITLEN_CODES 286
+#define FIXED_LITLEN_CODES 288
+#define DIST_CODES 30
+#define CODELEN_CODES 19
+#define END_OF_BLOCK 256
+
+#define MAX_BITS 15
+#define MAX_CODELEN_BITS 7
+
+#define FAST_BITS 10 /* code bits resolved by one table lookup when inflating */
+
+struct _symbol_frequency;
+struct _huffman;
+struct _bitreader;
+
+static uint8_t _log2(uint32_t);
+static uint16_t _reverse(uint16_t code, uint8_t length);
+static uint8_t _length_code(uint8_t);
+static uint8_t _distance_code(uint16_t);
+
+static uint16_t _insert(fpx_deflate_t *, size_t position);
+static size_t _match_length(const uint8_t *, const uint8_t *, size_t max);
+static size_t _longest_match(fpx_deflate_t *, uint16_t, size_t, size_t *);
+static void _slide(fpx_deflate_t *);
+
+static int _symfreq_compare(const void *, const void *);
+static void _minimum_redundancy(struct _symbol_frequency *, uint16_t);
+static void _limit_lengths(uint32_t *counts, uint16_t used, uint8_t max_bits);
+static void _huffman_lengths(const uint32_t *, uint16_t, uint8_t *, uint8_t);
+static void _huffman_codes(const uint8_t *, uint16_t, uint16_t *);
+static size_t _rle_lengths(const uint8_t *, size_t, uint8_t *, uint8_t *);
+static size_t _data_bits(const uint32_t *, const uint8_t *, const uint32_t *,
+                         const uint8_t *);
+
+static int _out_reserve(fpx_deflate_t *, size_t);
+static void _put_bits(fpx_deflate_t *, uint32_t value, uint8_t count);
+static void _put_align(fpx_deflate_t *);
+static void _put_symbols(fpx_deflate_t *, const uint16_t *, const uint8_t *,
+                         const uint16_t *, const uint8_t *);
+static int _flush_block(fpx_deflate_t *);
+
+static void _refill(struct _bitreader *);
+static uint32_t _bits(struct _bitreader *, uint8_t);
+static size_t _consumed(const struct _bitreader *);
+static int _huffman_build(struct _huffman *, const uint8_t *, uint16_t);
+static int _decode(struct _bitreader *, const struct _huffman *);
+static int _inflate_reserve(fpx_inflate_t *, size_t, size_t max_output);
+static int _inflate_stored(fpx_inflate_t *, struct _bitreader *, size_t);
+static int _inflate_codes(fpx_inflate_t *, struct _bitreader *,
+                          const struct _huffman *, const struct _huffman *,
+                          size_t);
+static int _inflate_fixed(fpx_inflate_t *, struct _bitreader *, size_t);
+static int _inflate_dynamic(fpx_inflate_t *, struct _bitreader *, size_t);
+static void _window_update(fpx_inflate_t *);
+
+struct _symbol_frequency {
+  uint32_t key; // the frequency going in, the code length coming out
+  uint16_t symbol;
+};
+
+struct _huffman {
+  // (symbol << 4) | length for every code of at most FAST_BITS bits,
+  // indexed by the next FAST_BITS bits of input; 0 for longer codes
+  uint16_t fast[1 << FAST_BITS];
+
+  uint16_t count[MAX_BITS + 1];
+  uint16_t symbol[FIXED_LITLEN_CODES];
+};
+
+struct _bitreader {
+  const uint8_t *data;
+  size_t length;
+  size_t limit; // reading this far in means the input has run out
+
+  size_t pos; // bytes loaded into `buffer` so far
+  uint64_t buffer;
+  uint8_t count;
+};
+
+static const uint16_t _length_base[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t _length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                          1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                          4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t _distance_base[DIST_CODES] = {
+    1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+    33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t _distance_extra[DIST_CODES] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t _codelen_order[CODELEN_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// what the sync flush ends in; permessage-deflate leaves it off the wire
+static const uint8_t _sync_tail[4] = {0x00, 0x00, 0xff, 0xff};
+
+int fpx_deflate_init(fpx_deflate_t *d, uint8_t window_bits) {
+  if (NULL == d)
+    return -1;
+
+  if (window_bits < 9 || window_bits > 15)
+    return -2;
+
+  memset(d, 0, sizeof(*d));
+
+  size_t window_size = (size_t)1 << window_bits;
+  d->window_bits = window_bits;
+
+  d->window = (uint8_t *)malloc(2 * window_size);
+  d->head = (uint16_t *)calloc(window_size, sizeof(*d->head));
+  d->prev = (uint16_t *)calloc(window_size, sizeof(*d->prev));
+  d->lengths = (uint8_t *)malloc(SYMBOL_MAX * sizeof(*d->lengths));
+  d->distances = (uint16_t *)malloc(SYMBOL_MAX * sizeof(*d->distances));
+
+  if (NULL == d->window || NULL == d->head || NULL == d->prev ||
+      NULL == d->lengths || NULL == d->distances) {
+    fpx_deflate_destroy(d);
+    return -3;
+  }
+
+  return 0;
+}
+
+int fpx_deflate_message(fpx_deflate_t *d, const uint8_t *data, size_t length,
+                        uint8_t keep_context) {
+  if (NULL == d || NULL == d->window || (NULL == data && length))
+    return -1;
+
+  size_t window_size = (size_t)1 << d->window_bits;
+  size_t max_distance = window_size - MIN_LOOKAHEAD;
+
+  if (!keep_context) {
+    d->strstart = 0;
+    memset(d->head, 0, window_size * sizeof(*d->head));
+  }
+
+  d->lookahead = 0;
+  d->block_start = (int64_t)d->strstart;
+  d->block_bytes = 0;
+  d->symbol_count = 0;
+  d->bit_buffer = 0;
+  d->bit_count = 0;
+  d->out_len = 0;
+
+  // lazy matching: a match found at one position is only taken once the
+  // next position has been checked for a longer one
+  size_t match_length = MIN_MATCH - 1;
+  size_t match_start = 0;
+  uint8_t match_available = FALSE;
+  int result;
+
+  for (;;) {
+    if (d->lookahead < MIN_LOOKAHEAD && length) {
+      if (d->strstart >= 2 * window_size - MIN_LOOKAHEAD) {
+        _slide(d);
+        if (match_start >= window_size)
+          match_start -= window_size;
+      }
+
+      size_t room = 2 * window_size - d->strstart - d->lookahead;
+      size_t take = (length < room) ? length : room;
+
+      memcpy(d->window + d->strstart + d->lookahead, data, take);
+      data += take;
+      length -= take;
+      d->lookahead += take;
+    }
+
+    if (0 == d->lookahead)
+      break;
+
+    uint16_t hash_head = 0;
+    if (d->lookahead >= MIN_MATCH)
+      hash_head = _insert(d, d->strstart);
+
+    size_t prev_length = match_length;
+    size_t prev_match = match_start;
+    match_length = MIN_MATCH - 1;
+
+    if (hash_head && hash_head < d->strstart && prev_length < LAZY_MATCH &&
+        d->strstart - hash_head <= max_distance) {
+      match_length = _longest_match(d, hash_head, prev_length, &match_start);
+
+      if (MIN_MATCH == match_length && d->strstart - match_start > TOO_FAR)
+        match_length = MIN_MATCH - 1;
+    }
+
+    if (prev_length >= MIN_MATCH && match_length <= prev_length) {
+      size_t max_insert = d->strstart + d->lookahead - MIN_MATCH;
+
+      d->lengths[d->symbol_count] = (uint8_t)(prev_length - MIN_MATCH);
+      d->distances[d->symbol_count] =
+        (uint16_t)(d->strstart - 1 - prev_match);
+      d->symbol_count++;
+      d->block_bytes += prev_length;
+
+      // the match started at strstart - 1, which is already accounted for
+      d->lookahead -= prev_length - 1;
+      for (prev_length -= 2; prev_length; --prev_length) {
+        if (++d->strstart <= max_insert)
+          _insert(d, d->strstart);
+      }
+
+      match_available = FALSE;
+      match_length = MIN_MATCH - 1;
+      d->strstart++;
+    } else if (match_available) {
+      d->lengths[d->symbol_count] = d->window[d->strstart - 1];
+      d->distances[d->symbol_count] = 0;
+      d->symbol_count++;
+      d->block_bytes++;
+
+      d->strstart++;
+      d->lookahead--;
+    } else {
+      match_available = TRUE;
+      d->strstart++;
+      d->lookahead--;
+    }
+
+    if (SYMBOL_MAX == d->symbol_count) {
+      result = _flush_block(d);
+      if (result)
+        return result;
+    }
+  }
+
+  if (match_available) {
+    d->lengths[d->symbol_count] = d->window[d->strstart - 1];
+    d->distances[d->symbol_count] = 0;
+    d->symbol_count++;
+    d->block_bytes++;
+  }
+
+  result = _flush_block(d);
+  if (result)
+    return result;
+
+  // sync flush: an empty stored block, of which only the header stays
+  if (_out_reserve(d, 16))
+    return -3;
+
+  _put_bits(d, 0, 3);
+  _put_align(d);
+
+  return 0;
+}
+
+size_t fpx_deflate_memory(uint8_t window_bits) {
+  if (window_bits < 9 || window_bits > 15)
+    return 0;
+
+  // the window twice over, both hash tables, and the symbols of one block
+  size_t window_size = (size_t)1 << window_bits;
+  return 2 * window_size + 2 * window_size * sizeof(uint16_t) +
+         SYMBOL_MAX * (sizeof(uint8_t) + sizeof(uint16_t));
+}
+
+int fpx_deflate_destroy(fpx_deflate_t *d) {
+  if (NULL == d)
+    return -1;
+
+  free(d->window);
+  free(d->head);
+  free(d->prev);
+  free(d->lengths);
+  free(d->distances);
+  free(d->out);
+
+  memset(d, 0, sizeof(*d));
+
+  return 0;
+}
+
+int fpx_inflate_init(fpx_inflate_t *f, uint8_t window_bits) {
+  if (NULL == f)
+    return -1;
+
+  if (window_bits && (window_bits < 8 || window_bits > 15))
+    return -2;
+
+  memset(f, 0, sizeof(*f));
+  f->window_bits = window_bits;
+
+  if (window_bits) {
+    f->window = (uint8_t *)malloc((size_t)1 << window_bits);
+    if (NULL == f->window)
+      return -3;
+  }
+
+  return 0;
+}
+
+int fpx_inflate_message(fpx_inflate_t *f, const uint8_t *data, size_t length,
+                        size_t max_output) {
+  if (NULL == f || (NULL == data && length))
+    return -1;
+
+  struct _bitreader br = {0};
+  br.data = data;
+  br.length = length;
+  br.limit = length + sizeof(_sync_tail) + sizeof(br.buffer);
+
+  f->out_len = 0;
+
+  int result = 0;
+  uint8_t last;
+
+  do {
+    last = (uint8_t)_bits(&br, 1);
+
+    switch (_bits(&br, 2)) {
+      case 0:
+        result = _inflate_stored(f, &br, max_output);
+        break;
+      case 1:
+        result = _inflate_fixed(f, &br, max_output);
+        break;
+      case 2:
+        result = _inflate_dynamic(f, &br, max_output);
+        break;
+      default:
+        result = -4;
+        break;
+    }
+
+    if (0 == result && _consumed(&br) > (length + sizeof(_sync_tail)) * 8)
+      result = -4;
+
+    if (result)
+      break;
+
+    // a message is done at its final block, or once the sync flush that
+    // was put back at the end has been read
+  } while (!last &&
+           (_consumed(&br) + 7) / 8 < length + sizeof(_sync_tail));
+
+  if (result) {
+    f->window_fill = 0;
+    return result;
+  }
+
+  if (f->window_bits)
+    _window_update(f);
+
+  return 0;
+}
+
+int fpx_inflate_destroy(fpx_inflate_t *f) {
+  if (NULL == f)
+    return -1;
+
+  free(f->window);
+  free(f->out);
+
+  memset(f, 0, sizeof(*f));
+
+  return 0;
+}
+
+static uint8_t _log2(uint32_t value) {
+#if defined(__GNUC__)
+  return (uint8_t)(31 - __builtin_clz(value));
+#else
+  uint8_t result = 0;
+  while (value >>= 1)
+    ++result;
+  return result;
+#endif
+}
+
+static uint16_t _reverse(uint16_t code, uint8_t length) {
+  uint16_t result = 0;
+
+  for (uint8_t i = 0; i < length; ++i) {
+    result = (uint16_t)((result << 1) | (code & 1));
+    code >>= 1;
+  }
+
+  return result;
+}
+
+static uint8_t _length_code(uint8_t length) {
+  // `length` is the match length minus 3
+  if (length < 8)
+    return length;
+
+  if (255 == length)
+    return 28;
+
+  uint8_t shift = _log2(length) - 2;
+  return (uint8_t)(4 * shift + 4 + ((length >> shift) & 3));
+}
+
+static uint8_t _distance_code(uint16_t distance) {
+  // `distance` is the match distance minus 1
+  if (distance < 4)
+    return (uint8_t)distance;
+
+  uint8_t shift = _log2(distance) - 1;
+  return (uint8_t)(2 * shift + 2 + ((distance >> shift) & 1));
+}
+
+static uint16_t _insert(fpx_deflate_t *d, size_t position) {
+  const uint8_t *bytes = d->window + position;
+  uint32_t value = bytes[0] | (bytes[1] << 8) | ((uint32_t)bytes[2] << 16);
+  uint32_t hash = (value * 2654435761u) >> (32 - d->window_bits);
+
+  uint16_t head = d->head[hash];
+  d->prev[position & (((size_t)1 << d->window_bits) - 1)] = head;
+  d->head[hash] = (uint16_t)position;
+
+  return head;
+}
+
+static size_t _match_length(const uint8_t *a, const uint8_t *b, size_t max) {
+  size_t length = 0;
+
+#ifdef WORD_LOADS
+  while (length + 8 <= max) {
+    uint64_t x, y;
+    memcpy(&x, a + length, 8);
+    memcpy(&y, b + length, 8);
+
+    if (x != y)
+      return length + ((size_t)__builtin_ctzll(x ^ y) >> 3);
+
+    length += 8;
+  }
+#endif
+
+  while (length < max && a[length] == b[length])
+    ++length;
+
+  return length;
+}
+
+static size_t _longest_match(fpx_deflate_t *d, uint16_t candidate,
+                             size_t best, size_t *match_start) {
+  size_t window_mask = ((size_t)1 << d->window_bits) - 1;
+  size_t max_distance = window_mask + 1 - MIN_LOOKAHEAD;
+  size_t limit = (d->strstart > max_distance) ? d->strstart - max_distance : 0;
+  size_t max = (d->lookahead < MAX_MATCH) ? d->lookahead : MAX_MATCH;
+  uint16_t chain = MAX_CHAIN;
+
+  if (best >= max)
+    return best;
+
+  const uint8_t *scan = d->window + d->strstart;
+
+  for (;;) {
+    const uint8_t *match = d->window + candidate;
+
+    // the byte that would make this match longer than the best one
+    // rules out most candidates by itself
+    if (match[best] == scan[best] && match[0] == scan[0] &&
+        match[1] == scan[1]) {
+      size_t length = _match_length(scan, match, max);
+
+      if (length > best) {
+        *match_start = candidate;
+        best = length;
+
+        if (length >= NICE_MATCH || length >= max)
+          break;
+      }
+    }
+
+    uint16_t next = d->prev[candidate & window_mask];
+    if (next >= candidate || next <= limit || 0 == --chain)
+      break;
+
+    candidate = next;
+  }
+
+  return best;
+}
+
+static void _slide(fpx_deflate_t *d) {
+  size_t window_size = (size_t)1 << d->window_bits;
+
+  memcpy(d->window, d->window + window_size, window_size);
+  d->strstart -= window_size;
+  d->block_start -= (int64_t)window_size;
+
+  for (size_t i = 0; i < window_size; ++i) {
+    d->head[i] =
+      (d->head[i] >= window_size) ? (uint16_t)(d->head[i] - window_size) : 0;
+    d->prev[i] =
+      (d->prev[i] >= window_size) ? (uint16_t)(d->prev[i] - window_size) : 0;
+  }
+}
+
+static int _symfreq_compare(const void *a, const void *b) {
+  const struct _symbol_frequency *x = (const struct _symbol_frequency *)a;
+  const struct _symbol_frequency *y = (const struct _symbol_frequency *)b;
+
+  if (x->key != y->key)
+    return (x->key < y->key) ? -1 : 1;
+
+  return (int)x->symbol - (int)y->symbol;
+}
+
+static void _minimum_redundancy(struct _symbol_frequency *a, uint16_t n) {
+  // Moffat and Katajainen's in-place code length calculation. `a` is sorted
+  // by ascending frequency and ends up holding each symbol's depth
+  int root, leaf, next, available, used, depth;
+
+  if (0 == n)
+    return;
+
+  if (1 == n) {
+    a[0].key = 1;
+    return;
+  }
+
+  a[0].key += a[1].key;
+  root = 0;
+  leaf = 2;
+
+  for (next = 1; next < n - 1; ++next) {
+    if (leaf >= n || a[root].key < a[leaf].key) {
+      a[next].key = a[root].key;
+      a[root++].key = (uint32_t)next;
+    } else {
+      a[next].key = a[leaf++].key;
+    }
+
+    if (leaf >= n || (root < next && a[root].key < a[leaf].key)) {
+      a[next].key += a[root].key;
+      a[root++].key = (uint32_t)next;
+    } else {
+      a[next].key += a[leaf++].key;
+    }
+  }
+
+  a[n - 2].key = 0;
+  for (next = n - 3; next >= 0; --next)
+    a[next].key = a[a[next].key].key + 1;
+
+  available = 1;
+  used = depth = 0;
+  root = n - 2;
+  next = n - 1;
+
+  while (available > 0) {
+    while (root >= 0 && (int)a[root].key == depth) {
+      ++used;
+      --root;
+    }
+
+    while (available > used) {
+      a[next--].key = (uint32_t)depth;
+      --available;
+    }
+
+    available = 2 * used;
+    ++depth;
+    used = 0;
+  }
+}
+
+static void _limit_lengths(uint32_t *counts, uint16_t used, uint8_t max_bits) {
+  // moves codes that are too long up, and makes room for them by pushing
+  // shorter ones down, until the lengths describe a complete code again
+  if (used <= 1)
+    return;
+
+  for (uint8_t i = max_bits + 1; i <= 32; ++i)
+    counts[max_bits] += counts[i];
+
+  uint32_t total = 0;
+  for (uint8_t i = max_bits; i > 0; --i)
+    total += counts[i] << (max_bits - i);
+
+  while (total != (1u << max_bits)) {
+    counts[max_bits]--;
+
+    for (uint8_t i = max_bits - 1; i > 0; --i) {
+      if (counts[i]) {
+        counts[i]--;
+        counts[i + 1] += 2;
+        break;
+      }
+    }
+
+    total--;
+  }
+}
+
+static void _huffman_lengths(const uint32_t *frequencies, uint16_t n,
+                             uint8_t *lengths, uint8_t max_bits) {
+  struct _symbol_frequency symbols[LITLEN_CODES];
+  uint32_t counts[33] = {0};
+  uint16_t used = 0;
+
+  memset(lengths, 0, n);
+
+  for (uint16_t i = 0; i < n; ++i) {
+    if (frequencies[i]) {
+      symbols[used].key = frequencies[i];
+      symbols[used].symbol = i;
+      used++;
+    }
+  }
+
+  // a code with a single symbol in it is not complete, and not every
+  // inflater lets that slide, so there are always at least two
+  for (uint16_t i = 0; used < 2 && i < n; ++i) {
+    if (0 == frequencies[i]) {
+      symbols[used].key = 1;
+      symbols[used].symbol = i;
+      used++;
+    }
+  }
+
+  qsort(symbols, used, sizeof(*symbols), _symfreq_compare);
+  _minimum_redundancy(symbols, used);
+
+  for (uint16_t i = 0; i < used; ++i)
+    counts[(symbols[i].key > 32) ? 32 : symbols[i].key]++;
+
+  _limit_lengths(counts, used, max_bits);
+
+  // the most frequent symbols are at the end, and get the shortest codes
+  uint16_t index = used;
+  for (uint8_t bits = 1; bits <= max_bits; ++bits) {
+    for (uint32_t i = counts[bits]; i > 0; --i)
+      lengths[symbols[--index].symbol] = bits;
+  }
+}
+
+static void _huffman_codes(const uint8_t *lengths, uint16_t n,
+                           uint16_t *codes) {
+  uint16_t counts[MAX_BITS + 1] = {0};
+  uint16_t next[MAX_BITS + 1];
+  uint16_t code = 0;
+
+  for (uint16_t i = 0; i < n; ++i)
+    counts[lengths[i]]++;
+  counts[0] = 0;
+
+  for (uint8_t bits = 1; bits <= MAX_BITS; ++bits) {
+    code = (uint16_t)((code + counts[bits - 1]) << 1);
+    next[bits] = code;
+  }
+
+  // DEFLATE sends Huffman codes starting at their top bit, and everything
+  // else starting at the bottom one; reversing them here lets both go
+  // through the same bit writer
+  for (uint16_t i = 0; i < n; ++i) {
+    if (lengths[i])
+      codes[i] = _reverse(next[lengths[i]]++, lengths[i]);
+  }
+}
+
+static size_t _rle_lengths(const uint8_t *lengths, size_t n, uint8_t *symbols,
+                           uint8_t *extras) {
+  size_t count = 0;
+
+  for (size_t i = 0; i < n;) {
+    uint8_t value = lengths[i];
+    size_t run = 1;
+
+    while (i + run < n && lengths[i + run] == value)
+      ++run;
+    i += run;
+
+    if (0 == value) {
+      while (run >= 11) {
+        size_t part = (run < 138) ? run : 138;
+        symbols[count] = 18;
+        extras[count++] = (uint8_t)(part - 11);
+        run -= part;
+      }
+
+      if (run >= 3) {
+        symbols[count] = 17;
+        extras[count++] = (uint8_t)(run - 3);
+        run = 0;
+      }
+    } else {
+      symbols[count] = value;
+      extras[count++] = 0;
+      run--;
+
+      while (run >= 3) {
+        size_t part = (run < 6) ? run : 6;
+        symbols[count] = 16;
+        extras[count++] = (uint8_t)(part - 3);
+        run -= part;
+      }
+    }
+
+    for (; run; --run) {
+      symbols[count] = value;
+      extras[count++] = 0;
+    }
+  }
+
+  return count;
+}
+
+static size_t _data_bits(const uint32_t *litlen_frequencies,
+                         const uint8_t *litlen_lengths,
+                         const uint32_t *distance_frequencies,
+                         const uint8_t *distance_lengths) {
+  size_t bits = 0;
+
+  for (uint16_t i = 0; i < LITLEN_CODES; ++i)
+    bits += (size_t)litlen_frequencies[i] * litlen_lengths[i];
+
+  for (uint16_t i = 0; i < 29; ++i)
+    bits += (size_t)litlen_frequencies[257 + i] * _length_extra[i];
+
+  for (uint16_t i = 0; i < DIST_CODES; ++i)
+    bits += (size_t)distance_frequencies[i] *
+            (distance_lengths[i] + _distance_extra[i]);
+
+  return bits;
+}
+
+static int _out_reserve(fpx_deflate_t *d, size_t bytes) {
+  if (d->out_len + bytes <= d->out_allocated)
+    return 0;
+
+  size_t new_size = (d->out_allocated) ? d->out_allocated : 1024;
+  while (new_size < d->out_len + bytes)
+    new_size *= 2;
+
+  uint8_t *new_out = (uint8_t *)realloc(d->out, new_size);
+  if (NULL == new_out)
+    return -1;
+
+  d->out = new_out;
+  d->out_allocated = new_size;
+
+  return 0;
+}
+
+static void _put_bits(fpx_deflate_t *d, uint32_t value, uint8_t count) {
+  d->bit_buffer |= (uint64_t)value << d->bit_count;
+  d->bit_count += count;
+
+  if (d->bit_count >= 32) {
+    uint8_t *out = d->out + d->out_len;
+    out[0] = (uint8_t)d->bit_buffer;
+    out[1] = (uint8_t)(d->bit_buffer >> 8);
+    out[2] = (uint8_t)(d->bit_buffer >> 16);
+    out[3] = (uint8_t)(d->bit_buffer >> 24);
+
+    d->out_len += 4;
+    d->bit_buffer >>= 32;
+    d->bit_count -= 32;
+  }
+}
+
+static void _put_align(fpx_deflate_t *d) {
+  while (d->bit_count > 0) {
+    d->out[d->out_len++] = (uint8_t)d->bit_buffer;
+    d->bit_buffer >>= 8;
+    d->bit_count = (d->bit_count > 8) ? d->bit_count - 8 : 0;
+  }
+
+  d->bit_buffer = 0;
+}
+
+static void _put_symbols(fpx_deflate_t *d, const uint16_t *litlen_codes,
+                         const uint8_t *litlen_lengths,
+                         const uint16_t *distance_codes,
+                         const uint8_t *distance_lengths) {
+  for (size_t i = 0; i < d->symbol_count; ++i) {
+    uint8_t length = d->lengths[i];
+    uint16_t distance = d->distances[i];
+
+    if (0 == distance) {
+      _put_bits(d, litlen_codes[length], litlen_lengths[length]);
+      continue;
+    }
+
+    uint8_t code = _length_code(length);
+    _put_bits(d, litlen_codes[257 + code], litlen_lengths[257 + code]);
+    if (_length_extra[code])
+      _put_bits(d, length + MIN_MATCH - _length_base[code],
+                _length_extra[code]);
+
+    code = _distance_code(distance - 1);
+    _put_bits(d, distance_codes[code], distance_lengths[code]);
+    if (_distance_extra[code])
+      _put_bits(d, distance - _distance_base[code], _distance_extra[code]);
+  }
+
+  _put_bits(d, litlen_codes[END_OF_BLOCK], litlen_lengths[END_OF_BLOCK]);
+}
+
+static int _flush_block(fpx_deflate_t *d) {
+  if (0 == d->symbol_count)
+    return 0;
+
+  uint32_t litlen_frequencies[LITLEN_CODES] = {0};
+  uint32_t distance_frequencies[DIST_CODES] = {0};
+
+  for (size_t i = 0; i < d->symbol_count; ++i) {
+    if (0 == d->distances[i]) {
+      litlen_frequencies[d->lengths[i]]++;
+    } else {
+      litlen_frequencies[257 + _length_code(d->lengths[i])]++;
+      distance_frequencies[_distance_code(d->distances[i] - 1)]++;
+    }
+  }
+  litlen_frequencies[END_OF_BLOCK] = 1;
+
+  // dynamic block
+  uint8_t litlen_lengths[LITLEN_CODES];
+  uint8_t distance_lengths[DIST_CODES];
+  _huffman_lengths(litlen_frequencies, LITLEN_CODES, litlen_lengths, MAX_BITS);
+  _huffman_lengths(distance_frequencies, DIST_CODES, distance_lengths,
+                   MAX_BITS);
+
+  uint16_t litlen_count = LITLEN_CODES;
+  while (litlen_count > 257 && 0 == litlen_lengths[litlen_count - 1])
+    --litlen_count;
+
+  uint16_t distance_count = DIST_CODES;
+  while (distance_count > 1 && 0 == distance_lengths[distance_count - 1])
+    --distance_count;
+
+  uint8_t all_lengths[LITLEN_CODES + DIST_CODES];
+  memcpy(all_lengths, litlen_lengths, litlen_count);
+  memcpy(all_lengths + litlen_count, distance_lengths, distance_count);
+
+  uint8_t rle_symbols[LITLEN_CODES + DIST_CODES];
+  uint8_t rle_extras[LITLEN_CODES + DIST_CODES];
+  size_t rle_count = _rle_lengths(all_lengths, litlen_count + distance_count,
+                                  rle_symbols, rle_extras);
+
+  uint32_t codelen_frequencies[CODELEN_CODES] = {0};
+  for (size_t i = 0; i < rle_count; ++i)
+    codelen_frequencies[rle_symbols[i]]++;
+
+  uint8_t codelen_lengths[CODELEN_CODES];
+  _huffman_lengths(codelen_frequencies, CODELEN_CODES, codelen_lengths,
+                   MAX_CODELEN_BITS);
+
+  uint8_t codelen_count = CODELEN_CODES;
+  while (codelen_count > 4 &&
+         0 == codelen_lengths[_codelen_order[codelen_count - 1]])
+    --codelen_count;
+
+  size_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * (size_t)codelen_count;
+  for (uint8_t i = 0; i < CODELEN_CODES; ++i)
+    dynamic_bits += (size_t)codelen_frequencies[i] * codelen_lengths[i];
+  dynamic_bits += 2 * (size_t)codelen_frequencies[16] +
+                  3 * (size_t)codelen_frequencies[17] +
+                  7 * (size_t)codelen_frequencies[18];
+  dynamic_bits += _data_bits(litlen_frequencies, litlen_lengths,
+                             distance_frequencies, distance_lengths);
+
+  // fixed block
+  // all 288 lengths have to be there for the codes to come out right, even
+  // though the last two symbols never get used
+  uint8_t fixed_litlen[FIXED_LITLEN_CODES];
+  uint8_t fixed_distance[DIST_CODES];
+  memset(fixed_litlen, 8, 144);
+  memset(fixed_litlen + 144, 9, 256 - 144);
+  memset(fixed_litlen + 256, 7, 280 - 256);
+  memset(fixed_litlen + 280, 8, FIXED_LITLEN_CODES - 280);
+  memset(fixed_distance, 5, DIST_CODES);
+
+  size_t fixed_bits = 3 + _data_bits(litlen_frequencies, fixed_litlen,
+                                     distance_frequencies, fixed_distance);
+
+  // stored block(s), counting the worst case for padding. not an option
+  // once the start of the block has been slid out of the window
+  size_t stored_blocks = (d->block_bytes + STORED_MAX - 1) / STORED_MAX;
+  size_t stored_bits = 8 * d->block_bytes + stored_blocks * (3 + 7 + 32);
+
+  if (d->block_start < 0)
+    stored_bits = SIZE_MAX;
+
+  if (stored_bits < dynamic_bits && stored_bits < fixed_bits) {
+    if (_out_reserve(d, stored_bits / 8 + 16))
+      return -3;
+
+    const uint8_t *block = d->window + d->block_start;
+    size_t left = d->block_bytes;
+
+    while (left) {
+      uint16_t part = (left < STORED_MAX) ? (uint16_t)left : STORED_MAX;
+
+      _put_bits(d, 0, 3);
+      _put_align(d);
+
+      d->out[d->out_len++] = (uint8_t)part;
+      d->out[d->out_len++] = (uint8_t)(part >> 8);
+      d->out[d->out_len++] = (uint8_t)~part;
+      d->out[d->out_len++] = (uint8_t)(~part >> 8);
+
+      memcpy(d->out + d->out_len, block, part);
+      d->out_len += part;
+      block += part;
+      left -= part;
+    }
+  } else {
+    uint16_t litlen_codes[FIXED_LITLEN_CODES];
+    uint16_t distance_codes[DIST_CODES];
+
+    if (dynamic_bits < fixed_bits) {
+      if (_out_reserve(d, dynamic_bits / 8 + 16))
+        return -3;
+
+      uint16_t codelen_codes[CODELEN_CODES];
+      _huffman_codes(codelen_lengths, CODELEN_CODES, codelen_codes);
+      _huffman_codes(litlen_lengths, LITLEN_CODES, litlen_codes);
+      _huffman_codes(distance_lengths, DIST_CODES, distance_codes);
+
+      _put_bits(d, 2 << 1, 3);
+      _put_bits(d, litlen_count - 257, 5);
+      _put_bits(d, distance_count - 1, 5);
+      _put_bits(d, codelen_count - 4, 4);
+
+      for (uint8_t i = 0; i < codelen_count; ++i)
+        _put_bits(d, codelen_lengths[_codelen_order[i]], 3);
+
+      for (size_t i = 0; i < rle_count; ++i) {
+        uint8_t symbol = rle_symbols[i];
+        _put_bits(d, codelen_codes[symbol], codelen_lengths[symbol]);
+
+        if (16 == symbol)
+          _put_bits(d, rle_extras[i], 2);
+        else if (17 == symbol)
+          _put_bits(d, rle_extras[i], 3);
+        else if (18 == symbol)
+          _put_bits(d, rle_extras[i], 7);
+      }
+
+      _put_symbols(d, litlen_codes, litlen_lengths, distance_codes,
+                   distance_lengths);
+    } else {
+      if (_out_reserve(d, fixed_bits / 8 + 16))
+        return -3;
+
+      _huffman_codes(fixed_litlen, FIXED_LITLEN_CODES, litlen_codes);
+      _huffman_codes(fixed_distance, DIST_CODES, distance_codes);
+
+      _put_bits(d, 1 << 1, 3);
+      _put_symbols(d, litlen_codes, fixed_litlen, distance_codes,
+                   fixed_distance);
+    }
+  }
+
+  d->block_start += (int64_t)d->block_bytes;
+  d->block_bytes = 0;
+  d->symbol_count = 0;
+
+  return 0;
+}
+
+static void _refill(struct _bitreader *br) {
+#ifdef WORD_LOADS
+  if (br->pos + 8 <= br->length) {
+    // bits past `count` get loaded again next time, and come out the same
+    uint64_t word;
+    memcpy(&word, br->data + br->pos, 8);
+
+    br->buffer |= word << br->count;
+    br->pos += (63 - br->count) >> 3;
+    br->count |= 56;
+    return;
+  }
+#endif
+
+  while (br->count <= 56) {
+    uint8_t byte = 0;
+
+    if (br->pos < br->length)
+      byte = br->data[br->pos];
+    else if (br->pos < br->length + sizeof(_sync_tail))
+      byte = _sync_tail[br->pos - br->length];
+
+    br->buffer |= (uint64_t)byte << br->count;
+    br->count += 8;
+    br->pos++;
+  }
+}
+
+static uint32_t _bits(struct _bitreader *br, uint8_t count) {
+  if (br->count < count)
+    _refill(br);
+
+  uint32_t value = (uint32_t)(br->buffer & ((1ull << count) - 1));
+  br->buffer >>= count;
+  br->count -= count;
+
+  return value;
+}
+
+static size_t _consumed(const struct _bitreader *br) {
+  return br->pos * 8 - br->count;
+}
+
+static int _huffman_build(struct _huffman *h, const uint8_t *lengths,
+                          uint16_t n) {
+  // returns 0 for a complete code, the number of unused codes for an
+  // incomplete one, and -1 for one that has too many codes in it
+  uint16_t offsets[MAX_BITS + 1];
+
+  memset(h->count, 0, sizeof(h->count));
+  memset(h->fast, 0, sizeof(h->fast));
+
+  for (uint16_t i = 0; i < n; ++i)
+    h->count[lengths[i]]++;
+
+  if (h->count[0] == n)
+    return 0;
+
+  int left = 1;
+  for (uint8_t bits = 1; bits <= MAX_BITS; ++bits) {
+    left <<= 1;
+    left -= h->count[bits];
+
+    if (left < 0)
+      return -1;
+  }
+
+  offsets[1] = 0;
+  for (uint8_t bits = 1; bits < MAX_BITS; ++bits)
+    offsets[bits + 1] = offsets[bits] + h->count[bits];
+
+  for (uint16_t i = 0; i < n; ++i) {
+    if (lengths[i])
+      h->symbol[offsets[lengths[i]]++] = i;
+  }
+
+  uint16_t code = 0;
+  uint16_t index = 0;
+  for (uint8_t bits = 1; bits <= FAST_BITS; ++bits) {
+    for (uint16_t i = 0; i < h->count[bits]; ++i) {
+      uint16_t entry = (uint16_t)((h->symbol[index++] << 4) | bits);
+
+      for (uint16_t r = _reverse(code++, bits); r < (1 << FAST_BITS);
+           r += (uint16_t)(1 << bits))
+        h->fast[r] = entry;
+    }
+
+    code <<= 1;
+  }
+
+  return left;
+}
+
+static int _decode(struct _bitreader *br, const struct _huffman *h) {
+  if (br->count < MAX_BITS)
+    _refill(br);
+
+  uint16_t entry = h->fast[br->buffer & ((1 << FAST_BITS) - 1)];
+  if (entry) {
+    br->buffer >>= entry & 15;
+    br->count -= entry & 15;
+    return entry >> 4;
+  }
+
+  // longer codes, one bit at a time
+  uint64_t bits = br->buffer;
+  int code = 0, first = 0, index = 0;
+
+  for (uint8_t length = 1; length <= MAX_BITS; ++length) {
+    code |= (int)(bits & 1);
+    bits >>= 1;
+
+    int count = h->count[length];
+    if (code - count < first) {
+      br->buffer >>= length;
+      br->count -= length;
+      return h->symbol[index + (code - first)];
+    }
+
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+
+  return -1;
+}
+
+static int _inflate_reserve(fpx_inflate_t *f, size_t bytes,
+                            size_t max_output) {
+  if (max_output && f->out_len + bytes > max_output)
+    return -5;
+
+  if (f->out_len + bytes <= f->out_allocated)
+    return 0;
+
+  size_t new_size = (f->out_allocated) ? f->out_allocated : 4096;
+  while (new_size < f->out_len + bytes)
+    new_size *= 2;
+
+  if (max_output && new_size > max_output)
+    new_size = max_output;
+
+  uint8_t *new_out = (uint8_t *)realloc(f->out, new_size);
+  if (NULL == new_out)
+    return -3;
+
+  f->out = new_out;
+  f->out_allocated = new_size;
+
+  return 0;
+}
+
+static int _inflate_stored(fpx_inflate_t *f, struct _bitreader *br,
+                           size_t max_output) {
+  // skip to the next byte, and hand back the whole bytes still buffered
+  br->pos -= br->count >> 3;
+  br->buffer = 0;
+  br->count = 0;
+
+  size_t total = br->length + sizeof(_sync_tail);
+  if (br->pos + 4 > total)
+    return -4;
+
+  uint8_t header[4];
+  for (uint8_t i = 0; i < 4; ++i, ++br->pos) {
+    header[i] = (br->pos < br->length) ? br->data[br->pos]
+                                       : _sync_tail[br->pos - br->length];
+  }
+
+  uint16_t length = (uint16_t)(header[0] | (header[1] << 8));
+  uint16_t check = (uint16_t)(header[2] | (header[3] << 8));
+
+  if ((length ^ check) != 0xffff || br->pos + length > total)
+    return -4;
+
+  int result = _inflate_reserve(f, length, max_output);
+  if (result)
+    return result;
+
+  size_t from_data = 0;
+  if (br->pos < br->length)
+    from_data = (br->length - br->pos < length) ? br->length - br->pos : length;
+
+  if (from_data)
+    memcpy(f->out + f->out_len, br->data + br->pos, from_data);
+
+  if (length > from_data)
+    memcpy(f->out + f->out_len + from_data,
+           _sync_tail + (br->pos + from_data - br->length), length - from_data);
+
+  f->out_len += length;
+  br->pos += length;
+
+  return 0;
+}
+
+static int _inflate_codes(fpx_inflate_t *f, struct _bitreader *br,
+                          const struct _huffman *litlen,
+                          const struct _huffman *distances,
+                          size_t max_output) {
+  size_t window_mask = ((size_t)1 << f->window_bits) - 1;
+  int result;
+
+  for (;;) {
+    int symbol = _decode(br, litlen);
+
+    if (symbol < 0 || br->pos > br->limit)
+      return -4;
+
+    if (symbol < 256) {
+      // the buffer never grows past `max_output`, so a full one is all
+      // there is to check for
+      if (f->out_len == f->out_allocated) {
+        result = _inflate_reserve(f, 1, max_output);
+        if (result)
+          return result;
+      }
+
+      f->out[f->out_len++] = (uint8_t)symbol;
+      continue;
+    }
+
+    if (END_OF_BLOCK == symbol)
+      return 0;
+
+    symbol -= 257;
+    if (symbol >= 29)
+      return -4;
+
+    size_t length = _length_base[symbol] + _bits(br, _length_extra[symbol]);
+
+    symbol = _decode(br, distances);
+    if (symbol < 0 || symbol >= DIST_CODES)
+      return -4;
+
+    size_t distance =
+        _distance_base[symbol] + _bits(br, _distance_extra[symbol]);
+
+    result = _inflate_reserve(f, length, max_output);
+    if (result)
+      return result;
+
+    if (distance > f->out_len) {
+      // reaches back into the previous messages
+      if (distance - f->out_len > f->window_fill)
+        return -4;
+
+      for (; length; --length, ++f->out_len) {
+        if (distance > f->out_len)
+          f->out[f->out_len] =
+            f->window[(f->window_pos - (distance - f->out_len)) & window_mask];
+        else
+          f->out[f->out_len] = f->out[f->out_len - distance];
+      }
+
+      continue;
+    }
+
+    uint8_t *to = f->out + f->out_len;
+    const uint8_t *from = to - distance;
+    f->out_len += length;
+
+    if (distance >= length) {
+      memcpy(to, from, length);
+      continue;
+    }
+
+    // overlapping; whole words are fine as long as they don't overlap
+    // each other
+    if (distance >= 8) {
+      for (; length >= 8; length -= 8, to += 8, from += 8)
+        memcpy(to, from, 8);
+    }
+
+    while (length--)
+      *to++ = *from++;
+  }
+}
+
+static int _inflate_fixed(fpx_inflate_t *f, struct _bitreader *br,
+                          size_t max_output) {
+  struct _huffman litlen, distances;
+  uint8_t lengths[FIXED_LITLEN_CODES];
+
+  memset(lengths, 8, 144);
+  memset(lengths + 144, 9, 256 - 144);
+  memset(lengths + 256, 7, 280 - 256);
+  memset(lengths + 280, 8, FIXED_LITLEN_CODES - 280);
+  _huffman_build(&litlen, lengths, FIXED_LITLEN_CODES);
+
+  memset(lengths, 5, DIST_CODES);
+  _huffman_build(&distances, lengths, DIST_CODES);
+
+  return _inflate_codes(f, br, &litlen, &distances, max_output);
+}
+
+static int _inflate_dynamic(fpx_inflate_t *f, struct _bitreader *br,
+                            size_t max_output) {
+  struct _huffman litlen, distances;
+  uint8_t lengths[LITLEN_CODES + DIST_CODES];
+
+  uint16_t litlen_count = (uint16_t)(_bits(br, 5) + 257);
+  uint16_t distance_count = (uint16_t)(_bits(br, 5) + 1);
+  uint8_t codelen_count = (uint8_t)(_bits(br, 4) + 4);
+
+  if (litlen_count > LITLEN_CODES || distance_count > DIST_CODES)
+    return -4;
+
+  memset(lengths, 0, CODELEN_CODES);
+  for (uint8_t i = 0; i < codelen_count; ++i)
+    lengths[_codelen_order[i]] = (uint8_t)_bits(br, 3);
+
+  // the code length code has to be complete
+  if (_huffman_build(&litlen, lengths, CODELEN_CODES))
+    return -4;
+
+  uint16_t total = litlen_count + distance_count;
+  for (uint16_t index = 0; index < total;) {
+    int symbol = _decode(br, &litlen);
+
+    if (symbol < 0 || br->pos > br->limit)
+      return -4;
+
+    if (symbol < 16) {
+      lengths[index++] = (uint8_t)symbol;
+      continue;
+    }
+
+    uint8_t value = 0;
+    uint8_t repeat;
+
+    if (16 == symbol) {
+      if (0 == index)
+        return -4;
+
+      value = lengths[index - 1];
+      repeat = (uint8_t)(3 + _bits(br, 2));
+    } else if (17 == symbol) {
+      repeat = (uint8_t)(3 + _bits(br, 3));
+    } else {
+      repeat = (uint8_t)(11 + _bits(br, 7));
+    }
+
+    if (index + repeat > total)
+      return -4;
+
+    memset(lengths + index, value, repeat);
+    index += repeat;
+  }
+
+  if (0 == lengths[END_OF_BLOCK])
+    return -4;
+
+  // incomplete codes are only fine when they are a single 1-bit code
+  int left = _huffman_build(&litlen, lengths, litlen_count);
+  if (left && (left < 0 || litlen_count != litlen.count[0] + litlen.count[1]))
+    return -4;
+
+  left = _huffman_build(&distances, lengths + litlen_count, distance_count);
+  if (left &&
+      (left < 0 || distance_count != distances.count[0] + distances.count[1]))
+    return -4;
+
+  return _inflate_codes(f, br, &litlen, &distances, max_output);
+}
+
+static void _window_update(fpx_inflate_t *f) {
+  size_t window_size = (size_t)1 << f->window_bits;
+
+  if (f->out_len >= window_size) {
+    memcpy(f->window, f->out + f->out_len - window_size, window_size);
+    f->window_pos = 0;
+    f->window_fill = window_size;
+    return;
+  }
+
+  const uint8_t *from = f->out;
+  size_t left = f->out_len;
+
+  while (left) {
+    size_t part = window_size - f->window_pos;
+    if (part > left)
+      part = left;
+
+    memcpy(f->window + f->window_pos, from, part);
+    f->window_pos = (f->window_pos + part) & (window_size - 1);
+    from += part;
+    left -= part;
+  }
+
+  f->window_fill += f->out_len;
+  if (f->window_fill > window_size)
+    f->window_fill = window_size;
+}
@@ -6,56 +6,377 @@
 
 #include "c-utils/format.h"
 #include "c-utils/endian.h"
-#include "math/math.h"
 
-#ifndef __FPXLIBC_ASM
-int fpx_strint(const char *input) {
-  // state checkers
-  unsigned char first = 1;
-  unsigned char positive = 1;
+#include <float.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdlib.h>
 
-  int retval = 0;
+#define MANTISSA_DIGITS_MAX 19 /* any 19 decimal digits fit in a uint64_t */
+#define MANTISSA_19_DIGITS 1000000000000000000ULL /* smallest with 19 */
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BIAS 1075 /* 1023, plus the 52 mantissa bits */
+#define DOUBLE_INFINITY_BITS 0x7FF0000000000000ULL
+#define DOUBLE_NAN_BITS 0x7FF8000000000000ULL
+#define EXACT_POW10_MAX 22 /* the largest power of ten a double holds exactly */
+#define PARSE_POW10_MAX 308 /* above 10^308, every parsed value is infinite */
+#define POW5_MIN -342 /* below 10^-342, every parsed value rounds to 0 */
+#define POW5_MAX 324  /* formatting goes down to 10^-324 */
+#define POW5_COUNT (POW5_MAX - POW5_MIN + 1)
+#define BIG_SCALE 1760 /* 2^1760 / 5^342 keeps the 2z + 128 bits needed below */
+#define BIG_LIMBS 56   /* 32-bit limbs, enough to hold 2^BIG_SCALE */
+#define FALLBACK_STACK 256 /* longer numbers are copied to the heap */
 
-  while ((*input >= '0' && *input <= '9') || (first && (*input == '-'))) {
-    retval *= 10;
-    first = 0;
+#define IS_DIGIT(c) ((uint8_t)((c) - '0') < 10)
 
-    if (*input == '-') {
-      positive = 0;
-      ++input;
-      continue;
+typedef struct {
+  uint64_t hi, lo;
+} _u128;
+
+typedef struct {
+  uint64_t mantissa; // the first 19 significant digits
+  int64_t exponent;  // the value is about mantissa * 10^exponent
+  uint8_t negative;
+  uint8_t truncated; // there were more than 19 significant digits
+} _decimal;
+
+typedef union {
+  double value;
+  uint64_t bits;
+} _double_bits;
+
+static const char _digit_pairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t _pow10_u64[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+static const double _exact_pow10[EXACT_POW10_MAX + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// normalized 128-bit powers of five, 5^POW5_MIN at index 0;
+// filled in by _build_pow5_tables() when the library is loaded
+static _u128 _pow5_parse[POW5_COUNT];  // truncated, as Eisel-Lemire expects
+static _u128 _pow5_format[POW5_COUNT]; // rounded up, as Schubfach expects
+
+static int _count_digits(uint64_t);
+static void _write_digits(char *end, uint64_t);
+static int _parse_digits(const char *, size_t, uint64_t *, size_t *);
+
+static size_t _parse_decimal(const char *, size_t, _decimal *);
+static size_t _parse_special(const char *, size_t, double *);
+static uint64_t _eisel_lemire(int64_t power, uint64_t mantissa);
+static int _parse_fallback(const char *, size_t, double *);
+static void _shortest(uint64_t ieee_mantissa, int ieee_exponent,
+                      uint64_t *digits, int *exponent);
+
+static _u128 _mul64(uint64_t, uint64_t);
+static int _clz64(uint64_t);
+
+int fpx_uint64str(uint64_t value, char *output, size_t buflen) {
+  if (NULL == output)
+    return -1;
+
+  int len = _count_digits(value);
+  if (buflen < (size_t)len)
+    return -2;
+
+  _write_digits(output + len, value);
+
+  if (buflen > (size_t)len)
+    output[len] = '\0';
+
+  return len;
+}
+
+int fpx_int64str(int64_t value, char *output, size_t buflen) {
+  if (NULL == output)
+    return -1;
+
+  if (0 <= value)
+    return fpx_uint64str((uint64_t)value, output, buflen);
+
+  // the magnitude as unsigned also covers INT64_MIN
+  uint64_t magnitude = 0 - (uint64_t)value;
+
+  int len = _count_digits(magnitude) + 1;
+  if (buflen < (size_t)len)
+    return -2;
+
+  output[0] = '-';
+  _write_digits(output + len, magnitude);
+
+  if (buflen > (size_t)len)
+    output[len] = '\0';
+
+  return len;
+}
+
+int fpx_struint64(const char *input, size_t len, uint64_t *output,
+                  size_t *used) {
+  if (NULL == input || NULL == output)
+    return -1;
+
+  size_t digits = 0;
+  int result = _parse_digits(input, len, output, &digits);
+
+  if (NULL != used)
+    *used = digits;
+
+  return result;
+}
+
+int fpx_strint64(const char *input, size_t len, int64_t *output,
+                 size_t *used) {
+  if (NULL == input || NULL == output)
+    return -1;
+
+  uint8_t negative = (0 < len && '-' == input[0]);
+
+  uint64_t magnitude = 0;
+  size_t digits = 0;
+  int result = _parse_digits(input + negative, len - negative, &magnitude,
+                             &digits);
+
+  if (-2 == result)
+    return -2;
+
+  if (negative) {
+    if (magnitude > (uint64_t)INT64_MAX + 1) {
+      result = -3;
+      magnitude = (uint64_t)INT64_MAX + 1;
+    }
+
+    // written this way round, so INT64_MIN does not overflow
+    *output = (0 == magnitude) ? 0 : -(int64_t)(magnitude - 1) - 1;
+  } else {
+    if (magnitude > (uint64_t)INT64_MAX) {
+      result = -3;
+      magnitude = INT64_MAX;
     }
 
-    retval += (*input - '0');
-    ++input;
+    *output = (int64_t)magnitude;
   }
 
-  if (!positive)
-    retval *= -1;
+  if (NULL != used)
+    *used = digits + negative;
 
-  return retval;
+  return result;
+}
+
+#ifndef __FPXLIBC_ASM
+int fpx_strint(const char *input) {
+  int64_t value = 0;
+
+  // parsing stops at the NULL-byte, so the string needs no measuring
+  fpx_strint64(input, SIZE_MAX, &value, NULL);
+
+  if (value > INT_MAX)
+    return INT_MAX;
+  if (value < INT_MIN)
+    return INT_MIN;
+
+  return (int)value;
 }
 #endif // __FPXLIBC_ASM
 
 int fpx_intstr(int input, char *output) {
-  uint8_t digits = 0;
-  int input_clone = input;
+  uint64_t magnitude =
+      (0 > input) ? 0 - (uint64_t)(int64_t)input : (uint64_t)input;
+
+  if (0 > input)
+    *(output++) = '-';
+
+  // like before, there is no NULL-byte
+  _write_digits(output + _count_digits(magnitude), magnitude);
+
+  return (int)magnitude;
+}
 
-  // get amount of digits
-  for (; input_clone || !digits; input_clone /= 10) {
-    ++digits;
+int fpx_doublestr(double value, char *output, size_t buflen) {
+  if (NULL == output)
+    return -1;
+
+  _double_bits pun;
+  pun.value = value;
+
+  uint8_t negative = pun.bits >> 63;
+  int ieee_exponent = (pun.bits >> DOUBLE_MANTISSA_BITS) & 0x7FF;
+  uint64_t ieee_mantissa = pun.bits & ((1ULL << DOUBLE_MANTISSA_BITS) - 1);
+
+  uint64_t digits = 0;
+  int exponent = 0;
+  const char *special = NULL;
+
+  if (0x7FF == ieee_exponent)
+    special = (0 != ieee_mantissa) ? "NaN"
+              : (negative)         ? "-Infinity"
+                                   : "Infinity";
+  else if (0 != ieee_exponent || 0 != ieee_mantissa)
+    _shortest(ieee_mantissa, ieee_exponent, &digits, &exponent);
+
+  if (NULL != special) {
+    size_t len = 0;
+    while (special[len])
+      ++len;
+
+    if (buflen < len)
+      return -2;
+
+    for (size_t i = 0; i < len; ++i)
+      output[i] = special[i];
+
+    if (buflen > len)
+      output[len] = '\0';
+
+    return (int)len;
   }
 
-  if (input < 0) {
-    *(output++) = '-';
-    input = (int)fpx_abs(input);
+  int count = _count_digits(digits);
+
+  // where the decimal point goes, counted from the first digit
+  int point = exponent + count;
+  int sci_exponent = (0 < point) ? point - 1 : 1 - point;
+
+  int len;
+  if (count <= point && point <= 21)
+    len = point; // digits, then zeros
+  else if (0 < point && point <= 21)
+    len = count + 1; // digits with a point in between
+  else if (-6 < point && point <= 0)
+    len = 2 - point + count; // "0.", zeros, then digits
+  else
+    len = count + (1 < count) + 2 + _count_digits(sci_exponent);
+
+  len += negative;
+
+  if (buflen < (size_t)len)
+    return -2;
+
+  char *out = output;
+  if (negative)
+    *(out++) = '-';
+
+  if (count <= point && point <= 21) {
+    _write_digits(out + count, digits);
+    for (int i = count; i < point; ++i)
+      out[i] = '0';
+  } else if (0 < point && point <= 21) {
+    _write_digits(out + count, digits);
+    for (int i = count; i > point; --i)
+      out[i] = out[i - 1];
+    out[point] = '.';
+  } else if (-6 < point && point <= 0) {
+    out[0] = '0';
+    out[1] = '.';
+    for (int i = 0; i < -point; ++i)
+      out[2 + i] = '0';
+    _write_digits(out + 2 - point + count, digits);
+  } else {
+    // write the digits one place to the right, then pull the first one back
+    _write_digits(out + 1 + count, digits);
+    out[0] = out[1];
+
+    if (1 < count)
+      out[1] = '.';
+    else
+      --out;
+
+    out += count + 1;
+    *(out++) = 'e';
+    *(out++) = (0 < point) ? '+' : '-';
+    _write_digits(out + _count_digits(sci_exponent), sci_exponent);
   }
 
-  for (; digits > 0; --digits) {
-    *(output++) = ((input / (fpx_pow(10, digits - 1))) % 10) + '0';
+  if (buflen > (size_t)len)
+    output[len] = '\0';
+
+  return len;
+}
+
+int fpx_strdouble(const char *input, size_t len, double *output, size_t *used) {
+  if (NULL == input || NULL == output)
+    return -1;
+
+  _decimal decimal;
+  size_t consumed = _parse_decimal(input, len, &decimal);
+
+  if (0 == consumed) {
+    consumed = _parse_special(input, len, output);
+    if (0 == consumed)
+      return -2;
+
+    if (NULL != used)
+      *used = consumed;
+
+    return 0;
+  }
+
+  _double_bits pun;
+
+#if defined(FLT_EVAL_METHOD) && 0 == FLT_EVAL_METHOD
+  // both the mantissa and the power of ten are exact doubles here,
+  // so a single rounding operation gives the correctly rounded result
+  if (!decimal.truncated && -EXACT_POW10_MAX <= decimal.exponent &&
+      EXACT_POW10_MAX >= decimal.exponent &&
+      (1ULL << (DOUBLE_MANTISSA_BITS + 1)) >= decimal.mantissa) {
+    pun.value = (double)decimal.mantissa;
+
+    if (0 > decimal.exponent)
+      pun.value /= _exact_pow10[-decimal.exponent];
+    else
+      pun.value *= _exact_pow10[decimal.exponent];
+  } else
+#endif
+  {
+    pun.bits = _eisel_lemire(decimal.exponent, decimal.mantissa);
+
+    // the digits that were cut off can only matter when rounding the
+    // truncated mantissa up would give a different double
+    if (decimal.truncated &&
+        pun.bits != _eisel_lemire(decimal.exponent, decimal.mantissa + 1)) {
+      if (0 > _parse_fallback(input, consumed, output))
+        return -3;
+
+      if (NULL != used)
+        *used = consumed;
+
+      return 0;
+    }
   }
 
-  return input;
+  *output = (decimal.negative) ? -pun.value : pun.value;
+
+  if (NULL != used)
+    *used = consumed;
+
+  return 0;
 }
 
 void *fpx_hexstr(void *input, size_t bytes, char *output, size_t buflen) {
@@ -108,3 +429,558 @@ void *fpx_hexstr(void *input, size_t bytes, char *output, size_t buflen) {
 
   return output;
 }
+
+static int _count_digits(uint64_t value) {
+  if (10 > value)
+    return 1;
+
+  // log10 from log2; the guess is at most one too high
+  int guess = ((64 - _clz64(value)) * 1233) >> 12;
+  return guess + 1 - (value < _pow10_u64[guess]);
+}
+
+static void _write_digits(char *end, uint64_t value) {
+  // two at a time, backwards from the end
+  while (100 <= value) {
+    const char *pair = _digit_pairs + (value % 100) * 2;
+    value /= 100;
+
+    *(--end) = pair[1];
+    *(--end) = pair[0];
+  }
+
+  if (10 <= value) {
+    *(--end) = _digit_pairs[value * 2 + 1];
+    *(--end) = _digit_pairs[value * 2];
+  } else {
+    *(--end) = '0' + value;
+  }
+}
+
+static int _parse_digits(const char *input, size_t len, uint64_t *output,
+                         size_t *used) {
+  size_t i = 0;
+
+  // leading zeros do not count towards the 20 digits that fit
+  while (i < len && '0' == input[i])
+    ++i;
+
+  size_t start = i;
+  uint64_t value = 0;
+  int result = 0;
+
+  // up to 19 digits cannot overflow, so only the rest needs checking
+  while (i < len && i - start < MANTISSA_DIGITS_MAX && IS_DIGIT(input[i]))
+    value = value * 10 + (input[i++] - '0');
+
+  for (; i < len && IS_DIGIT(input[i]); ++i) {
+    uint64_t digit = input[i] - '0';
+
+    if (0 != result || value > (UINT64_MAX - digit) / 10) {
+      result = -3;
+      value = UINT64_MAX;
+    } else {
+      value = value * 10 + digit;
+    }
+  }
+
+  if (0 == i)
+    return -2;
+
+  *output = value;
+  *used = i;
+
+  return result;
+}
+
+static inline uint64_t _load_eight(const char *input) {
+  // compilers turn this into a single load on little endian machines
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i)
+    value |= (uint64_t)(uint8_t)input[i] << (i * 8);
+
+  return value;
+}
+
+static inline uint8_t _is_eight_digits(uint64_t chars) {
+  return 0 == (((chars & 0xF0F0F0F0F0F0F0F0ULL) |
+                (((chars + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >>
+                 4)) ^
+               0x3333333333333333ULL);
+}
+
+static inline uint64_t _parse_eight(uint64_t chars) {
+  // SWAR: pairs, then quads, then the whole thing
+  chars -= 0x3030303030303030ULL;
+  chars = (chars * 10) + (chars >> 8);
+  chars = (((chars & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+           (((chars >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >>
+          32;
+
+  return (uint32_t)chars;
+}
+
+static size_t _parse_decimal(const char *input, size_t len,
+                             _decimal *decimal) {
+  size_t i = 0;
+
+  decimal->negative = (0 < len && '-' == input[0]);
+  i += decimal->negative;
+
+  uint64_t mantissa = 0;
+
+  size_t int_start = i;
+  while (i + 8 <= len && _is_eight_digits(_load_eight(input + i))) {
+    mantissa = mantissa * 100000000 + _parse_eight(_load_eight(input + i));
+    i += 8;
+  }
+  while (i < len && IS_DIGIT(input[i]))
+    mantissa = mantissa * 10 + (input[i++] - '0');
+  size_t int_end = i;
+
+  size_t frac_start = i, frac_end = i;
+  if (i < len && '.' == input[i]) {
+    frac_start = ++i;
+    while (i + 8 <= len && _is_eight_digits(_load_eight(input + i))) {
+      mantissa = mantissa * 100000000 + _parse_eight(_load_eight(input + i));
+      i += 8;
+    }
+    while (i < len && IS_DIGIT(input[i]))
+      mantissa = mantissa * 10 + (input[i++] - '0');
+    frac_end = i;
+  }
+
+  int64_t digits = (int_end - int_start) + (frac_end - frac_start);
+  if (0 == digits)
+    return 0;
+
+  // an 'e' without digits after it is not part of the number
+  int64_t exp_number = 0;
+  if (i < len && ('e' == input[i] || 'E' == input[i])) {
+    size_t e = i + 1;
+    uint8_t exp_negative = FALSE;
+
+    if (e < len && ('-' == input[e] || '+' == input[e]))
+      exp_negative = ('-' == input[e++]);
+
+    if (e < len && IS_DIGIT(input[e])) {
+      for (; e < len && IS_DIGIT(input[e]); ++e) {
+        // this is out of range either way; keep it from overflowing
+        if (0x10000000 > exp_number)
+          exp_number = exp_number * 10 + (input[e] - '0');
+      }
+
+      if (exp_negative)
+        exp_number = -exp_number;
+
+      i = e;
+    }
+  }
+
+  decimal->mantissa = mantissa;
+  decimal->exponent = exp_number - (int64_t)(frac_end - frac_start);
+  decimal->truncated = FALSE;
+
+  if (MANTISSA_DIGITS_MAX < digits) {
+    // leading zeros are not significant
+    for (size_t s = int_start;
+         s < frac_end && ('0' == input[s] || '.' == input[s]); ++s)
+      digits -= ('0' == input[s]);
+  }
+
+  if (MANTISSA_DIGITS_MAX < digits) {
+    // keep the first 19 significant digits, and scale for the rest
+    decimal->truncated = TRUE;
+    mantissa = 0;
+
+    size_t s = int_start;
+    while (MANTISSA_19_DIGITS > mantissa && s < int_end)
+      mantissa = mantissa * 10 + (input[s++] - '0');
+
+    if (MANTISSA_19_DIGITS <= mantissa) {
+      decimal->exponent = (int64_t)(int_end - s) + exp_number;
+    } else {
+      s = frac_start;
+      while (MANTISSA_19_DIGITS > mantissa && s < frac_end)
+        mantissa = mantissa * 10 + (input[s++] - '0');
+
+      decimal->exponent = exp_number - (int64_t)(s - frac_start);
+    }
+
+    decimal->mantissa = mantissa;
+  }
+
+  return i;
+}
+
+static uint8_t _starts_with_nocase(const char *input, size_t len,
+                                   const char *word) {
+  for (size_t i = 0; word[i]; ++i) {
+    if (i >= len || (input[i] | 0x20) != word[i])
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static size_t _parse_special(const char *input, size_t len, double *output) {
+  uint8_t negative = (0 < len && '-' == input[0]);
+  size_t used = 0;
+
+  _double_bits pun;
+
+  if (_starts_with_nocase(input + negative, len - negative, "infinity")) {
+    pun.bits = DOUBLE_INFINITY_BITS;
+    used = 8;
+  } else if (_starts_with_nocase(input + negative, len - negative, "inf")) {
+    pun.bits = DOUBLE_INFINITY_BITS;
+    used = 3;
+  } else if (_starts_with_nocase(input + negative, len - negative, "nan")) {
+    pun.bits = DOUBLE_NAN_BITS;
+    used = 3;
+  } else {
+    return 0;
+  }
+
+  *output = (negative) ? -pun.value : pun.value;
+
+  return used + negative;
+}
+
+static uint64_t _eisel_lemire(int64_t power, uint64_t mantissa) {
+  // Lemire, "Number Parsing at a Gigabyte per Second" (2021), as done in
+  // fast_float. With 19 digits and a 128-bit table it never needs to give up
+  if (0 == mantissa || POW5_MIN > power)
+    return 0;
+  if (PARSE_POW10_MAX < power)
+    return DOUBLE_INFINITY_BITS;
+
+  int leading = _clz64(mantissa);
+  mantissa <<= leading;
+
+  _u128 pow5 = _pow5_parse[power - POW5_MIN];
+  _u128 product = _mul64(mantissa, pow5.hi);
+
+  // the low half of the table entry only matters when it could carry into
+  // the bits that are kept
+  if (0x1FF == (product.hi & 0x1FF)) {
+    _u128 second = _mul64(mantissa, pow5.lo);
+    product.lo += second.hi;
+    product.hi += (second.hi > product.lo);
+  }
+
+  int upper = (int)(product.hi >> 63);
+  int shift = upper + 64 - DOUBLE_MANTISSA_BITS - 3;
+  uint64_t bits = product.hi >> shift;
+
+  // floor(log2(10^power)), plus the normalization
+  int32_t exponent =
+      (int32_t)(((217706 * power) >> 16) + 63 + upper - leading + 1023);
+
+  if (0 >= exponent) {
+    // subnormal; rounding up may still make it the smallest normal number,
+    // in which case the carry lands in the exponent by itself
+    if (64 <= 1 - exponent)
+      return 0;
+
+    bits >>= 1 - exponent;
+    bits += bits & 1;
+
+    return bits >> 1;
+  }
+
+  // exactly halfway between two doubles: round to even instead of up
+  if (1 >= product.lo && -4 <= power && 23 >= power && 1 == (bits & 3) &&
+      (bits << shift) == product.hi)
+    bits &= ~1ULL;
+
+  bits += bits & 1;
+  bits >>= 1;
+
+  if ((2ULL << DOUBLE_MANTISSA_BITS) <= bits) {
+    bits = 1ULL << DOUBLE_MANTISSA_BITS;
+    ++exponent;
+  }
+
+  if (0x7FF <= exponent)
+    return DOUBLE_INFINITY_BITS;
+
+  bits &= ~(1ULL << DOUBLE_MANTISSA_BITS);
+
+  return ((uint64_t)exponent << DOUBLE_MANTISSA_BITS) | bits;
+}
+
+static int _parse_fallback(const char *input, size_t len, double *output) {
+  char stack[FALLBACK_STACK];
+  char *copy = (len < sizeof(stack)) ? stack : (char *)malloc(len + 1);
+
+  if (NULL == copy)
+    return -3;
+
+  // strtod() wants the decimal point of the current locale
+  char point = localeconv()->decimal_point[0];
+
+  for (size_t i = 0; i < len; ++i)
+    copy[i] = ('.' == input[i]) ? point : input[i];
+  copy[len] = '\0';
+
+  *output = strtod(copy, NULL);
+
+  if (copy != stack)
+    free(copy);
+
+  return 0;
+}
+
+static inline int _floor_log2_pow10(int e) { return (e * 1741647) >> 19; }
+
+static inline int _floor_log10_pow2(int e) { return (e * 1262611) >> 22; }
+
+static inline int _floor_log10_three_quarters_pow2(int e) {
+  return (e * 1262611 - 524031) >> 22;
+}
+
+static inline uint64_t _round_to_odd(_u128 g, uint64_t cp) {
+  _u128 x = _mul64(g.lo, cp);
+  _u128 y = _mul64(g.hi, cp);
+
+  y.lo += x.hi;
+  y.hi += (y.lo < x.hi);
+
+  return y.hi | (1 < y.lo);
+}
+
+static void _shortest(uint64_t ieee_mantissa, int ieee_exponent,
+                      uint64_t *digits, int *exponent) {
+  // Giulietti, "The Schubfach way to render doubles" (2020)
+  uint64_t c;
+  int q;
+
+  if (0 != ieee_exponent) {
+    c = (1ULL << DOUBLE_MANTISSA_BITS) | ieee_mantissa;
+    q = ieee_exponent - DOUBLE_EXPONENT_BIAS;
+
+    // small integers are their own shortest representation
+    if (0 <= -q && -q < DOUBLE_MANTISSA_BITS + 1 &&
+        0 == (c & ((1ULL << -q) - 1))) {
+      *digits = c >> -q;
+      *exponent = 0;
+      return;
+    }
+  } else {
+    c = ieee_mantissa;
+    q = 1 - DOUBLE_EXPONENT_BIAS;
+  }
+
+  uint8_t even = (0 == (c & 1));
+
+  // at a power of two, the next double down is closer than the next one up
+  uint8_t closer = (0 == ieee_mantissa && 1 < ieee_exponent);
+
+  uint64_t cbl = 4 * c - 2 + closer;
+  uint64_t cb = 4 * c;
+  uint64_t cbr = 4 * c + 2;
+
+  int k = (closer) ? _floor_log10_three_quarters_pow2(q) : _floor_log10_pow2(q);
+  int h = q + _floor_log2_pow10(-k) + 1;
+
+  _u128 g = _pow5_format[-k - POW5_MIN];
+
+  uint64_t vbl = _round_to_odd(g, cbl << h);
+  uint64_t vb = _round_to_odd(g, cb << h);
+  uint64_t vbr = _round_to_odd(g, cbr << h);
+
+  uint64_t lower = vbl + !even;
+  uint64_t upper = vbr - !even;
+
+  // one digit less, if that still lands within the rounding interval
+  uint64_t s = vb / 4;
+  if (10 <= s) {
+    uint64_t sp = s / 10;
+    uint8_t up_inside = lower <= 40 * sp;
+    uint8_t wp_inside = 40 * sp + 40 <= upper;
+
+    if (up_inside != wp_inside) {
+      s = sp + wp_inside;
+      k += 1;
+      goto strip;
+    }
+  }
+
+  {
+    uint8_t u_inside = lower <= 4 * s;
+    uint8_t w_inside = 4 * s + 4 <= upper;
+
+    if (u_inside != w_inside) {
+      s += w_inside;
+    } else {
+      // both fit; take the closest one
+      uint64_t mid = 4 * s + 2;
+      s += (vb > mid || (vb == mid && 0 != (s & 1)));
+    }
+  }
+
+strip:
+  while (0 == s % 10) {
+    s /= 10;
+    ++k;
+  }
+
+  *digits = s;
+  *exponent = k;
+}
+
+static uint32_t _big_limb(const uint32_t *big, int index) {
+  return (BIG_LIMBS > index) ? big[index] : 0;
+}
+
+static int _big_bitlength(const uint32_t *big) {
+  for (int i = BIG_LIMBS - 1; i >= 0; --i) {
+    if (big[i])
+      return i * 32 + 64 - _clz64(big[i]);
+  }
+
+  return 0;
+}
+
+// the 128 bits from bit 'shift' upwards
+static _u128 _big_bits(const uint32_t *big, int shift) {
+  uint32_t words[4];
+
+  for (int i = 0; i < 4; ++i) {
+    int limb = (shift >> 5) + i;
+    uint64_t pair =
+        ((uint64_t)_big_limb(big, limb + 1) << 32) | _big_limb(big, limb);
+    words[i] = (uint32_t)(pair >> (shift & 31));
+  }
+
+  _u128 bits = {((uint64_t)words[3] << 32) | words[2],
+                ((uint64_t)words[1] << 32) | words[0]};
+  return bits;
+}
+
+static uint8_t _big_low_zero(const uint32_t *big, int bits) {
+  for (int i = 0; i < bits >> 5; ++i) {
+    if (big[i])
+      return FALSE;
+  }
+
+  return 0 == (bits & 31) || 0 == (big[bits >> 5] & ((1U << (bits & 31)) - 1));
+}
+
+static void _big_mul5(uint32_t *big) {
+  uint64_t carry = 0;
+
+  for (int i = 0; i < BIG_LIMBS; ++i) {
+    carry += (uint64_t)big[i] * 5;
+    big[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+}
+
+static void _big_div5(uint32_t *big) {
+  uint64_t remainder = 0;
+
+  for (int i = BIG_LIMBS - 1; i >= 0; --i) {
+    uint64_t current = (remainder << 32) | big[i];
+    big[i] = (uint32_t)(current / 5);
+    remainder = current % 5;
+  }
+}
+
+static _u128 _u128_add(_u128 value, uint64_t addend) {
+  value.lo += addend;
+  value.hi += (value.lo < addend);
+
+  return value;
+}
+
+// Both algorithms need 5^p as a normalized 128-bit number. These are worked
+// out exactly with a small big-integer, instead of shipping 20 KiB of tables
+__attribute__((constructor)) static void _build_pow5_tables(void) {
+  uint32_t big[BIG_LIMBS] = {0};
+  uint32_t power[BIG_LIMBS] = {0};
+  uint32_t scaled[BIG_LIMBS];
+
+  // 5^p * 2^128, so the top 128 bits are always a right shift away
+  big[4] = 1;
+  for (int p = 0; p <= POW5_MAX; ++p) {
+    if (0 < p)
+      _big_mul5(big);
+
+    int shift = _big_bitlength(big) - 128;
+    _u128 truncated = _big_bits(big, shift);
+
+    _pow5_parse[p - POW5_MIN] = truncated;
+    _pow5_format[p - POW5_MIN] =
+        _u128_add(truncated, !_big_low_zero(big, shift));
+  }
+
+  // floor(2^BIG_SCALE / 5^p); dividing the floor again stays exact
+  for (int i = 0; i < BIG_LIMBS; ++i)
+    big[i] = 0;
+  big[BIG_SCALE / 32] = 1U << (BIG_SCALE % 32);
+  power[0] = 1;
+
+  for (int p = 1; p <= -POW5_MIN; ++p) {
+    _big_div5(big);
+    _big_mul5(power);
+
+    // 2^(z + 127) / 5^p lies between 2^127 and 2^128, and is never whole
+    int z = _big_bitlength(power);
+    _u128 rounded_up = _u128_add(_big_bits(big, BIG_SCALE - z - 127), 1);
+
+    _pow5_format[-p - POW5_MIN] = rounded_up;
+
+    if (27 >= p) {
+      _pow5_parse[-p - POW5_MIN] = rounded_up;
+      continue;
+    }
+
+    // like fast_float: floor(2^(2z + 128) / 5^p) + 1, then truncated
+    int drop = BIG_SCALE - 2 * z - 128;
+    for (int i = 0; i < BIG_LIMBS; ++i) {
+      uint64_t pair = ((uint64_t)_big_limb(big, i + (drop >> 5) + 1) << 32) |
+                      _big_limb(big, i + (drop >> 5));
+      scaled[i] = (uint32_t)(pair >> (drop & 31));
+    }
+
+    for (int i = 0; i < BIG_LIMBS && 0 == ++scaled[i]; ++i)
+      ;
+
+    _pow5_parse[-p - POW5_MIN] =
+        _big_bits(scaled, _big_bitlength(scaled) - 128);
+  }
+}
+
+static _u128 _mul64(uint64_t a, uint64_t b) {
+  _u128 product;
+
+#ifdef __SIZEOF_INT128__
+  __extension__ unsigned __int128 full = (unsigned __int128)a * b;
+  product.hi = (uint64_t)(full >> 64);
+  product.lo = (uint64_t)full;
+#else
+  uint64_t ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+  uint64_t lh = (a & 0xFFFFFFFF) * (b >> 32);
+  uint64_t hl = (a >> 32) * (b & 0xFFFFFFFF);
+  uint64_t hh = (a >> 32) * (b >> 32);
+
+  uint64_t middle = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+  product.lo = (middle << 32) | (ll & 0xFFFFFFFF);
+  product.hi = hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+#endif
+
+  return product;
+}
+
+static int _clz64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(value);
+#else
+  int count = 0;
+  for (uint64_t bit = 1ULL << 63; bit && !(value & bit); bit >>= 1)
+    ++count;
+  return count;
+#endif
+}
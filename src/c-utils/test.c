@@ -0,0 +1,189 @@
+//
+//  "test.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+// Benchmarks the integer and double conversions in format.c against
+// snprintf() and strtod()/strtoull(), then the throughput of the SHA-1 and
+// SHA-256 code in crypto.c, one message at a time and batched.
+// src/test/c-utils.cpp checks both for correctness. Build with ./compile.sh
+
+#include "../../include/c-utils/crypto.h"
+#include "../../include/c-utils/format.h"
+#include "../../include/test/bench.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_VALUES 4096
+#define BENCH_ROUNDS 256
+#define HASH_MESSAGES 1024
+#define HASH_BYTES (1 << 16) /* size of the large message that is hashed */
+
+static double _random_double(void) {
+  union {
+    uint64_t bits;
+    double value;
+  } pun;
+
+  // finite values only, over the whole exponent range
+  do
+    pun.bits = bench_random();
+  while (0x7FF == ((pun.bits >> 52) & 0x7FF));
+
+  return pun.value;
+}
+
+static void _bench_hashes(const uint8_t *data) {
+  static const uint8_t *inputs[HASH_MESSAGES];
+  static size_t lengths[HASH_MESSAGES];
+  static uint8_t many1[HASH_MESSAGES][20], many256[HASH_MESSAGES][32];
+  uint8_t digest[32];
+  double t[3];
+
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    fpx_sha1_digest(data, HASH_BYTES, digest, 0);
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    fpx_sha256_digest(data, HASH_BYTES, digest, 0);
+  t[2] = bench_now();
+
+  double mbytes = (double)BENCH_ROUNDS * HASH_BYTES / (1 << 20);
+  printf("%-16s %9.0f MB/s\n", "sha1 64 KiB", mbytes / (t[1] - t[0]));
+  printf("%-16s %9.0f MB/s\n", "sha256 64 KiB", mbytes / (t[2] - t[1]));
+
+  // about the size of a WebSocket key with the GUID appended
+  for (int i = 0; i < HASH_MESSAGES; ++i) {
+    inputs[i] = data + i;
+    lengths[i] = 60;
+  }
+
+  printf("\n");
+  bench_report_header("60-byte messages", "one by one", "batched");
+
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < HASH_MESSAGES; ++i)
+      fpx_sha1_digest(inputs[i], lengths[i], many1[i], 0);
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    fpx_sha1_digest_many(inputs, lengths, HASH_MESSAGES, many1);
+  t[2] = bench_now();
+
+  double count = (double)BENCH_ROUNDS * HASH_MESSAGES;
+  bench_report_calls("sha1", count, t[1] - t[0], t[2] - t[1]);
+
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < HASH_MESSAGES; ++i)
+      fpx_sha256_digest(inputs[i], lengths[i], many256[i], 0);
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    fpx_sha256_digest_many(inputs, lengths, HASH_MESSAGES, many256);
+  t[2] = bench_now();
+
+  bench_report_calls("sha256", count, t[1] - t[0], t[2] - t[1]);
+}
+
+int main(void) {
+  char text[64];
+
+  double *doubles = malloc(BENCH_VALUES * sizeof(double));
+  uint64_t *integers = malloc(BENCH_VALUES * sizeof(uint64_t));
+  char(*strings)[32] = malloc(BENCH_VALUES * sizeof(*strings));
+  char(*int_strings)[32] = malloc(BENCH_VALUES * sizeof(*int_strings));
+  if (NULL == doubles || NULL == integers || NULL == strings ||
+      NULL == int_strings)
+    return 1;
+
+  for (int i = 0; i < BENCH_VALUES; ++i) {
+    doubles[i] = _random_double();
+    integers[i] = bench_random() >> (bench_random() % 64);
+    snprintf(strings[i], sizeof(*strings), "%.17g", doubles[i]);
+    snprintf(int_strings[i], sizeof(*int_strings), "%" PRIu64, integers[i]);
+  }
+
+  volatile uint64_t sink = 0;
+  double t[3];
+
+  double count = (double)BENCH_VALUES * BENCH_ROUNDS;
+  bench_report_header("", "libc", "fpxlibc");
+
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < BENCH_VALUES; ++i)
+      sink += snprintf(text, sizeof(text), "%" PRIu64, integers[i]);
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < BENCH_VALUES; ++i)
+      sink += fpx_uint64str(integers[i], text, sizeof(text));
+  t[2] = bench_now();
+  bench_report_calls("format uint64", count, t[1] - t[0], t[2] - t[1]);
+
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < BENCH_VALUES; ++i)
+      sink += strtoull(int_strings[i], NULL, 10);
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r) {
+    for (int i = 0; i < BENCH_VALUES; ++i) {
+      uint64_t value;
+      fpx_struint64(int_strings[i], sizeof(*int_strings), &value, NULL);
+      sink += value;
+    }
+  }
+  t[2] = bench_now();
+  bench_report_calls("parse uint64", count, t[1] - t[0], t[2] - t[1]);
+
+  // %.17g round trips too, but is usually longer than it needs to be
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < BENCH_VALUES; ++i)
+      sink += snprintf(text, sizeof(text), "%.17g", doubles[i]);
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < BENCH_VALUES; ++i)
+      sink += fpx_doublestr(doubles[i], text, sizeof(text));
+  t[2] = bench_now();
+  bench_report_calls("format double", count, t[1] - t[0], t[2] - t[1]);
+
+  t[0] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r)
+    for (int i = 0; i < BENCH_VALUES; ++i)
+      sink += (0 < strtod(strings[i], NULL));
+  t[1] = bench_now();
+  for (int r = 0; r < BENCH_ROUNDS; ++r) {
+    for (int i = 0; i < BENCH_VALUES; ++i) {
+      double value;
+      fpx_strdouble(strings[i], sizeof(*strings), &value, NULL);
+      sink += (0 < value);
+    }
+  }
+  t[2] = bench_now();
+  bench_report_calls("parse double", count, t[1] - t[0], t[2] - t[1]);
+
+  (void)sink;
+
+  free(doubles);
+  free(integers);
+  free(strings);
+  free(int_strings);
+
+  uint8_t *data = malloc(HASH_BYTES);
+  if (NULL == data)
+    return 1;
+
+  for (int i = 0; i < HASH_BYTES; ++i)
+    data[i] = (uint8_t)bench_random();
+
+  printf("\n");
+  _bench_hashes(data);
+
+  free(data);
+
+  return 0;
+}
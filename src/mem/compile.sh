@@ -0,0 +1,10 @@
+#!/bin/bash
+
+CFLAGS="-g -O3"
+
+gcc \
+  test.c \
+  mem.c \
+  -I../../include \
+  $CFLAGS \
+  -o c.out
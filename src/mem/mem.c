@@ -6,38 +6,103 @@
 
 #include "mem/mem.h"
 
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MEM_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define SMALL_MAX 16 /* sizes up to here never reach a kernel */
+#define ERMS_THRESHOLD 4096 /* `rep movsb/stosb` wins from here on */
+#define CPUID_7_EBX_ERMS (1 << 9)
+
+// every kernel is only called for more than SMALL_MAX bytes
+typedef void (*_copy_kernel)(uint8_t *dst, const uint8_t *src, size_t length);
+typedef void (*_set_kernel)(uint8_t *dst, uint8_t value, size_t length);
+typedef int (*_compare_kernel)(const uint8_t *a, const uint8_t *b,
+                               size_t length);
+
+static void _copy_small(uint8_t *dst, const uint8_t *src, size_t length);
+static void _set_small(uint8_t *dst, uint8_t value, size_t length);
+static int _compare_small(const uint8_t *a, const uint8_t *b, size_t length);
+
+#if defined(MEM_X86)
+static void _copy_sse2(uint8_t *dst, const uint8_t *src, size_t length);
+static void _copy_sse2_backward(uint8_t *dst, const uint8_t *src,
+                                size_t length);
+static void _set_sse2(uint8_t *dst, uint8_t value, size_t length);
+static int _compare_sse2(const uint8_t *a, const uint8_t *b, size_t length);
+
+static void _copy_avx2(uint8_t *dst, const uint8_t *src, size_t length);
+static void _copy_avx2_backward(uint8_t *dst, const uint8_t *src,
+                                size_t length);
+static void _set_avx2(uint8_t *dst, uint8_t value, size_t length);
+static int _compare_avx2(const uint8_t *a, const uint8_t *b, size_t length);
+
+static void _copy_erms(uint8_t *dst, const uint8_t *src, size_t length);
+static void _set_erms(uint8_t *dst, uint8_t value, size_t length);
+#else
+static void _copy_words(uint8_t *dst, const uint8_t *src, size_t length);
+static void _copy_words_backward(uint8_t *dst, const uint8_t *src,
+                                 size_t length);
+static void _set_words(uint8_t *dst, uint8_t value, size_t length);
+static int _compare_words(const uint8_t *a, const uint8_t *b, size_t length);
+
+static void _copy_erms(uint8_t *dst, const uint8_t *src, size_t length);
+static void _set_erms(uint8_t *dst, uint8_t value, size_t length);
+#endif
+
+#if defined(MEM_X86)
+// SSE2 is part of x86_64, so these are right even before _pick_kernels()
+static _copy_kernel _copy = _copy_sse2;
+static _copy_kernel _copy_backward = _copy_sse2_backward;
+static _set_kernel _set = _set_sse2;
+static _compare_kernel _compare = _compare_sse2;
+#else
+static _copy_kernel _copy = _copy_words;
+static _copy_kernel _copy_backward = _copy_words_backward;
+static _set_kernel _set = _set_words;
+static _compare_kernel _compare = _compare_words;
+#endif
+
+// copies and fills of at least this size go to the string instructions
+static size_t _string_threshold = SIZE_MAX;
+
+#if defined(MEM_X86)
+__attribute__((constructor)) static void _pick_kernels(void) {
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    _copy = _copy_avx2;
+    _copy_backward = _copy_avx2_backward;
+    _set = _set_avx2;
+    _compare = _compare_avx2;
+  }
+
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+      (ebx & CPUID_7_EBX_ERMS))
+    _string_threshold = ERMS_THRESHOLD;
+
+  return;
+}
+#endif
+
 #ifndef __FPXLIBC_ASM
 void *fpx_memcpy(void *dst, const void *src, size_t length) {
   if (!(length && dst && src))
     return dst;
-  void *temp = dst;
-  uint8_t increment;
-
-  while (length > 0) {
-    if (length > 7) {
-      // qword
-      increment = 8;
-      *(uint64_t *)dst = *(uint64_t *)src;
-    } else if (length > 3) {
-      // dword
-      increment = 4;
-      *(uint32_t *)dst = *(uint64_t *)src;
-    } else if (length > 1) {
-      // word
-      increment = 2;
-      *(uint16_t *)dst = *(uint16_t *)src;
-    } else if (length == 1) {
-      // byte
-      increment = 1;
-      *(uint8_t *)dst = *(uint8_t *)src;
-    }
 
-    dst = (uint8_t *)dst + increment;
-    src = (uint8_t *)src + increment;
-    length -= increment;
-  }
+  if (length <= SMALL_MAX)
+    _copy_small(dst, src, length);
+  else if (length >= _string_threshold)
+    _copy_erms(dst, src, length);
+  else
+    _copy(dst, src, length);
 
-  return temp;
+  return dst;
 }
 #endif // __FPXLIBC_ASM
 
@@ -45,36 +110,611 @@ void *fpx_memcpy(void *dst, const void *src, size_t length) {
 void *fpx_memset(void *dst, uint8_t value, size_t length) {
   if (!(dst && length))
     return dst;
-  void *temp = dst;
-  uint8_t increment;
-
-  uint64_t realval = value | (value << 8);
-  realval |= realval << 16;
-  realval |= realval << 32;
-
-  while (length > 0) {
-
-    if (length > 7) {
-      *(uint64_t *)dst = realval;
-      increment = 8;
-    } else if (length > 3) {
-      uint32_t *new_dst_value_ptr = (uint32_t *)&realval;
-      *(uint32_t *)dst = *new_dst_value_ptr;
-      increment = 4;
-    } else if (length > 1) {
-      uint16_t *new_dst_value_ptr = (uint16_t *)&realval;
-      *(uint16_t *)dst = *new_dst_value_ptr;
-      increment = 2;
-    } else if (length == 1) {
-      uint8_t *new_dst_value_ptr = (uint8_t *)&realval;
-      *(uint8_t *)dst = *new_dst_value_ptr;
-      increment = 1;
+
+  if (length <= SMALL_MAX)
+    _set_small(dst, value, length);
+  else if (length >= _string_threshold)
+    _set_erms(dst, value, length);
+  else
+    _set(dst, value, length);
+
+  return dst;
+}
+#endif // __FPXLIBC_ASM
+
+void *fpx_memmove(void *dst, const void *src, size_t length) {
+  if (!(length && dst && src) || dst == src)
+    return dst;
+
+  uintptr_t forward_gap = (uintptr_t)dst - (uintptr_t)src;
+  uintptr_t backward_gap = (uintptr_t)src - (uintptr_t)dst;
+
+  // the kernels read everything they need before writing when the destination
+  // sits below the source, so only a destination inside the source, past its
+  // start, has to be copied back to front
+  if (length <= SMALL_MAX)
+    _copy_small(dst, src, length);
+  else if (forward_gap < length)
+    _copy_backward(dst, src, length);
+  else if (length >= _string_threshold && backward_gap >= length)
+    _copy_erms(dst, src, length);
+  else
+    _copy(dst, src, length);
+
+  return dst;
+}
+
+int fpx_memcmp(const void *a, const void *b, size_t length) {
+  if (!(length && a && b) || a == b)
+    return 0;
+
+  if (length <= SMALL_MAX)
+    return _compare_small(a, b, length);
+
+  return _compare(a, b, length);
+}
+
+static inline uint64_t _load64(const uint8_t *src) {
+  uint64_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+static inline void _store64(uint8_t *dst, uint64_t value) {
+  memcpy(dst, &value, sizeof(value));
+}
+
+// both big-endian, so that comparing them as numbers compares the bytes in
+// memory order
+static inline uint64_t _load_be64(const uint8_t *src) {
+  return ((uint64_t)src[0] << 56) | ((uint64_t)src[1] << 48) |
+         ((uint64_t)src[2] << 40) | ((uint64_t)src[3] << 32) |
+         ((uint64_t)src[4] << 24) | ((uint64_t)src[5] << 16) |
+         ((uint64_t)src[6] << 8) | (uint64_t)src[7];
+}
+
+static inline uint32_t _load_be32(const uint8_t *src) {
+  return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) |
+         ((uint32_t)src[2] << 8) | (uint32_t)src[3];
+}
+
+static void _copy_small(uint8_t *dst, const uint8_t *src, size_t length) {
+  // a head and a tail that overlap in the middle cover every length in the
+  // class; both are read before either is written, which also makes this
+  // safe for overlapping moves
+  if (length >= 8) {
+    uint64_t head = _load64(src);
+    uint64_t tail = _load64(src + length - 8);
+    _store64(dst, head);
+    _store64(dst + length - 8, tail);
+  } else if (length >= 4) {
+    uint32_t head, tail;
+    memcpy(&head, src, sizeof(head));
+    memcpy(&tail, src + length - 4, sizeof(tail));
+    memcpy(dst, &head, sizeof(head));
+    memcpy(dst + length - 4, &tail, sizeof(tail));
+  } else if (length >= 2) {
+    uint16_t head, tail;
+    memcpy(&head, src, sizeof(head));
+    memcpy(&tail, src + length - 2, sizeof(tail));
+    memcpy(dst, &head, sizeof(head));
+    memcpy(dst + length - 2, &tail, sizeof(tail));
+  } else {
+    *dst = *src;
+  }
+
+  return;
+}
+
+static void _set_small(uint8_t *dst, uint8_t value, size_t length) {
+  uint64_t pattern = value * 0x0101010101010101ULL;
+
+  if (length >= 8) {
+    _store64(dst, pattern);
+    _store64(dst + length - 8, pattern);
+  } else if (length >= 4) {
+    uint32_t half = (uint32_t)pattern;
+    memcpy(dst, &half, sizeof(half));
+    memcpy(dst + length - 4, &half, sizeof(half));
+  } else if (length >= 2) {
+    uint16_t quarter = (uint16_t)pattern;
+    memcpy(dst, &quarter, sizeof(quarter));
+    memcpy(dst + length - 2, &quarter, sizeof(quarter));
+  } else {
+    *dst = value;
+  }
+
+  return;
+}
+
+static int _compare_small(const uint8_t *a, const uint8_t *b, size_t length) {
+  if (length >= 8) {
+    uint64_t x = _load_be64(a), y = _load_be64(b);
+    if (x == y) {
+      x = _load_be64(a + length - 8);
+      y = _load_be64(b + length - 8);
+    }
+    return (x > y) - (x < y);
+  }
+
+  if (length >= 4) {
+    uint32_t x = _load_be32(a), y = _load_be32(b);
+    if (x == y) {
+      x = _load_be32(a + length - 4);
+      y = _load_be32(b + length - 4);
     }
+    return (x > y) - (x < y);
+  }
 
-    dst = (uint8_t *)dst + increment;
-    length -= increment;
+  for (size_t i = 0; i < length; ++i) {
+    if (a[i] != b[i])
+      return a[i] - b[i];
   }
 
-  return temp;
+  return 0;
 }
-#endif // __FPXLIBC_ASM
+
+#if defined(MEM_X86)
+static inline __m128i _load128(const uint8_t *src) {
+  return _mm_loadu_si128((const __m128i *)src);
+}
+
+static inline void _store128(uint8_t *dst, __m128i value) {
+  _mm_storeu_si128((__m128i *)dst, value);
+}
+
+// up to 64 bytes, entirely through registers, so it is safe for any overlap
+static inline void _copy_sse2_upto64(uint8_t *dst, const uint8_t *src,
+                                     size_t length) {
+  if (length <= 32) {
+    __m128i head = _load128(src);
+    __m128i tail = _load128(src + length - 16);
+    _store128(dst, head);
+    _store128(dst + length - 16, tail);
+    return;
+  }
+
+  __m128i a = _load128(src);
+  __m128i b = _load128(src + 16);
+  __m128i c = _load128(src + length - 32);
+  __m128i d = _load128(src + length - 16);
+  _store128(dst, a);
+  _store128(dst + 16, b);
+  _store128(dst + length - 32, c);
+  _store128(dst + length - 16, d);
+
+  return;
+}
+
+static void _copy_sse2(uint8_t *dst, const uint8_t *src, size_t length) {
+  if (length <= 64) {
+    _copy_sse2_upto64(dst, src, length);
+    return;
+  }
+
+  // the first 16 and last 64 bytes are kept in registers, so the loop can
+  // store to aligned addresses and stop short; loading them first also keeps
+  // this right when moving to a lower, overlapping address
+  const uint8_t *src_tail = src + length - 64;
+  __m128i head = _load128(src);
+  __m128i t0 = _load128(src_tail);
+  __m128i t1 = _load128(src_tail + 16);
+  __m128i t2 = _load128(src_tail + 32);
+  __m128i t3 = _load128(src_tail + 48);
+
+  uint8_t *dst_tail = dst + length - 64;
+  size_t skip = 16 - ((uintptr_t)dst & 15);
+  uint8_t *d = dst + skip;
+  const uint8_t *s = src + skip;
+
+  for (; d < dst_tail; d += 64, s += 64) {
+    __m128i a = _load128(s);
+    __m128i b = _load128(s + 16);
+    __m128i c = _load128(s + 32);
+    __m128i e = _load128(s + 48);
+    _mm_store_si128((__m128i *)d, a);
+    _mm_store_si128((__m128i *)(d + 16), b);
+    _mm_store_si128((__m128i *)(d + 32), c);
+    _mm_store_si128((__m128i *)(d + 48), e);
+  }
+
+  _store128(dst, head);
+  _store128(dst_tail, t0);
+  _store128(dst_tail + 16, t1);
+  _store128(dst_tail + 32, t2);
+  _store128(dst_tail + 48, t3);
+
+  return;
+}
+
+static void _copy_sse2_backward(uint8_t *dst, const uint8_t *src,
+                                size_t length) {
+  if (length <= 64) {
+    _copy_sse2_upto64(dst, src, length);
+    return;
+  }
+
+  // the mirror image of _copy_sse2(): the first 64 and last 16 bytes are
+  // kept, and the loop walks down from an aligned end
+  __m128i h0 = _load128(src);
+  __m128i h1 = _load128(src + 16);
+  __m128i h2 = _load128(src + 32);
+  __m128i h3 = _load128(src + 48);
+  __m128i tail = _load128(src + length - 16);
+
+  size_t skip = (uintptr_t)(dst + length) & 15;
+  uint8_t *d = dst + length - skip;
+  const uint8_t *s = src + length - skip;
+
+  for (; d > dst + 64; d -= 64, s -= 64) {
+    __m128i a = _load128(s - 16);
+    __m128i b = _load128(s - 32);
+    __m128i c = _load128(s - 48);
+    __m128i e = _load128(s - 64);
+    _mm_store_si128((__m128i *)(d - 16), a);
+    _mm_store_si128((__m128i *)(d - 32), b);
+    _mm_store_si128((__m128i *)(d - 48), c);
+    _mm_store_si128((__m128i *)(d - 64), e);
+  }
+
+  _store128(dst + length - 16, tail);
+  _store128(dst, h0);
+  _store128(dst + 16, h1);
+  _store128(dst + 32, h2);
+  _store128(dst + 48, h3);
+
+  return;
+}
+
+static void _set_sse2(uint8_t *dst, uint8_t value, size_t length) {
+  __m128i v = _mm_set1_epi8((char)value);
+
+  if (length <= 32) {
+    _store128(dst, v);
+    _store128(dst + length - 16, v);
+    return;
+  }
+
+  _store128(dst, v);
+
+  uint8_t *dst_tail = dst + length - 64;
+  uint8_t *d = dst + 16 - ((uintptr_t)dst & 15);
+
+  for (; d < dst_tail; d += 64) {
+    _mm_store_si128((__m128i *)d, v);
+    _mm_store_si128((__m128i *)(d + 16), v);
+    _mm_store_si128((__m128i *)(d + 32), v);
+    _mm_store_si128((__m128i *)(d + 48), v);
+  }
+
+  // may reach back before `dst` for lengths under 64, so clamp to the start
+  if (length < 64)
+    dst_tail = dst;
+
+  _store128(dst_tail, v);
+  _store128(dst_tail + 16, v);
+  _store128(dst + length - 32, v);
+  _store128(dst + length - 16, v);
+
+  return;
+}
+
+static int _compare_sse2(const uint8_t *a, const uint8_t *b, size_t length) {
+  size_t i = 0;
+
+  for (;; i += 16) {
+    // the last block overlaps the one before it instead of running past
+    if (i + 16 > length)
+      i = length - 16;
+
+    __m128i eq = _mm_cmpeq_epi8(_load128(a + i), _load128(b + i));
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(eq) ^ 0xffff;
+
+    if (mask) {
+      size_t at = i + __builtin_ctz(mask);
+      return a[at] - b[at];
+    }
+
+    if (i + 16 == length)
+      return 0;
+  }
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+_load256(const uint8_t *src) {
+  return _mm256_loadu_si256((const __m256i *)src);
+}
+
+__attribute__((target("avx2"))) static inline void
+_store256(uint8_t *dst, __m256i value) {
+  _mm256_storeu_si256((__m256i *)dst, value);
+}
+
+__attribute__((target("avx2"))) static void
+_copy_avx2(uint8_t *dst, const uint8_t *src, size_t length) {
+  if (length <= 32) {
+    _copy_sse2_upto64(dst, src, length);
+    return;
+  }
+
+  if (length <= 64) {
+    __m256i head = _load256(src);
+    __m256i tail = _load256(src + length - 32);
+    _store256(dst, head);
+    _store256(dst + length - 32, tail);
+    return;
+  }
+
+  if (length <= 128) {
+    __m256i a = _load256(src);
+    __m256i b = _load256(src + 32);
+    __m256i c = _load256(src + length - 64);
+    __m256i d = _load256(src + length - 32);
+    _store256(dst, a);
+    _store256(dst + 32, b);
+    _store256(dst + length - 64, c);
+    _store256(dst + length - 32, d);
+    return;
+  }
+
+  // same shape as _copy_sse2(), at twice the width
+  const uint8_t *src_tail = src + length - 128;
+  __m256i head = _load256(src);
+  __m256i t0 = _load256(src_tail);
+  __m256i t1 = _load256(src_tail + 32);
+  __m256i t2 = _load256(src_tail + 64);
+  __m256i t3 = _load256(src_tail + 96);
+
+  uint8_t *dst_tail = dst + length - 128;
+  size_t skip = 32 - ((uintptr_t)dst & 31);
+  uint8_t *d = dst + skip;
+  const uint8_t *s = src + skip;
+
+  for (; d < dst_tail; d += 128, s += 128) {
+    __m256i a = _load256(s);
+    __m256i b = _load256(s + 32);
+    __m256i c = _load256(s + 64);
+    __m256i e = _load256(s + 96);
+    _mm256_store_si256((__m256i *)d, a);
+    _mm256_store_si256((__m256i *)(d + 32), b);
+    _mm256_store_si256((__m256i *)(d + 64), c);
+    _mm256_store_si256((__m256i *)(d + 96), e);
+  }
+
+  _store256(dst, head);
+  _store256(dst_tail, t0);
+  _store256(dst_tail + 32, t1);
+  _store256(dst_tail + 64, t2);
+  _store256(dst_tail + 96, t3);
+
+  return;
+}
+
+__attribute__((target("avx2"))) static void
+_copy_avx2_backward(uint8_t *dst, const uint8_t *src, size_t length) {
+  if (length <= 128) {
+    // everything is loaded before anything is stored
+    _copy_avx2(dst, src, length);
+    return;
+  }
+
+  __m256i h0 = _load256(src);
+  __m256i h1 = _load256(src + 32);
+  __m256i h2 = _load256(src + 64);
+  __m256i h3 = _load256(src + 96);
+  __m256i tail = _load256(src + length - 32);
+
+  size_t skip = (uintptr_t)(dst + length) & 31;
+  uint8_t *d = dst + length - skip;
+  const uint8_t *s = src + length - skip;
+
+  for (; d > dst + 128; d -= 128, s -= 128) {
+    __m256i a = _load256(s - 32);
+    __m256i b = _load256(s - 64);
+    __m256i c = _load256(s - 96);
+    __m256i e = _load256(s - 128);
+    _mm256_store_si256((__m256i *)(d - 32), a);
+    _mm256_store_si256((__m256i *)(d - 64), b);
+    _mm256_store_si256((__m256i *)(d - 96), c);
+    _mm256_store_si256((__m256i *)(d - 128), e);
+  }
+
+  _store256(dst + length - 32, tail);
+  _store256(dst, h0);
+  _store256(dst + 32, h1);
+  _store256(dst + 64, h2);
+  _store256(dst + 96, h3);
+
+  return;
+}
+
+__attribute__((target("avx2"))) static void
+_set_avx2(uint8_t *dst, uint8_t value, size_t length) {
+  if (length <= 32) {
+    _set_sse2(dst, value, length);
+    return;
+  }
+
+  __m256i v = _mm256_set1_epi8((char)value);
+
+  if (length <= 64) {
+    _store256(dst, v);
+    _store256(dst + length - 32, v);
+    return;
+  }
+
+  _store256(dst, v);
+
+  uint8_t *dst_tail = dst + length - 128;
+  uint8_t *d = dst + 32 - ((uintptr_t)dst & 31);
+
+  for (; d < dst_tail; d += 128) {
+    _mm256_store_si256((__m256i *)d, v);
+    _mm256_store_si256((__m256i *)(d + 32), v);
+    _mm256_store_si256((__m256i *)(d + 64), v);
+    _mm256_store_si256((__m256i *)(d + 96), v);
+  }
+
+  if (length < 128)
+    dst_tail = dst;
+
+  _store256(dst_tail, v);
+  _store256(dst_tail + 32, v);
+  _store256(dst + length - 64, v);
+  _store256(dst + length - 32, v);
+
+  return;
+}
+
+__attribute__((target("avx2"))) static inline int
+_compare_avx2_32(const uint8_t *a, const uint8_t *b) {
+  // the difference at the first of the 32 bytes that differs, or 0
+  __m256i eq = _mm256_cmpeq_epi8(_load256(a), _load256(b));
+  unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(eq);
+
+  if (0 == mask)
+    return 0;
+
+  size_t at = __builtin_ctz(mask);
+  return a[at] - b[at];
+}
+
+__attribute__((target("avx2"))) static inline int
+_compare_avx2_any(const uint8_t *a, const uint8_t *b, size_t first,
+                  size_t second, size_t third, size_t fourth) {
+  // checks four vectors at once; nothing is split up unless one differs.
+  // the vectors may overlap, but have to come in memory order
+  __m256i x0 = _mm256_xor_si256(_load256(a + first), _load256(b + first));
+  __m256i x1 = _mm256_xor_si256(_load256(a + second), _load256(b + second));
+  __m256i x2 = _mm256_xor_si256(_load256(a + third), _load256(b + third));
+  __m256i x3 = _mm256_xor_si256(_load256(a + fourth), _load256(b + fourth));
+  __m256i any =
+    _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(x2, x3));
+
+  if (_mm256_testz_si256(any, any))
+    return 0;
+
+  int difference = _compare_avx2_32(a + first, b + first);
+  if (0 == difference)
+    difference = _compare_avx2_32(a + second, b + second);
+  if (0 == difference)
+    difference = _compare_avx2_32(a + third, b + third);
+  if (0 == difference)
+    difference = _compare_avx2_32(a + fourth, b + fourth);
+
+  return difference;
+}
+
+__attribute__((target("avx2"))) static int
+_compare_avx2(const uint8_t *a, const uint8_t *b, size_t length) {
+  if (length < 32)
+    return _compare_sse2(a, b, length);
+
+  if (length <= 64) {
+    int difference = _compare_avx2_32(a, b);
+    return (0 != difference) ? difference
+                             : _compare_avx2_32(a + length - 32,
+                                                b + length - 32);
+  }
+
+  if (length <= 128)
+    return _compare_avx2_any(a, b, 0, 32, length - 64, length - 32);
+
+  // four vectors per check; after the first one `a` is read aligned, and the
+  // last check overlaps the one before it instead of running past the end
+  int difference = _compare_avx2_any(a, b, 0, 32, 64, 96);
+  if (0 != difference)
+    return difference;
+
+  size_t i = 128 - ((uintptr_t)a & 31);
+
+  for (; i + 128 <= length; i += 128) {
+    difference = _compare_avx2_any(a + i, b + i, 0, 32, 64, 96);
+    if (0 != difference)
+      return difference;
+  }
+
+  if (i == length)
+    return 0;
+
+  i = length - 128;
+  return _compare_avx2_any(a + i, b + i, 0, 32, 64, 96);
+}
+
+static void _copy_erms(uint8_t *dst, const uint8_t *src, size_t length) {
+  __asm__ volatile("rep movsb"
+                   : "+D"(dst), "+S"(src), "+c"(length)
+                   :
+                   : "memory");
+  return;
+}
+
+static void _set_erms(uint8_t *dst, uint8_t value, size_t length) {
+  __asm__ volatile("rep stosb"
+                   : "+D"(dst), "+c"(length)
+                   : "a"(value)
+                   : "memory");
+  return;
+}
+#else
+static void _copy_words(uint8_t *dst, const uint8_t *src, size_t length) {
+  // the last word is read up front, because the loop may already have
+  // overwritten it when moving to a lower, overlapping address
+  uint64_t tail = _load64(src + length - 8);
+  size_t i = 0;
+
+  for (; i + 8 < length; i += 8)
+    _store64(dst + i, _load64(src + i));
+
+  _store64(dst + length - 8, tail);
+
+  return;
+}
+
+static void _copy_words_backward(uint8_t *dst, const uint8_t *src,
+                                 size_t length) {
+  uint64_t head = _load64(src);
+  size_t i = length;
+
+  for (; i > 8; i -= 8)
+    _store64(dst + i - 8, _load64(src + i - 8));
+
+  _store64(dst, head);
+
+  return;
+}
+
+static void _set_words(uint8_t *dst, uint8_t value, size_t length) {
+  uint64_t pattern = value * 0x0101010101010101ULL;
+  size_t i = 0;
+
+  for (; i + 8 < length; i += 8)
+    _store64(dst + i, pattern);
+
+  _store64(dst + length - 8, pattern);
+
+  return;
+}
+
+static int _compare_words(const uint8_t *a, const uint8_t *b, size_t length) {
+  size_t i = 0;
+
+  for (; i + 8 < length; i += 8) {
+    if (_load64(a + i) != _load64(b + i))
+      return _compare_small(a + i, b + i, 8);
+  }
+
+  return _compare_small(a + length - 8, b + length - 8, 8);
+}
+
+// never reached; `_string_threshold` stays at SIZE_MAX
+static void _copy_erms(uint8_t *dst, const uint8_t *src, size_t length) {
+  _copy(dst, src, length);
+  return;
+}
+
+static void _set_erms(uint8_t *dst, uint8_t value, size_t length) {
+  _set(dst, value, length);
+  return;
+}
+#endif // MEM_X86
@@ -0,0 +1,100 @@
+//
+//  "test.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+// Benchmarks fpx_memcpy, fpx_memset, fpx_memmove and fpx_memcmp against
+// the C library from 1 byte to 16 MiB; src/test/mem.cpp checks that they
+// agree with it. Build with ./compile.sh
+
+#include "../../include/mem/mem.h"
+#include "../../include/test/bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_ROUNDS 4096 /* keeps the tiny sizes from measuring the clock */
+#define MAX_SIZE (16 << 20)
+
+enum operation { OP_COPY, OP_SET, OP_MOVE, OP_COMPARE };
+
+static const char *op_names[] = { "memcpy", "memset", "memmove", "memcmp" };
+
+static double _measure(enum operation op, int use_fpx, uint8_t *a, uint8_t *b,
+                       size_t len, size_t rounds) {
+  volatile int sink = 0;
+  double start = bench_now();
+
+  for (size_t r = 0; r < rounds; ++r) {
+    // move around a little, so the alignment is not always the same
+    size_t shift = r & 7;
+
+    switch (op) {
+      case OP_COPY:
+        if (use_fpx)
+          fpx_memcpy(a + shift, b, len);
+        else
+          memcpy(a + shift, b, len);
+        break;
+      case OP_SET:
+        if (use_fpx)
+          fpx_memset(a + shift, (uint8_t)r, len);
+        else
+          memset(a + shift, (int)(uint8_t)r, len);
+        break;
+      case OP_MOVE:
+        if (use_fpx)
+          fpx_memmove(a + shift + 1, a + shift, len);
+        else
+          memmove(a + shift + 1, a + shift, len);
+        break;
+      case OP_COMPARE:
+        if (use_fpx)
+          sink += fpx_memcmp(b, b + 8, len);
+        else
+          sink += memcmp(b, b + 8, len);
+        break;
+    }
+
+    sink += a[shift];
+  }
+
+  (void)sink;
+  return bench_now() - start;
+}
+
+int main(void) {
+  uint8_t *a = malloc(MAX_SIZE + 64);
+  uint8_t *b = malloc(MAX_SIZE + 64);
+  if (NULL == a || NULL == b)
+    return 1;
+
+  // every 8th byte repeats, so memcmp(b, b + 8) runs all the way
+  for (size_t i = 0; i < MAX_SIZE + 64; ++i)
+    a[i] = b[i] = (uint8_t)(i % 8);
+
+  for (enum operation op = OP_COPY; op <= OP_COMPARE; ++op) {
+    bench_report_header(op_names[op], "libc", "fpxlibc");
+
+    for (size_t len = 1; len <= MAX_SIZE; len *= 2) {
+      size_t rounds = BENCH_BYTES / len;
+      if (rounds < 8)
+        rounds = 8;
+      if (rounds < MIN_ROUNDS && len < 4096)
+        rounds = MIN_ROUNDS;
+
+      double libc_time = _measure(op, 0, a, b, len, rounds);
+      double fpx_time = _measure(op, 1, a, b, len, rounds);
+      bench_report_bytes(len, (double)rounds * len, libc_time, fpx_time);
+    }
+
+    printf("\n");
+  }
+
+  free(a);
+  free(b);
+
+  return 0;
+}
@@ -10,11 +10,17 @@ gcc \
   test.c \
   http.c \
   httpserver.c \
-  ../../build/unlinked/mem* \
-  ../../build/unlinked/string* \
-  ../../build/unlinked/format* \
-  ../../build/unlinked/math* \
-  ../../build/unlinked/endian* \
-  ../../build/unlinked/crypto.o \
+  ../../alloc/arena.c \
+  ../../c-utils/crypto.c \
+  ../../c-utils/deflate.c \
+  ../../c-utils/endian.c \
+  ../../c-utils/format.c \
+  ../../mem/mem.c \
+  ../../string/string.c \
+  ../../string/strbuf.c \
+  ../../math/math.c \
+  -I../../../include \
   $CFLAGS \
+  -lpthread \
+  -lm \
   -o c.out
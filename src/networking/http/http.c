@@ -10,16 +10,34 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h> // malloc()
+#include <string.h> // memchr(), memcmp(), memmove()
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+// only what _send_all() needs; windows has no sendmsg()
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MASK_X86
+#include <immintrin.h>
 #endif
 
 // START OF FPXLIBC LINK-TIME DEPENDENCIES
+#include "alloc/arena.h"    // requires arena*.o
+#include "c-utils/format.h" // requires format*.o
 #include "mem/mem.h"
 #include "string/string.h"
 // END OF FPXLIBC LINK-TIME DEPENDENCIES
@@ -27,15 +45,33 @@
 #define URI_MAXLENGTH 255
 #define HTTP_DATA_ALLOC_BLOCK_SIZE 512
 
+/* see fpx_http_allocation_count() */
+static atomic_ullong _allocation_count = 0;
+
 #define BUFFER_DEFAULT 16384
+#define BATCH_MAX_FRAMES 64 /* frames per call in the batch send */
+
+/* parser defaults; see fpx_httpparser_init() */
+#define PARSER_MAX_REQUEST (1 << 20)
+#define PARSER_MAX_HEADER_BYTES 8192
+
+/* 32-bit FNV-1a; see _header_hash() */
+#define HEADER_HASH_OFFSET 2166136261u
+#define HEADER_HASH_PRIME 16777619u
+
+enum _parser_state {
+  PARSER_REQUEST_LINE = 0,
+  PARSER_HEADERS,
+  PARSER_BODY,
+};
 
 static int _set_http_version(struct _fpx_http_content *_cnt,
                              const char *_version);
 static int _get_http_version(struct _fpx_http_content *_cnt, char *_output,
                              size_t _maxlen);
 
-static int _add_http_header(struct _fpx_http_content *_cnt, const char *_key,
-                            const char *_value);
+static int _add_http_header(struct _fpx_http_content *_cnt, fpx_strview_t _key,
+                            fpx_strview_t _value);
 static int _get_http_header(struct _fpx_http_content *_cnt, const char *_key,
                             char *_output, size_t _maxlen);
 
@@ -48,6 +84,52 @@ static int _copy_http_content(struct _fpx_http_content *_dst,
                               const struct _fpx_http_content *_src);
 
 static int _destroy_http_content(struct _fpx_http_content *cntptr);
+static int _own_http_content(struct _fpx_http_content *cntptr);
+static char *_grow_buffer(struct _fpx_http_content *, char *buffer,
+                          size_t used, size_t *allocated, size_t wanted,
+                          uint8_t *in_arena);
+
+static void *_counted_realloc(void *, size_t);
+
+static uint32_t _header_hash(const char *key, size_t key_len);
+static int _known_header_id(const char *key, size_t key_len);
+static void _index_header(struct _fpx_http_content *, uint8_t field_idx);
+static int _find_header(const struct _fpx_http_content *, fpx_strview_t key,
+                        fpx_strview_t *value);
+static int _scan_headers(const struct _fpx_http_content *, fpx_strview_t key,
+                         fpx_strview_t *value);
+static int _get_known_header(const struct _fpx_http_content *,
+                             fpx_httpheader_t, const char **, size_t *);
+
+/* indexed by fpx_httpheader_t; names must be lowercase */
+static const struct {
+  const char *name;
+  uint32_t len;
+} _known_headers[HTTP_HEADER_KNOWN_COUNT] = {
+    [HTTP_HEADER_CONNECTION] = {"connection", 10},
+    [HTTP_HEADER_CONTENT_LENGTH] = {"content-length", 14},
+    [HTTP_HEADER_CONTENT_TYPE] = {"content-type", 12},
+    [HTTP_HEADER_HOST] = {"host", 4},
+    [HTTP_HEADER_KEEP_ALIVE] = {"keep-alive", 10},
+    [HTTP_HEADER_TRANSFER_ENCODING] = {"transfer-encoding", 17},
+    [HTTP_HEADER_UPGRADE] = {"upgrade", 7},
+    [HTTP_HEADER_SEC_WEBSOCKET_KEY] = {"sec-websocket-key", 17},
+    [HTTP_HEADER_SEC_WEBSOCKET_VERSION] = {"sec-websocket-version", 21},
+    [HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS] = {"sec-websocket-extensions", 24},
+};
+
+static int _send_all(int fd, struct iovec *, int iov_count);
+
+static void _mask_words(uint8_t *data, size_t len, uint32_t key);
+#if defined(MASK_X86)
+static void _mask_sse2(uint8_t *data, size_t len, uint32_t key);
+static void _mask_avx2(uint8_t *data, size_t len, uint32_t key);
+#endif
+
+static int _parse_request_line(fpx_httpparser_t *, const char *line,
+                               size_t line_start, size_t line_len);
+static int _parse_header_line(fpx_httpparser_t *, const char *line,
+                              size_t line_start, size_t line_len);
 
 int fpx_httprequest_init(fpx_httprequest_t *reqptr) {
   if (NULL == reqptr)
@@ -58,6 +140,15 @@ int fpx_httprequest_init(fpx_httprequest_t *reqptr) {
   return 0;
 }
 
+int fpx_httprequest_use_arena(fpx_httprequest_t *reqptr, fpx_arena *arena) {
+  if (NULL == reqptr)
+    return -1;
+
+  reqptr->content.arena = arena;
+
+  return 0;
+}
+
 int fpx_httprequest_set_method(fpx_httprequest_t *reqptr,
                                fpx_httpmethod_t method) {
   if (NULL == reqptr)
@@ -122,6 +213,14 @@ int fpx_httprequest_get_version(fpx_httprequest_t *reqptr, char *outbuffer,
 
 int fpx_httprequest_add_header(fpx_httprequest_t *reqptr, const char *key,
                                const char *value) {
+  if (NULL == reqptr || NULL == key || NULL == value)
+    return -1;
+
+  return _add_http_header(&reqptr->content, fpx_strview(key), fpx_strview(value));
+}
+
+int fpx_httprequest_add_header_view(fpx_httprequest_t *reqptr, fpx_strview_t key,
+                                    fpx_strview_t value) {
   if (NULL == reqptr)
     return -1;
 
@@ -136,6 +235,38 @@ int fpx_httprequest_get_header(fpx_httprequest_t *reqptr, const char *key,
   return _get_http_header(&reqptr->content, key, output, output_len);
 }
 
+int fpx_httprequest_get_known_header(fpx_httprequest_t *reqptr,
+                                     fpx_httpheader_t which,
+                                     const char **value, size_t *value_len) {
+  if (NULL == reqptr)
+    return -1;
+
+  return _get_known_header(&reqptr->content, which, value, value_len);
+}
+
+int fpx_httprequest_get_param(const fpx_httprequest_t *reqptr,
+                              const char *name, const char **value,
+                              size_t *value_len) {
+  if (NULL == reqptr || NULL == name || NULL == value || NULL == value_len)
+    return -1;
+
+  size_t name_len = fpx_getstringlength(name);
+
+  for (int i = 0; i < reqptr->param_count; ++i) {
+    const struct _fpx_http_param *param = &reqptr->params[i];
+
+    if (param->name_len != name_len ||
+        0 != memcmp(param->name, name, name_len))
+      continue;
+
+    *value = &reqptr->uri[param->value];
+    *value_len = param->value_len;
+    return 0;
+  }
+
+  return -2;
+}
+
 int fpx_httprequest_append_body(fpx_httprequest_t *reqptr,
                                 const char *new_chunk, size_t body_len) {
   if (NULL == reqptr)
@@ -168,6 +299,10 @@ int fpx_httprequest_copy(fpx_httprequest_t *_dst,
 
   _dst->method = _src->method;
 
+  // names are borrowed from the route and values are offsets; both stay valid
+  fpx_memcpy(_dst->params, _src->params, sizeof(_dst->params));
+  _dst->param_count = _src->param_count;
+
   return _copy_http_content(&_dst->content, &_src->content);
 }
 
@@ -187,6 +322,15 @@ int fpx_httpresponse_init(fpx_httpresponse_t *resptr) {
   return 0;
 }
 
+int fpx_httpresponse_use_arena(fpx_httpresponse_t *resptr, fpx_arena *arena) {
+  if (NULL == resptr)
+    return -1;
+
+  resptr->content.arena = arena;
+
+  return 0;
+}
+
 int fpx_httpresponse_set_version(fpx_httpresponse_t *resptr,
                                  const char *input) {
   if (NULL == resptr)
@@ -205,6 +349,14 @@ int fpx_httpresponse_get_version(fpx_httpresponse_t *resptr, char *outbuffer,
 
 int fpx_httpresponse_add_header(fpx_httpresponse_t *resptr, const char *key,
                                 const char *value) {
+  if (NULL == resptr || NULL == key || NULL == value)
+    return -1;
+
+  return _add_http_header(&resptr->content, fpx_strview(key), fpx_strview(value));
+}
+
+int fpx_httpresponse_add_header_view(fpx_httpresponse_t *resptr, fpx_strview_t key,
+                                     fpx_strview_t value) {
   if (NULL == resptr)
     return -1;
 
@@ -219,6 +371,15 @@ int fpx_httpresponse_get_header(fpx_httpresponse_t *resptr, const char *key,
   return _get_http_header(&resptr->content, key, output, output_len);
 }
 
+int fpx_httpresponse_get_known_header(fpx_httpresponse_t *resptr,
+                                      fpx_httpheader_t which,
+                                      const char **value, size_t *value_len) {
+  if (NULL == resptr)
+    return -1;
+
+  return _get_known_header(&resptr->content, which, value, value_len);
+}
+
 int fpx_httpresponse_append_body(fpx_httpresponse_t *resptr,
                                  const char *new_chunk, size_t body_len) {
   if (NULL == resptr)
@@ -227,6 +388,12 @@ int fpx_httpresponse_append_body(fpx_httpresponse_t *resptr,
   return _append_http_body(&resptr->content, new_chunk, body_len);
 }
 
+int fpx_httpresponse_body_sink(void *resptr, const char *new_chunk,
+                               size_t body_len) {
+  return fpx_httpresponse_append_body((fpx_httpresponse_t *)resptr, new_chunk,
+                                      body_len);
+}
+
 int fpx_httpresponse_get_body(fpx_httpresponse_t *resptr, char *outbuffer,
                               size_t max_len) {
   if (NULL == resptr)
@@ -260,6 +427,255 @@ int fpx_httpresponse_destroy(fpx_httpresponse_t *resptr) {
   return _destroy_http_content(&resptr->content);
 }
 
+uint64_t fpx_http_allocation_count(void) {
+  return atomic_load_explicit(&_allocation_count, memory_order_relaxed);
+}
+
+int fpx_httpparser_init(fpx_httpparser_t *parser) {
+  if (NULL == parser)
+    return -1;
+
+  fpx_memset(parser, 0, sizeof(*parser));
+
+  parser->max_request = PARSER_MAX_REQUEST;
+  parser->max_header_bytes = PARSER_MAX_HEADER_BYTES;
+
+  return 0;
+}
+
+char *fpx_httpparser_reserve(fpx_httpparser_t *parser, size_t minimum,
+                             size_t *available) {
+  if (NULL == parser || NULL == available)
+    return NULL;
+
+  if (parser->start == parser->length) {
+    // everything was consumed; start over at the front
+    parser->start = parser->length = 0;
+  }
+
+  if (parser->allocated - parser->length < minimum && 0 < parser->start) {
+    // move the unconsumed bytes to the front;
+    // every offset the parser keeps is relative to `start`
+    size_t left = parser->length - parser->start;
+    memmove(parser->buffer, parser->buffer + parser->start, left);
+    parser->start = 0;
+    parser->length = left;
+  }
+
+  if (parser->allocated - parser->length < minimum) {
+    size_t new_size =
+        (0 == parser->allocated) ? BUFFER_DEFAULT : parser->allocated;
+
+    while (new_size - parser->length < minimum)
+      new_size *= 2;
+
+    char *new_buffer = (char *)_counted_realloc(parser->buffer, new_size);
+    if (NULL == new_buffer)
+      return NULL;
+
+    parser->buffer = new_buffer;
+    parser->allocated = new_size;
+  }
+
+  *available = parser->allocated - parser->length;
+
+  return parser->buffer + parser->length;
+}
+
+int fpx_httpparser_commit(fpx_httpparser_t *parser, size_t written) {
+  if (NULL == parser)
+    return -1;
+
+  if (written > parser->allocated - parser->length)
+    return -2;
+
+  parser->length += written;
+
+  return 0;
+}
+
+int fpx_httpparser_feed(fpx_httpparser_t *parser, const char *data,
+                        size_t len) {
+  if (NULL == parser || NULL == data)
+    return -1;
+
+  size_t available;
+  char *space = fpx_httpparser_reserve(parser, len, &available);
+
+  if (NULL == space)
+    return -2;
+
+  fpx_memcpy(space, data, len);
+
+  return fpx_httpparser_commit(parser, len);
+}
+
+int fpx_httpparser_execute(fpx_httpparser_t *parser,
+                           fpx_httprequest_t *reqptr) {
+  if (NULL == parser || NULL == reqptr)
+    return -1;
+
+  const char *req = parser->buffer + parser->start;
+  size_t avail = parser->length - parser->start;
+
+  while (PARSER_BODY != parser->state) {
+    const char *newline = NULL;
+
+    if (parser->scan < avail)
+      newline = (const char *)memchr(req + parser->scan, '\n',
+                                     avail - parser->scan);
+
+    size_t line_start = parser->line;
+
+    if (NULL == newline) {
+      // incomplete line; remember how far we looked
+      parser->scan = avail;
+
+      if (avail > parser->max_header_bytes)
+        return (PARSER_REQUEST_LINE == parser->state) ? -4 : -3;
+
+      return 0;
+    }
+
+    size_t line_end = newline - req;
+    size_t line_len = line_end - line_start;
+
+    // accept both CRLF and a bare LF
+    if (line_len > 0 && req[line_end - 1] == '\r')
+      --line_len;
+
+    parser->line = parser->scan = line_end + 1;
+
+    if (parser->scan > parser->max_header_bytes)
+      return (PARSER_REQUEST_LINE == parser->state) ? -4 : -3;
+
+    int result;
+
+    if (PARSER_REQUEST_LINE == parser->state) {
+      // empty lines in front of a request are ignored (RFC 9112, 2.2)
+      if (0 == line_len)
+        continue;
+
+      result = _parse_request_line(parser, req, line_start, line_len);
+      if (0 > result)
+        return result;
+
+      parser->state = PARSER_HEADERS;
+      parser->headers_start = parser->scan;
+      parser->field_count = 0;
+      parser->content_length = 0;
+      parser->seen_content_length = FALSE;
+    } else if (0 == line_len) {
+      // end of the header section
+      parser->headers_end = line_start;
+      parser->body_start = parser->scan;
+      parser->state = PARSER_BODY;
+    } else {
+      result = _parse_header_line(parser, req, line_start, line_len);
+      if (0 > result)
+        return result;
+    }
+  }
+
+  if (parser->content_length > parser->max_request)
+    return -5;
+
+  if (avail - parser->body_start < parser->content_length)
+    return 0; // body incomplete
+
+  // complete request; fill the request object
+  {
+    char uri[URI_MAXLENGTH + 1] = {0};
+    char version[sizeof(reqptr->content.version)] = {0};
+
+    // lengths were checked by _parse_request_line()
+    fpx_memcpy(uri, req + parser->uri, parser->uri_len);
+    fpx_memcpy(version, req + parser->version, parser->version_len);
+
+    reqptr->method = (fpx_httpmethod_t)parser->method;
+    fpx_httprequest_set_uri(reqptr, uri);
+    fpx_httprequest_set_version(reqptr, version);
+  }
+
+  {
+    struct _fpx_http_content *cnt = &reqptr->content;
+
+    // borrowed; *_allocated stays 0 so destroying the request leaves them be
+    cnt->headers = (char *)req + parser->headers_start;
+    cnt->headers_len = parser->headers_end - parser->headers_start;
+    cnt->headers_allocated = 0;
+
+    cnt->body = (0 < parser->content_length)
+                    ? (char *)req + parser->body_start
+                    : NULL;
+    cnt->body_len = parser->content_length;
+    cnt->body_allocated = 0;
+
+    fpx_memcpy(cnt->fields, parser->fields,
+               parser->field_count * sizeof(parser->fields[0]));
+    cnt->field_count = parser->field_count;
+
+    fpx_memset(cnt->index, 0, sizeof(cnt->index));
+    fpx_memset(cnt->known, 0, sizeof(cnt->known));
+    for (uint16_t i = 0; i < cnt->field_count; ++i)
+      _index_header(cnt, i);
+  }
+
+  // get ready for the next (possibly pipelined) request
+  parser->start += parser->body_start + parser->content_length;
+  parser->line = parser->scan = 0;
+  parser->state = PARSER_REQUEST_LINE;
+
+  return 1;
+}
+
+int fpx_httpparser_destroy(fpx_httpparser_t *parser) {
+  if (NULL == parser)
+    return -1;
+
+  free(parser->buffer);
+  fpx_memset(parser, 0, sizeof(*parser));
+
+  return 0;
+}
+
+int fpx_websocket_mask(uint8_t *payload, size_t length, const uint8_t key[4],
+                       uint64_t offset) {
+  // picked on first use; racing threads all pick the same one
+  static void (*kernel)(uint8_t *, size_t, uint32_t) = NULL;
+
+  if (NULL == payload || NULL == key)
+    return -1;
+
+  // not worth the setup for the smallest frames
+  if (length < 16) {
+    for (size_t i = 0; i < length; ++i)
+      payload[i] ^= key[(offset + i) & 3];
+
+    return 0;
+  }
+
+  if (NULL == kernel) {
+#if defined(MASK_X86)
+    kernel = __builtin_cpu_supports("avx2") ? _mask_avx2 : _mask_sse2;
+#else
+    kernel = _mask_words;
+#endif
+  }
+
+  // line the key up with the first byte, so the kernels can start at 0
+  uint8_t rotated[4];
+  for (int i = 0; i < 4; ++i)
+    rotated[i] = key[(offset + i) & 3];
+
+  uint32_t key_word;
+  memcpy(&key_word, rotated, sizeof(key_word));
+
+  kernel(payload, length, key_word);
+
+  return 0;
+}
+
 int fpx_websocket_send_close(int filedescriptor, int16_t code,
                              const uint8_t *reason, uint8_t reason_length,
                              uint8_t masked) {
@@ -348,97 +764,138 @@ int fpx_websocketframe_append_payload(fpx_websocketframe_t *frameptr,
   return 0;
 }
 
-int fpx_websocketframe_send(const fpx_websocketframe_t *frameptr, int fd) {
-  uint8_t write_buf[BUFFER_DEFAULT] = {0};
+int fpx_websocketframe_write_header(const fpx_websocketframe_t *frameptr,
+                                    uint8_t *out) {
+  if (NULL == frameptr || NULL == out)
+    return -1;
 
-// to ignore SIGPIPE when writing to a disconnected client
-#if defined(_WIN32) || defined(_WIN64)
-  int send_flags = 0;
-#else
-  int send_flags = MSG_NOSIGNAL | MSG_MORE;
-#endif
+  uint64_t payload_len = frameptr->payload_length;
+  size_t header_len = 2;
 
-  {
-    uint8_t meta_byte = 0x0;
-    meta_byte |= ((frameptr->final != 0) << 7); // fin bit is MSB of byte
-    meta_byte |= (frameptr->opcode & 0x0f);     // set op-code
+  out[0] = ((frameptr->final != 0) << 7) | ((frameptr->reserved1 != 0) << 6) |
+           ((frameptr->reserved2 != 0) << 5) |
+           ((frameptr->reserved3 != 0) << 4) | (frameptr->opcode & 0x0f);
 
-    if (0 > send(fd, (char *)&meta_byte, 1, send_flags)) // send meta_byte
-      return errno;
+  uint8_t len_len = 0;
+
+  if (payload_len < 126) {
+    out[1] = payload_len;
+  } else if (payload_len <= USHRT_MAX) {
+    out[1] = 126;
+    len_len = 2;
+  } else {
+    out[1] = 127;
+    len_len = 8;
   }
 
-  uint8_t len_len = 0;
+  // network byte order
+  for (int i = len_len - 1; i >= 0; --i) {
+    out[header_len++] = (payload_len >> (i * 8)) & 0xff;
+  }
 
-  {
-    uint8_t payload_len_first_byte = 0;
+  if (frameptr->mask_set) {
+    out[1] |= 0x80;
+    fpx_memcpy(out + header_len, frameptr->masking_key, 4);
+    header_len += 4;
+  }
 
-    if (frameptr->payload_length < 126)
-      payload_len_first_byte = frameptr->payload_length;
-    else if (frameptr->payload_length <= USHRT_MAX) {
-      payload_len_first_byte = 126;
-      len_len = 2;
-    } else {
-      payload_len_first_byte = 127;
-      len_len = 8;
-    }
+  return header_len;
+}
+
+int fpx_websocketframe_send(const fpx_websocketframe_t *frameptr, int fd) {
+  if (NULL == frameptr || (0 < frameptr->payload_length &&
+                           NULL == frameptr->payload))
+    return -1;
 
-    if (frameptr->mask_set)
-      payload_len_first_byte |= 0x80;
+  if (FALSE == frameptr->mask_set) {
+    // header and payload leave in a single call, straight from the frame
+    uint8_t header[FPX_WEBSOCKET_HEADER_MAX];
 
-    if (0 > send(fd, (char *)&payload_len_first_byte, 1, send_flags))
-      return errno;
+    struct iovec iov[2] = {
+        {header, fpx_websocketframe_write_header(frameptr, header)},
+        {frameptr->payload, frameptr->payload_length},
+    };
+
+    return _send_all(fd, iov, 2);
   }
 
-  {
-    uint16_t short_len;
-    uint64_t longlong_len;
+  // a masked payload has to be copied before it can be masked; the header
+  // goes in front of the first chunk so that small frames still take one
+  // call
+  uint8_t write_buf[BUFFER_DEFAULT];
+  size_t header_len = fpx_websocketframe_write_header(frameptr, write_buf);
+
+  uint64_t payload_written = 0;
+  do {
+    size_t to_write = sizeof(write_buf) - header_len;
 
-    void *the_length = NULL;
+    if (to_write > frameptr->payload_length - payload_written)
+      to_write = frameptr->payload_length - payload_written;
 
-    if (2 == len_len) {
-      short_len = frameptr->payload_length;
-      the_length = &short_len;
-    } else if (8 == len_len) {
-      longlong_len = frameptr->payload_length;
-      the_length = &longlong_len;
-    }
+    uint8_t *chunk = write_buf + header_len;
 
-    fpx_endian_swap_if_little(the_length, len_len);
+    fpx_memcpy(chunk, frameptr->payload + payload_written, to_write);
+    fpx_websocket_mask(chunk, to_write, frameptr->masking_key,
+                       payload_written);
 
-#if defined(_WIN32) || defined(_WIN64)
-    int flag = 0;
-#else
-    int flag = (0 < frameptr->payload_length) ? MSG_MORE : 0;
-#endif
+    struct iovec iov = {write_buf, header_len + to_write};
 
-    if (0 > send(fd, the_length, len_len, flag | send_flags))
-      return errno;
-  }
+    int status = _send_all(fd, &iov, 1);
+    if (0 != status)
+      return status;
 
-  uint64_t payload_written = 0;
-  while (payload_written < frameptr->payload_length) {
-    int to_write = (frameptr->payload_length - payload_written);
-    int remaining_space = sizeof(write_buf);
+    payload_written += to_write;
+    header_len = 0;
+  } while (payload_written < frameptr->payload_length);
+
+  return 0;
+}
 
-    if (to_write > remaining_space)
-      to_write = remaining_space;
+int fpx_websocketframe_send_batch(const fpx_websocketframe_t *frames,
+                                  size_t count, int fd) {
+  if (NULL == frames && 0 < count)
+    return -1;
 
-    fpx_memcpy(write_buf, frameptr->payload + payload_written, to_write);
+  uint8_t headers[BATCH_MAX_FRAMES][FPX_WEBSOCKET_HEADER_MAX];
+  struct iovec iov[BATCH_MAX_FRAMES * 2];
+  int queued = 0;
 
-    // mask the payload
-    if (frameptr->mask_set) {
-      for (int i = 0; i < to_write; ++i) {
-        write_buf[i] ^= frameptr->masking_key[i % 4];
-      }
+  for (size_t i = 0; i < count; ++i) {
+    const fpx_websocketframe_t *frame = &frames[i];
+
+    if (0 < frame->payload_length && NULL == frame->payload)
+      return -1;
+
+    if (frame->mask_set) {
+      // needs a masked copy; send what is queued first to keep the order
+      int status = _send_all(fd, iov, queued * 2);
+      queued = 0;
+
+      if (0 == status)
+        status = fpx_websocketframe_send(frame, fd);
+
+      if (0 != status)
+        return status;
+
+      continue;
     }
 
-    payload_written += to_write;
+    iov[queued * 2].iov_base = headers[queued];
+    iov[queued * 2].iov_len =
+        fpx_websocketframe_write_header(frame, headers[queued]);
+    iov[queued * 2 + 1].iov_base = frame->payload;
+    iov[queued * 2 + 1].iov_len = frame->payload_length;
 
-    if (0 > send(fd, (char *)write_buf, to_write, 0 | send_flags))
-      return errno;
+    if (BATCH_MAX_FRAMES == ++queued) {
+      int status = _send_all(fd, iov, queued * 2);
+      queued = 0;
+
+      if (0 != status)
+        return status;
+    }
   }
 
-  return 0;
+  return _send_all(fd, iov, queued * 2);
 }
 
 int fpx_websocketframe_destroy(fpx_websocketframe_t *frameptr) {
@@ -464,16 +921,63 @@ static int _destroy_http_content(struct _fpx_http_content *cntptr) {
   if (NULL == cntptr)
     return -2;
 
-  if (0 < cntptr->body_allocated) {
+  // arena memory is handed back all at once, when the arena is reset
+  if (0 < cntptr->body_allocated && FALSE == cntptr->body_in_arena) {
     fpx_memset(cntptr->body, 0, cntptr->body_len);
     free(cntptr->body);
-    cntptr->body_len = 0;
   }
 
-  if (0 < cntptr->headers_allocated) {
+  if (0 < cntptr->headers_allocated && FALSE == cntptr->headers_in_arena) {
     fpx_memset(cntptr->headers, 0, cntptr->headers_len);
     free(cntptr->headers);
-    cntptr->headers_len = 0;
+  }
+
+  cntptr->body_len = cntptr->headers_len = 0;
+
+  cntptr->field_count = 0;
+  fpx_memset(cntptr->index, 0, sizeof(cntptr->index));
+  fpx_memset(cntptr->known, 0, sizeof(cntptr->known));
+
+  return 0;
+}
+
+static int _own_http_content(struct _fpx_http_content *cntptr) {
+  // turns headers and body that are borrowed (e.g. from a parser's buffer)
+  // into heap copies that the content object owns
+
+  if (0 == cntptr->headers_allocated && NULL != cntptr->headers) {
+    if (0 == cntptr->headers_len) {
+      cntptr->headers = NULL;
+    } else {
+      size_t to_allocate;
+      FPX_ALLOC_CALC(to_allocate, cntptr->headers_len, 0);
+
+      char *copy = _grow_buffer(cntptr, cntptr->headers, cntptr->headers_len,
+                                &cntptr->headers_allocated, to_allocate,
+                                &cntptr->headers_in_arena);
+      if (NULL == copy)
+        return -2;
+
+      cntptr->headers = copy;
+    }
+  }
+
+  if (0 == cntptr->body_allocated && NULL != cntptr->body) {
+    if (0 == cntptr->body_len) {
+      cntptr->body = NULL;
+    } else {
+      size_t to_allocate;
+      FPX_ALLOC_CALC(to_allocate, cntptr->body_len, 0);
+
+      char *copy =
+          _grow_buffer(cntptr, cntptr->body, cntptr->body_len,
+                       &cntptr->body_allocated, to_allocate,
+                       &cntptr->body_in_arena);
+      if (NULL == copy)
+        return -2;
+
+      cntptr->body = copy;
+    }
   }
 
   return 0;
@@ -511,16 +1015,21 @@ int _get_http_version(struct _fpx_http_content *cntptr, char *outbuffer,
   return 0;
 }
 
-static int _add_http_header(struct _fpx_http_content *cntptr, const char *key,
-                            const char *value) {
-  if (NULL == cntptr || NULL == key || NULL == value)
+static int _add_http_header(struct _fpx_http_content *cntptr, fpx_strview_t key,
+                            fpx_strview_t value) {
+  if (NULL == cntptr || (NULL == key.data && 0 < key.len) ||
+      (NULL == value.data && 0 < value.len))
     return -1;
 
-  size_t keylen, valuelen;
-  size_t to_allocate;
+  if (0 > _own_http_content(cntptr))
+    return -2;
+
+  // remove leading whitespace from header value
+  for (; 0 < value.len && *value.data == ' '; ++value.data, --value.len)
+    ;
 
-  keylen = fpx_getstringlength(key);
-  valuelen = fpx_getstringlength(value);
+  size_t keylen = key.len, valuelen = value.len;
+  size_t to_allocate;
 
   size_t new_header_len = // total length of header =
       keylen +            // header key length
@@ -535,39 +1044,45 @@ static int _add_http_header(struct _fpx_http_content *cntptr, const char *key,
     cntptr->headers_allocated = 0;
   }
 
-  if (cntptr->headers_allocated == 0) {
-    cntptr->headers = (char *)calloc(to_allocate, 1);
-  } else if (to_allocate > cntptr->headers_allocated) {
-    cntptr->headers = (char *)realloc(cntptr->headers, to_allocate);
-  }
+  if (to_allocate > cntptr->headers_allocated) {
+    char *grown = _grow_buffer(cntptr, cntptr->headers, cntptr->headers_len,
+                               &cntptr->headers_allocated, to_allocate,
+                               &cntptr->headers_in_arena);
 
-  if (NULL == cntptr->headers) {
-    // bad alloc
-    return -2;
+    if (NULL == grown) {
+      // bad alloc
+      return -2;
+    }
+
+    cntptr->headers = grown;
   }
 
-  // prepare the key for converting to lowercase;
+  // the key is stored in lowercase, which is allowed according to HTTP RFC;
   // this will help later when finding a header by key
-  fpx_memcpy(&cntptr->headers[cntptr->headers_len], key, keylen);
-  cntptr->headers[cntptr->headers_len + keylen] = 0;
-
-  // now we convert the key to lowercase
-  // this is allowed according to HTTP RFC
-  fpx_string_to_lower(&cntptr->headers[cntptr->headers_len], FALSE);
+  fpx_strview_to_lower(key, &cntptr->headers[cntptr->headers_len]);
 
   fpx_memcpy(&cntptr->headers[cntptr->headers_len + keylen], ": ", 2);
 
-  // remove leading whitespace from header value
-  for (; *value == ' '; ++value, --valuelen)
-    ;
-
-  fpx_memcpy(&cntptr->headers[cntptr->headers_len + keylen + 2], value,
+  fpx_memcpy(&cntptr->headers[cntptr->headers_len + keylen + 2], value.data,
              valuelen);
   fpx_memcpy(&cntptr->headers[cntptr->headers_len + keylen + 2 + valuelen],
              "\r\n", 2);
 
+  // past the limit, the header is only kept in `headers`; lookups fall back
+  // to _scan_headers() to find it
+  if (FPX_HTTP_MAX_HEADER_FIELDS > cntptr->field_count) {
+    struct _fpx_http_header *field = &cntptr->fields[cntptr->field_count];
+
+    field->key = cntptr->headers_len;
+    field->key_len = keylen;
+    field->value = cntptr->headers_len + keylen + 2;
+    field->value_len = valuelen;
+    field->hash = _header_hash(&cntptr->headers[field->key], keylen);
+
+    _index_header(cntptr, cntptr->field_count++);
+  }
+
   cntptr->headers_len += keylen + 2 + valuelen + 2;
-  cntptr->headers_allocated = to_allocate;
 
   return 0;
 }
@@ -577,66 +1092,56 @@ static int _get_http_header(struct _fpx_http_content *cntptr, const char *key,
   if (NULL == cntptr || NULL == key || NULL == output)
     return -1;
 
-  if (NULL == cntptr->headers ||
-      cntptr->headers_len < 6 /*minimum length of valid header: "x:y\r\n"*/)
+  if (NULL == cntptr->headers)
     return -2;
 
-  int found_index;
-
-  {
-    int keylen;
-    char *key_but_lowercase = NULL;
-
-    keylen = fpx_getstringlength(key);
-    key_but_lowercase = (char *)malloc(keylen + 3);
-    if (NULL == key_but_lowercase)
-      return -3;
-    fpx_memcpy(key_but_lowercase, key, keylen);
-    fpx_memcpy(&key_but_lowercase[keylen], ": ", 2);
-    key_but_lowercase[keylen + 2] = 0; // NULL-terminator
+  fpx_strview_t value;
 
-    fpx_string_to_lower(key_but_lowercase, FALSE);
+  if (0 != _find_header(cntptr, fpx_strview(key), &value))
+    return -2;
 
-    found_index = fpx_substringindex(cntptr->headers, key_but_lowercase);
+  if (value.len > output_len)
+    return value.len + 1;
 
-    free(key_but_lowercase);
-    key_but_lowercase = NULL;
-  }
+  fpx_memcpy(output, value.data, value.len);
 
-  if (found_index < 0)
-    return -2;
+  if (value.len < output_len)
+    output[value.len] = 0;
 
-  if (found_index > 0 && cntptr->headers[found_index - 1] != '\n') {
-    // the key is not immediately after the CRLF of another header
-    // this should never happen
-    return -3;
-  }
+  return 0;
+}
 
-  {
-    int value_start, crlf_index;
+static int _get_known_header(const struct _fpx_http_content *cntptr,
+                             fpx_httpheader_t which, const char **value,
+                             size_t *value_len) {
+  if (NULL == cntptr || NULL == value || NULL == value_len)
+    return -1;
 
-    value_start = fpx_substringindex(&cntptr->headers[found_index], ":");
+  if ((unsigned)which >= HTTP_HEADER_KNOWN_COUNT)
+    return -2;
 
-    if (value_start < 0) {
-      // a colon was not found after the key
-      // this should never happen
-      return -3;
-    }
+  if (0 == cntptr->known[which]) {
+    // only a full table may have left it out
+    fpx_strview_t view;
 
-    value_start++;
+    if (FPX_HTTP_MAX_HEADER_FIELDS > cntptr->field_count ||
+        0 != _scan_headers(cntptr,
+                           (fpx_strview_t){_known_headers[which].name,
+                                           _known_headers[which].len},
+                           &view))
+      return -2;
 
-    // now we ignore leading whitespace
-    for (; cntptr->headers[found_index + value_start] == ' '; ++value_start)
-      ;
+    *value = view.data;
+    *value_len = view.len;
 
-    crlf_index =
-        fpx_substringindex(&cntptr->headers[found_index + value_start], "\r\n");
+    return 0;
+  }
 
-    if (crlf_index > (int)output_len)
-      return crlf_index + 1;
+  const struct _fpx_http_header *field =
+      &cntptr->fields[cntptr->known[which] - 1];
 
-    fpx_memcpy(output, &cntptr->headers[found_index + value_start], crlf_index);
-  }
+  *value = &cntptr->headers[field->value];
+  *value_len = field->value_len;
 
   return 0;
 }
@@ -649,6 +1154,9 @@ static int _append_http_body(struct _fpx_http_content *cntptr,
   if (body_len < 1)
     return 0;
 
+  if (0 > _own_http_content(cntptr))
+    return -2;
+
   size_t to_allocate;
 
   FPX_ALLOC_CALC(to_allocate, cntptr->body_len, body_len);
@@ -658,21 +1166,22 @@ static int _append_http_body(struct _fpx_http_content *cntptr,
     cntptr->body_allocated = 0;
   }
 
-  if (cntptr->body_allocated == 0) {
-    cntptr->body = (char *)calloc(to_allocate, 1);
-  } else if (cntptr->body_allocated < to_allocate) {
-    cntptr->body = (char *)realloc(cntptr->body, to_allocate);
-  }
+  if (cntptr->body_allocated < to_allocate) {
+    char *grown = _grow_buffer(cntptr, cntptr->body, cntptr->body_len,
+                               &cntptr->body_allocated, to_allocate,
+                               &cntptr->body_in_arena);
 
-  if (NULL == cntptr->body) {
-    // bad alloc
-    return -2;
+    if (NULL == grown) {
+      // bad alloc
+      return -2;
+    }
+
+    cntptr->body = grown;
   }
 
   fpx_memcpy(&cntptr->body[cntptr->body_len], new_chunk, body_len);
 
   cntptr->body_len += body_len;
-  cntptr->body_allocated = to_allocate;
 
   return 0;
 }
@@ -682,8 +1191,7 @@ static int _get_http_body(struct _fpx_http_content *cntptr, char *outbuffer,
   if (NULL == cntptr || NULL == outbuffer)
     return -1;
 
-  if (NULL == cntptr->body || cntptr->body_len == 0 ||
-      cntptr->body_allocated == 0)
+  if (NULL == cntptr->body || cntptr->body_len == 0)
     return -2;
 
   int lesser;
@@ -706,26 +1214,421 @@ static int _copy_http_content(struct _fpx_http_content *_dst,
   if (NULL == _dst || NULL == _src)
     return -3;
 
+  fpx_arena *arena = _dst->arena;
+
   fpx_memcpy(_dst, _src, sizeof(*_dst));
 
-  if (_dst->headers_allocated > 0) {
-    _dst->headers = (char *)malloc(_dst->headers_allocated);
-    if (NULL == _dst->headers) {
-      // bad alloc
-      return -2;
+  // treat the source's buffers as borrowed, so that they get duplicated
+  // (into the destination's own arena, if it has one)
+  _dst->headers_allocated = 0;
+  _dst->body_allocated = 0;
+  _dst->arena = arena;
+
+  return _own_http_content(_dst);
+}
+
+static char *_grow_buffer(struct _fpx_http_content *cntptr, char *buffer,
+                          size_t used, size_t *allocated, size_t wanted,
+                          uint8_t *in_arena) {
+  // returns a buffer of at least `wanted` bytes that starts out with the
+  // first `used` bytes of `buffer`, or NULL on failure. `buffer` is only
+  // owned (and thus released or resized) if `*allocated` is not 0
+
+  // arena blocks can not grow in place; double so that appending in small
+  // pieces does not use up the arena
+  if (wanted < *allocated * 2)
+    wanted = *allocated * 2;
+
+  uint8_t owned = (0 < *allocated);
+  char *grown = NULL;
+
+  if (NULL != cntptr->arena)
+    grown = (char *)fpx_arena_alloc(cntptr->arena, wanted);
+
+  if (NULL != grown) {
+    if (0 < used)
+      fpx_memcpy(grown, buffer, used);
+
+    // an old arena block stays where it is until the arena is reset
+    if (owned && FALSE == *in_arena)
+      free(buffer);
+
+    *in_arena = TRUE;
+  } else if (owned && FALSE == *in_arena) {
+    grown = (char *)_counted_realloc(buffer, wanted);
+  } else {
+    grown = (char *)_counted_realloc(NULL, wanted);
+
+    if (NULL != grown && 0 < used)
+      fpx_memcpy(grown, buffer, used);
+
+    *in_arena = FALSE;
+  }
+
+  if (NULL != grown)
+    *allocated = wanted;
+
+  return grown;
+}
+
+static void *_counted_realloc(void *ptr, size_t size) {
+  atomic_fetch_add_explicit(&_allocation_count, 1, memory_order_relaxed);
+  return realloc(ptr, size);
+}
+
+static uint32_t _header_hash(const char *key, size_t key_len) {
+  // case-insensitive, so "Content-Length" and "content-length" collide
+  uint32_t hash = HEADER_HASH_OFFSET;
+
+  for (size_t i = 0; i < key_len; ++i) {
+    uint8_t c = key[i];
+
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+
+    hash = (hash ^ c) * HEADER_HASH_PRIME;
+  }
+
+  return hash;
+}
+
+static int _known_header_id(const char *key, size_t key_len) {
+  for (int i = 0; i < HTTP_HEADER_KNOWN_COUNT; ++i) {
+    if (fpx_strview_equals_nocase(
+            (fpx_strview_t){key, key_len},
+            (fpx_strview_t){_known_headers[i].name, _known_headers[i].len}))
+      return i;
+  }
+
+  return -1;
+}
+
+static void _index_header(struct _fpx_http_content *cntptr,
+                          uint8_t field_idx) {
+  const struct _fpx_http_header *field = &cntptr->fields[field_idx];
+  const char *key = &cntptr->headers[field->key];
+
+  size_t slot = field->hash & (FPX_HTTP_HEADER_INDEX_SIZE - 1);
+
+  // linear probing; the table is never more than half full
+  while (0 != cntptr->index[slot]) {
+    const struct _fpx_http_header *other =
+        &cntptr->fields[cntptr->index[slot] - 1];
+
+    if (other->hash == field->hash &&
+        fpx_strview_equals_nocase(
+            (fpx_strview_t){&cntptr->headers[other->key], other->key_len},
+            (fpx_strview_t){key, field->key_len}))
+      return; // a repeated key; lookups return the first one
+
+    slot = (slot + 1) & (FPX_HTTP_HEADER_INDEX_SIZE - 1);
+  }
+
+  cntptr->index[slot] = field_idx + 1;
+
+  int known = _known_header_id(key, field->key_len);
+  if (0 <= known)
+    cntptr->known[known] = field_idx + 1;
+}
+
+static int _find_header(const struct _fpx_http_content *cntptr,
+                        fpx_strview_t key, fpx_strview_t *value) {
+  uint32_t hash = _header_hash(key.data, key.len);
+  size_t slot = hash & (FPX_HTTP_HEADER_INDEX_SIZE - 1);
+
+  while (0 != cntptr->index[slot]) {
+    const struct _fpx_http_header *field =
+        &cntptr->fields[cntptr->index[slot] - 1];
+
+    if (field->hash == hash &&
+        fpx_strview_equals_nocase(
+            (fpx_strview_t){&cntptr->headers[field->key], field->key_len},
+            key)) {
+      *value = (fpx_strview_t){&cntptr->headers[field->value],
+                               field->value_len};
+      return 0;
     }
 
-    fpx_memcpy(_dst->headers, _src->headers, _dst->headers_len);
+    slot = (slot + 1) & (FPX_HTTP_HEADER_INDEX_SIZE - 1);
   }
 
-  if (_dst->body_allocated > 0) {
-    _dst->body = (char *)malloc(_dst->body_allocated);
-    if (NULL == _dst->body) {
-      // bad alloc
-      return -2;
+  // only a full table may have left headers out
+  if (FPX_HTTP_MAX_HEADER_FIELDS > cntptr->field_count)
+    return -2;
+
+  return _scan_headers(cntptr, key, value);
+}
+
+static int _scan_headers(const struct _fpx_http_content *cntptr,
+                         fpx_strview_t key, fpx_strview_t *value) {
+  // the headers that did not fit in `fields` are the lines after the last
+  // one that did, and they are rare enough to just go through one by one
+  const struct _fpx_http_header *last =
+      &cntptr->fields[FPX_HTTP_MAX_HEADER_FIELDS - 1];
+
+  const char *end = cntptr->headers + cntptr->headers_len;
+  const char *line = cntptr->headers + last->value + last->value_len;
+  const char *newline = (const char *)memchr(line, '\n', end - line);
+
+  while (NULL != newline) {
+    line = newline + 1;
+    newline = (const char *)memchr(line, '\n', end - line);
+
+    const char *line_end = (NULL != newline) ? newline : end;
+    if (line_end > line && '\r' == line_end[-1])
+      --line_end;
+
+    const char *colon = (const char *)memchr(line, ':', line_end - line);
+
+    if (NULL == colon ||
+        !fpx_strview_equals_nocase((fpx_strview_t){line, colon - line}, key))
+      continue;
+
+    const char *start = colon + 1;
+    while (start < line_end && (' ' == *start || '\t' == *start))
+      ++start;
+    while (line_end > start && (' ' == line_end[-1] || '\t' == line_end[-1]))
+      --line_end;
+
+    *value = (fpx_strview_t){start, line_end - start};
+    return 0;
+  }
+
+  return -2;
+}
+
+static int _send_all(int fd, struct iovec *iov, int iov_count) {
+  // sends every entry of `iov`, advancing them along the way.
+  // returns 0 on success, or errno if sending fails
+  int first = 0;
+
+  while (TRUE) {
+    while (first < iov_count && 0 == iov[first].iov_len)
+      ++first;
+
+    if (first == iov_count)
+      return 0;
+
+#if defined(_WIN32) || defined(_WIN64)
+    long written =
+        send(fd, (char *)iov[first].iov_base, iov[first].iov_len, 0);
+#else
+    struct msghdr msg;
+    fpx_memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov[first];
+    msg.msg_iovlen = iov_count - first;
+
+    // to ignore SIGPIPE when writing to a disconnected client
+    long written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+#endif
+
+    if (0 > written) {
+      if (EINTR == errno)
+        continue;
+
+      return errno;
+    }
+
+    for (int i = first; i < iov_count && written > 0; ++i) {
+      size_t part =
+          ((size_t)written < iov[i].iov_len) ? (size_t)written : iov[i].iov_len;
+
+      iov[i].iov_base = (char *)iov[i].iov_base + part;
+      iov[i].iov_len -= part;
+      written -= part;
+    }
+  }
+}
+
+static void _mask_words(uint8_t *data, size_t len, uint32_t key) {
+  // `key` holds the four key bytes in memory order
+  uint64_t key_long = ((uint64_t)key << 32) | key;
+  size_t i = 0;
+
+  for (; i + sizeof(key_long) <= len; i += sizeof(key_long)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    word ^= key_long;
+    memcpy(data + i, &word, sizeof(word));
+  }
+
+  const uint8_t *key_bytes = (const uint8_t *)&key;
+  for (; i < len; ++i)
+    data[i] ^= key_bytes[i & 3];
+
+  return;
+}
+
+#if defined(MASK_X86)
+static void _mask_sse2(uint8_t *data, size_t len, uint32_t key) {
+  __m128i key_vec = _mm_set1_epi32((int)key);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    _mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, key_vec));
+  }
+
+  // whole vectors keep the key aligned to `i`
+  _mask_words(data + i, len - i, key);
+
+  return;
+}
+
+__attribute__((target("avx2"))) static void _mask_avx2(uint8_t *data,
+                                                       size_t len,
+                                                       uint32_t key) {
+  __m256i key_vec = _mm256_set1_epi32((int)key);
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(data + i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(data + i + 32));
+    _mm256_storeu_si256((__m256i *)(data + i), _mm256_xor_si256(a, key_vec));
+    _mm256_storeu_si256((__m256i *)(data + i + 32),
+                        _mm256_xor_si256(b, key_vec));
+  }
+
+  if (i + 32 <= len) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(data + i));
+    _mm256_storeu_si256((__m256i *)(data + i), _mm256_xor_si256(a, key_vec));
+    i += 32;
+  }
+
+  _mask_sse2(data + i, len - i, key);
+
+  return;
+}
+#endif
+
+static int _parse_request_line(fpx_httpparser_t *parser, const char *req,
+                               size_t line_start, size_t line_len) {
+  static const struct {
+    const char *name;
+    uint32_t len;
+    fpx_httpmethod_t method;
+  } methods[] = {
+      {"GET", 3, HTTP_GET},         {"HEAD", 4, HTTP_HEAD},
+      {"POST", 4, HTTP_POST},       {"PUT", 3, HTTP_PUT},
+      {"DELETE", 6, HTTP_DELETE},   {"CONNECT", 7, HTTP_CONNECT},
+      {"OPTIONS", 7, HTTP_OPTIONS}, {"TRACE", 5, HTTP_TRACE},
+      {"PATCH", 5, HTTP_PATCH},
+  };
+
+  const char *line = req + line_start;
+  const char *end = line + line_len;
+
+  // METHOD SP request-target SP HTTP-version
+  const char *first_space = (const char *)memchr(line, ' ', line_len);
+  if (NULL == first_space)
+    return -2;
+
+  const char *uri = first_space + 1;
+  const char *second_space = (const char *)memchr(uri, ' ', end - uri);
+  if (NULL == second_space)
+    return -2;
+
+  const char *version = second_space + 1;
+
+  parser->method = HTTP_ERROR;
+  for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i) {
+    if (methods[i].len == (uint32_t)(first_space - line) &&
+        0 == strncmp(line, methods[i].name, methods[i].len)) {
+      parser->method = methods[i].method;
+      break;
     }
+  }
+
+  if (HTTP_ERROR == parser->method)
+    return -2; // bad METHOD
+
+  if (second_space == uri || *uri != '/')
+    return -2; // bad URI
+
+  if (second_space - uri > URI_MAXLENGTH)
+    return -4; // URI too long
+
+  if (end - version < 6 || 0 != strncmp(version, "HTTP/", 5))
+    return -2; // bad VERSION
+
+  version += 5;
+
+  if ((size_t)(end - version) >=
+      sizeof(((fpx_httprequest_t *)0)->content.version))
+    return -2; // VERSION too long
+
+  parser->method_len = first_space - line;
+  parser->uri = uri - req;
+  parser->uri_len = second_space - uri;
+  parser->version = version - req;
+  parser->version_len = end - version;
+
+  return 0;
+}
+
+static int _parse_header_line(fpx_httpparser_t *parser, const char *req,
+                              size_t line_start, size_t line_len) {
+  const char *line = req + line_start;
+  const char *end = line + line_len;
+
+  // obsolete line folding is not accepted (RFC 9112, 5.2)
+  if (' ' == *line || '\t' == *line)
+    return -2;
+
+  const char *colon = (const char *)memchr(line, ':', line_len);
+  if (NULL == colon || colon == line)
+    return -2;
+
+  // no whitespace is allowed in or after the field name
+  for (const char *c = line; c < colon; ++c)
+    if (' ' == *c || '\t' == *c)
+      return -2;
+
+  const char *value = colon + 1;
+  while (value < end && (' ' == *value || '\t' == *value))
+    ++value;
+
+  const char *value_end = end;
+  while (value_end > value && (' ' == value_end[-1] || '\t' == value_end[-1]))
+    --value_end;
+
+  size_t key_len = colon - line;
+
+  // past the limit, the header is left for _scan_headers() to find
+  if (FPX_HTTP_MAX_HEADER_FIELDS > parser->field_count) {
+    struct _fpx_http_header *field = &parser->fields[parser->field_count++];
+
+    // relative to the start of the header section
+    field->key = line_start - parser->headers_start;
+    field->key_len = key_len;
+    field->value = (value - req) - parser->headers_start;
+    field->value_len = value_end - value;
+    field->hash = _header_hash(line, key_len);
+  }
+
+  int known = _known_header_id(line, key_len);
+
+  if (HTTP_HEADER_CONTENT_LENGTH == known) {
+    uint64_t length = 0;
+    size_t used = 0;
+
+    // digits only, all the way to the end of the value; anything too big
+    // for 64 bits is clamped, and refused later on anyway
+    if (-2 == fpx_struint64(value, value_end - value, &length, &used) ||
+        used != (size_t)(value_end - value))
+      return -2;
+
+    // where size_t is smaller, keep it from wrapping around to something small
+    if ((size_t)length != length)
+      length = SIZE_MAX;
+
+    if (parser->seen_content_length && length != parser->content_length)
+      return -2; // conflicting lengths
 
-    fpx_memcpy(_dst->body, _src->body, _dst->body_len);
+    parser->content_length = length;
+    parser->seen_content_length = TRUE;
+  } else if (HTTP_HEADER_TRANSFER_ENCODING == known) {
+    return -6;
   }
 
   return 0;
@@ -4,8 +4,14 @@
 //  Author: Erynn 'foorpyxof' Scholtes
 //
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // accept4()
+#endif
+
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,13 +25,38 @@
 
 #if defined(_WIN32) || defined(_WIN64)
 #define LONG_FORMAT "ll"
+#define MSG_DONTWAIT 0
 #else
 #define LONG_FORMAT "l"
+#include <fcntl.h>
 #include <poll.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#endif
+
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <strings.h> // strcasecmp()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+// only what _send_iov() needs; windows has no sendmsg()
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
 // START OF FPXLIBC LINK-TIME DEPENDENCIES
+#include "alloc/arena.h"    // requires arena*.o
 #include "c-utils/crypto.h" // requires crypto*.o
+#include "c-utils/deflate.h" // requires deflate*.o
 #include "c-utils/endian.h" // requires endian*.o
 #include "c-utils/format.h" // requires format*.o
 #include "mem/mem.h"        // requires mem*.o
@@ -41,13 +72,40 @@
 /* this is the default maximum amount of endpoints to be handled */
 #define ENDPOINTS_DEFAULT 16
 
-/* this is the default maximum amount of clients to handle per HTTP thread */
+/* this is the initial size of the per-thread client tables; they grow as
+ * needed */
 #define CLIENTS_DEFAULT 64
 
+/* this is the default maximum amount of concurrent connections on a server */
+#define CONNECTIONS_DEFAULT 16384
+
 /* this is the default buffer size for HTTP reading and writing */
 #define BUFFER_DEFAULT 16384
 
-#define MAX_HEADERS 4096
+/* this is the size of the arena a connection builds its requests and
+ * responses in; whatever does not fit goes to the heap */
+#define REQUEST_ARENA_SIZE (1 << 16)
+
+/* this is how many parsers and arenas of connections that went idle every
+ * HTTP thread keeps around for the next request, instead of freeing them */
+#define SPARE_CONTEXTS 64
+
+/* a client that lets this many bytes of responses pile up without reading
+ * them gets disconnected */
+#define PENDING_OUTPUT_MAX (1 << 22)
+
+/* static files that can not be sent with sendfile() are mapped and written
+ * this many bytes at a time */
+#define FILE_MAP_WINDOW (1 << 20)
+
+/* this is the maximum amount of events handled per epoll_wait() call */
+#define EVENTS_PER_WAKEUP 64
+
+/* these size the per-thread timer wheel used for idle timeouts;
+ * a full turn of the wheel spans TIMER_SLOTS * TIMER_TICK_MS milliseconds */
+#define TIMER_SLOTS 256
+#define TIMER_TICK_MS 250
+
 // #define MAX_BODY 8192
 
 /* this is the HTTP version that will be used in responses */
@@ -59,6 +117,39 @@
 /* this is the default maximum idle timer for websocket connections */
 #define WS_TIMEOUT_SECONDS 60
 
+/* this is the default maximum size of a websocket message, after the
+ * fragments it was sent in have been put back together */
+#define WS_MESSAGE_DEFAULT (1 << 24)
+
+/* this is the size of the per-connection websocket receive ring; must be a
+ * power of two. payloads bigger than it are read around it */
+#define WS_RING_SIZE 16384
+
+/* this is the smallest buffer a websocket message is received into; it
+ * doubles from there as the payload comes in */
+#define WS_MESSAGE_MIN 1024
+
+/* this is the default window that messages to permessage-deflate clients are
+ * compressed with, as a base-2 logarithm */
+#define WS_DEFLATE_BITS_DEFAULT 15
+
+/* this is the default cap on the compression state a client may make the
+ * server keep between messages; it covers a compressor of our own with a
+ * 13-bit window, plus the largest window for what the client sends */
+#define WS_DEFLATE_MEMORY_DEFAULT (1 << 17)
+
+/* outgoing payloads shorter than this are sent uncompressed, unless the
+ * client lets us refer back to earlier messages */
+#define WS_DEFLATE_MIN_LENGTH 64
+
+/* this is the maximum length of a pub/sub topic name, including the
+ * null-terminator */
+#define TOPIC_MAX_LENGTH 64
+
+/* this is the amount of hash buckets every websocket thread sorts the topics
+ * of its clients into */
+#define TOPIC_BUCKETS 256
+
 #define SERVER_HEADER "fpx_http"
 
 // returns out of the function this macro is placed in if
@@ -81,6 +172,19 @@ struct _websocket_frame;
 
 struct _fpx_endpoint;
 struct _fpx_httpserver_metadata;
+struct _ws_owner;
+
+struct _route_node;
+
+struct _pending_output;
+struct _output_segment;
+struct _file_body;
+
+struct _ws_receiver;
+
+struct _topic;
+struct _ws_broadcast;
+struct _ws_command;
 // end of struct forward declarations
 
 /* start of static function declarations */
@@ -90,41 +194,158 @@ static int _endpoint_get(fpx_httpserver_t *, const char *uri);
 static int _available_endpoint_index(fpx_httpserver_t *, const char *uri);
 static int _fix_endpoint_uri(const char *in, char *out, size_t maxlen);
 
-static void _thread_init(struct _thread *);
+static struct _route_node *_route_node_new(const char *segment, size_t len);
+static int _route_add(struct _route_node *root, const char *pattern,
+                      int endpoint);
+static struct _route_node *_route_add_static(struct _route_node *,
+                                             const char *segment, size_t len);
+static int _route_match(const struct _route_node *, fpx_httprequest_t *,
+                        size_t at, size_t end);
+static struct _fpx_endpoint *_route_lookup(fpx_httpserver_t *,
+                                           fpx_httprequest_t *);
+static int _create_listen_socket(struct sockaddr_in *, uint8_t reuse_port);
+static int _accept_socket(int listen_fd, struct sockaddr_in *,
+                          socklen_t *addr_len);
+static struct _client_meta *_accept_client(fpx_httpserver_t *, int fd,
+                                           struct sockaddr_in *);
+
+static int _thread_init(struct _thread *);
+static void _thread_destroy(struct _thread *);
 static void *_thread_loop(void *thread_package);
-
-static int _add_client_to_thread(struct _thread *, int client_fd);
+static void _thread_poll(struct _thread *);
+#if defined(__linux__)
+static void _thread_epoll(struct _thread *);
+#endif
+static void _thread_expire(struct _thread *, uint64_t now);
+static int _thread_next_timeout(struct _thread *, uint64_t now);
+static void _timer_schedule(struct _thread *, struct _client_meta *);
+static void _timer_unlink(struct _client_meta *);
+static uint64_t _monotonic_ms(void);
+static void _thread_take_pending(struct _thread *);
+static void _thread_accept(struct _thread *);
+static struct _thread *_thread_reserve(struct _thread *threads, int count);
+static int _thread_grow(struct _thread *);
+static int _connection_reserve(fpx_httpserver_t *);
+static void _connection_release(fpx_httpserver_t *);
+static void _thread_hand_off(struct _thread *, struct _client_meta *);
+
+static int _add_client_to_thread(struct _thread *, struct _client_meta *);
 static int _disconnect_client(struct _thread *thread, int idx,
                               uint8_t close_socket);
 
 static int _http_handle_client(struct _thread *thread, int idx);
-static int _http_parse_request(char *readbuf, int readbuf_len,
-                               fpx_httprequest_t *output);
+static int _http_context_take(struct _thread *, struct _client_meta *);
+static void _http_context_release(struct _thread *, struct _client_meta *);
+static int _http_handle_request(struct _thread *, int idx,
+                                fpx_httprequest_t *, int parse_result);
 static void _handle_http_endpoint(struct _thread *, fpx_httprequest_t *,
-                                  fpx_httpresponse_t *);
+                                  fpx_httpresponse_t *, struct _file_body *);
+static void _serve_static(struct _fpx_endpoint *, const char *path,
+                          fpx_httprequest_t *, fpx_httpresponse_t *,
+                          struct _file_body *);
+#if !(defined(_WIN32) || defined(_WIN64))
+static int _static_resolve_path(const char *directory, const char *uri_path,
+                                char *out, size_t out_len);
+static const char *_static_content_type(const char *path);
+static int _static_etag_matches(const char *if_none_match, const char *etag);
+static int _static_parse_range(const char *range, uint64_t size,
+                               uint64_t *first, uint64_t *last);
+#endif
 static int _send_response(fpx_httprequest_t *, fpx_httpresponse_t *,
-                          int client_fd);
+                          int client_fd, struct _pending_output *);
+static long _send_iov(int fd, struct iovec *, int iov_count, int flags);
+static int _pending_append(struct _pending_output *, const struct iovec *,
+                           int iov_count);
+static int _pending_append_file(struct _pending_output *, struct _file_body *);
+static long _send_file(int fd, struct _output_segment *);
+static int _pending_append_shared(struct _pending_output *,
+                                  struct _ws_broadcast *, size_t offset);
+static int _pending_flush(struct _pending_output *, int fd);
+static int _pending_drain(struct _pending_output *, int fd);
+static void _pending_free(struct _pending_output *);
+static int _flush_client(struct _thread *, struct _client_meta *);
+static void _watch_writable(struct _thread *, struct _client_meta *,
+                            uint8_t enable);
 
 static int _ws_handle_client(struct _thread *thread, int idx);
-static int _ws_parse_request(int fd, fpx_websocketframe_t *output);
+static int _ws_decode(struct _thread *, int idx);
+static int _ws_frame_done(struct _thread *, int idx);
+static int _ws_fail(struct _thread *, int idx, int16_t code,
+                   const char *reason);
+static void _ws_ring_read(struct _ws_receiver *, uint8_t *out, size_t len,
+                          uint8_t consume);
+static int _ws_message_reserve(struct _ws_receiver *, uint64_t amount,
+                               uint32_t max_message);
+static void _ws_receiver_free(struct _ws_receiver *);
+static int _ws_negotiate_deflate(fpx_httpserver_t *, fpx_httprequest_t *,
+                                 fpx_websocketclient_t *, char *out,
+                                 size_t out_len);
+static int _ws_deflate_offer(fpx_httpserver_t *, const char *offer,
+                             size_t len, fpx_websocketclient_t *, char *out,
+                             size_t out_len);
+static int _token_equals(const char *, size_t, const char *token);
+static int16_t _ws_inflate(fpx_websocketclient_t *, uint64_t max_message,
+                           const char **reason);
+static fpx_deflate_t *_ws_deflater(struct _thread *, uint8_t window_bits);
+
+static int _ws_subscription(fpx_httpserver_t *, int fd, const char *topic,
+                            int command_type);
+static int _ws_owner_set(fpx_httpserver_t *, struct _thread *,
+                         struct _client_meta *);
+static void _ws_owner_clear(fpx_httpserver_t *, struct _client_meta *);
+static int _ws_owner_get(fpx_httpserver_t *, int fd, struct _ws_owner *out);
+static struct _client_meta *_ws_owner_client(struct _thread *,
+                                             struct _ws_command *);
+static int _ws_command_post(struct _thread *, struct _ws_command *);
+static void _ws_command_run(struct _thread *, struct _ws_command *);
+static struct _ws_broadcast *_ws_broadcast_new(enum websocket_opcode,
+                                               uint8_t compressed,
+                                               const uint8_t *payload,
+                                               size_t payload_length);
+static struct _ws_broadcast *_ws_broadcast_deflate(fpx_httpserver_t *,
+                                                   enum websocket_opcode,
+                                                   const uint8_t *payload,
+                                                   size_t payload_length);
+static void _ws_broadcast_release(struct _ws_broadcast *);
+static uint32_t _topic_hash(const char *name, size_t len);
+static struct _topic *_topic_find(struct _thread *, const char *name,
+                                  size_t len, uint8_t create);
+static int _topic_join(struct _thread *, struct _client_meta *,
+                       const char *name, size_t len);
+static void _topic_leave(struct _thread *, struct _client_meta *,
+                         struct _topic *);
+static void _topic_leave_all(struct _thread *, struct _client_meta *);
+static void _topic_drop(struct _thread *, struct _topic *);
+static void _topic_deliver(struct _thread *, struct _topic *,
+                           struct _ws_broadcast *,
+                           struct _ws_broadcast *deflated);
+static void _ws_deliver(struct _thread *, struct _client_meta *,
+                        struct _ws_broadcast *,
+                        struct _ws_broadcast *deflated);
+static int _ws_send_message(struct _thread *, struct _client_meta *,
+                            enum websocket_opcode, const uint8_t *payload,
+                            size_t payload_length);
+static int _ws_write(struct _thread *, struct _client_meta *,
+                     const fpx_websocketframe_t *);
 
 // returns -2 on invalid request (400)
 // returns -3 if no content-length was passed, and thus no body was read
 static int _apply_default_headers(fpx_httpserver_t *srvptr,
                                   fpx_httpresponse_t *resptr);
-static int _http_parse_request_line(const char *, fpx_httprequest_t *output);
 static int _sanitize_headers(const char *in, char *out, size_t out_len,
                              size_t *copied_count);
 static int _is_upgradable(fpx_httprequest_t *);
 static void _set_keepalive(fpx_httprequest_t *, fpx_httpresponse_t *);
-static void _upgrade_to_ws(struct _thread *, int idx, fpx_websocketcallback_t);
-static void _on_response_ready(struct _thread *, fpx_httprequest_t *,
-                               fpx_httpresponse_t *, int idx);
-
-static int _ws_frame_validate(fpx_websocketframe_t *, fpx_websocketclient_t *,
-                              int fd);
-static void _handle_control_frame(fpx_websocketframe_t *,
-                                  fpx_websocketclient_t *, int fd);
+static void _upgrade_to_ws(struct _thread *, int idx, struct _thread *ws_thread,
+                           fpx_websocketcallback_t);
+static int _on_response_ready(struct _thread *, fpx_httprequest_t *,
+                              fpx_httpresponse_t *, int idx,
+                              struct _file_body *);
+
+static int16_t _ws_frame_validate(const fpx_websocketclient_t *,
+                                  uint64_t max_message, const char **reason);
+static int _handle_control_frame(struct _thread *, struct _client_meta *,
+                                 fpx_websocketframe_t *);
 static int _generate_ws_accept_header(fpx_httprequest_t *, char[32]);
 
 // static int _check_manual_ws_upgrade(fpx_httprequest_t*, fpx_httpresponse_t*);
@@ -142,6 +363,12 @@ static int _generate_ws_accept_header(fpx_httprequest_t *, char[32]);
 #define SET_HTTP_200(srvptr, res, body, body_len)                              \
   SET_HTTPRESPONSE_PRESET(srvptr, res, 200, "OK", body, body_len)
 
+#define SET_HTTP_206(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 206, "Partial Content", body, body_len)
+
+#define SET_HTTP_304(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 304, "Not Modified", body, body_len)
+
 #define SET_HTTP_400(srvptr, res, body, body_len)                              \
   SET_HTTPRESPONSE_PRESET(srvptr, res, 400, "Bad Request", body, body_len)
 
@@ -155,10 +382,27 @@ static int _generate_ws_accept_header(fpx_httprequest_t *, char[32]);
 #define SET_HTTP_411(srvptr, res, body, body_len)                              \
   SET_HTTPRESPONSE_PRESET(srvptr, res, 411, "Length Required", body, body_len)
 
+#define SET_HTTP_413(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 413, "Content Too Large", body, body_len)
+
+#define SET_HTTP_414(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 414, "URI Too Long", body, body_len)
+
+#define SET_HTTP_431(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 431,                                    \
+                          "Request Header Fields Too Large", body, body_len)
+
+#define SET_HTTP_416(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 416, "Range Not Satisfiable", body,     \
+                          body_len)
+
 #define SET_HTTP_500(srvptr, res, body, body_len)                              \
   SET_HTTPRESPONSE_PRESET(srvptr, res, 500, "Internal Server Error", body,     \
                           body_len)
 
+#define SET_HTTP_501(srvptr, res, body, body_len)                              \
+  SET_HTTPRESPONSE_PRESET(srvptr, res, 501, "Not Implemented", body, body_len)
+
 #define SET_HTTP_503(srvptr, res, body, body_len)                              \
   SET_HTTPRESPONSE_PRESET(srvptr, res, 503, "Service Unavailable", body,       \
                           body_len)
@@ -168,18 +412,181 @@ static int _generate_ws_accept_header(fpx_httprequest_t *, char[32]);
                           body, body_len)
 
 // start struct definitions
+
+// return values of the client handlers;
+// tells the event loop whether the socket is worth reading from again
+enum _handler_status {
+  HANDLER_GONE = -1,   // the client was disconnected or handed off
+  HANDLER_AGAIN = 0,   // something was handled; there may be more to read
+  HANDLER_DRAINED = 1, // the socket has nothing left for us right now
+};
+
 enum _ws_client_flags {
   CLOSE_SENT = 0x01,
   CLOSE_RECV = 0x02,
 };
 
+// receiving side of a websocket connection; frames are decoded from `ring`
+// as their bytes come in, over as many reads as it takes
+struct _ws_receiver {
+  // HEAP; bytes read from the socket but not decoded yet. they occupy
+  // [head, head + fill) modulo WS_RING_SIZE
+  uint8_t *ring;
+  size_t head;
+  size_t fill;
+
+  // header of the frame being received; its payload goes straight into
+  // `message` or `control`. `left` is what is still to come of it
+  uint8_t in_payload;
+  fpx_websocketframe_t frame;
+  uint64_t left;
+  uint64_t mask_offset;
+
+  // the data message being put back together from its fragments;
+  // the opcode is WEBSOCKET_CONTINUE while there is none
+  fpx_websocketframe_t message;
+
+  // control frames may arrive in between the fragments of a message
+  uint8_t control[125];
+
+  // HEAP; permessage-deflate only. created for the first compressed message
+  fpx_inflate_t *inflater;
+};
+
 struct _fpx_websocketclient {
   uint8_t flags;
   fpx_websocketcallback_t callback;
+
+  struct _ws_receiver rx;
+
+  // permessage-deflate, as negotiated in the handshake. what the client
+  // sends may refer back as far as its window reaches, which is 0 if it may
+  // not. what we send refers back through `deflater`, whose window fits in
+  // ws_deflate_memory; `deflate_own_bits` is 0 if the client does not allow
+  // that (or it does not fit), and we use the compressor of the thread
+  uint8_t deflate;
+  uint8_t deflate_server_bits;
+  uint8_t deflate_client_bits;
+  uint8_t deflate_own_bits;
+
+  // HEAP; created for the first message we compress. `deflate_fresh` is set
+  // when the client's copy of its window no longer matches, after a message
+  // that it did not compress
+  fpx_deflate_t *deflater;
+  uint8_t deflate_fresh;
+
+  // HEAP; the topics this client is subscribed to
+  struct _topic **topics;
+  int topic_count;
+  int topic_capacity;
+
+  // this client's entry in the server's owner table; 0 if it has none
+  uint32_t generation;
+};
+
+// a message on its way to the subscribers of a topic; framed once and then
+// shared by the output of every client it is sent to
+struct _ws_broadcast {
+  atomic_int references;
+
+  size_t length;
+  size_t header_length;
+  uint8_t data[]; // frame header, followed by the payload
+};
+
+// the clients of one websocket thread that are subscribed to a topic
+struct _topic {
+  struct _topic *next; // in the same hash bucket
+  uint32_t hash;
+
+  // HEAP; in no particular order
+  struct _client_meta **subscribers;
+  int subscriber_count;
+  int subscriber_capacity;
+
+  size_t name_len;
+  char name[TOPIC_MAX_LENGTH];
+};
+
+// work handed to a websocket thread by any other thread
+struct _ws_command {
+  struct _ws_command *next;
+
+  enum { WsSubscribe, WsUnsubscribe, WsPublish, WsSend } type;
+
+  int fd;                        // all but publish
+  uint32_t generation;           // of the client on `fd`; all but publish
+  struct _ws_broadcast *message; // publish and send; holds a reference
+
+  // publish and send; the same message compressed, for permessage-deflate
+  // clients. holds a reference, or is NULL
+  struct _ws_broadcast *deflated;
+
+  size_t topic_len;
+  char topic[TOPIC_MAX_LENGTH];
+};
+
+// the websocket thread that owns the client on a descriptor. descriptors are
+// reused, so commands carry the generation of the client they were meant for
+struct _ws_owner {
+  struct _thread *thread;
+  struct _client_meta *client; // only for `thread` to touch
+  uint32_t generation;         // 0 if the descriptor has no websocket client
+};
+
+// one queued piece of output; either bytes or a range of an open file
+struct _output_segment {
+  struct _output_segment *next;
+
+  int file_fd;     // -1 for in-memory data; closed when the segment is done
+  uint64_t offset; // into the file, or into `data`
+  uint64_t left;   // bytes still to be written
+
+  // if set, the in-memory data is in here instead of in `data`;
+  // the reference is released when the segment is done
+  struct _ws_broadcast *shared;
+
+  char data[]; // in-memory data only
+};
+
+// response bytes the socket would not take yet, in order; written out on
+// POLLOUT. only ever touched by the thread that owns the client
+struct _pending_output {
+  struct _output_segment *head; // HEAP
+  struct _output_segment *tail;
+
+  size_t buffered; // in-memory bytes waiting; capped at PENDING_OUTPUT_MAX
+};
+
+// a file range that is sent after the headers of a response
+struct _file_body {
+  int fd; // -1 if the response has no file body
+  uint64_t offset;
+  uint64_t length;
 };
 
 struct _client_meta {
-  time_t last_time;
+  int fd;
+  int slot; // index into the `clients` and `pfds` of the owning thread
+
+  // HTTP only; holds partially received (or pipelined) requests.
+  // allocated on the first read and released again once it runs empty
+  fpx_httpparser_t *parser;
+
+  // HTTP only; requests and responses are built in here. comes and goes
+  // together with `parser`, and may be NULL
+  fpx_arena *arena;
+
+  struct _pending_output output;
+
+  // set when the connection is to be closed as soon as `output` is written
+  uint8_t close_after_flush;
+
+  // idle timeout bookkeeping; see _timer_schedule()
+  uint64_t deadline;
+  struct _client_meta *timer_next;
+  struct _client_meta **timer_pprev;
+
   struct sockaddr in_address;
 
   fpx_websocketclient_t ws;
@@ -189,12 +596,64 @@ struct _thread {
   fpx_httpserver_t *server;
   pthread_t thread;
 
+  // this only guards `pending` and `inbox`;
+  // the loop itself never holds it while waiting for or handling events
   pthread_mutex_t loop_mutex;
-  pthread_cond_t loop_condition;
+
+  // clients handed to this thread by the acceptor, or by an HTTP thread after
+  // a WebSocket upgrade, which the thread has not picked up yet
+  struct _client_meta **pending;
+  int pending_count;
+  int pending_capacity;
+
+  // WebSockets only; subscriptions and messages for the clients of this
+  // thread, which the thread has not picked up yet
+  struct _ws_command *inbox;
+  struct _ws_command *inbox_tail;
+
+  // writing to wake_fds[1] interrupts the thread's poll/epoll wait
+  int wake_fds[2];
+
+  // only valid when running the EpollBackend; -1 otherwise
+  int epoll_fd;
+
+  // this thread's own SO_REUSEPORT listening socket when the server runs with
+  // the ReusePort option; -1 otherwise
+  int listen_fd;
+
+  // set when accepting ran out of descriptors (or memory); the listener is
+  // edge-triggered, so _thread_loop() retries every tick until it works again
+  uint8_t accept_paused;
+
+  // connected + pending clients; read by other threads for load balancing
+  atomic_int load;
 
   int connection_count;
+  int capacity;        // size of `clients`; grows on demand
+  // mirrors `clients`, plus one entry for wake_fds[0] and one for listen_fd
   struct pollfd *pfds;
-  struct _client_meta *client_data;
+  struct _client_meta **clients;
+
+  // hashed timer wheel; slot i holds the clients whose deadline rounds up to a
+  // tick that is congruent to i. `wheel_tick` is the next tick to expire
+  struct _client_meta *wheel[TIMER_SLOTS];
+  uint64_t wheel_tick;
+
+  // HTTP only; parsers (with their buffer) and arenas of clients that went
+  // idle, ready for the next request. see _http_context_take()
+  fpx_httpparser_t *spare_parsers[SPARE_CONTEXTS];
+  fpx_arena *spare_arenas[SPARE_CONTEXTS];
+  int spare_count;
+
+  // WebSockets only; hash table of the topics the clients of this thread are
+  // subscribed to. `delivering` is kept alive even when it runs empty, see
+  // _topic_deliver()
+  struct _topic *topics[TOPIC_BUCKETS];
+  struct _topic *delivering;
+
+  // WebSockets only; HEAP. compressors for messages sent from callbacks, one
+  // for every window size from 9 bits up, created on first use
+  fpx_deflate_t *deflaters[7];
 
   // function pointer to the client handler; (HTTP or websockets)
   int (*handler)(struct _thread *, int);
@@ -210,6 +669,25 @@ struct _fpx_endpoint {
 
   fpx_httpcallback_t http_callback;
   fpx_websocketcallback_t ws_callback;
+
+  // static file endpoints only; empty otherwise
+  char directory[256];
+};
+
+struct _route_node {
+  // HEAP; the literal text matched by this node, or the name of the parameter
+  // for `param` and `wildcard` nodes
+  char *segment;
+  uint16_t segment_len;
+
+  // HEAP; literal children, no two of which start with the same byte
+  struct _route_node **children;
+  uint16_t child_count;
+
+  struct _route_node *param;    // ":name"; matches up to the next '/'
+  struct _route_node *wildcard; // "*name"; matches the rest of the path
+
+  int endpoint; // index into `endpoints`, or -1 if no route ends here
 };
 
 struct _fpx_httpserver_metadata {
@@ -225,19 +703,45 @@ struct _fpx_httpserver_metadata {
   struct _fpx_endpoint default_endpoint;
 
   struct _fpx_endpoint *endpoints;
-  uint8_t active_endpoints;
+  uint16_t active_endpoints;
+
+  // radix tree over the endpoint URIs, built as endpoints are created
+  struct _route_node *routes;
 
   char *default_headers;
   size_t default_headers_len;
 
   uint8_t is_listening;
 
+  // every open client socket, across all threads; capped at max_connections
+  atomic_uint connections;
+
+  // HEAP; compresses published messages, which may come from any thread.
+  // created on first use
+  fpx_deflate_t *publish_deflater;
+  pthread_mutex_t publish_mutex;
+
+  // HEAP; indexed by descriptor. tells other threads which websocket thread
+  // to hand a client's commands to
+  struct _ws_owner *ws_owners;
+  int ws_owner_capacity;
+  uint32_t ws_generation; // the last one given out
+  pthread_mutex_t ws_owner_mutex;
+
   // int16_t max_body_size;
 };
 // end struct definitions
 
+// the websocket client whose callback is running on this thread, if any;
+// lets fpx_httpserver_subscribe() and fpx_httpserver_ws_send() skip the inbox
+// for that client
+static _Thread_local struct {
+  struct _thread *thread;
+  struct _client_meta *client;
+} _ws_in_callback;
+
 int fpx_httpserver_init(fpx_httpserver_t *srvptr, const uint8_t http_threads,
-                        const uint8_t ws_threads, uint8_t max_endpoints) {
+                        const uint8_t ws_threads, uint16_t max_endpoints) {
   if (NULL == srvptr)
     return -1;
 
@@ -245,6 +749,12 @@ int fpx_httpserver_init(fpx_httpserver_t *srvptr, const uint8_t http_threads,
 
   srvptr->server_type = WebSockets;
 
+#if defined(__linux__)
+  srvptr->backend = EpollBackend;
+#else
+  srvptr->backend = PollBackend;
+#endif
+
   srvptr->_internal = (struct _fpx_httpserver_metadata *)calloc(
       1, sizeof(struct _fpx_httpserver_metadata));
 
@@ -277,9 +787,26 @@ int fpx_httpserver_init(fpx_httpserver_t *srvptr, const uint8_t http_threads,
     return errno;
   }
 
+  meta->routes = _route_node_new("", 0);
+
+  if (NULL == meta->routes) {
+    free(meta->endpoints);
+    free(meta);
+    return ENOMEM;
+  }
+
   srvptr->keepalive_timeout = KEEPALIVE_SECONDS;
   srvptr->websockets_timeout = WS_TIMEOUT_SECONDS;
 
+  srvptr->max_connections = CONNECTIONS_DEFAULT;
+  srvptr->max_ws_message = WS_MESSAGE_DEFAULT;
+  atomic_init(&meta->connections, 0);
+
+  srvptr->ws_deflate_window_bits = WS_DEFLATE_BITS_DEFAULT;
+  srvptr->ws_deflate_memory = WS_DEFLATE_MEMORY_DEFAULT;
+  pthread_mutex_init(&meta->publish_mutex, NULL);
+  pthread_mutex_init(&meta->ws_owner_mutex, NULL);
+
   fpx_httpserver_set_default_headers(srvptr, "server: " SERVER_HEADER "\r\n");
 
   return 0;
@@ -300,6 +827,7 @@ int fpx_httpserver_set_default_headers(fpx_httpserver_t *srvptr,
     if (NULL != srvptr->_internal->default_headers)
       free(srvptr->_internal->default_headers);
 
+    srvptr->_internal->default_headers = NULL;
     srvptr->_internal->default_headers_len = 0;
 
     return 0;
@@ -317,14 +845,15 @@ int fpx_httpserver_set_default_headers(fpx_httpserver_t *srvptr,
 
   {
     if (NULL == srvptr->_internal->default_headers)
-      srvptr->_internal->default_headers = (char *)malloc(new_headers_len);
+      srvptr->_internal->default_headers = (char *)malloc(new_headers_len + 1);
     else
       srvptr->_internal->default_headers =
-          realloc(srvptr->_internal->default_headers, new_headers_len);
+          realloc(srvptr->_internal->default_headers, new_headers_len + 1);
   }
 
   // copy contents of temp buffer into default_headers buffer of the server
   fpx_memcpy(srvptr->_internal->default_headers, temp_output, new_headers_len);
+  srvptr->_internal->default_headers[new_headers_len] = 0;
   srvptr->_internal->default_headers_len = new_headers_len;
 
   free(temp_output);
@@ -442,6 +971,186 @@ int fpx_httpserver_create_ws_endpoint(fpx_httpserver_t *srvptr, const char *uri,
   return 0;
 }
 
+int fpx_httpserver_create_static_endpoint(fpx_httpserver_t *srvptr,
+                                          const char *uri,
+                                          const char *directory) {
+  SRV_ASSERT(srvptr);
+  if (NULL == uri || NULL == directory)
+    return -1;
+
+#if defined(_WIN32) || defined(_WIN64)
+  return -6;
+#else
+  size_t directory_len = fpx_getstringlength(directory);
+
+  // a trailing slash would end up doubled in every path
+  while (directory_len > 1 && '/' == directory[directory_len - 1])
+    --directory_len;
+
+  if (directory_len >= sizeof(((struct _fpx_endpoint *)0)->directory))
+    return -5;
+
+  int endpoint_index = _endpoint_get(srvptr, uri);
+
+  if (-5 == endpoint_index)
+    return -7;
+  if (0 > endpoint_index)
+    return endpoint_index;
+
+  struct _fpx_endpoint *ptr = &srvptr->_internal->endpoints[endpoint_index];
+
+  {
+    // everything below the URI is served as well
+    char pattern[sizeof(ptr->uri) + sizeof("/*path")];
+    size_t uri_len = fpx_getstringlength(ptr->uri);
+
+    while (uri_len > 0 && '/' == ptr->uri[uri_len - 1])
+      --uri_len;
+
+    fpx_memcpy(pattern, ptr->uri, uri_len);
+    fpx_memcpy(&pattern[uri_len], "/*path", sizeof("/*path"));
+
+    if (0 > _route_add(srvptr->_internal->routes, pattern, endpoint_index))
+      return -7;
+  }
+
+  fpx_memcpy(ptr->directory, directory, directory_len);
+  ptr->directory[directory_len] = 0;
+
+  ptr->allowed_methods = HTTP_GET | HTTP_HEAD;
+  ptr->active = TRUE;
+
+  return endpoint_index;
+#endif
+}
+
+int fpx_httpserver_subscribe(fpx_httpserver_t *srvptr, int fd,
+                             const char *topic) {
+  return _ws_subscription(srvptr, fd, topic, WsSubscribe);
+}
+
+int fpx_httpserver_unsubscribe(fpx_httpserver_t *srvptr, int fd,
+                               const char *topic) {
+  return _ws_subscription(srvptr, fd, topic, WsUnsubscribe);
+}
+
+int fpx_httpserver_publish(fpx_httpserver_t *srvptr, const char *topic,
+                           enum websocket_opcode opcode, const uint8_t *payload,
+                           size_t payload_length) {
+  SRV_ASSERT(srvptr);
+  if (NULL == topic || (NULL == payload && 0 < payload_length))
+    return -1;
+
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+
+  if (FALSE == meta->is_listening || NULL == meta->ws_threads)
+    return -3;
+
+  size_t topic_len = fpx_getstringlength(topic);
+  if (0 == topic_len || TOPIC_MAX_LENGTH <= topic_len)
+    return -4;
+
+  if (WEBSOCKET_TEXT != opcode && WEBSOCKET_BINARY != opcode)
+    return -5;
+
+  // our own references keep these alive while we hand them out
+  struct _ws_broadcast *message =
+      _ws_broadcast_new(opcode, FALSE, payload, payload_length);
+  if (NULL == message)
+    return ENOMEM;
+
+  // NULL if nobody can take it, or if it did not get any smaller
+  struct _ws_broadcast *deflated =
+      _ws_broadcast_deflate(srvptr, opcode, payload, payload_length);
+
+  int retval = 0;
+
+  for (int i = 0; i < srvptr->ws_thread_count; ++i) {
+    struct _ws_command *command =
+        (struct _ws_command *)malloc(sizeof(struct _ws_command));
+    if (NULL == command) {
+      retval = ENOMEM;
+      break;
+    }
+
+    command->type = WsPublish;
+    command->fd = -1;
+    command->generation = 0;
+    command->topic_len = topic_len;
+    fpx_memcpy(command->topic, topic, topic_len);
+
+    atomic_fetch_add(&message->references, 1);
+    command->message = message;
+
+    command->deflated = deflated;
+    if (NULL != deflated)
+      atomic_fetch_add(&deflated->references, 1);
+
+    _ws_command_post(&meta->ws_threads[i], command);
+  }
+
+  _ws_broadcast_release(message);
+  if (NULL != deflated)
+    _ws_broadcast_release(deflated);
+
+  return retval;
+}
+
+int fpx_httpserver_ws_send(fpx_httpserver_t *srvptr, int fd,
+                           enum websocket_opcode opcode, const uint8_t *payload,
+                           size_t payload_length) {
+  SRV_ASSERT(srvptr);
+  if (NULL == payload && 0 < payload_length)
+    return -1;
+
+  if (WEBSOCKET_TEXT != opcode && WEBSOCKET_BINARY != opcode)
+    return -5;
+
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+
+  if (FALSE == meta->is_listening || NULL == meta->ws_threads)
+    return -3;
+
+  struct _thread *t = _ws_in_callback.thread;
+  struct _client_meta *client = _ws_in_callback.client;
+
+  if (NULL != t && t->server == srvptr && client->fd == fd) {
+    // we are in the callback of this client, on the thread that owns it;
+    // its output and its compressor are ours to use
+    return _ws_send_message(t, client, opcode, payload, payload_length);
+  }
+
+  // anywhere else, writing to the socket could cut into output that the
+  // owning thread has queued; that thread has to send it
+  struct _ws_owner owner;
+  if (0 != _ws_owner_get(srvptr, fd, &owner))
+    return -6;
+
+  struct _ws_command *command =
+      (struct _ws_command *)malloc(sizeof(struct _ws_command));
+  if (NULL == command)
+    return ENOMEM;
+
+  // compressed by the owning thread, since the client's compressor may
+  // refer back to what that thread sent before
+  command->message = _ws_broadcast_new(opcode, FALSE, payload, payload_length);
+  if (NULL == command->message) {
+    free(command);
+    return ENOMEM;
+  }
+
+  command->deflated = NULL;
+
+  command->type = WsSend;
+  command->fd = fd;
+  command->generation = owner.generation;
+  command->topic_len = 0;
+
+  _ws_command_post(owner.thread, command);
+
+  return 0;
+}
+
 int fpx_httpserver_listen(fpx_httpserver_t *srvptr, const char *ip,
                           const uint16_t port) {
   SRV_ASSERT(srvptr);
@@ -455,22 +1164,8 @@ int fpx_httpserver_listen(fpx_httpserver_t *srvptr, const char *ip,
 
   // socket things
   {
-    int listen_socket;
     struct sockaddr_in listen_addr;
-
-    listen_socket = socket(AF_INET, SOCK_STREAM, 0);
-
-    if (listen_socket == -1) {
-      int err = errno;
-      perror("socket()");
-      return err;
-    }
-
-    {
-      int one = 1;
-      setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, (void *)&one,
-                 sizeof(one));
-    }
+    fpx_memset(&listen_addr, 0, sizeof(listen_addr));
 
 // set IP address for socket; return error if invalid
 #if defined(_WIN32) || defined(_WIN64)
@@ -484,21 +1179,22 @@ int fpx_httpserver_listen(fpx_httpserver_t *srvptr, const char *ip,
     listen_addr.sin_family = AF_INET;
     listen_addr.sin_port = htons(port);
 
-    if (-1 == bind(listen_socket, (struct sockaddr *)&listen_addr,
-                   sizeof(listen_addr))) {
-      int err = errno;
-      perror("bind()");
-      return err;
-    }
+    meta->addr_4 = listen_addr;
+    meta->socket_4 = -1;
 
-    if (-1 == listen(listen_socket, 256)) {
-      int err = errno;
-      perror("listen()");
-      return err;
-    }
+#if defined(SO_REUSEPORT) && !(defined(_WIN32) || defined(_WIN64))
+    if (FALSE == (srvptr->options & ReusePort))
+#else
+    if (srvptr->options & ReusePort)
+      FPX_WARN("SO_REUSEPORT is unavailable; using a single acceptor\n");
+#endif
+    {
+      int listen_socket = _create_listen_socket(&listen_addr, FALSE);
+      if (0 > listen_socket)
+        return -listen_socket;
 
-    meta->socket_4 = listen_socket;
-    meta->addr_4 = listen_addr;
+      meta->socket_4 = listen_socket;
+    }
 
     meta->is_listening = TRUE;
   }
@@ -516,7 +1212,19 @@ int fpx_httpserver_listen(fpx_httpserver_t *srvptr, const char *ip,
       t->thread_type = HttpThread;
       t->handler = _http_handle_client;
 
-      pthread_mutex_init(&t->loop_mutex, NULL);
+      t->listen_fd = -1;
+      if (-1 == meta->socket_4) {
+        // ReusePort; every HTTP thread accepts its own clients
+        t->listen_fd = _create_listen_socket(&meta->addr_4, TRUE);
+        if (0 > t->listen_fd)
+          return -t->listen_fd;
+      }
+
+      {
+        int err = _thread_init(t);
+        if (0 != err)
+          return err;
+      }
 
       if (0 != pthread_create(&t->thread, NULL, _thread_loop, t)) {
         int err = errno;
@@ -537,7 +1245,13 @@ int fpx_httpserver_listen(fpx_httpserver_t *srvptr, const char *ip,
       t->thread_type = WebSocketsThread;
       t->handler = _ws_handle_client;
 
-      pthread_mutex_init(&t->loop_mutex, NULL);
+      t->listen_fd = -1;
+
+      {
+        int err = _thread_init(t);
+        if (0 != err)
+          return err;
+      }
 
       if (0 != pthread_create(&t->thread, NULL, _thread_loop, t)) {
         int err = errno;
@@ -554,54 +1268,35 @@ int fpx_httpserver_listen(fpx_httpserver_t *srvptr, const char *ip,
               ntohs(srvptr->_internal->addr_4.sin_port));
   }
 
-  while (TRUE) {
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-    int client = accept(meta->socket_4, (struct sockaddr *)&client_addr,
-                        &client_addr_len);
-
-    {
-      FPX_DEBUG("connection accepted from %s:%hu\n",
-                inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-    }
-
-    int current_lowest = CLIENTS_DEFAULT;
-    struct _thread *lowest_thread = NULL;
-
-    for (int i = 0; i < srvptr->http_thread_count; ++i) {
-      struct _thread *t = &meta->http_threads[i];
+  if (-1 == meta->socket_4) {
+    // the HTTP threads do all the accepting;
+    // we block here until the server is closed, like the acceptor loop would
+    for (int i = 0; i < srvptr->http_thread_count; ++i)
+      pthread_join(meta->http_threads[i].thread, NULL);
 
-      pthread_mutex_lock(&t->loop_mutex);
-
-      if (t->connection_count < current_lowest) {
-        current_lowest = t->connection_count;
-        lowest_thread = t;
-      }
+    for (int i = 0; i < srvptr->ws_thread_count; ++i)
+      pthread_join(meta->ws_threads[i].thread, NULL);
 
-      pthread_mutex_unlock(&t->loop_mutex);
-    }
+    return 0;
+  }
 
-    if (current_lowest >= CLIENTS_DEFAULT) {
-      // server full; respond with 503 Service Unavailable
-      fpx_httpresponse_t res;
-      fpx_httpresponse_init(&res);
-      _apply_default_headers(srvptr, &res);
-      SET_HTTP_503(srvptr, res, "", 0);
-      fpx_httpresponse_add_header(&res, "retry-after", "60");
-      if (-10 == _send_response(NULL, &res, client)) {
-        // broken pipe
-      }
+  while (TRUE) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int client = _accept_socket(meta->socket_4, &client_addr, &client_addr_len);
 
-      FPX_WARN("Server full; connection refused\n");
+    if (0 > client)
       continue;
-    }
 
-    pthread_mutex_lock(&lowest_thread->loop_mutex);
+    struct _client_meta *client_meta =
+        _accept_client(srvptr, client, &client_addr);
 
-    if (0 == _add_client_to_thread(lowest_thread, client))
-      pthread_cond_signal(&lowest_thread->loop_condition);
+    if (NULL == client_meta)
+      continue;
 
-    pthread_mutex_unlock(&lowest_thread->loop_mutex);
+    _thread_hand_off(
+        _thread_reserve(meta->http_threads, srvptr->http_thread_count),
+        client_meta);
   }
 
   FPX_ERROR("wtf");
@@ -616,6 +1311,23 @@ int fpx_httpserver_close(fpx_httpserver_t *srvptr) {
 
   srvptr->_internal->is_listening = FALSE;
 
+#if !(defined(_WIN32) || defined(_WIN64))
+  {
+    // idle threads may be waiting without a timeout; wake them up so they
+    // notice that the server stopped
+    struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+    uint8_t byte = 0;
+
+    for (int i = 0; i < srvptr->http_thread_count; ++i)
+      if (-1 == write(meta->http_threads[i].wake_fds[1], &byte, 1)) {
+      }
+
+    for (int i = 0; i < srvptr->ws_thread_count; ++i)
+      if (-1 == write(meta->ws_threads[i].wake_fds[1], &byte, 1)) {
+      }
+  }
+#endif
+
   return 0;
 }
 
@@ -794,20 +1506,134 @@ static int _fix_endpoint_uri(const char *input, char *output, size_t maxlen) {
   return 0;
 }
 
-static int _endpoint_get(fpx_httpserver_t *srvptr, const char *uri) {
-  SRV_ASSERT(srvptr);
-
-  if (NULL == uri)
-    return -1;
-
-  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
-
-  char the_uri[sizeof(meta->endpoints->uri)] = {0};
+static int _create_listen_socket(struct sockaddr_in *addr,
+                                 uint8_t reuse_port) {
+  // returns the socket on success; -errno on failure
+  int listen_socket = socket(AF_INET, SOCK_STREAM, 0);
 
-  {
-    int fix_status = _fix_endpoint_uri(uri, the_uri, sizeof(the_uri) - 1);
-    if (0 > fix_status)
-      return fix_status;
+  if (listen_socket == -1) {
+    int err = errno;
+    perror("socket()");
+    return -err;
+  }
+
+  {
+    int one = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, (void *)&one,
+               sizeof(one));
+
+#if defined(SO_REUSEPORT) && !(defined(_WIN32) || defined(_WIN64))
+    if (reuse_port) {
+      if (-1 == setsockopt(listen_socket, SOL_SOCKET, SO_REUSEPORT,
+                           (void *)&one, sizeof(one))) {
+        int err = errno;
+        perror("setsockopt()");
+        close(listen_socket);
+        return -err;
+      }
+
+      // the owning thread accepts until EAGAIN
+      fcntl(listen_socket, F_SETFL, O_NONBLOCK);
+      fcntl(listen_socket, F_SETFD, FD_CLOEXEC);
+    }
+#else
+    UNUSED(reuse_port);
+#endif
+  }
+
+  if (-1 == bind(listen_socket, (struct sockaddr *)addr, sizeof(*addr))) {
+    int err = errno;
+    perror("bind()");
+    close(listen_socket);
+    return -err;
+  }
+
+  if (-1 == listen(listen_socket, 256)) {
+    int err = errno;
+    perror("listen()");
+    close(listen_socket);
+    return -err;
+  }
+
+  return listen_socket;
+}
+
+static int _accept_socket(int listen_fd, struct sockaddr_in *addr,
+                          socklen_t *addr_len) {
+  // responses (and sendfile() in particular) must never block the HTTP
+  // threads, so clients start out non-blocking; _upgrade_to_ws() undoes this
+#if defined(__linux__)
+  return accept4(listen_fd, (struct sockaddr *)addr, addr_len,
+                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  int fd = accept(listen_fd, (struct sockaddr *)addr, addr_len);
+
+#if !(defined(_WIN32) || defined(_WIN64))
+  if (0 <= fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+
+  return fd;
+#endif
+}
+
+static struct _client_meta *_accept_client(fpx_httpserver_t *srvptr, int fd,
+                                           struct sockaddr_in *addr) {
+  // returns NULL (after turning the client away) if the server is full
+
+  {
+    FPX_DEBUG("connection accepted from %s:%hu\n", inet_ntoa(addr->sin_addr),
+              ntohs(addr->sin_port));
+  }
+
+  struct _client_meta *client_meta = NULL;
+  if (0 == _connection_reserve(srvptr)) {
+    client_meta = (struct _client_meta *)calloc(1, sizeof(*client_meta));
+
+    if (NULL == client_meta)
+      _connection_release(srvptr);
+  }
+
+  if (NULL == client_meta) {
+    // server full; respond with 503 Service Unavailable
+    fpx_httpresponse_t res;
+    fpx_httpresponse_init(&res);
+    _apply_default_headers(srvptr, &res);
+    SET_HTTP_503(srvptr, res, "", 0);
+    fpx_httpresponse_add_header(&res, "retry-after", "60");
+    if (-10 == _send_response(NULL, &res, fd, NULL)) {
+      // broken pipe
+    }
+    fpx_httpresponse_destroy(&res);
+
+    close(fd);
+
+    FPX_WARN("Server full; connection refused\n");
+    return NULL;
+  }
+
+  client_meta->fd = fd;
+  fpx_memcpy(&client_meta->in_address, addr, sizeof(client_meta->in_address));
+
+  return client_meta;
+}
+
+static int _endpoint_get(fpx_httpserver_t *srvptr, const char *uri) {
+  SRV_ASSERT(srvptr);
+
+  if (NULL == uri)
+    return -1;
+
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+
+  char the_uri[sizeof(meta->endpoints->uri)] = {0};
+
+  {
+    int fix_status = _fix_endpoint_uri(uri, the_uri, sizeof(the_uri) - 1);
+    if (0 > fix_status)
+      return fix_status;
   }
 
   int available_endpoint = _available_endpoint_index(srvptr, the_uri);
@@ -817,6 +1643,13 @@ static int _endpoint_get(fpx_httpserver_t *srvptr, const char *uri) {
 
   struct _fpx_endpoint *ptr = &meta->endpoints[available_endpoint];
   if (FALSE == ptr->active) {
+    int route_status = _route_add(meta->routes, the_uri, available_endpoint);
+
+    if (-2 == route_status)
+      return -2;
+    if (0 > route_status)
+      return -5;
+
     fpx_memset(ptr, 0, sizeof(*ptr));
     fpx_strcpy(ptr->uri, the_uri);
     meta->active_endpoints++;
@@ -825,1119 +1658,3793 @@ static int _endpoint_get(fpx_httpserver_t *srvptr, const char *uri) {
   return available_endpoint;
 }
 
-static void _thread_init(struct _thread *t) {
-  {
-    int bytes = CLIENTS_DEFAULT * sizeof(struct pollfd);
-    t->pfds = (struct pollfd *)malloc(bytes);
-    fpx_memset(t->pfds, -1, bytes);
+static struct _route_node *_route_node_new(const char *segment, size_t len) {
+  struct _route_node *node =
+      (struct _route_node *)calloc(1, sizeof(struct _route_node));
+
+  if (NULL == node)
+    return NULL;
+
+  node->segment = (char *)malloc(len + 1);
+
+  if (NULL == node->segment) {
+    free(node);
+    return NULL;
   }
 
-  {
-    int bytes = CLIENTS_DEFAULT * sizeof(struct _client_meta);
-    t->client_data = (struct _client_meta *)malloc(bytes);
-    fpx_memset(t->client_data, -1, bytes);
+  fpx_memcpy(node->segment, segment, len);
+  node->segment[len] = 0;
+  node->segment_len = len;
+  node->endpoint = -1;
+
+  return node;
+}
+
+static int _route_add(struct _route_node *node, const char *pattern,
+                      int endpoint) {
+  // returns 0 on success, -2 on allocation failure, -5 if the pattern is
+  // malformed or conflicts with a route that already exists
+  const char *c = pattern;
+  int param_count = 0;
+
+  while (0 != *c) {
+    if ('/' != *c && c > pattern && '/' == c[-1] && (':' == *c || '*' == *c)) {
+      char kind = *c++;
+      const char *name = c;
+
+      while (0 != *c && '/' != *c)
+        ++c;
+
+      size_t name_len = c - name;
+
+      // wildcards swallow the rest of the path, so nothing may follow them
+      if ((':' == kind && 0 == name_len) || ('*' == kind && 0 != *c))
+        return -5;
+
+      if (++param_count > FPX_HTTP_MAX_PARAMS)
+        return -5;
+
+      struct _route_node **slot =
+          (':' == kind) ? &node->param : &node->wildcard;
+
+      if (NULL == *slot) {
+        *slot = _route_node_new(name, name_len);
+        if (NULL == *slot)
+          return -2;
+      } else if ((*slot)->segment_len != name_len ||
+                 0 != strncmp((*slot)->segment, name, name_len)) {
+        // "/users/:id" and "/users/:name" cannot both exist
+        return -5;
+      }
+
+      node = *slot;
+      continue;
+    }
+
+    // literal text, up to the next parameter
+    const char *end = c + 1;
+    while (0 != *end && !('/' == end[-1] && (':' == *end || '*' == *end)))
+      ++end;
+
+    node = _route_add_static(node, c, end - c);
+    if (NULL == node)
+      return -2;
+
+    c = end;
   }
 
-  return;
+  if (-1 != node->endpoint && endpoint != node->endpoint)
+    return -5;
+
+  node->endpoint = endpoint;
+
+  return 0;
 }
 
-static void *_thread_loop(void *tp) {
-  struct _thread *t = (struct _thread *)tp;
+static struct _route_node *_route_add_static(struct _route_node *node,
+                                             const char *segment, size_t len) {
+  while (len > 0) {
+    struct _route_node *child = NULL;
+    int i = 0;
+
+    for (; i < node->child_count; ++i) {
+      if (node->children[i]->segment[0] == segment[0]) {
+        child = node->children[i];
+        break;
+      }
+    }
 
-  _thread_init(t);
+    if (NULL == child) {
+      struct _route_node **grown = (struct _route_node **)realloc(
+          node->children, (node->child_count + 1) * sizeof(*grown));
 
-  while (t->server->_internal->is_listening) {
-    usleep(50); /* NOTE: i hate this <3 */         \
-                /* but it needs to be done */      \
-                /* because otherwise it regrabs */ \
-                /* the mutex too quickly */        \
-                                                   \
-    /* loop logic start */
-    pthread_mutex_lock(&t->loop_mutex);
+      if (NULL == grown)
+        return NULL;
 
-    if (t->connection_count < 1)
-      pthread_cond_wait(&t->loop_condition, &t->loop_mutex);
+      node->children = grown;
 
-    {
-      // if http_thread, check for keepalive
-      if (t->thread_type == HttpThread) {
-        for (int i = 0; i < t->connection_count; ++i) {
-          if ((time(NULL) - t->client_data[i].last_time) >
-              t->server->keepalive_timeout) {
-            FPX_DEBUG("Keepalive timeout reached\n");
-            _disconnect_client(t, i, TRUE);
-          }
-        }
+      child = _route_node_new(segment, len);
+      if (NULL == child)
+        return NULL;
+
+      node->children[node->child_count++] = child;
+      return child;
+    }
+
+    size_t common = 1;
+    while (common < len && common < child->segment_len &&
+           segment[common] == child->segment[common])
+      ++common;
+
+    if (common < child->segment_len) {
+      // split the child; the shared part becomes a node of its own
+      struct _route_node *upper = _route_node_new(segment, common);
+
+      if (NULL == upper)
+        return NULL;
+
+      upper->children =
+          (struct _route_node **)malloc(sizeof(*(upper->children)));
+
+      if (NULL == upper->children) {
+        free(upper->segment);
+        free(upper);
+        return NULL;
       }
 
-      if (t->thread_type == WebSocketsThread) {
-        for (int i = 0; i < t->connection_count; ++i) {
-          if ((time(NULL) - t->client_data[i].last_time) >
-              t->server->websockets_timeout) {
-            FPX_DEBUG("WebSocket timeout reached\n");
-            _disconnect_client(t, i, TRUE);
-          }
-        }
+      child->segment_len -= common;
+      memmove(child->segment, &child->segment[common], child->segment_len + 1);
+
+      upper->children[0] = child;
+      upper->child_count = 1;
+
+      node->children[i] = upper;
+      child = upper;
+    }
+
+    node = child;
+    segment += common;
+    len -= common;
+  }
+
+  return node;
+}
+
+static int _route_match(const struct _route_node *node, fpx_httprequest_t *req,
+                        size_t at, size_t end) {
+  // returns the endpoint index, or -1; literal routes win over parameters,
+  // which win over wildcards
+  if (at == end && -1 != node->endpoint)
+    return node->endpoint;
+
+  uint8_t param_count = req->param_count;
+
+  if (at < end) {
+    for (int i = 0; i < node->child_count; ++i) {
+      const struct _route_node *child = node->children[i];
+
+      if (child->segment[0] != req->uri[at])
+        continue;
+
+      if (child->segment_len <= end - at &&
+          0 == strncmp(child->segment, &req->uri[at], child->segment_len)) {
+        int found = _route_match(child, req, at + child->segment_len, end);
+        if (0 <= found)
+          return found;
       }
 
-      // do things
-      int available_clients;
-#if defined(_WIN32) || defined(_WIN64)
-      available_clients = WSAPoll(t->pfds, t->connection_count, 1000);
-#else
-      available_clients = poll(t->pfds, t->connection_count, 1000);
-#endif
+      break;
+    }
 
-      for (int i = 0, j = 0; i < t->connection_count && j < available_clients;
-           ++i) {
-        if (0 == t->pfds[i].revents)
-          continue;
-
-        if (t->pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-          // client disconnect
-          _disconnect_client(t, i, TRUE);
-        } else if (t->pfds[i].revents & POLLIN) {
-          // client has written
-          t->handler(t, i); // handler is either for HTTP or WebSockets
-        }
+    if (NULL != node->param) {
+      size_t value_end = at;
+      while (value_end < end && '/' != req->uri[value_end])
+        ++value_end;
+
+      if (value_end > at) {
+        struct _fpx_http_param *param = &req->params[param_count];
+        param->name = node->param->segment;
+        param->name_len = node->param->segment_len;
+        param->value = at;
+        param->value_len = value_end - at;
+        req->param_count = param_count + 1;
+
+        int found = _route_match(node->param, req, value_end, end);
+        if (0 <= found)
+          return found;
 
-        ++j;
+        req->param_count = param_count;
       }
     }
+  }
+
+  if (NULL != node->wildcard && -1 != node->wildcard->endpoint) {
+    struct _fpx_http_param *param = &req->params[param_count];
+    param->name = node->wildcard->segment;
+    param->name_len = node->wildcard->segment_len;
+    param->value = at;
+    param->value_len = end - at;
+    req->param_count = param_count + 1;
 
-    pthread_mutex_unlock(&t->loop_mutex);
+    return node->wildcard->endpoint;
   }
 
-  free(t->pfds);
-  free(t->client_data);
+  return -1;
+}
 
-  return NULL;
+static struct _fpx_endpoint *_route_lookup(fpx_httpserver_t *srvptr,
+                                           fpx_httprequest_t *reqptr) {
+  // the query string takes no part in routing
+  size_t end = 0;
+  while (0 != reqptr->uri[end] && '?' != reqptr->uri[end])
+    ++end;
+
+  reqptr->param_count = 0;
+
+  int found = _route_match(srvptr->_internal->routes, reqptr, 0, end);
+
+  if (0 > found) {
+    reqptr->param_count = 0;
+    return NULL;
+  }
+
+  return &srvptr->_internal->endpoints[found];
 }
 
-static int _add_client_to_thread(struct _thread *t, int client_fd) {
-  if (NULL == t)
-    return -1;
+static int _thread_init(struct _thread *t) {
+  t->epoll_fd = -1;
+  t->wake_fds[0] = t->wake_fds[1] = -1;
 
-  if (0 > client_fd)
-    return -2;
+  atomic_init(&t->load, 0);
 
-  if (CLIENTS_DEFAULT <= t->connection_count)
-    return -3;
+  fpx_memset(t->wheel, 0, sizeof(t->wheel));
+  t->wheel_tick = _monotonic_ms() / TIMER_TICK_MS;
 
-  struct pollfd *pfd = &t->pfds[t->connection_count];
-  struct _client_meta *client_meta = &t->client_data[t->connection_count];
+  t->spare_count = 0;
 
-  fpx_memset(pfd, 0, sizeof(struct pollfd));
-  pfd->fd = client_fd;
-  pfd->events = POLLIN;
+  t->inbox = t->inbox_tail = NULL;
 
-  fpx_memset(client_meta, 0, sizeof(*client_meta));
+  fpx_memset(t->topics, 0, sizeof(t->topics));
+  t->delivering = NULL;
 
-  time(&client_meta->last_time);
+  t->capacity = CLIENTS_DEFAULT;
+  t->pending_capacity = CLIENTS_DEFAULT;
 
-  return t->connection_count++;
-}
+  t->clients = (struct _client_meta **)calloc(CLIENTS_DEFAULT,
+                                              sizeof(struct _client_meta *));
+  t->pending = (struct _client_meta **)calloc(CLIENTS_DEFAULT,
+                                              sizeof(struct _client_meta *));
 
-static void _on_response_ready(struct _thread *thread,
-                               fpx_httprequest_t *reqptr,
-                               fpx_httpresponse_t *resptr, int idx) {
-  char method[16] = {0};
+  {
+    // extra entries for the wakeup pipe and the listening socket
+    int bytes = (CLIENTS_DEFAULT + 2) * sizeof(struct pollfd);
+    t->pfds = (struct pollfd *)malloc(bytes);
+    if (NULL != t->pfds)
+      fpx_memset(t->pfds, -1, bytes);
+  }
 
-  switch (reqptr->method) {
-  case HTTP_NONE:
-    fpx_strcpy(method, "NONE");
-    break;
-  case HTTP_OPTIONS:
-    fpx_strcpy(method, "OPTIONS");
-    break;
-  case HTTP_GET:
-    fpx_strcpy(method, "GET");
-    break;
-  case HTTP_HEAD:
-    fpx_strcpy(method, "HEAD");
-    break;
-  case HTTP_POST:
-    fpx_strcpy(method, "POST");
-    break;
-  case HTTP_PUT:
-    fpx_strcpy(method, "PUT");
-    break;
-  case HTTP_PATCH:
-    fpx_strcpy(method, "PATCH");
-    break;
-  case HTTP_DELETE:
-    fpx_strcpy(method, "DELETE");
-    break;
-  case HTTP_CONNECT:
-    fpx_strcpy(method, "CONNECT");
-    break;
-  case HTTP_TRACE:
-    fpx_strcpy(method, "TRACE");
-    break;
+  if (NULL == t->clients || NULL == t->pending || NULL == t->pfds)
+    return ENOMEM;
 
-  case HTTP_ERROR:
-    fpx_strcpy(method, "ERROR");
-    break;
+  pthread_mutex_init(&t->loop_mutex, NULL);
+
+#if !(defined(_WIN32) || defined(_WIN64))
+  if (-1 == pipe(t->wake_fds)) {
+    int err = errno;
+    perror("pipe()");
+    return err;
   }
 
-  /* debug print */
-  FPX_DEBUG("%hu | %s | %s | HTTP/%s\n", resptr->status, method, reqptr->uri,
-            reqptr->content.version);
+  fcntl(t->wake_fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(t->wake_fds[1], F_SETFL, O_NONBLOCK);
+#endif
 
-  uint16_t s = resptr->status;
-  uint8_t add_close_header = (s == 429);
+#if defined(__linux__)
+  if (EpollBackend == t->server->backend) {
+    t->epoll_fd = epoll_create1(0);
 
-  uint8_t closing = add_close_header;
+    if (-1 == t->epoll_fd) {
+      int err = errno;
+      perror("epoll_create1()");
+      return err;
+    }
 
-  {
-    char header_val[32] = {0};
-    if (-2 == fpx_httpresponse_get_header(resptr, "connection", header_val,
-                                          sizeof(header_val) - 1)) {
-      // there is no connection header set in the response yet, so we do so now
-      if (add_close_header)
-        fpx_httpresponse_add_header(resptr, "connection", "close");
-      else {
-        fpx_httpresponse_add_header(resptr, "connection", "keep-alive");
-        fpx_httpresponse_add_header(resptr, "keep-alive",
-                                    STR(KEEPALIVE_SECONDS));
+    // a NULL data pointer marks the wakeup pipe
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (-1 == epoll_ctl(t->epoll_fd, EPOLL_CTL_ADD, t->wake_fds[0], &ev)) {
+      int err = errno;
+      perror("epoll_ctl()");
+      return err;
+    }
+
+    // and a pointer to the thread itself marks the listening socket
+    if (-1 != t->listen_fd) {
+      ev.events = EPOLLIN | EPOLLET;
+      ev.data.ptr = t;
+
+      if (-1 == epoll_ctl(t->epoll_fd, EPOLL_CTL_ADD, t->listen_fd, &ev)) {
+        int err = errno;
+        perror("epoll_ctl()");
+        return err;
       }
-    } else {
-      closing = (0 == strcmp(header_val, "close"));
     }
   }
+#endif
+
+  return 0;
+}
+
+static void _thread_destroy(struct _thread *t) {
+  while (t->connection_count > 0)
+    _disconnect_client(t, t->connection_count - 1, TRUE);
+
+  pthread_mutex_lock(&t->loop_mutex);
+  for (int i = 0; i < t->pending_count; ++i) {
+    close(t->pending[i]->fd);
+    free(t->pending[i]);
+    _connection_release(t->server);
+  }
+  t->pending_count = 0;
+
+  while (NULL != t->inbox) {
+    struct _ws_command *next = t->inbox->next;
+
+    if (NULL != t->inbox->message)
+      _ws_broadcast_release(t->inbox->message);
+
+    if (NULL != t->inbox->deflated)
+      _ws_broadcast_release(t->inbox->deflated);
+
+    free(t->inbox);
+    t->inbox = next;
+  }
+  t->inbox_tail = NULL;
+  pthread_mutex_unlock(&t->loop_mutex);
+
+  // all clients are gone, and with them all topics; this is just in case
+  for (int i = 0; i < TOPIC_BUCKETS; ++i)
+    while (NULL != t->topics[i])
+      _topic_drop(t, t->topics[i]);
+
+  if (-1 != t->epoll_fd)
+    close(t->epoll_fd);
+
+  if (-1 != t->listen_fd)
+    close(t->listen_fd);
+
+  if (-1 != t->wake_fds[0]) {
+    close(t->wake_fds[0]);
+    close(t->wake_fds[1]);
+  }
+
+  for (int i = 0; i < t->spare_count; ++i) {
+    fpx_httpparser_destroy(t->spare_parsers[i]);
+    free(t->spare_parsers[i]);
+
+    if (NULL != t->spare_arenas[i])
+      fpx_arena_destroy(t->spare_arenas[i]);
+  }
+  t->spare_count = 0;
+
+  for (size_t i = 0; i < sizeof(t->deflaters) / sizeof(*t->deflaters); ++i) {
+    if (NULL != t->deflaters[i]) {
+      fpx_deflate_destroy(t->deflaters[i]);
+      free(t->deflaters[i]);
+      t->deflaters[i] = NULL;
+    }
+  }
+
+  free(t->pfds);
+  free(t->clients);
+  free(t->pending);
+
+  return;
+}
+
+static void *_thread_loop(void *tp) {
+  struct _thread *t = (struct _thread *)tp;
+
+  while (t->server->_internal->is_listening) {
+    _thread_expire(t, _monotonic_ms());
+
+    if (t->accept_paused)
+      _thread_accept(t);
+
+#if defined(__linux__)
+    if (-1 != t->epoll_fd) {
+      _thread_epoll(t);
+      continue;
+    }
+#endif
+
+    _thread_poll(t);
+  }
+
+  _thread_destroy(t);
+
+  return NULL;
+}
+
+static void _thread_poll(struct _thread *t) {
+  int available_clients;
+  uint8_t woken;
+  uint8_t incoming = FALSE;
+
+#if defined(_WIN32) || defined(_WIN64)
+  // there is no wakeup pipe on windows,
+  // so we check for new clients every 10 ms instead
+  if (t->connection_count < 1) {
+    usleep(10000);
+    available_clients = 0;
+  } else {
+    available_clients = WSAPoll(t->pfds, t->connection_count, 10);
+  }
+
+  woken = TRUE;
+#else
+  struct pollfd *wake = &t->pfds[t->connection_count];
+  wake->fd = t->wake_fds[0];
+  wake->events = POLLIN;
+  wake->revents = 0;
+
+  struct pollfd *listener = wake + 1;
+  listener->fd = t->listen_fd;
+  // a paused listener would report POLLIN until descriptors free up
+  listener->events = t->accept_paused ? 0 : POLLIN;
+  listener->revents = 0;
+
+  available_clients =
+      poll(t->pfds, t->connection_count + ((-1 == t->listen_fd) ? 1 : 2),
+           _thread_next_timeout(t, _monotonic_ms()));
+
+  // read these now; the entries get overwritten as clients disconnect
+  woken = (0 != wake->revents);
+  incoming = (0 != listener->revents);
+#endif
+
+  // walk backwards, so that disconnecting a client does not skip another
+  for (int i = t->connection_count - 1; i >= 0 && available_clients > 0; --i) {
+    short revents = t->pfds[i].revents;
+
+    if (0 == revents)
+      continue;
+
+    if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      // client disconnect
+      _disconnect_client(t, i, TRUE);
+      continue;
+    }
+
+    if ((revents & POLLOUT) && HANDLER_GONE == _flush_client(t, t->clients[i]))
+      continue;
+
+    if (revents & POLLIN) {
+      // client has written
+      t->handler(t, i); // handler is either for HTTP or WebSockets
+    }
+  }
+
+  if (woken)
+    _thread_take_pending(t);
+
+  if (incoming)
+    _thread_accept(t);
+
+  return;
+}
+
+#if defined(__linux__)
+static void _thread_epoll(struct _thread *t) {
+  struct epoll_event events[EVENTS_PER_WAKEUP];
+
+  int available = epoll_wait(t->epoll_fd, events, EVENTS_PER_WAKEUP,
+                             _thread_next_timeout(t, _monotonic_ms()));
+
+  uint8_t woken = FALSE;
+  uint8_t incoming = FALSE;
+
+  for (int i = 0; i < available; ++i) {
+    struct _client_meta *client = (struct _client_meta *)events[i].data.ptr;
+
+    if (NULL == client) {
+      woken = TRUE;
+      continue;
+    }
+
+    if ((void *)t == (void *)client) {
+      incoming = TRUE;
+      continue;
+    }
+
+    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+      // client disconnect
+      _disconnect_client(t, client->slot, TRUE);
+      continue;
+    }
+
+    if ((events[i].events & EPOLLOUT) &&
+        HANDLER_GONE == _flush_client(t, client))
+      continue;
+
+    // the descriptor is edge-triggered, so we keep going until the handler
+    // has drained it (or has gotten rid of the client)
+    if (events[i].events & EPOLLIN)
+      while (HANDLER_AGAIN == t->handler(t, client->slot))
+        ;
+  }
+
+  if (woken)
+    _thread_take_pending(t);
+
+  if (incoming)
+    _thread_accept(t);
+
+  return;
+}
+#endif
+
+static void _thread_expire(struct _thread *t, uint64_t now) {
+  uint64_t now_tick = now / TIMER_TICK_MS;
+
+  if (now_tick < t->wheel_tick)
+    return;
+
+  // after a long sleep, one turn of the wheel visits every slot
+  if (now_tick - t->wheel_tick >= TIMER_SLOTS)
+    t->wheel_tick = now_tick - (TIMER_SLOTS - 1);
+
+  for (; t->wheel_tick <= now_tick; ++t->wheel_tick) {
+    struct _client_meta *client = t->wheel[t->wheel_tick % TIMER_SLOTS];
+
+    while (NULL != client) {
+      struct _client_meta *next = client->timer_next;
+
+      // entries for a later turn of the wheel share the slot; leave those
+      if (client->deadline <= now) {
+        FPX_DEBUG("%s timeout reached\n",
+                  (HttpThread == t->thread_type) ? "Keepalive" : "WebSocket");
+        _disconnect_client(t, client->slot, TRUE);
+      }
+
+      client = next;
+    }
+  }
+
+  return;
+}
+
+static int _thread_next_timeout(struct _thread *t, uint64_t now) {
+  // milliseconds until the first occupied slot is due; -1 if there are none.
+  // a paused listener is retried at least once every tick
+  int timeout = t->accept_paused ? TIMER_TICK_MS : -1;
+
+  for (uint64_t tick = t->wheel_tick; tick < t->wheel_tick + TIMER_SLOTS;
+       ++tick) {
+    if (NULL == t->wheel[tick % TIMER_SLOTS])
+      continue;
+
+    uint64_t due = tick * TIMER_TICK_MS;
+    if (due <= now)
+      return 0;
+
+    if (-1 == timeout || due - now < (uint64_t)timeout)
+      timeout = (int)(due - now);
+    break;
+  }
+
+  return timeout;
+}
+
+static void _timer_schedule(struct _thread *t, struct _client_meta *client) {
+  // (re)arms the idle timeout of a client; called on every bit of activity
+  uint32_t timeout = (HttpThread == t->thread_type)
+                         ? t->server->keepalive_timeout
+                         : t->server->websockets_timeout;
+
+  _timer_unlink(client);
+
+  client->deadline = _monotonic_ms() + (uint64_t)timeout * 1000;
+
+  // round up, so the slot never comes due before the deadline does
+  uint64_t tick = (client->deadline + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+  struct _client_meta **head = &t->wheel[tick % TIMER_SLOTS];
+
+  client->timer_next = *head;
+  client->timer_pprev = head;
+
+  if (NULL != *head)
+    (*head)->timer_pprev = &client->timer_next;
+
+  *head = client;
+
+  return;
+}
+
+static void _timer_unlink(struct _client_meta *client) {
+  if (NULL == client->timer_pprev)
+    return;
+
+  *client->timer_pprev = client->timer_next;
+
+  if (NULL != client->timer_next)
+    client->timer_next->timer_pprev = client->timer_pprev;
+
+  client->timer_next = NULL;
+  client->timer_pprev = NULL;
+
+  return;
+}
+
+static uint64_t _monotonic_ms(void) {
+#if defined(_WIN32) || defined(_WIN64)
+  return GetTickCount64();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static void _thread_take_pending(struct _thread *t) {
+#if !(defined(_WIN32) || defined(_WIN64))
+  {
+    // empty the wakeup pipe
+    char drain[64];
+    while (0 < read(t->wake_fds[0], drain, sizeof(drain)))
+      ;
+  }
+#endif
+
+  pthread_mutex_lock(&t->loop_mutex);
+
+  for (int i = 0; i < t->pending_count; ++i) {
+    struct _client_meta *client = t->pending[i];
+
+    if (0 > _add_client_to_thread(t, client)) {
+      _ws_owner_clear(t->server, client);
+      close(client->fd);
+      free(client);
+      atomic_fetch_sub(&t->load, 1);
+      _connection_release(t->server);
+    }
+  }
+
+  t->pending_count = 0;
+
+  struct _ws_command *commands = t->inbox;
+  t->inbox = t->inbox_tail = NULL;
+
+  pthread_mutex_unlock(&t->loop_mutex);
+
+  // in the order they were posted in
+  while (NULL != commands) {
+    struct _ws_command *next = commands->next;
+    _ws_command_run(t, commands);
+    commands = next;
+  }
+
+  return;
+}
+
+static void _thread_accept(struct _thread *t) {
+  // ReusePort only; accept everything the kernel queued on our own socket
+  while (TRUE) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    int client = _accept_socket(t->listen_fd, &client_addr, &client_addr_len);
+
+    if (0 > client) {
+      if (EINTR == errno || ECONNABORTED == errno)
+        continue;
+
+      // the queue is not empty, and no new edge is coming for it
+      t->accept_paused = (EMFILE == errno || ENFILE == errno ||
+                          ENOBUFS == errno || ENOMEM == errno);
+      return;
+    }
+
+    t->accept_paused = FALSE;
+
+    struct _client_meta *client_meta =
+        _accept_client(t->server, client, &client_addr);
+
+    if (NULL == client_meta)
+      continue;
+
+    atomic_fetch_add(&t->load, 1);
+
+    if (0 > _add_client_to_thread(t, client_meta)) {
+      close(client_meta->fd);
+      free(client_meta);
+      atomic_fetch_sub(&t->load, 1);
+      _connection_release(t->server);
+    }
+  }
+}
+
+static struct _thread *_thread_reserve(struct _thread *threads, int count) {
+  // claims a connection slot on the least loaded thread
+  struct _thread *lowest_thread = &threads[0];
+  int lowest_load =
+      atomic_load_explicit(&lowest_thread->load, memory_order_relaxed);
+
+  for (int i = 1; i < count; ++i) {
+    int load = atomic_load_explicit(&threads[i].load, memory_order_relaxed);
+
+    if (load < lowest_load) {
+      lowest_load = load;
+      lowest_thread = &threads[i];
+    }
+  }
+
+  atomic_fetch_add(&lowest_thread->load, 1);
+
+  return lowest_thread;
+}
+
+static int _thread_grow(struct _thread *t) {
+  // doubles the client tables; only ever called by the owning thread
+  int new_capacity = t->capacity * 2;
+
+  struct _client_meta **new_clients = (struct _client_meta **)realloc(
+      t->clients, new_capacity * sizeof(struct _client_meta *));
+  if (NULL == new_clients)
+    return -1;
+
+  t->clients = new_clients;
+
+  // extra entries for the wakeup pipe and the listening socket
+  struct pollfd *new_pfds = (struct pollfd *)realloc(
+      t->pfds, (new_capacity + 2) * sizeof(struct pollfd));
+  if (NULL == new_pfds)
+    return -1;
+
+  t->pfds = new_pfds;
+  t->capacity = new_capacity;
+
+  return 0;
+}
+
+static int _connection_reserve(fpx_httpserver_t *srvptr) {
+  // returns 0 if the client fits under max_connections; -1 otherwise
+  atomic_uint *connections = &srvptr->_internal->connections;
+  unsigned int current = atomic_load_explicit(connections, memory_order_relaxed);
+
+  do {
+    if (0 != srvptr->max_connections && current >= srvptr->max_connections)
+      return -1;
+  } while (!atomic_compare_exchange_weak(connections, &current, current + 1));
+
+  return 0;
+}
+
+static void _connection_release(fpx_httpserver_t *srvptr) {
+  atomic_fetch_sub(&srvptr->_internal->connections, 1);
+}
+
+static void _thread_hand_off(struct _thread *t, struct _client_meta *client) {
+  pthread_mutex_lock(&t->loop_mutex);
+
+  if (t->pending_count >= t->pending_capacity) {
+    int new_capacity = t->pending_capacity * 2;
+    struct _client_meta **new_pending = (struct _client_meta **)realloc(
+        t->pending, new_capacity * sizeof(struct _client_meta *));
+
+    if (NULL == new_pending) {
+      pthread_mutex_unlock(&t->loop_mutex);
+
+      _ws_owner_clear(t->server, client);
+      close(client->fd);
+      free(client);
+      atomic_fetch_sub(&t->load, 1);
+      _connection_release(t->server);
+      return;
+    }
+
+    t->pending = new_pending;
+    t->pending_capacity = new_capacity;
+  }
+
+  t->pending[t->pending_count++] = client;
+
+  pthread_mutex_unlock(&t->loop_mutex);
+
+#if !(defined(_WIN32) || defined(_WIN64))
+  uint8_t byte = 0;
+  if (-1 == write(t->wake_fds[1], &byte, 1)) {
+    // pipe full; the thread has a wakeup coming already
+  }
+#endif
+
+  return;
+}
+
+static int _add_client_to_thread(struct _thread *t,
+                                 struct _client_meta *client) {
+  if (NULL == t || NULL == client)
+    return -1;
+
+  if (0 > client->fd)
+    return -2;
+
+  if (t->capacity <= t->connection_count && 0 > _thread_grow(t))
+    return -3;
+
+#if defined(__linux__)
+  if (-1 != t->epoll_fd) {
+    // EPOLLOUT is edge-triggered too, so it only fires when a full socket
+    // buffer frees up; that is exactly when pending output can continue
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET,
+                             .data.ptr = client};
+
+    if (-1 == epoll_ctl(t->epoll_fd, EPOLL_CTL_ADD, client->fd, &ev))
+      return -4;
+  }
+#endif
+
+  struct pollfd *pfd = &t->pfds[t->connection_count];
+
+  fpx_memset(pfd, 0, sizeof(struct pollfd));
+  pfd->fd = client->fd;
+  pfd->events = POLLIN;
+
+  client->slot = t->connection_count;
+
+  if (NULL != client->output.head)
+    pfd->events |= POLLOUT;
+  t->clients[t->connection_count] = client;
+
+  _timer_schedule(t, client);
+
+  return t->connection_count++;
+}
+
+static int _on_response_ready(struct _thread *thread, fpx_httprequest_t *reqptr,
+                              fpx_httpresponse_t *resptr, int idx,
+                              struct _file_body *file) {
+  struct _client_meta *client = thread->clients[idx];
+
+  char method[16] = {0};
+
+  switch (reqptr->method) {
+  case HTTP_NONE:
+    fpx_strcpy(method, "NONE");
+    break;
+  case HTTP_OPTIONS:
+    fpx_strcpy(method, "OPTIONS");
+    break;
+  case HTTP_GET:
+    fpx_strcpy(method, "GET");
+    break;
+  case HTTP_HEAD:
+    fpx_strcpy(method, "HEAD");
+    break;
+  case HTTP_POST:
+    fpx_strcpy(method, "POST");
+    break;
+  case HTTP_PUT:
+    fpx_strcpy(method, "PUT");
+    break;
+  case HTTP_PATCH:
+    fpx_strcpy(method, "PATCH");
+    break;
+  case HTTP_DELETE:
+    fpx_strcpy(method, "DELETE");
+    break;
+  case HTTP_CONNECT:
+    fpx_strcpy(method, "CONNECT");
+    break;
+  case HTTP_TRACE:
+    fpx_strcpy(method, "TRACE");
+    break;
+
+  case HTTP_ERROR:
+    fpx_strcpy(method, "ERROR");
+    break;
+  }
+
+  /* debug print */
+  FPX_DEBUG("%hu | %s | %s | HTTP/%s\n", resptr->status, method, reqptr->uri,
+            reqptr->content.version);
+
+  uint16_t s = resptr->status;
+  uint8_t add_close_header = (s == 429);
+
+  uint8_t closing = add_close_header;
+
+  {
+    char header_val[32] = {0};
+    if (-2 == fpx_httpresponse_get_header(resptr, "connection", header_val,
+                                          sizeof(header_val) - 1)) {
+      // there is no connection header set in the response yet, so we do so now
+      if (add_close_header)
+        fpx_httpresponse_add_header(resptr, "connection", "close");
+      else {
+        fpx_httpresponse_add_header(resptr, "connection", "keep-alive");
+        fpx_httpresponse_add_header(resptr, "keep-alive",
+                                    STR(KEEPALIVE_SECONDS));
+      }
+    } else {
+      closing = (0 == strcmp(header_val, "close"));
+    }
+  }
+
+  if (0 > _send_response(reqptr, resptr, client->fd, &client->output)) {
+    // broken pipe, or the client is not reading its responses
+    _pending_free(&client->output);
+    closing = TRUE;
+  } else if (NULL != file && -1 != file->fd) {
+    // the file body goes right after the headers
+    if (0 > _pending_append_file(&client->output, file) ||
+        0 > _pending_flush(&client->output, client->fd)) {
+      _pending_free(&client->output);
+      closing = TRUE;
+    }
+  }
+
+  if (NULL != file && -1 != file->fd) {
+    close(file->fd);
+    file->fd = -1;
+  }
+
+  _timer_schedule(thread, client);
+
+  fpx_httprequest_destroy(reqptr);
+  fpx_httpresponse_destroy(resptr);
+
+  // whatever still has to be sent was copied; the arena can be reused
+  if (NULL != client->arena)
+    fpx_arena_reset(client->arena);
+
+  if (NULL != client->output.head) {
+    // the rest goes out once the socket is writable again
+    _watch_writable(thread, client, TRUE);
+
+    if (closing) {
+      client->close_after_flush = TRUE;
+      return HANDLER_DRAINED;
+    }
+  }
+
+  if (closing) {
+    FPX_DEBUG("Disconnecting client %d in thread %" LONG_FORMAT "u\n", idx,
+              thread->thread);
+    _disconnect_client(thread, idx, TRUE);
+    return HANDLER_GONE;
+  }
+
+  return HANDLER_AGAIN;
+}
+
+static void _handle_http_endpoint(struct _thread *thread,
+                                  fpx_httprequest_t *reqptr,
+                                  fpx_httpresponse_t *resptr,
+                                  struct _file_body *file) {
+  // check for endpoints
+  struct _fpx_endpoint *endpoint = _route_lookup(thread->server, reqptr);
+
+  if (NULL != endpoint && 0 != endpoint->directory[0]) {
+    // matched either the URI itself or its "/*path" route; in the latter case
+    // the path starts at the '/' in front of the capture
+    const char *static_path = "";
+    const char *value;
+    size_t value_len;
+
+    if (0 == fpx_httprequest_get_param(reqptr, "path", &value, &value_len))
+      static_path = value - 1;
+
+    _serve_static(endpoint, static_path, reqptr, resptr, file);
+    return;
+  }
+
+  // check wether to use the default endpoint
+  if (FALSE != thread->server->_internal->default_endpoint.active &&
+      NULL == endpoint) {
+    endpoint = &thread->server->_internal->default_endpoint;
+  }
+
+  if (NULL == endpoint || NULL == endpoint->http_callback) {
+    // 404
+    SET_HTTP_404(thread->server, (*resptr), "", 0);
+  } else if (!(endpoint->allowed_methods & reqptr->method)) {
+    // 405 | method not allowed
+    // TODO: add allowed methods into the response body
+    SET_HTTP_405(thread->server, (*resptr), "", 0);
+  } else {
+    // :thumbsup:
+    SET_HTTP_200(thread->server, (*resptr), "", 0);
+    endpoint->http_callback(reqptr, resptr);
+  }
+
+  return;
+}
+
+static void _serve_static(struct _fpx_endpoint *endpoint, const char *uri_path,
+                          fpx_httprequest_t *reqptr, fpx_httpresponse_t *resptr,
+                          struct _file_body *file) {
+#if defined(_WIN32) || defined(_WIN64)
+  UNUSED(endpoint);
+  UNUSED(uri_path);
+  UNUSED(reqptr);
+  UNUSED(file);
+
+  SET_HTTP_404(NULL, (*resptr), "", 0);
+#else
+  if (!(endpoint->allowed_methods & reqptr->method)) {
+    SET_HTTP_405(NULL, (*resptr), "", 0);
+    fpx_httpresponse_add_header(resptr, "allow", "GET, HEAD");
+    return;
+  }
+
+  char path[PATH_MAX];
+  struct stat info;
+  int fd = -1;
+
+  if (0 == _static_resolve_path(endpoint->directory, uri_path, path,
+                                sizeof(path)))
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (-1 != fd && 0 == fstat(fd, &info) && S_ISDIR(info.st_mode)) {
+    // a directory; serve its index instead
+    close(fd);
+    fd = -1;
+
+    size_t len = fpx_getstringlength(path);
+    const char index[] = "/index.html";
+
+    if (len + sizeof(index) <= sizeof(path)) {
+      fpx_memcpy(&path[len], index, sizeof(index));
+      fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+
+    if (-1 != fd && 0 != fstat(fd, &info))
+      info.st_mode = 0;
+  }
+
+  if (-1 == fd || !S_ISREG(info.st_mode)) {
+    if (-1 != fd)
+      close(fd);
+
+    SET_HTTP_404(NULL, (*resptr), "", 0);
+    return;
+  }
+
+  uint64_t size = info.st_size;
+
+  // validators
+  char etag[48];
+  char last_modified[32];
+  {
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)size,
+             (unsigned long long)info.st_mtime);
+
+    struct tm modified;
+    gmtime_r(&info.st_mtime, &modified);
+    strftime(last_modified, sizeof(last_modified),
+             "%a, %d %b %Y %H:%M:%S GMT", &modified);
+  }
+
+  char header_val[256];
+  uint8_t not_modified = FALSE;
+
+  if (0 == fpx_httprequest_get_header(reqptr, "if-none-match", header_val,
+                                      sizeof(header_val) - 1)) {
+    not_modified = _static_etag_matches(header_val, etag);
+  } else if (0 == fpx_httprequest_get_header(reqptr, "if-modified-since",
+                                             header_val,
+                                             sizeof(header_val) - 1)) {
+    // clients echo our own Last-Modified back, so an exact match is enough;
+    // anything else just gets the full file
+    not_modified = (0 == strcmp(header_val, last_modified));
+  }
+
+  uint64_t first = 0, last = (size > 0) ? size - 1 : 0;
+  uint16_t status = 200;
+
+  if (not_modified) {
+    status = 304;
+  } else if (0 == fpx_httprequest_get_header(reqptr, "range", header_val,
+                                             sizeof(header_val) - 1)) {
+    char if_range[64];
+
+    // a stale If-Range means the client wants the whole (new) file
+    if (0 != fpx_httprequest_get_header(reqptr, "if-range", if_range,
+                                        sizeof(if_range) - 1) ||
+        0 == strcmp(if_range, etag) || 0 == strcmp(if_range, last_modified)) {
+      int range = _static_parse_range(header_val, size, &first, &last);
+
+      if (1 == range)
+        status = 206;
+      else if (-1 == range)
+        status = 416;
+    }
+  }
+
+  char number[64];
+
+  switch (status) {
+  case 304:
+    SET_HTTP_304(NULL, (*resptr), "", 0);
+    break;
+
+  case 416:
+    close(fd);
+
+    SET_HTTP_416(NULL, (*resptr), "", 0);
+    snprintf(number, sizeof(number), "bytes */%llu", (unsigned long long)size);
+    fpx_httpresponse_add_header(resptr, "content-range", number);
+    return;
+
+  case 206:
+    SET_HTTP_206(NULL, (*resptr), "", 0);
+    snprintf(number, sizeof(number), "bytes %llu-%llu/%llu",
+             (unsigned long long)first, (unsigned long long)last,
+             (unsigned long long)size);
+    fpx_httpresponse_add_header(resptr, "content-range", number);
+    break;
+
+  default:
+    SET_HTTP_200(NULL, (*resptr), "", 0);
+    break;
+  }
+
+  uint64_t length = (0 == size) ? 0 : last - first + 1;
+
+  // the body is left empty; _send_response() sends the headers as they are
+  // and the file follows them
+  fpx_uint64str(length, number, sizeof(number));
+  fpx_httpresponse_add_header(resptr, "content-length", number);
+  fpx_httpresponse_add_header(resptr, "content-type",
+                              _static_content_type(path));
+  fpx_httpresponse_add_header(resptr, "etag", etag);
+  fpx_httpresponse_add_header(resptr, "last-modified", last_modified);
+  fpx_httpresponse_add_header(resptr, "accept-ranges", "bytes");
+
+  if (304 == status || 0 == length || (reqptr->method & HTTP_HEAD)) {
+    close(fd);
+    return;
+  }
+
+  file->fd = fd;
+  file->offset = first;
+  file->length = length;
+#endif
+
+  return;
+}
+
+#if !(defined(_WIN32) || defined(_WIN64))
+static int _static_resolve_path(const char *directory, const char *uri_path,
+                                char *out, size_t out_len) {
+  // percent-decodes `uri_path` (up to any query string) onto `directory`;
+  // returns -1 if the path is too long, contains a ".." segment or a NUL
+  size_t len = fpx_getstringlength(directory);
+
+  if (len >= out_len)
+    return -1;
+
+  fpx_memcpy(out, directory, len);
+
+  size_t segment_start = len;
+
+  for (const char *c = uri_path; 0 != *c && '?' != *c && '#' != *c; ++c) {
+    char decoded = *c;
+
+    if ('%' == *c) {
+      int value = 0;
+
+      for (int i = 1; i <= 2; ++i) {
+        char h = c[i];
+        value <<= 4;
+
+        if (h >= '0' && h <= '9')
+          value |= h - '0';
+        else if (h >= 'a' && h <= 'f')
+          value |= h - 'a' + 10;
+        else if (h >= 'A' && h <= 'F')
+          value |= h - 'A' + 10;
+        else
+          return -1;
+      }
+
+      if (0 == value)
+        return -1;
+
+      decoded = (char)value;
+      c += 2;
+    }
+
+    if ('/' == decoded) {
+      if (len - segment_start == 2 &&
+          0 == strncmp(&out[segment_start], "..", 2))
+        return -1;
+
+      segment_start = len + 1;
+    }
+
+    if (len + 1 >= out_len)
+      return -1;
+
+    out[len++] = decoded;
+  }
+
+  if (len - segment_start == 2 && 0 == strncmp(&out[segment_start], "..", 2))
+    return -1;
+
+  out[len] = 0;
+
+  return 0;
+}
+
+static const char *_static_content_type(const char *path) {
+  static const struct {
+    const char *extension;
+    const char *type;
+  } types[] = {
+      {"html", "text/html; charset=utf-8"},
+      {"htm", "text/html; charset=utf-8"},
+      {"css", "text/css; charset=utf-8"},
+      {"js", "text/javascript; charset=utf-8"},
+      {"mjs", "text/javascript; charset=utf-8"},
+      {"json", "application/json"},
+      {"txt", "text/plain; charset=utf-8"},
+      {"xml", "application/xml"},
+      {"svg", "image/svg+xml"},
+      {"png", "image/png"},
+      {"jpg", "image/jpeg"},
+      {"jpeg", "image/jpeg"},
+      {"gif", "image/gif"},
+      {"webp", "image/webp"},
+      {"ico", "image/x-icon"},
+      {"wasm", "application/wasm"},
+      {"pdf", "application/pdf"},
+      {"woff", "font/woff"},
+      {"woff2", "font/woff2"},
+  };
+
+  const char *extension = strrchr(path, '.');
+
+  if (NULL != extension && NULL == strchr(extension, '/')) {
+    ++extension;
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+      if (0 == strcasecmp(extension, types[i].extension))
+        return types[i].type;
+  }
+
+  return "application/octet-stream";
+}
+
+static int _static_etag_matches(const char *if_none_match, const char *etag) {
+  // If-None-Match is "*" or a comma separated list; compared weakly
+  size_t etag_len = fpx_getstringlength(etag);
+  const char *c = if_none_match;
+
+  while (0 != *c) {
+    while (' ' == *c || '\t' == *c || ',' == *c)
+      ++c;
+
+    if ('*' == *c)
+      return TRUE;
+
+    if (0 == strncmp(c, "W/", 2))
+      c += 2;
+
+    if (0 == strncmp(c, etag, etag_len)) {
+      char after = c[etag_len];
+      if (0 == after || ',' == after || ' ' == after || '\t' == after)
+        return TRUE;
+    }
+
+    while (0 != *c && ',' != *c)
+      ++c;
+  }
+
+  return FALSE;
+}
+
+static int _static_parse_range(const char *range, uint64_t size,
+                               uint64_t *first, uint64_t *last) {
+  // returns 1 for a satisfiable single byte range, -1 for an unsatisfiable
+  // one and 0 when the header should be ignored (multiple ranges, other units,
+  // malformed)
+  if (0 != strncmp(range, "bytes=", 6) || NULL != strchr(range, ','))
+    return 0;
+
+  range += 6;
+
+  uint64_t start = 0, end = 0;
+  size_t used = 0;
+
+  // the string ends at its NULL-byte, where parsing stops anyway
+  int start_result = fpx_struint64(range, SIZE_MAX, &start, &used);
+  range += used;
+
+  if ('-' != *range++)
+    return 0;
+
+  int end_result = fpx_struint64(range, SIZE_MAX, &end, &used);
+  range += used;
+
+  // numbers too big for 64 bits are malformed as well
+  uint8_t has_start = (0 == start_result), has_end = (0 == end_result);
+  if (0 != *range || -3 == start_result || -3 == end_result ||
+      (FALSE == has_start && FALSE == has_end))
+    return 0;
+
+  if (FALSE == has_start) {
+    // suffix range; the last `end` bytes
+    if (0 == end || 0 == size)
+      return -1;
+
+    *first = (end >= size) ? 0 : size - end;
+    *last = size - 1;
+    return 1;
+  }
+
+  if (has_end && end < start)
+    return 0;
+
+  if (start >= size)
+    return -1;
+
+  *first = start;
+  *last = (has_end && end < size) ? end : size - 1;
+
+  return 1;
+}
+#endif
+
+static void _set_keepalive(fpx_httprequest_t *reqptr,
+                           fpx_httpresponse_t *resptr) {
+  uint8_t keepalive = TRUE;
+  int return_value;
+
+  // this is never read afterwards,
+  // so we'll reuse it later
+  char header_val[32] = {0};
+
+  {
+    char version[8] = {0};
+    fpx_httprequest_get_version(reqptr, version, sizeof(version) - 1);
+    if (0 == strcmp(version, "1.0"))
+      keepalive = FALSE;
+  }
+
+  return_value = fpx_httprequest_get_header(reqptr, "connection", header_val,
+                                            sizeof(header_val) - 1);
+  fpx_string_to_lower(header_val, FALSE);
+
+  if (0 == return_value) {
+    if (0 == strncmp(header_val, "close", fpx_getstringlength(header_val))) {
+      // connection close
+      keepalive = FALSE;
+    } else if (0 == strncmp(header_val, "keep-alive",
+                            fpx_getstringlength(header_val))) {
+      // we keep the connection open ^^
+      keepalive = TRUE;
+    }
+  }
+
+  return_value = fpx_httpresponse_get_header(resptr, "connection", header_val,
+                                             sizeof(header_val) - 1);
+
+  if (-2 == return_value)
+    fpx_httpresponse_add_header(
+        resptr, "connection", (TRUE == keepalive) ? ("keep-alive") : ("close"));
+
+  return_value = fpx_httpresponse_get_header(resptr, "keep-alive", header_val,
+                                             sizeof(header_val) - 1);
+
+  if (-2 == return_value && TRUE == keepalive)
+    fpx_httpresponse_add_header(resptr, "keep-alive", STR(KEEPALIVE_SECONDS));
+
+  return;
+}
+
+static int _is_upgradable(fpx_httprequest_t *reqptr) {
+
+  // must be GET method
+  if (HTTP_GET != reqptr->method)
+    return FALSE;
+
+  // must be HTTP/1.1
+  if (0 != memcmp(reqptr->content.version, "1.1", 3))
+    return FALSE;
+
+  // check for headers
+  {
+    // way oversized buffer just in case
+    char header_val[256] = {0};
+
+    fpx_httprequest_get_header(reqptr, "connection", header_val,
+                               sizeof(header_val) - 1);
+    fpx_string_to_lower(header_val, FALSE);
+    if (-1 == fpx_substringindex(header_val, "upgrade"))
+      return FALSE;
+
+    fpx_memset(header_val, 0, sizeof(header_val));
+
+    fpx_httprequest_get_header(reqptr, "upgrade", header_val,
+                               sizeof(header_val) - 1);
+    fpx_string_to_lower(header_val, FALSE);
+    if (-1 == fpx_substringindex(header_val, "websocket"))
+      return FALSE;
+
+    fpx_memset(header_val, 0, sizeof(header_val));
+
+    fpx_httprequest_get_header(reqptr, "sec-websocket-version", header_val,
+                               sizeof(header_val) - 1);
+    if (13 != fpx_strint(header_val))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void _upgrade_to_ws(struct _thread *thread, int idx,
+                           struct _thread *ws_thread,
+                           fpx_websocketcallback_t ws_cb) {
+  // `ws_thread` already has a slot reserved for this client
+  struct _client_meta *client = thread->clients[idx];
+
+  client->ws.callback = ws_cb;
+
+  // the 101 response has to be out before the WS thread starts sending frames
+  if (0 > _pending_drain(&client->output, client->fd)) {
+    atomic_fetch_sub(&ws_thread->load, 1);
+    _disconnect_client(thread, idx, TRUE);
+    return;
+  }
+
+  _http_context_release(thread, client);
+
+#if !(defined(_WIN32) || defined(_WIN64))
+  // frames are sent from user callbacks, which expect blocking writes
+  fcntl(client->fd, F_SETFL, fcntl(client->fd, F_GETFL) & ~O_NONBLOCK);
+#endif
+
+  // from here on, other threads hand their commands for this client to
+  // `ws_thread`; they queue up behind the client itself
+  if (0 != _ws_owner_set(thread->server, ws_thread, client)) {
+    atomic_fetch_sub(&ws_thread->load, 1);
+    _disconnect_client(thread, idx, TRUE);
+    return;
+  }
+
+  _disconnect_client(thread, idx, FALSE);
+  _thread_hand_off(ws_thread, client);
+
+  return;
+}
+
+static int _generate_ws_accept_header(fpx_httprequest_t *reqptr,
+                                      char outbuf[32]) {
+  char key_header[128] = {0};
+  int key_len = 24;
+
+  uint8_t sha_intermediate[20];
+
+  char *accept_header;
+
+  if (0 > fpx_httprequest_get_header(reqptr, "sec-websocket-key", key_header,
+                                     key_len))
+    return -1;
+
+  fpx_strcpy(&key_header[key_len], "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+  fpx_sha1_digest((uint8_t *)key_header, fpx_getstringlength(key_header),
+                  sha_intermediate, FALSE);
+  accept_header = fpx_base64_encode(sha_intermediate, 20);
+
+  if (NULL == accept_header) {
+    // mem allocation failed
+    return -10;
+  }
+
+  fpx_memcpy(outbuf, accept_header, 28);
+  outbuf[28] = 0;
+
+  free(accept_header);
+
+  return 0;
+}
+
+// static int _check_manual_ws_upgrade(fpx_httprequest_t* reqptr,
+// fpx_httpresponse_t* resptr) {
+//   UNUSED(reqptr);
+//   {
+//     if (101 != resptr->status)
+//       return 0;
+//   }
+//
+//   return 1;
+// }
+
+static int _http_handle_client(struct _thread *thread, int idx) {
+  // we enter this function assuming the client-socket is ready to be read from
+
+  struct _client_meta *client = thread->clients[idx];
+
+  if (client->close_after_flush) {
+    // a final response is still being written; anything else is ignored
+    return HANDLER_DRAINED;
+  }
+
+  if (NULL == client->parser && 0 > _http_context_take(thread, client)) {
+    _disconnect_client(thread, idx, TRUE);
+    return HANDLER_GONE;
+  }
+
+  // read from socket, straight into the parser's buffer
+  size_t space = 0;
+  char *read_buffer =
+      fpx_httpparser_reserve(client->parser, BUFFER_DEFAULT / 4, &space);
+
+  if (NULL == read_buffer) {
+    _disconnect_client(thread, idx, TRUE);
+    return HANDLER_GONE;
+  }
+
+  int amount_read = recv(client->fd, read_buffer, space, MSG_DONTWAIT);
+  if (0 > amount_read && (EAGAIN == errno || EWOULDBLOCK == errno))
+    return HANDLER_DRAINED;
+
+  if (1 > amount_read) {
+    _disconnect_client(thread, idx, TRUE);
+    return HANDLER_GONE;
+  }
+
+  fpx_httpparser_commit(client->parser, amount_read);
+
+  // a single read may hold several (pipelined) requests, or only part of one
+  while (TRUE) {
+    fpx_httprequest_t incoming_request;
+    fpx_httprequest_init(&incoming_request);
+
+    int parse_result =
+        fpx_httpparser_execute(client->parser, &incoming_request);
+
+    if (0 == parse_result)
+      break;
+
+    int status =
+        _http_handle_request(thread, idx, &incoming_request, parse_result);
+
+    if (HANDLER_GONE == status)
+      return HANDLER_GONE;
+
+    if (client->close_after_flush)
+      return HANDLER_DRAINED;
+  }
+
+  if (client->parser->start == client->parser->length) {
+    // nothing left over; idle connections should not hold on to a buffer
+    _http_context_release(thread, client);
+  }
+
+  // a short read means the socket was emptied
+  return ((size_t)amount_read < space) ? HANDLER_DRAINED : HANDLER_AGAIN;
+}
+
+static int _http_context_take(struct _thread *thread,
+                              struct _client_meta *client) {
+  // gives the client a parser and an arena; from the spares when there are
+  // any, so that a busy keep-alive server does not allocate for them
+  if (0 < thread->spare_count) {
+    --thread->spare_count;
+    client->parser = thread->spare_parsers[thread->spare_count];
+    client->arena = thread->spare_arenas[thread->spare_count];
+    return 0;
+  }
+
+  client->parser = (fpx_httpparser_t *)malloc(sizeof(fpx_httpparser_t));
+
+  if (NULL == client->parser)
+    return -2;
+
+  fpx_httpparser_init(client->parser);
+
+  // without an arena, requests and responses just use the heap
+  client->arena = fpx_arena_create(REQUEST_ARENA_SIZE);
+
+  return 0;
+}
+
+static void _http_context_release(struct _thread *thread,
+                                  struct _client_meta *client) {
+  fpx_httpparser_t *parser = client->parser;
+  fpx_arena *arena = client->arena;
+
+  if (NULL == parser)
+    return;
+
+  client->parser = NULL;
+  client->arena = NULL;
+
+  // a buffer that grew for a large request is not worth holding on to
+  if (thread->spare_count < SPARE_CONTEXTS &&
+      parser->allocated <= BUFFER_DEFAULT) {
+    char *buffer = parser->buffer;
+    size_t allocated = parser->allocated;
+
+    fpx_httpparser_init(parser);
+    parser->buffer = buffer;
+    parser->allocated = allocated;
+
+    thread->spare_parsers[thread->spare_count] = parser;
+    thread->spare_arenas[thread->spare_count] = arena;
+    ++thread->spare_count;
+    return;
+  }
+
+  fpx_httpparser_destroy(parser);
+  free(parser);
+
+  if (NULL != arena)
+    fpx_arena_destroy(arena);
+}
+
+static int _http_handle_request(struct _thread *thread, int idx,
+                                fpx_httprequest_t *reqptr, int parse_result) {
+  fpx_httprequest_t incoming_request = *reqptr;
+  fpx_httpresponse_t outgoing_response;
+
+  fpx_httpresponse_init(&outgoing_response);
+
+  fpx_httprequest_use_arena(&incoming_request, thread->clients[idx]->arena);
+  fpx_httpresponse_use_arena(&outgoing_response, thread->clients[idx]->arena);
+  _apply_default_headers(thread->server, &outgoing_response);
+  fpx_httpresponse_set_version(&outgoing_response, STR(HTTP_VERSION));
+
+  if (0 > parse_result) {
+    switch (parse_result) {
+    case -2:
+      SET_HTTP_400(thread->server, outgoing_response, "", 0);
+      break;
+    case -3:
+      SET_HTTP_431(thread->server, outgoing_response, "", 0);
+      break;
+    case -4:
+      SET_HTTP_414(thread->server, outgoing_response, "", 0);
+      break;
+    case -5:
+      SET_HTTP_413(thread->server, outgoing_response, "", 0);
+      break;
+    case -6:
+      SET_HTTP_501(thread->server, outgoing_response, "", 0);
+      break;
+    default:
+      SET_HTTP_500(thread->server, outgoing_response, "", 0);
+      break;
+    }
+
+    // the parser can not find the start of the next request after this
+    fpx_httpresponse_add_header(&outgoing_response, "connection", "close");
+
+    return _on_response_ready(thread, &incoming_request, &outgoing_response,
+                              idx, NULL);
+  }
+
+  if (incoming_request.content.version[0] != '1') {
+    const char msg[] = "Only HTTP/1.X is supported";
+    SET_HTTP_505(thread->server, outgoing_response, msg, sizeof(msg) - 1);
+
+    return _on_response_ready(thread, &incoming_request, &outgoing_response,
+                              idx, NULL);
+  }
+
+  switch (incoming_request.method) {
+  case HTTP_POST:
+  case HTTP_PUT:
+  case HTTP_PATCH: {
+    const char *value;
+    size_t value_len;
+    if (-2 == fpx_httprequest_get_known_header(&incoming_request,
+                                               HTTP_HEADER_CONTENT_LENGTH,
+                                               &value, &value_len)) {
+      // HTTP 411: Length Required
+      SET_HTTP_411(thread->server, outgoing_response, "", 0);
+    }
+  } break;
+
+  default:
+    break;
+  }
+
+  struct _thread *ws_thread = NULL;
+  fpx_websocketcallback_t ws_callback = NULL;
+
+  if (_is_upgradable(&incoming_request)) {
+    struct _fpx_endpoint *endpoint =
+        _route_lookup(thread->server, &incoming_request);
+
+    if (NULL != endpoint && NULL != endpoint->ws_callback) {
+      // WS endpoint available, so we can upgrade
+      char accept_header[32] = {0};
+
+      ws_callback = endpoint->ws_callback;
+
+      if (0 > _generate_ws_accept_header(&incoming_request, accept_header)) {
+        SET_HTTP_400(thread->server, outgoing_response, "", 0);
+      } else {
+        // claim room on a websocket thread before agreeing to the upgrade
+        ws_thread = _thread_reserve(thread->server->_internal->ws_threads,
+                                    thread->server->ws_thread_count);
+
+        outgoing_response.status = 101;
+        fpx_strcpy(outgoing_response.reason, "Switching Protocols");
+
+        fpx_httpresponse_add_header(&outgoing_response, "sec-websocket-accept",
+                                    accept_header);
+        fpx_httpresponse_add_header(&outgoing_response, "upgrade", "websocket");
+        fpx_httpresponse_add_header(&outgoing_response, "connection",
+                                    "Upgrade");
+
+        char extensions[128];
+        if (0 == _ws_negotiate_deflate(thread->server, &incoming_request,
+                                       &thread->clients[idx]->ws, extensions,
+                                       sizeof(extensions)))
+          fpx_httpresponse_add_header(&outgoing_response,
+                                      "sec-websocket-extensions", extensions);
+      }
+    } else {
+      SET_HTTP_404(thread->server, outgoing_response, "", 0);
+    }
+  }
+
+  if (outgoing_response.status > 0) {
+    // that means we already set a response!
+    // specifically for a bad request or similar
+
+    // now we send it!
+
+    int status =
+        _on_response_ready(thread, &incoming_request, &outgoing_response, idx,
+                           NULL);
+
+    if (NULL != ws_thread) {
+      if (HANDLER_GONE == status) {
+        // client left before the upgrade went through
+        atomic_fetch_sub(&ws_thread->load, 1);
+        return HANDLER_GONE;
+      }
+
+      _upgrade_to_ws(thread, idx, ws_thread, ws_callback);
+      return HANDLER_GONE;
+    }
+
+    return status;
+  }
+
+  // do endpoint things
+  // (this includes running the programmer's callback)
+  struct _file_body file = {.fd = -1, .offset = 0, .length = 0};
+  _handle_http_endpoint(thread, &incoming_request, &outgoing_response, &file);
+
+  // keepalive
+  _set_keepalive(&incoming_request, &outgoing_response);
+
+  return _on_response_ready(thread, &incoming_request, &outgoing_response, idx,
+                            &file);
+}
+
+static int _disconnect_client(struct _thread *t, int idx,
+                              uint8_t close_socket) {
+  struct _client_meta *client = t->clients[idx];
+
+  _timer_unlink(client);
+
+  if (TRUE == close_socket) {
+#if defined(_WIN32) || defined(_WIN64)
+    FPX_DEBUG("Closing fd: %llu\n", client->fd);
+#else
+    FPX_DEBUG("Closing fd: %d\n", client->fd);
+#endif
+    // the descriptor may be reused as soon as it is closed
+    _ws_owner_clear(t->server, client);
+
+    // closing the descriptor also removes it from the epoll set
+    close(client->fd);
+
+    _http_context_release(t, client);
+    _ws_receiver_free(&client->ws.rx);
+
+    if (NULL != client->ws.deflater) {
+      fpx_deflate_destroy(client->ws.deflater);
+      free(client->ws.deflater);
+    }
+    _topic_leave_all(t, client);
+
+    _pending_free(&client->output);
+
+    free(client);
+    _connection_release(t->server);
+  }
+#if defined(__linux__)
+  else if (-1 != t->epoll_fd) {
+    // the client lives on in another thread
+    epoll_ctl(t->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+  }
+#endif
+
+  // move the last client into the freed slot;
+  // the loops walk backwards, so the moved client has already been visited
+  int last = t->connection_count - 1;
+
+  if (idx != last) {
+    t->pfds[idx] = t->pfds[last];
+    t->clients[idx] = t->clients[last];
+    t->clients[idx]->slot = idx;
+  }
+
+  fpx_memset(&t->pfds[last], -1, sizeof(t->pfds[0]));
+  t->clients[last] = NULL;
+
+  t->connection_count--;
+
+  atomic_fetch_sub(&t->load, 1);
+
+  return 0;
+}
+
+static int _apply_default_headers(fpx_httpserver_t *srvptr,
+                                  fpx_httpresponse_t *resptr) {
+  fpx_strview_t def_headers = {srvptr->_internal->default_headers,
+                               srvptr->_internal->default_headers_len};
+
+  if (NULL == def_headers.data)
+    return 0;
+
+  while (0 < def_headers.len) {
+    int64_t colon = fpx_strview_find(def_headers, FPX_STRVIEW_LITERAL(":"));
+    int64_t crlf = fpx_strview_find(def_headers, FPX_STRVIEW_LITERAL("\r\n"));
+
+    if (colon > crlf || -1 == colon)
+      break;
+
+    int result = fpx_httpresponse_add_header_view(
+        resptr, fpx_strview_slice(def_headers, 0, colon),
+        fpx_strview_slice(def_headers, colon + 1, crlf - (colon + 1)));
+    if (result != 0)
+      return result;
+
+    def_headers = fpx_strview_slice(def_headers, crlf + 2, SIZE_MAX);
+  }
+
+  return 0;
+}
+
+static int _send_response(fpx_httprequest_t *reqptr, fpx_httpresponse_t *resptr,
+                          int client_fd, struct _pending_output *pending) {
+  // without a `pending` queue the write blocks until everything is out;
+  // with one, whatever the socket does not take right away is queued there
+  if (NULL == resptr)
+    return -1;
+
+  if (client_fd < 0)
+    return -2;
+
+// to ignore SIGPIPE when writing to a disconnected client
+#if defined(_WIN32) || defined(_WIN64)
+  int send_flags = 0;
+#else
+  int send_flags = MSG_NOSIGNAL;
+
+  if (NULL != pending)
+    send_flags |= MSG_DONTWAIT;
+#endif
+
+  // some prerequisites (content-length header etc.)
+  size_t content_length = resptr->content.body_len;
+  {
+    const char *value;
+    size_t value_len;
+
+    if (0 == fpx_httpresponse_get_known_header(resptr,
+                                               HTTP_HEADER_CONTENT_LENGTH,
+                                               &value, &value_len)) {
+      // set by the endpoint; trust it (within the body we have)
+      uint64_t declared;
+      if (0 == fpx_struint64(value, value_len, &declared, NULL) &&
+          declared < content_length)
+        content_length = declared;
+    } else {
+      // header not yet set, so we set it
+      char content_length_header[FPX_INT64_MAX_LENGTH + 1];
+      fpx_uint64str(resptr->content.body_len, content_length_header,
+                    sizeof(content_length_header));
+      fpx_httpresponse_add_header(resptr, "content-length",
+                                  content_length_header);
+    }
+  }
+
+  // response status line
+  char status_line[64 + sizeof(resptr->reason)];
+  int status_line_len;
+  {
+    char version[16] = {0};
+    fpx_httpresponse_get_version(resptr, version, sizeof(version));
+
+    status_line_len = snprintf(status_line, sizeof(status_line),
+                               "HTTP/%s %hu %s\r\n", version, resptr->status,
+                               resptr->reason);
+
+    if (status_line_len >= (int)sizeof(status_line))
+      status_line_len = sizeof(status_line) - 1;
+  }
+
+  // status line, headers, the empty line and the body go out in one call;
+  // nothing gets copied unless the socket can not take it all
+  struct iovec iov[4] = {
+      {status_line, status_line_len},
+      {resptr->content.headers, resptr->content.headers_len},
+      {(void *)"\r\n", 2},
+      {resptr->content.body, 0},
+  };
+
+  if (content_length > 0 &&
+      (NULL == reqptr || FALSE == (reqptr->method & HTTP_HEAD)))
+    iov[3].iov_len = content_length;
+
+  if (NULL != pending && NULL != pending->head) {
+    // earlier responses are still waiting; this one has to go after them
+    if (0 > _pending_flush(pending, client_fd))
+      return -10;
+
+    if (NULL != pending->head)
+      return _pending_append(pending, iov, 4);
+  }
+
+  if (0 > _send_iov(client_fd, iov, 4, send_flags)) {
+    if (errno == EPIPE)
+      return -10;
+
+    return -3;
+  }
+
+  // anything _send_iov() did not get rid of is still in `iov`
+  if (NULL != pending)
+    return _pending_append(pending, iov, 4);
+
+  return 0;
+}
+
+static long _send_iov(int fd, struct iovec *iov, int iov_count, int flags) {
+  // writes until everything is out or the socket would block;
+  // every entry of `iov` is advanced past the bytes that were written.
+  // returns the amount of bytes written, or -1 on error
+  long total = 0;
+  int first = 0;
+
+  while (TRUE) {
+    while (first < iov_count && 0 == iov[first].iov_len)
+      ++first;
+
+    if (first == iov_count)
+      break;
+
+#if defined(_WIN32) || defined(_WIN64)
+    long written = send(fd, iov[first].iov_base, iov[first].iov_len, flags);
+#else
+    struct msghdr msg;
+    fpx_memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov[first];
+    msg.msg_iovlen = iov_count - first;
+
+    long written = sendmsg(fd, &msg, flags);
+#endif
+
+    if (0 > written) {
+      if (EINTR == errno)
+        continue;
+
+      if (EAGAIN == errno || EWOULDBLOCK == errno)
+        break;
+
+      return -1;
+    }
+
+    total += written;
+
+    for (int i = first; i < iov_count && written > 0; ++i) {
+      size_t part =
+          ((size_t)written < iov[i].iov_len) ? (size_t)written : iov[i].iov_len;
+
+      iov[i].iov_base = (char *)iov[i].iov_base + part;
+      iov[i].iov_len -= part;
+      written -= part;
+    }
+  }
+
+  return total;
+}
+
+static int _pending_append(struct _pending_output *out,
+                           const struct iovec *iov, int iov_count) {
+  // returns 0 on success, -2 if memory allocation fails and -3 if the client
+  // has more than PENDING_OUTPUT_MAX bytes waiting
+  size_t incoming = 0;
+  for (int i = 0; i < iov_count; ++i)
+    incoming += iov[i].iov_len;
+
+  if (0 == incoming)
+    return 0;
+
+  if (out->buffered + incoming > PENDING_OUTPUT_MAX)
+    return -3;
+
+  struct _output_segment *segment = (struct _output_segment *)malloc(
+      sizeof(struct _output_segment) + incoming);
+  if (NULL == segment)
+    return -2;
+
+  segment->next = NULL;
+  segment->file_fd = -1;
+  segment->offset = 0;
+  segment->left = incoming;
+  segment->shared = NULL;
+
+  {
+    char *write_copy = segment->data;
+    for (int i = 0; i < iov_count; ++i) {
+      fpx_memcpy(write_copy, iov[i].iov_base, iov[i].iov_len);
+      write_copy += iov[i].iov_len;
+    }
+  }
+
+  if (NULL == out->tail)
+    out->head = segment;
+  else
+    out->tail->next = segment;
+
+  out->tail = segment;
+  out->buffered += incoming;
+
+  return 0;
+}
+
+static int _pending_append_file(struct _pending_output *out,
+                                struct _file_body *file) {
+  // takes over `file->fd`, also when it fails; returns 0 or -2
+  struct _output_segment *segment =
+      (struct _output_segment *)malloc(sizeof(struct _output_segment));
+
+  if (NULL == segment) {
+    close(file->fd);
+    return -2;
+  }
+
+  segment->next = NULL;
+  segment->file_fd = file->fd;
+  segment->offset = file->offset;
+  segment->left = file->length;
+  segment->shared = NULL;
+
+  file->fd = -1;
+
+  if (NULL == out->tail)
+    out->head = segment;
+  else
+    out->tail->next = segment;
+
+  out->tail = segment;
+
+  return 0;
+}
+
+static int _pending_append_shared(struct _pending_output *out,
+                                  struct _ws_broadcast *message,
+                                  size_t offset) {
+  // queues what is left of `message` after `offset` without copying it, and
+  // takes a reference to it. returns the same as _pending_append()
+  size_t incoming = message->length - offset;
+
+  if (out->buffered + incoming > PENDING_OUTPUT_MAX)
+    return -3;
+
+  struct _output_segment *segment =
+      (struct _output_segment *)malloc(sizeof(struct _output_segment));
+  if (NULL == segment)
+    return -2;
+
+  atomic_fetch_add(&message->references, 1);
+
+  segment->next = NULL;
+  segment->file_fd = -1;
+  segment->offset = offset;
+  segment->left = incoming;
+  segment->shared = message;
+
+  if (NULL == out->tail)
+    out->head = segment;
+  else
+    out->tail->next = segment;
+
+  out->tail = segment;
+  out->buffered += incoming;
+
+  return 0;
+}
+
+static int _pending_flush(struct _pending_output *out, int fd) {
+  // returns 0 when the socket took what it could, -1 on a write error
+  while (NULL != out->head) {
+    struct _output_segment *segment = out->head;
+    long written;
+
+    if (-1 == segment->file_fd) {
+      char *data = (NULL != segment->shared) ? (char *)segment->shared->data
+                                             : segment->data;
+      struct iovec iov = {data + segment->offset, segment->left};
+
+#if defined(_WIN32) || defined(_WIN64)
+      written = _send_iov(fd, &iov, 1, 0);
+#else
+      written = _send_iov(fd, &iov, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
+
+      if (0 > written)
+        return -1;
+
+      out->buffered -= written;
+      segment->offset += written;
+      segment->left -= written;
+    } else {
+      if (0 > _send_file(fd, segment))
+        return -1;
+    }
+
+    if (0 < segment->left)
+      return 0; // the socket is full
+
+    out->head = segment->next;
+    if (NULL == out->head)
+      out->tail = NULL;
+
+    if (-1 != segment->file_fd)
+      close(segment->file_fd);
+
+    if (NULL != segment->shared)
+      _ws_broadcast_release(segment->shared);
+
+    free(segment);
+  }
+
+  return 0;
+}
+
+static int _pending_drain(struct _pending_output *out, int fd) {
+  // writes all of `out`, waiting for the socket where needed; returns 0 on
+  // success, or -1 if the socket fails or stays full for a second
+  while (NULL != out->head) {
+    struct pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+
+#if defined(_WIN32) || defined(_WIN64)
+    int ready = WSAPoll(&pfd, 1, 1000);
+#else
+    int ready = poll(&pfd, 1, 1000);
+#endif
+
+    if (1 > ready || 0 > _pending_flush(out, fd))
+      return -1;
+  }
+
+  return 0;
+}
+
+static long _send_file(int fd, struct _output_segment *segment) {
+  // sends as much of the file segment as the (non-blocking) socket takes;
+  // returns the amount of bytes written, or -1 on error
+#if defined(_WIN32) || defined(_WIN64)
+  UNUSED(fd);
+  UNUSED(segment);
+
+  errno = ENOSYS;
+  return -1;
+#else
+  long total = 0;
+
+#if defined(__linux__)
+  while (0 < segment->left) {
+    off_t offset = segment->offset;
+    size_t chunk = (segment->left > (1 << 30)) ? (1 << 30) : segment->left;
+
+    ssize_t written = sendfile(fd, segment->file_fd, &offset, chunk);
+
+    if (0 > written) {
+      if (EINTR == errno)
+        continue;
+
+      if (EAGAIN == errno || EWOULDBLOCK == errno)
+        return total;
+
+      if (EINVAL == errno || ENOSYS == errno)
+        break; // this file can not be sent from; map it instead
+
+      return -1;
+    }
+
+    if (0 == written) {
+      // the file got shorter since we looked at it
+      errno = EIO;
+      return -1;
+    }
+
+    segment->offset += written;
+    segment->left -= written;
+    total += written;
+  }
+
+  if (0 == segment->left)
+    return total;
+#endif
+
+  // fallback; map a window of the file and write it out from there
+  long page = sysconf(_SC_PAGESIZE);
+
+  while (0 < segment->left) {
+    uint64_t map_start = segment->offset - (segment->offset % page);
+    size_t skip = segment->offset - map_start;
+    size_t window =
+        (segment->left > FILE_MAP_WINDOW) ? FILE_MAP_WINDOW : segment->left;
+
+    void *map = mmap(NULL, skip + window, PROT_READ, MAP_SHARED,
+                     segment->file_fd, map_start);
+    if (MAP_FAILED == map)
+      return -1;
+
+    struct iovec iov = {(char *)map + skip, window};
+    long written = _send_iov(fd, &iov, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    munmap(map, skip + window);
+
+    if (0 > written)
+      return -1;
+
+    segment->offset += written;
+    segment->left -= written;
+    total += written;
+
+    if ((size_t)written < window)
+      break; // the socket is full
+  }
+
+  return total;
+#endif
+}
+
+static void _pending_free(struct _pending_output *out) {
+  while (NULL != out->head) {
+    struct _output_segment *next = out->head->next;
+
+    if (-1 != out->head->file_fd)
+      close(out->head->file_fd);
+
+    if (NULL != out->head->shared)
+      _ws_broadcast_release(out->head->shared);
+
+    free(out->head);
+    out->head = next;
+  }
+
+  out->tail = NULL;
+  out->buffered = 0;
+
+  return;
+}
+
+static int _flush_client(struct _thread *t, struct _client_meta *client) {
+  // the socket became writable; continue with the pending output
+  if (NULL == client->output.head)
+    return HANDLER_AGAIN;
+
+  if (0 > _pending_flush(&client->output, client->fd)) {
+    _disconnect_client(t, client->slot, TRUE);
+    return HANDLER_GONE;
+  }
+
+  if (NULL != client->output.head)
+    return HANDLER_DRAINED;
+
+  _watch_writable(t, client, FALSE);
+
+  if (client->close_after_flush) {
+    _disconnect_client(t, client->slot, TRUE);
+    return HANDLER_GONE;
+  }
+
+  return HANDLER_AGAIN;
+}
+
+static void _watch_writable(struct _thread *t, struct _client_meta *client,
+                            uint8_t enable) {
+  // the epoll set always includes EPOLLOUT, so only poll() needs to be told
+  if (enable)
+    t->pfds[client->slot].events |= POLLOUT;
+  else
+    t->pfds[client->slot].events &= ~POLLOUT;
+
+  return;
+}
+
+static int16_t _ws_frame_validate(const fpx_websocketclient_t *ws,
+                                  uint64_t max_message, const char **reason) {
+  // returns 0 if the frame in `ws->rx.frame` may be received, or the status
+  // code to close the connection with otherwise
+  const struct _ws_receiver *rx = &ws->rx;
+  const fpx_websocketframe_t *frame = &rx->frame;
+  uint8_t is_control = (0 != (frame->opcode & 0x8));
+
+  if (FALSE == frame->mask_set) {
+    *reason = "no mask set";
+    return 1002;
+  }
+
+  if (frame->reserved2 || frame->reserved3) {
+    *reason = "no extensions negotiated";
+    return 1002;
+  }
+
+  // permessage-deflate marks the first frame of a compressed message
+  if (frame->reserved1 &&
+      (FALSE == ws->deflate ||
+       (WEBSOCKET_TEXT != frame->opcode && WEBSOCKET_BINARY != frame->opcode))) {
+    *reason = "unexpected compression bit";
+    return 1002;
+  }
+
+  switch (frame->opcode) {
+  case WEBSOCKET_CONTINUE:
+    if (WEBSOCKET_CONTINUE == rx->message.opcode) {
+      *reason = "no message to continue";
+      return 1002;
+    }
+    break;
+
+  case WEBSOCKET_TEXT:
+  case WEBSOCKET_BINARY:
+    if (WEBSOCKET_CONTINUE != rx->message.opcode) {
+      *reason = "expected a continuation frame";
+      return 1002;
+    }
+    break;
+
+  case WEBSOCKET_CLOSE:
+  case WEBSOCKET_PING:
+  case WEBSOCKET_PONG:
+    break;
+
+  default:
+    *reason = "unknown opcode";
+    return 1002;
+  }
+
+  if (is_control) {
+    if (FALSE == frame->final || 125 < frame->payload_length) {
+      *reason = "bad control frame";
+      return 1002;
+    }
+
+    return 0;
+  }
+
+  if (frame->payload_length >> 63) {
+    *reason = "bad payload length";
+    return 1002;
+  }
+
+  if (0 != max_message &&
+      rx->message.payload_length + frame->payload_length > max_message) {
+    *reason = "message too big";
+    return 1009;
+  }
+
+  return 0;
+}
+
+static int _handle_control_frame(struct _thread *thread,
+                                 struct _client_meta *client,
+                                 fpx_websocketframe_t *incoming_frame) {
+  // answers a control frame; returns 0, or what _ws_write() returned if the
+  // answer could not be sent
+  fpx_websocketclient_t *cliptr = &client->ws;
+  int sent_status = 0;
+
+  switch (incoming_frame->opcode) {
+  case WEBSOCKET_CLOSE:
+    // close
+
+    cliptr->flags |= CLOSE_RECV;
+
+    if (FALSE == (cliptr->flags & CLOSE_SENT)) {
+      fpx_websocketframe_t close_frame;
+
+      fpx_websocketframe_init(&close_frame);
+
+      close_frame.final = TRUE;
+      close_frame.opcode = WEBSOCKET_CLOSE;
+
+      fpx_websocketframe_append_payload(&close_frame, incoming_frame->payload,
+                                        incoming_frame->payload_length);
+
+      sent_status = _ws_write(thread, client, &close_frame);
+      if (0 != sent_status) {
+        // error happened
+        if (sent_status == EPIPE) {
+          FPX_WARN("Broken client pipe\n");
+        } else {
+          FPX_WARN("Could not send a closing frame.\tErrno: %d\n",
+                   sent_status);
+        }
+      }
+
+      // the handshake is complete either way
+      cliptr->flags |= CLOSE_SENT;
+
+      fpx_websocketframe_destroy(&close_frame);
+    }
+    break;
+
+  case WEBSOCKET_PING:
+    // ping
+
+    {
+      fpx_websocketframe_t pong_frame;
+      fpx_websocketframe_init(&pong_frame);
+
+      pong_frame.final = TRUE;
+      pong_frame.opcode = WEBSOCKET_PONG;
+
+      fpx_websocketframe_append_payload(&pong_frame, incoming_frame->payload,
+                                        incoming_frame->payload_length);
+
+      sent_status = _ws_write(thread, client, &pong_frame);
+      if (0 != sent_status) {
+        // error happened
+        if (sent_status == EPIPE) {
+          FPX_WARN("Broken client pipe\n");
+        } else {
+          FPX_WARN("Could not send a pong.\tErrno: %d\n", sent_status);
+        }
+      }
+
+      fpx_websocketframe_destroy(&pong_frame);
+    }
+    break;
+
+  case WEBSOCKET_PONG:
+    // pong
+    break;
+
+  default:
+    // ???? what
+    break;
+  }
+
+  return sent_status;
+}
+
+static int _ws_handle_client(struct _thread *thread, int idx) {
+  // we enter this function assuming the client socket is ready to be read from
+  // https://datatracker.ietf.org/doc/html/rfc6455#section-5.2
 
-  if (-10 == _send_response(reqptr, resptr, thread->pfds[idx].fd)) {
-    // broken pipe
-    closing = TRUE;
+  struct _client_meta *cliptr = thread->clients[idx];
+  struct _ws_receiver *rx = &cliptr->ws.rx;
+
+  if (cliptr->close_after_flush) {
+    // the closing frame is still being written; anything else is ignored
+    return HANDLER_DRAINED;
   }
 
-  time(&thread->client_data[idx].last_time);
+  if (NULL == rx->ring) {
+    rx->ring = (uint8_t *)malloc(WS_RING_SIZE);
 
-  if (closing) {
-    FPX_DEBUG("Disconnecting client %d in thread %" LONG_FORMAT "u\n", idx,
-              thread->thread);
-    _disconnect_client(thread, idx, TRUE);
+    if (NULL == rx->ring) {
+      _disconnect_client(thread, idx, TRUE);
+      return HANDLER_GONE;
+    }
   }
 
-  fpx_httprequest_destroy(reqptr);
-  fpx_httpresponse_destroy(resptr);
+  uint8_t *target;
+  size_t space;
+  uint8_t direct = FALSE;
+
+  if (rx->in_payload && 0 == rx->fill && WS_RING_SIZE <= rx->left &&
+      0 == (rx->frame.opcode & 0x8)) {
+    // the ring is empty and the payload will not fit in it anyway;
+    // read it straight into the message instead of copying it over later
+    if (0 > _ws_message_reserve(rx, WS_RING_SIZE,
+                                thread->server->max_ws_message))
+      return _ws_fail(thread, idx, 1011, "out of memory");
+
+    direct = TRUE;
+    target = rx->message.payload + rx->message.payload_length;
+    space = rx->message.payload_allocated - rx->message.payload_length;
+
+    if (space > rx->left)
+      space = rx->left;
+    if (space > INT_MAX)
+      space = INT_MAX;
+  } else {
+    size_t tail = (rx->head + rx->fill) & (WS_RING_SIZE - 1);
+    target = rx->ring + tail;
+    space = (tail < rx->head) ? rx->head - tail : WS_RING_SIZE - tail;
 
-  return;
-}
+    if (WS_RING_SIZE == rx->fill)
+      space = 0;
+  }
 
-static void _handle_http_endpoint(struct _thread *thread,
-                                  fpx_httprequest_t *reqptr,
-                                  fpx_httpresponse_t *resptr) {
-  // check for endpoints
-  struct _fpx_endpoint *endpoint = NULL;
+  int amount_read = 0;
 
-  for (int i = 0;
-       i < thread->server->_internal->active_endpoints && NULL == endpoint;
-       ++i) {
-    struct _fpx_endpoint *endp = &thread->server->_internal->endpoints[i];
+  if (0 < space) {
+    amount_read = recv(cliptr->fd, (char *)target, space, MSG_DONTWAIT);
 
-    if (0 == strncmp(endp->uri, reqptr->uri, sizeof(endp->uri))) {
-      // endpoint found
-      endpoint = endp;
-      break;
+    if (0 > amount_read && (EAGAIN == errno || EWOULDBLOCK == errno))
+      return HANDLER_DRAINED;
+
+    if (1 > amount_read) {
+      _disconnect_client(thread, idx, TRUE);
+      return HANDLER_GONE;
     }
-  }
 
-  // check wether to use the default endpoint
-  if (FALSE != thread->server->_internal->default_endpoint.active &&
-      NULL == endpoint) {
-    endpoint = &thread->server->_internal->default_endpoint;
+    _timer_schedule(thread, cliptr);
   }
 
-  if (NULL == endpoint || NULL == endpoint->http_callback) {
-    // 404
-    SET_HTTP_404(thread->server, (*resptr), "", 0);
-  } else if (!(endpoint->allowed_methods & reqptr->method)) {
-    // 405 | method not allowed
-    // TODO: add allowed methods into the response body
-    SET_HTTP_405(thread->server, (*resptr), "", 0);
+  if (direct) {
+    fpx_websocket_mask(target, amount_read, rx->frame.masking_key,
+                       rx->mask_offset);
+
+    rx->message.payload_length += amount_read;
+    rx->mask_offset += amount_read;
+    rx->left -= amount_read;
+
+    if (0 == rx->left && HANDLER_GONE == _ws_frame_done(thread, idx))
+      return HANDLER_GONE;
   } else {
-    // :thumbsup:
-    SET_HTTP_200(thread->server, (*resptr), "", 0);
-    endpoint->http_callback(reqptr, resptr);
+    rx->fill += amount_read;
   }
 
-  return;
+  if (HANDLER_GONE == _ws_decode(thread, idx))
+    return HANDLER_GONE;
+
+  // a short read means the socket was emptied
+  return ((size_t)amount_read < space) ? HANDLER_DRAINED : HANDLER_AGAIN;
 }
 
-static void _set_keepalive(fpx_httprequest_t *reqptr,
-                           fpx_httpresponse_t *resptr) {
-  uint8_t keepalive = TRUE;
-  int return_value;
+static int _ws_decode(struct _thread *thread, int idx) {
+  // decodes as many frames out of the ring as it holds; returns HANDLER_GONE
+  // if the client got disconnected, and HANDLER_AGAIN otherwise
+  struct _client_meta *cliptr = thread->clients[idx];
+  struct _ws_receiver *rx = &cliptr->ws.rx;
 
-  // this is never read afterwards,
-  // so we'll reuse it later
-  char header_val[32] = {0};
+  while (FALSE == cliptr->close_after_flush) {
+    if (FALSE == rx->in_payload) {
+      uint8_t header[14];
 
-  {
-    char version[8] = {0};
-    fpx_httprequest_get_version(reqptr, version, sizeof(version) - 1);
-    if (0 == strcmp(version, "1.0"))
-      keepalive = FALSE;
-  }
+      if (2 > rx->fill)
+        break;
 
-  return_value = fpx_httprequest_get_header(reqptr, "connection", header_val,
-                                            sizeof(header_val) - 1);
-  fpx_string_to_lower(header_val, FALSE);
+      _ws_ring_read(rx, header, 2, FALSE);
 
-  if (0 == return_value) {
-    if (0 == strncmp(header_val, "close", fpx_getstringlength(header_val))) {
-      // connection close
-      keepalive = FALSE;
-    } else if (0 == strncmp(header_val, "keep-alive",
-                            fpx_getstringlength(header_val))) {
-      // we keep the connection open ^^
-      keepalive = TRUE;
-    }
-  }
+      uint8_t length_first = header[1] & 0x7f;
+      size_t header_len = 2 + ((header[1] & 0x80) ? 4 : 0);
 
-  return_value = fpx_httpresponse_get_header(resptr, "connection", header_val,
-                                             sizeof(header_val) - 1);
+      if (126 == length_first)
+        header_len += 2;
+      else if (127 == length_first)
+        header_len += 8;
 
-  if (-2 == return_value)
-    fpx_httpresponse_add_header(
-        resptr, "connection", (TRUE == keepalive) ? ("keep-alive") : ("close"));
+      if (header_len > rx->fill)
+        break;
 
-  return_value = fpx_httpresponse_get_header(resptr, "keep-alive", header_val,
-                                             sizeof(header_val) - 1);
+      _ws_ring_read(rx, header, header_len, TRUE);
 
-  if (-2 == return_value && TRUE == keepalive)
-    fpx_httpresponse_add_header(resptr, "keep-alive", STR(KEEPALIVE_SECONDS));
+      fpx_websocketframe_t *frame = &rx->frame;
 
-  return;
-}
+      frame->final = (header[0] >> 7) & 0x01; // MSB; 1 or 0
+      frame->reserved1 = (header[0] >> 6) & 0x01;
+      frame->reserved2 = (header[0] >> 5) & 0x01;
+      frame->reserved3 = (header[0] >> 4) & 0x01;
 
-static int _is_upgradable(fpx_httprequest_t *reqptr) {
+      frame->opcode = (header[0] & 0xf);
 
-  // must be GET method
-  if (HTTP_GET != reqptr->method)
-    return FALSE;
+      frame->mask_set = (header[1] >> 7) & 0x01;
 
-  // must be HTTP/1.1
-  if (0 != memcmp(reqptr->content.version, "1.1", 3))
-    return FALSE;
+      uint8_t *rest = header + 2;
 
-  // check for headers
-  {
-    // way oversized buffer just in case
-    char header_val[256] = {0};
+      if (126 > length_first) {
+        frame->payload_length = length_first;
+      } else if (126 == length_first) {
+        uint16_t extended;
+        fpx_memcpy(&extended, rest, sizeof(extended));
+        fpx_endian_swap_if_little(&extended, sizeof(extended));
+        frame->payload_length = extended;
+        rest += sizeof(extended);
+      } else {
+        uint64_t extended;
+        fpx_memcpy(&extended, rest, sizeof(extended));
+        fpx_endian_swap_if_little(&extended, sizeof(extended));
+        frame->payload_length = extended;
+        rest += sizeof(extended);
+      }
 
-    fpx_httprequest_get_header(reqptr, "connection", header_val,
-                               sizeof(header_val) - 1);
-    fpx_string_to_lower(header_val, FALSE);
-    if (-1 == fpx_substringindex(header_val, "upgrade"))
-      return FALSE;
+      if (frame->mask_set)
+        fpx_memcpy(frame->masking_key, rest, sizeof(frame->masking_key));
 
-    fpx_memset(header_val, 0, sizeof(header_val));
+      const char *reason = NULL;
+      int16_t status =
+          _ws_frame_validate(&cliptr->ws, thread->server->max_ws_message,
+                             &reason);
 
-    fpx_httprequest_get_header(reqptr, "upgrade", header_val,
-                               sizeof(header_val) - 1);
-    fpx_string_to_lower(header_val, FALSE);
-    if (-1 == fpx_substringindex(header_val, "websocket"))
-      return FALSE;
+      if (0 != status)
+        return _ws_fail(thread, idx, status, reason);
 
-    fpx_memset(header_val, 0, sizeof(header_val));
+      if (0 == (frame->opcode & 0x8)) {
+        fpx_websocketframe_t *message = &rx->message;
 
-    fpx_httprequest_get_header(reqptr, "sec-websocket-version", header_val,
-                               sizeof(header_val) - 1);
-    if (13 != fpx_strint(header_val))
-      return FALSE;
-  }
+        if (WEBSOCKET_CONTINUE == message->opcode) {
+          // first fragment; the message takes over its header
+          message->opcode = frame->opcode;
+          message->reserved1 = frame->reserved1;
+          message->mask_set = frame->mask_set;
+          fpx_memcpy(message->masking_key, frame->masking_key,
+                     sizeof(message->masking_key));
+        }
+      }
 
-  return TRUE;
-}
+      rx->in_payload = TRUE;
+      rx->left = frame->payload_length;
+      rx->mask_offset = 0;
+    }
 
-static void _upgrade_to_ws(struct _thread *thread, int idx,
-                           fpx_websocketcallback_t ws_cb) {
-  fpx_httpserver_t *srv = thread->server;
-  struct _thread *ws_thread = srv->_internal->ws_threads;
+    if (0 < rx->left) {
+      if (0 == rx->fill)
+        break;
+
+      size_t amount = (rx->left < rx->fill) ? rx->left : rx->fill;
+      uint8_t *out;
+
+      if (rx->frame.opcode & 0x8) {
+        out = rx->control + rx->mask_offset;
+      } else {
+        if (0 > _ws_message_reserve(rx, amount,
+                                    thread->server->max_ws_message))
+          return _ws_fail(thread, idx, 1011, "out of memory");
+
+        out = rx->message.payload + rx->message.payload_length;
+        rx->message.payload_length += amount;
+      }
 
-  int lowest_count = CLIENTS_DEFAULT;
-  struct _thread *lowest_thread = NULL;
+      _ws_ring_read(rx, out, amount, TRUE);
+      fpx_websocket_mask(out, amount, rx->frame.masking_key, rx->mask_offset);
 
-  for (int i = 0; i < srv->ws_thread_count; ++i, ++ws_thread) {
-    pthread_mutex_lock(&ws_thread->loop_mutex);
+      rx->mask_offset += amount;
+      rx->left -= amount;
 
-    if (ws_thread->connection_count < lowest_count) {
-      lowest_count = ws_thread->connection_count;
-      lowest_thread = ws_thread;
+      if (0 < rx->left)
+        break;
     }
 
-    pthread_mutex_unlock(&ws_thread->loop_mutex);
+    if (HANDLER_GONE == _ws_frame_done(thread, idx))
+      return HANDLER_GONE;
   }
 
-  pthread_mutex_lock(&lowest_thread->loop_mutex);
+  return HANDLER_AGAIN;
+}
 
-  int new_index = _add_client_to_thread(lowest_thread, thread->pfds[idx].fd);
-  if (0 == new_index)
-    pthread_cond_signal(&lowest_thread->loop_condition);
+static int _ws_frame_done(struct _thread *thread, int idx) {
+  // the payload of `rx->frame` has fully arrived
+  struct _client_meta *cliptr = thread->clients[idx];
+  struct _ws_receiver *rx = &cliptr->ws.rx;
+
+  rx->in_payload = FALSE;
+
+  if (rx->frame.opcode & 0x8) {
+    fpx_websocketframe_t control = rx->frame;
+    control.payload = rx->control;
+    control.payload_length = rx->frame.payload_length;
+
+    if (0 != _handle_control_frame(thread, cliptr, &control) ||
+        ((cliptr->ws.flags & (CLOSE_SENT | CLOSE_RECV)) ==
+             (CLOSE_SENT | CLOSE_RECV) &&
+         NULL == cliptr->output.head)) {
+      // we close
+      _disconnect_client(thread, idx, TRUE);
+      return HANDLER_GONE;
+    }
 
-  lowest_thread->client_data[new_index] = thread->client_data[idx];
-  lowest_thread->client_data[new_index].ws.callback = ws_cb;
+    if (cliptr->ws.flags & CLOSE_RECV) {
+      // our closing frame is queued behind published messages
+      cliptr->close_after_flush = TRUE;
+    }
 
-  pthread_mutex_unlock(&lowest_thread->loop_mutex);
+    return HANDLER_AGAIN;
+  }
 
-  _disconnect_client(thread, idx, FALSE);
+  if (FALSE == rx->frame.final)
+    return HANDLER_AGAIN;
 
-  return;
-}
+  fpx_websocketframe_t *message = &rx->message;
+  message->final = TRUE;
 
-static int _generate_ws_accept_header(fpx_httprequest_t *reqptr,
-                                      char outbuf[32]) {
-  char key_header[128] = {0};
-  int key_len = 24;
+  if (message->reserved1 && FALSE == (cliptr->ws.flags & CLOSE_SENT)) {
+    // the callback gets to see the message as it was before compression
+    const char *reason = NULL;
+    int16_t status =
+        _ws_inflate(&cliptr->ws, thread->server->max_ws_message, &reason);
 
-  uint8_t sha_intermediate[20];
+    if (0 != status)
+      return _ws_fail(thread, idx, status, reason);
+  }
 
-  char *accept_header;
+  if (FALSE == (cliptr->ws.flags & CLOSE_SENT)) {
+    _ws_in_callback.thread = thread;
+    _ws_in_callback.client = cliptr;
 
-  if (0 > fpx_httprequest_get_header(reqptr, "sec-websocket-key", key_header,
-                                     key_len))
-    return -1;
+    cliptr->ws.callback(message, cliptr->fd, &(cliptr->in_address));
 
-  fpx_strcpy(&key_header[key_len], "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-  fpx_sha1_digest((uint8_t *)key_header, fpx_getstringlength(key_header),
-                  sha_intermediate, FALSE);
-  accept_header = fpx_base64_encode(sha_intermediate, 20);
+    _ws_in_callback.thread = NULL;
+    _ws_in_callback.client = NULL;
+  }
 
-  if (NULL == accept_header) {
-    // mem allocation failed
-    return -10;
+  // keep a small buffer around for the next message; not a large one
+  if (WS_RING_SIZE < message->payload_allocated) {
+    free(message->payload);
+    message->payload = NULL;
+    message->payload_allocated = 0;
   }
 
-  fpx_memcpy(outbuf, accept_header, 28);
-  outbuf[28] = 0;
+  if (NULL != rx->inflater && WS_RING_SIZE < rx->inflater->out_allocated) {
+    free(rx->inflater->out);
+    rx->inflater->out = NULL;
+    rx->inflater->out_allocated = 0;
+  }
 
-  free(accept_header);
+  message->payload_length = 0;
+  message->opcode = WEBSOCKET_CONTINUE;
+  message->reserved1 = FALSE;
 
-  return 0;
+  return HANDLER_AGAIN;
 }
 
-// static int _check_manual_ws_upgrade(fpx_httprequest_t* reqptr,
-// fpx_httpresponse_t* resptr) {
-//   UNUSED(reqptr);
-//   {
-//     if (101 != resptr->status)
-//       return 0;
-//   }
-//
-//   return 1;
-// }
+static int _ws_fail(struct _thread *thread, int idx, int16_t code,
+                    const char *reason) {
+  // the stream can not be followed anymore after a protocol error, so there
+  // is no waiting for the client's closing frame either
+  struct _client_meta *client = thread->clients[idx];
 
-static int _http_handle_client(struct _thread *thread, int idx) {
-  // we enter this function assuming the client-socket is ready to be read from
+  // status code, followed by as much of the reason as fits
+  uint8_t payload[125];
+  size_t reason_len = fpx_getstringlength(reason);
 
-  char read_buffer[BUFFER_DEFAULT] = {0};
+  if (reason_len > sizeof(payload) - 2)
+    reason_len = sizeof(payload) - 2;
 
-  // read from socket
-  int fd = thread->pfds[idx].fd;
-  int amount_read = recv(fd, read_buffer, sizeof(read_buffer), 0);
-  if (1 > amount_read) {
+  payload[0] = (uint8_t)((uint16_t)code >> 8);
+  payload[1] = (uint8_t)code;
+  fpx_memcpy(payload + 2, reason, reason_len);
+
+  fpx_websocketframe_t close_frame;
+  fpx_websocketframe_init(&close_frame);
+
+  close_frame.final = TRUE;
+  close_frame.opcode = WEBSOCKET_CLOSE;
+  close_frame.payload = payload;
+  close_frame.payload_length = 2 + reason_len;
+
+  client->ws.flags |= CLOSE_SENT;
+
+  // the closing frame goes after anything that is still queued
+  int sent = _ws_write(thread, client, &close_frame);
+
+  if (0 != sent) {
+    FPX_WARN("Could not send a closing frame (%s).\tErrno: %d\n", reason,
+             sent);
+  }
+
+  if (0 != sent || NULL == client->output.head) {
     _disconnect_client(thread, idx, TRUE);
-    return 0;
+    return HANDLER_GONE;
   }
 
-  fpx_httprequest_t incoming_request = {0};
-  fpx_httpresponse_t outgoing_response = {0};
+  client->close_after_flush = TRUE;
+  return HANDLER_AGAIN;
+}
 
-  fpx_httprequest_init(&incoming_request);
+static void _ws_ring_read(struct _ws_receiver *rx, uint8_t *out, size_t len,
+                          uint8_t consume) {
+  // copies the first `len` bytes of the ring into `out`;
+  // removing them from the ring if `consume` is set
+  size_t first = WS_RING_SIZE - rx->head;
 
-  fpx_httpresponse_init(&outgoing_response);
-  _apply_default_headers(thread->server, &outgoing_response);
-  fpx_httpresponse_set_version(&outgoing_response, STR(HTTP_VERSION));
+  if (first > len)
+    first = len;
 
-  int parse_result =
-      _http_parse_request(read_buffer, amount_read, &incoming_request);
+  fpx_memcpy(out, rx->ring + rx->head, first);
+  if (first < len)
+    fpx_memcpy(out + first, rx->ring, len - first);
 
-  if (incoming_request.content.version[0] != '1') {
-    const char msg[] = "Only HTTP/1.X is supported";
-    SET_HTTP_505(thread->server, outgoing_response, msg, sizeof(msg) - 1);
+  if (consume) {
+    rx->head = (rx->head + len) & (WS_RING_SIZE - 1);
+    rx->fill -= len;
+
+    if (0 == rx->fill)
+      rx->head = 0;
+  }
+
+  return;
+}
 
-    _on_response_ready(thread, &incoming_request, &outgoing_response, idx);
+static int _ws_message_reserve(struct _ws_receiver *rx, uint64_t amount,
+                               uint32_t max_message) {
+  // makes room for `amount` more payload bytes in the message. it grows as the
+  // bytes arrive, not by what the headers announce, and doubles so fragments
+  // do not copy the message over every time
+  fpx_websocketframe_t *message = &rx->message;
+  uint64_t needed = message->payload_length + amount;
 
+  if (needed <= message->payload_allocated)
     return 0;
+
+  uint64_t grown = message->payload_allocated * 2;
+  if (grown < WS_MESSAGE_MIN)
+    grown = WS_MESSAGE_MIN;
+
+  // nothing more can come than the rest of a final frame, or the limit
+  if (rx->frame.final && grown > message->payload_length + rx->left)
+    grown = message->payload_length + rx->left;
+  if (0 != max_message && grown > max_message)
+    grown = max_message;
+  if (grown < needed)
+    grown = needed;
+
+  uint8_t *payload = (uint8_t *)realloc(message->payload, grown);
+
+  if (NULL == payload)
+    return -1;
+
+  message->payload = payload;
+  message->payload_allocated = grown;
+
+  return 0;
+}
+
+static void _ws_receiver_free(struct _ws_receiver *rx) {
+  free(rx->ring);
+  free(rx->message.payload);
+
+  if (NULL != rx->inflater) {
+    fpx_inflate_destroy(rx->inflater);
+    free(rx->inflater);
   }
 
-  switch (parse_result) {
-  case -1:
-    // nullptrs passed
-    break;
-  case -2:
-    // bad
-    SET_HTTP_400(thread->server, outgoing_response, "", 0);
-    break;
+  fpx_memset(rx, 0, sizeof(*rx));
 
-  case -3:
-    // no content-length header was passed
-    {
-      switch (incoming_request.method) {
-      case HTTP_POST:
-      case HTTP_PUT:
-      case HTTP_PATCH:
-        // HTTP 411: Length Required
-        SET_HTTP_411(thread->server, outgoing_response, "", 0);
-        break;
+  return;
+}
 
-      default:
-        break;
-      }
-    }
-    break;
+static int _ws_negotiate_deflate(fpx_httpserver_t *srvptr,
+                                 fpx_httprequest_t *reqptr,
+                                 fpx_websocketclient_t *ws, char *out,
+                                 size_t out_len) {
+  // goes along with the first permessage-deflate offer in the client's
+  // Sec-WebSocket-Extensions that we can agree to. returns 0 and writes the
+  // value of our own Sec-WebSocket-Extensions to `out` if there is one,
+  // or -2 if there is none
+  const char *value;
+  size_t value_len;
+
+  if (0 == srvptr->ws_deflate_window_bits)
+    return -2;
+
+  if (0 != fpx_httprequest_get_known_header(
+               reqptr, HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS, &value,
+               &value_len))
+    return -2;
+
+  size_t start = 0;
+
+  while (start < value_len) {
+    size_t end = start;
+    while (end < value_len && ',' != value[end])
+      ++end;
+
+    if (0 == _ws_deflate_offer(srvptr, value + start, end - start, ws, out,
+                               out_len))
+      return 0;
+
+    start = end + 1;
   }
 
-  uint8_t ws_upgrade = FALSE;
-  fpx_websocketcallback_t ws_callback = NULL;
+  return -2;
+}
 
-  if (_is_upgradable(&incoming_request)) {
-    // TODO: Fix this; it is very smelly code
-    // to the point where it feels like a hack
-    // even though it isn't
+static int _ws_deflate_offer(fpx_httpserver_t *srvptr, const char *offer,
+                             size_t len, fpx_websocketclient_t *ws, char *out,
+                             size_t out_len) {
+  // one extension offer; its name, then parameters separated by ';'.
+  // returns 0 if it is permessage-deflate and we accept it, -2 otherwise
+  uint8_t server_bits = srvptr->ws_deflate_window_bits;
+  uint8_t client_bits = 15;
 
-    int endpoint_index = thread->server->max_endpoints;
-    for (int i = 0; i < thread->server->max_endpoints; ++i) {
-      struct _fpx_endpoint *endp = &thread->server->_internal->endpoints[i];
+  // parameters seen so far; none may appear twice
+  uint8_t seen_server_context = FALSE, seen_client_context = FALSE;
+  uint8_t seen_server_bits = FALSE, seen_client_bits = FALSE;
 
-      if (!strcmp(incoming_request.uri, endp->uri)) {
-        endpoint_index = i;
+  if (9 > server_bits || 15 < server_bits)
+    return -2;
+
+  for (size_t param = 0, at = 0; at <= len; ++param) {
+    size_t end = at;
+    while (end < len && ';' != offer[end])
+      ++end;
+
+    // split off "=value", and trim the spaces around both halves
+    size_t name_start = at, name_end = end;
+    size_t value_start = end, value_end = end;
+
+    for (size_t i = at; i < end; ++i) {
+      if ('=' == offer[i]) {
+        name_end = i;
+        value_start = i + 1;
         break;
       }
+    }
 
-      if (FALSE == endp->active)
-        break;
+    while (name_start < name_end &&
+           (' ' == offer[name_start] || '\t' == offer[name_start]))
+      ++name_start;
+    while (name_end > name_start &&
+           (' ' == offer[name_end - 1] || '\t' == offer[name_end - 1]))
+      --name_end;
+    while (value_start < value_end &&
+           (' ' == offer[value_start] || '\t' == offer[value_start] ||
+            '"' == offer[value_start]))
+      ++value_start;
+    while (value_end > value_start &&
+           (' ' == offer[value_end - 1] || '\t' == offer[value_end - 1] ||
+            '"' == offer[value_end - 1]))
+      --value_end;
+
+    const char *name = offer + name_start;
+    size_t name_len = name_end - name_start;
+    uint8_t has_value = (value_start < end);
+
+    // window sizes are 8 to 15; anything else makes the offer unusable
+    int bits = -1;
+    if (value_start < value_end && 2 >= value_end - value_start) {
+      bits = 0;
+      for (size_t i = value_start; i < value_end && 0 <= bits; ++i)
+        bits = ('0' <= offer[i] && '9' >= offer[i])
+                   ? bits * 10 + (offer[i] - '0')
+                   : -1;
     }
 
-    if (endpoint_index < thread->server->max_endpoints) {
-      // WS endpoint available, so we can upgrade
-      char accept_header[32] = {0};
+    at = end + 1;
+
+    if (0 == param) {
+      if (has_value || FALSE == _token_equals(name, name_len,
+                                              "permessage-deflate"))
+        return -2;
+    } else if (_token_equals(name, name_len, "server_no_context_takeover")) {
+      if (has_value || seen_server_context)
+        return -2;
+      seen_server_context = TRUE;
+    } else if (_token_equals(name, name_len, "client_no_context_takeover")) {
+      if (has_value || seen_client_context)
+        return -2;
+      seen_client_context = TRUE;
+    } else if (_token_equals(name, name_len, "server_max_window_bits")) {
+      if (seen_server_bits || 8 > bits || 15 < bits)
+        return -2;
+      seen_server_bits = TRUE;
+
+      // our compressor can not go below 9 bits
+      if (9 > bits)
+        return -2;
+
+      if (bits < server_bits)
+        server_bits = (uint8_t)bits;
+    } else if (_token_equals(name, name_len, "client_max_window_bits")) {
+      if (seen_client_bits || (has_value && (8 > bits || 15 < bits)))
+        return -2;
+      seen_client_bits = TRUE;
+
+      if (has_value)
+        client_bits = (uint8_t)bits;
+    } else {
+      return -2;
+    }
+  }
+
+  // our own compressor comes first; its window may be smaller than the one
+  // we announce, so it shrinks until it fits. without context takeover there
+  // is nothing to keep, and the thread's compressor does the work
+  uint64_t memory = (0 != srvptr->ws_deflate_memory)
+                        ? srvptr->ws_deflate_memory
+                        : UINT64_MAX;
+  uint8_t own_bits = 0;
+
+  if (FALSE == seen_server_context) {
+    own_bits = server_bits;
+
+    while (9 < own_bits && memory < fpx_deflate_memory(own_bits))
+      --own_bits;
+
+    if (memory < fpx_deflate_memory(own_bits))
+      own_bits = 0;
+    else
+      memory -= fpx_deflate_memory(own_bits);
+  }
+
+  // how far back the client's messages may refer is up to us only if it
+  // offered client_max_window_bits; otherwise it is the full 15 bits, or
+  // nothing at all if we say client_no_context_takeover
+  if (seen_client_bits)
+    while (9 < client_bits && memory < (1u << client_bits))
+      --client_bits;
+
+  if (seen_client_context || 9 > client_bits || memory < (1u << client_bits))
+    client_bits = 0;
+
+  int written = snprintf(out, out_len, "permessage-deflate%s",
+                         (0 == own_bits) ? "; server_no_context_takeover" : "");
+
+  if (15 > server_bits && 0 < written && (size_t)written < out_len)
+    written += snprintf(out + written, out_len - written,
+                        "; server_max_window_bits=%d", server_bits);
+
+  if (0 == client_bits && 0 < written && (size_t)written < out_len)
+    written += snprintf(out + written, out_len - written,
+                        "; client_no_context_takeover");
+  else if (seen_client_bits && 0 < written && (size_t)written < out_len)
+    written += snprintf(out + written, out_len - written,
+                        "; client_max_window_bits=%d", client_bits);
+
+  if (0 > written || (size_t)written >= out_len)
+    return -2;
+
+  ws->deflate = TRUE;
+  ws->deflate_server_bits = server_bits;
+  ws->deflate_client_bits = client_bits;
+  ws->deflate_own_bits = own_bits;
+
+  return 0;
+}
+
+static int _token_equals(const char *text, size_t len, const char *token) {
+  // case-insensitive; `token` is lowercase
+  size_t i = 0;
 
-      ws_callback =
-          thread->server->_internal->endpoints[endpoint_index].ws_callback;
+  for (; i < len; ++i) {
+    char c = text[i];
+    if ('A' <= c && 'Z' >= c)
+      c += 'a' - 'A';
 
-      if (0 > _generate_ws_accept_header(&incoming_request, accept_header))
-        return -10;
+    if (c != token[i])
+      return FALSE;
+  }
 
-      outgoing_response.status = 101;
-      fpx_strcpy(outgoing_response.reason, "Switching Protocols");
+  return ('\0' == token[i]);
+}
 
-      fpx_httpresponse_add_header(&outgoing_response, "sec-websocket-accept",
-                                  accept_header);
-      fpx_httpresponse_add_header(&outgoing_response, "upgrade", "websocket");
-      fpx_httpresponse_add_header(&outgoing_response, "connection", "Upgrade");
+static int16_t _ws_inflate(fpx_websocketclient_t *ws, uint64_t max_message,
+                           const char **reason) {
+  // decompresses the message in `ws->rx.message` in place; returns 0, or the
+  // status code to close the connection with
+  struct _ws_receiver *rx = &ws->rx;
+  fpx_websocketframe_t *message = &rx->message;
 
-      ws_upgrade = TRUE;
-    } else {
-      SET_HTTP_404(thread->server, outgoing_response, "", 0);
+  if (NULL == rx->inflater) {
+    rx->inflater = (fpx_inflate_t *)malloc(sizeof(fpx_inflate_t));
+
+    if (NULL == rx->inflater ||
+        0 != fpx_inflate_init(rx->inflater, ws->deflate_client_bits)) {
+      free(rx->inflater);
+      rx->inflater = NULL;
 
-      ws_upgrade = FALSE;
+      *reason = "out of memory";
+      return 1011;
     }
   }
 
-  if (outgoing_response.status > 0) {
-    // that means we already set a response!
-    // specifically for a bad request or similar
+  fpx_inflate_t *inflater = rx->inflater;
 
-    // now we send it!
+  switch (fpx_inflate_message(inflater, message->payload,
+                              message->payload_length, max_message)) {
+  case 0:
+    break;
 
-    _on_response_ready(thread, &incoming_request, &outgoing_response, idx);
+  case -5:
+    *reason = "message too big";
+    return 1009;
 
-    if (TRUE == ws_upgrade) {
-      _upgrade_to_ws(thread, idx, ws_callback);
-    }
+  case -4:
+    *reason = "invalid compressed data";
+    return 1007;
 
-    return 0;
+  default:
+    *reason = "out of memory";
+    return 1011;
   }
 
-  // do endpoint things
-  // (this includes running the programmer's callback)
-  _handle_http_endpoint(thread, &incoming_request, &outgoing_response);
+  // the output becomes the message, and the compressed message's buffer is
+  // where the next one gets decompressed into
+  uint8_t *compressed = message->payload;
+  size_t compressed_allocated = message->payload_allocated;
 
-  // keepalive
-  _set_keepalive(&incoming_request, &outgoing_response);
+  message->payload = inflater->out;
+  message->payload_length = inflater->out_len;
+  message->payload_allocated = inflater->out_allocated;
+  message->reserved1 = FALSE;
 
-  _on_response_ready(thread, &incoming_request, &outgoing_response, idx);
+  inflater->out = compressed;
+  inflater->out_len = 0;
+  inflater->out_allocated = compressed_allocated;
 
   return 0;
 }
 
-static int _disconnect_client(struct _thread *t, int idx,
-                              uint8_t close_socket) {
-  if (TRUE == close_socket) {
-#if defined(_WIN32) || defined(_WIN64)
-    FPX_DEBUG("Closing fd: %llu\n", t->pfds[idx].fd);
-#else
-    FPX_DEBUG("Closing fd: %d\n", t->pfds[idx].fd);
-#endif
-    close(t->pfds[idx].fd);
-  }
+static fpx_deflate_t *_ws_deflater(struct _thread *t, uint8_t window_bits) {
+  // the compressor of `t` for the given window size; NULL on failure
+  fpx_deflate_t **slot = &t->deflaters[window_bits - 9];
 
-  for (int i = idx; i < (t->connection_count - 1); ++i) {
-    t->pfds[i] = t->pfds[i + 1];
-    t->client_data[i] = t->client_data[i + 1];
-  }
+  if (NULL != *slot)
+    return *slot;
 
-  fpx_memset(&t->pfds[t->connection_count - 1], -1, sizeof(t->pfds[0]));
-  fpx_memset(&t->client_data[t->connection_count - 1], -1,
-             sizeof(t->client_data[0]));
+  fpx_deflate_t *deflater = (fpx_deflate_t *)malloc(sizeof(fpx_deflate_t));
+  if (NULL == deflater)
+    return NULL;
 
-  t->connection_count--;
+  if (0 != fpx_deflate_init(deflater, window_bits)) {
+    free(deflater);
+    return NULL;
+  }
 
-  return 0;
+  *slot = deflater;
+  return deflater;
 }
 
-static int _http_parse_request_line(const char *reql,
-                                    fpx_httprequest_t *reqptr) {
-  int reqline_len;
-  const char *reql_start = reql;
-
-  reqline_len = fpx_substringindex(reql, "\r\n") + 2 /*2 = CRLF*/;
-
-  fpx_httpmethod_t method;
-  if (0 == strncmp(reql, "GET ", 4)) {
-    method = HTTP_GET;
-    reql += 4;
-  } else if (0 == strncmp(reql, "POST ", 5)) {
-    method = HTTP_POST;
-    reql += 5;
-  } else if (0 == strncmp(reql, "OPTIONS ", 8)) {
-    method = HTTP_OPTIONS;
-    reql += 8;
-  } else if (0 == strncmp(reql, "HEAD ", 5)) {
-    method = HTTP_HEAD;
-    reql += 5;
-  } else if (0 == strncmp(reql, "DELETE ", 7)) {
-    method = HTTP_DELETE;
-    reql += 7;
-  } else if (0 == strncmp(reql, "PUT ", 4)) {
-    method = HTTP_PUT;
-    reql += 4;
-  } else if (0 == strncmp(reql, "TRACE ", 6)) {
-    method = HTTP_TRACE;
-    reql += 6;
-  } else if (0 == strncmp(reql, "CONNECT ", 8)) {
-    method = HTTP_CONNECT;
-    reql += 8;
-  } else
-    method = HTTP_ERROR;
-
-  fpx_httprequest_set_method(reqptr, method);
-
-  if (method == HTTP_ERROR)
-    return -2; // bad METHOD
-
-  if (*reql != '/')
-    return -3; // bad URI
+static int _ws_subscription(fpx_httpserver_t *srvptr, int fd,
+                            const char *topic, int command_type) {
+  // fpx_httpserver_subscribe() and fpx_httpserver_unsubscribe()
+  SRV_ASSERT(srvptr);
+  if (NULL == topic)
+    return -1;
 
-  {
-    char *temp_reql = (char *)reql;
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
 
-    int uri_len = fpx_substringindex(reql, " ");
-    temp_reql[uri_len] = 0;
-    if (0 < fpx_httprequest_set_uri(reqptr, reql))
-      return -4; // URI too long
+  if (FALSE == meta->is_listening || NULL == meta->ws_threads)
+    return -3;
 
-    temp_reql[uri_len] = ' ';
+  size_t topic_len = fpx_getstringlength(topic);
+  if (0 == topic_len || TOPIC_MAX_LENGTH <= topic_len)
+    return -4;
 
-    reql += uri_len + 1;
-  }
+  struct _thread *t = _ws_in_callback.thread;
+  struct _client_meta *client = _ws_in_callback.client;
 
-  if (0 != strncmp(reql, "HTTP/", 5))
-    return -5; // bad VERSION
+  if (NULL != t && t->server == srvptr && client->fd == fd) {
+    // we are in the callback of this client, on the thread that owns it
+    if (WsSubscribe == command_type)
+      return _topic_join(t, client, topic, topic_len);
 
-  reql += 5;
+    struct _topic *found = _topic_find(t, topic, topic_len, FALSE);
+    if (NULL != found)
+      _topic_leave(t, client, found);
 
-  int ver_len = fpx_substringindex(reql, "\r\n");
-  if (0 > ver_len)
-    return -5;
+    return 0;
+  }
 
-  char ver[8] = {0};
-  fpx_memset(ver, 0, sizeof(ver));
-  fpx_memcpy(ver, reql, ver_len);
+  // only the thread that owns the client knows about it
+  struct _ws_owner owner;
+  if (0 != _ws_owner_get(srvptr, fd, &owner))
+    return -6;
 
-  if (0 < fpx_httprequest_set_version(reqptr, ver))
-    return -6; // VERSION too long
+  struct _ws_command *command =
+      (struct _ws_command *)malloc(sizeof(struct _ws_command));
+  if (NULL == command)
+    return ENOMEM;
 
-  reql += ver_len + 2;
+  command->type = command_type;
+  command->fd = fd;
+  command->generation = owner.generation;
+  command->message = NULL;
+  command->deflated = NULL;
+  command->topic_len = topic_len;
+  fpx_memcpy(command->topic, topic, topic_len);
 
-  if (reql - reql_start != reqline_len)
-    return -7; // something went horribly wrong
+  _ws_command_post(owner.thread, command);
 
-  return reqline_len;
+  return 0;
 }
 
-static int _http_parse_request(char *read_buffer, int read_buffer_length,
-                               fpx_httprequest_t *reqptr) {
-  char *req_line = NULL;
-  char *headers = NULL;
-  char *body = NULL;
+static int _ws_owner_set(fpx_httpserver_t *srvptr, struct _thread *t,
+                         struct _client_meta *client) {
+  // `t` is about to own `client`; returns 0, or ENOMEM
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+  int fd = client->fd;
 
-  req_line = read_buffer;
-  for (int i = 0; i < read_buffer_length && req_line[i] == ' '; ++i, ++req_line)
-    ;
+  pthread_mutex_lock(&meta->ws_owner_mutex);
 
-  if (!(*req_line == 'O' || // OPTIONS
-        *req_line == 'G' || // GET
-        *req_line == 'H' || // HEAD
-        *req_line == 'P' || // POST, PUT
-        *req_line == 'D' || // DELETE
-        *req_line == 'T' || // TRACE
-        *req_line == 'C'    // CONNECT
-        ))
-    return -2;
+  if (fd >= meta->ws_owner_capacity) {
+    int capacity = (0 < meta->ws_owner_capacity) ? meta->ws_owner_capacity : 64;
+    while (fd >= capacity)
+      capacity *= 2;
 
-  // parse request line into request object
-  {
-    int req_line_len = _http_parse_request_line(req_line, reqptr);
+    struct _ws_owner *owners = (struct _ws_owner *)realloc(
+        meta->ws_owners, capacity * sizeof(struct _ws_owner));
 
-    if (req_line_len < 0)
-      return -2;
+    if (NULL == owners) {
+      pthread_mutex_unlock(&meta->ws_owner_mutex);
+      return ENOMEM;
+    }
+
+    fpx_memset(&owners[meta->ws_owner_capacity], 0,
+               (capacity - meta->ws_owner_capacity) * sizeof(struct _ws_owner));
 
-    headers = &read_buffer[req_line_len];
+    meta->ws_owners = owners;
+    meta->ws_owner_capacity = capacity;
   }
 
-  int headers_total_len = fpx_substringindex(headers, "\r\n\r\n");
+  // 0 means "nobody"; skip it when the counter wraps around
+  if (0 == ++meta->ws_generation)
+    ++meta->ws_generation;
 
-  if (headers_total_len > MAX_HEADERS - 1) {
-    // HTTP 431 | request header fields too large
-  }
+  client->ws.generation = meta->ws_generation;
 
-  // separate key from value
-  // and store inside of request object
-  {
-    char *current_header = headers;
+  meta->ws_owners[fd].thread = t;
+  meta->ws_owners[fd].client = client;
+  meta->ws_owners[fd].generation = client->ws.generation;
 
-    while (TRUE) {
-      int colon_index = fpx_substringindex(current_header, ":");
-      int crlf_index = fpx_substringindex(current_header, "\r\n");
-      if (colon_index > crlf_index || colon_index == -1)
-        break; // no more headers left
+  pthread_mutex_unlock(&meta->ws_owner_mutex);
 
-      current_header[colon_index] = 0;
-      current_header[crlf_index] = 0;
+  return 0;
+}
 
-      if (0 > fpx_httprequest_add_header(reqptr, current_header,
-                                         current_header + colon_index + 1))
-        return -2;
+static void _ws_owner_clear(fpx_httpserver_t *srvptr,
+                            struct _client_meta *client) {
+  // before the descriptor of `client` is closed, and can be handed out again
+  if (0 == client->ws.generation)
+    return;
+
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
 
-      current_header[colon_index] = ':'; // set back to colon
-      current_header[crlf_index] = '\r'; // set back to CR
+  pthread_mutex_lock(&meta->ws_owner_mutex);
 
-      current_header += crlf_index + 2;
-    }
+  if (client->fd < meta->ws_owner_capacity &&
+      client->ws.generation == meta->ws_owners[client->fd].generation)
+    fpx_memset(&meta->ws_owners[client->fd], 0, sizeof(struct _ws_owner));
 
-    body = current_header + 2;
-  }
+  pthread_mutex_unlock(&meta->ws_owner_mutex);
 
-  char content_length_value[32];
-  if (-2 == fpx_httprequest_get_header(reqptr, "content-length",
-                                       content_length_value,
-                                       sizeof(content_length_value))) {
-    // no content-length header in POST request body
-    // so we just return now
-    return -3;
+  client->ws.generation = 0;
+
+  return;
+}
+
+static int _ws_owner_get(fpx_httpserver_t *srvptr, int fd,
+                         struct _ws_owner *out) {
+  // returns 0 and the owner of the client on `fd`, or -1 if there is none
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+  int retval = -1;
+
+  pthread_mutex_lock(&meta->ws_owner_mutex);
+
+  if (0 <= fd && fd < meta->ws_owner_capacity &&
+      0 != meta->ws_owners[fd].generation) {
+    *out = meta->ws_owners[fd];
+    retval = 0;
   }
 
-  // now copy body over
-  fpx_httprequest_append_body(reqptr, body, fpx_strint(content_length_value));
+  pthread_mutex_unlock(&meta->ws_owner_mutex);
 
-  return 0;
+  return retval;
 }
 
-static int _apply_default_headers(fpx_httpserver_t *srvptr,
-                                  fpx_httpresponse_t *resptr) {
-  char *def_headers = srvptr->_internal->default_headers;
+static struct _client_meta *_ws_owner_client(struct _thread *t,
+                                             struct _ws_command *command) {
+  // the client `command` was meant for, if it is still connected to `t`;
+  // not some later client that got the same descriptor
+  struct _ws_owner owner;
 
-  char key[32];
-  char value[512];
+  if (0 != _ws_owner_get(t->server, command->fd, &owner) || owner.thread != t ||
+      owner.generation != command->generation)
+    return NULL;
 
-  while (*def_headers != 0) {
-    int colon = fpx_substringindex(def_headers, ":");
-    int crlf = fpx_substringindex(def_headers, "\r\n");
+  return owner.client;
+}
 
-    if (colon > crlf || -1 == colon)
-      break;
+static int _ws_command_post(struct _thread *t, struct _ws_command *command) {
+  command->next = NULL;
+
+  pthread_mutex_lock(&t->loop_mutex);
 
-    fpx_memset(key, 0, sizeof(key));
-    fpx_memset(value, 0, sizeof(value));
+  if (NULL == t->inbox_tail)
+    t->inbox = command;
+  else
+    t->inbox_tail->next = command;
 
-    fpx_memcpy(key, def_headers, colon);
-    fpx_memcpy(value, def_headers + colon + 1, crlf - (colon + 1));
+  t->inbox_tail = command;
 
-    int result = fpx_httpresponse_add_header(resptr, key, value);
-    if (result != 0)
-      return result;
+  pthread_mutex_unlock(&t->loop_mutex);
 
-    def_headers += crlf + 2;
+#if !(defined(_WIN32) || defined(_WIN64))
+  uint8_t byte = 0;
+  if (-1 == write(t->wake_fds[1], &byte, 1)) {
+    // pipe full; the thread has a wakeup coming already
   }
+#endif
 
   return 0;
 }
 
-static int _send_response(fpx_httprequest_t *reqptr, fpx_httpresponse_t *resptr,
-                          int client_fd) {
-  if (NULL == resptr)
-    return -1;
+static void _ws_command_run(struct _thread *t, struct _ws_command *command) {
+  // carries out (and frees) a command taken from the inbox of `t`
+  switch (command->type) {
+  case WsPublish: {
+    struct _topic *topic =
+        _topic_find(t, command->topic, command->topic_len, FALSE);
 
-  if (client_fd < 0)
-    return -2;
+    if (NULL != topic)
+      _topic_deliver(t, topic, command->message, command->deflated);
 
-  char write_buffer[BUFFER_DEFAULT] = {0};
-  char *write_copy = write_buffer;
-  fpx_memset(write_buffer, 0, sizeof(write_buffer));
+    _ws_broadcast_release(command->message);
+    if (NULL != command->deflated)
+      _ws_broadcast_release(command->deflated);
+    break;
+  }
 
-// to ignore SIGPIPE when writing to a disconnected client
-#if defined(_WIN32) || defined(_WIN64)
-  int send_flags = 0;
-#else
-  int send_flags = MSG_NOSIGNAL;
-#endif
+  case WsSubscribe:
+  case WsUnsubscribe: {
+    struct _client_meta *client = _ws_owner_client(t, command);
 
-  // some prerequisites (content-length header etc.)
-  {
-    char content_length_header[32] = {0};
-    if (-2 == fpx_httpresponse_get_header(resptr, "content-length",
-                                          content_length_header,
-                                          sizeof(content_length_header))) {
-      // header not yet set, so we set it
-      fpx_intstr(resptr->content.body_len, content_length_header);
-      fpx_httpresponse_add_header(resptr, "content-length",
-                                  content_length_header);
+    if (NULL == client)
+      break;
+
+    if (WsSubscribe == command->type) {
+      if (0 != _topic_join(t, client, command->topic, command->topic_len)) {
+        FPX_WARN("Could not subscribe client to a topic\n");
+      }
+    } else {
+      struct _topic *topic =
+          _topic_find(t, command->topic, command->topic_len, FALSE);
+
+      if (NULL != topic)
+        _topic_leave(t, client, topic);
     }
+    break;
   }
 
-  // response status line
-  {
-    char version[16] = {0};
-    fpx_httpresponse_get_version(resptr, version, sizeof(version));
+  case WsSend: {
+    struct _client_meta *client = _ws_owner_client(t, command);
 
-    write_copy += snprintf(write_copy, 1024, "HTTP/%s %hu %s\r\n", version,
-                           resptr->status, resptr->reason);
-  }
+    struct _ws_broadcast *message = command->message;
 
-  // headers
-  {
-    fpx_memcpy(write_copy, resptr->content.headers,
-               resptr->content.headers_len);
-    write_copy += resptr->content.headers_len;
+    if (NULL == client) {
+      // gone already
+    } else if (client->ws.deflate) {
+      const uint8_t *payload = message->data + message->header_length;
+
+      if (0 != _ws_send_message(t, client, message->data[0] & 0x0f, payload,
+                                message->length - message->header_length)) {
+        FPX_WARN("Could not send to a client; disconnecting\n");
+        _disconnect_client(t, client->slot, TRUE);
+      }
+    } else {
+      _ws_deliver(t, client, message, NULL);
+    }
 
-    fpx_memcpy(write_copy, "\r\n", 2);
-    write_copy += 2;
+    _ws_broadcast_release(message);
+    if (NULL != command->deflated)
+      _ws_broadcast_release(command->deflated);
+    break;
+  }
   }
 
-  int sent_success = 0;
+  free(command);
 
-  // body
-  if (resptr->content.body_len > 0 &&
-      (NULL == reqptr || FALSE == (reqptr->method & HTTP_HEAD))) {
-    int content_written = 0;
+  return;
+}
+
+static struct _ws_broadcast *_ws_broadcast_new(enum websocket_opcode opcode,
+                                               uint8_t compressed,
+                                               const uint8_t *payload,
+                                               size_t payload_length) {
+  // frames a published message; the reference it starts with is the caller's
+  fpx_websocketframe_t frame;
+  fpx_websocketframe_init(&frame);
+
+  frame.final = TRUE;
+  frame.reserved1 = compressed;
+  frame.opcode = opcode;
+  frame.payload_length = payload_length;
 
-    int content_length;
-    char content_length_stringvalue[32] = {0};
+  uint8_t header[FPX_WEBSOCKET_HEADER_MAX];
+  int header_len = fpx_websocketframe_write_header(&frame, header);
 
-    fpx_httpresponse_get_header(resptr, "content-length",
-                                content_length_stringvalue,
-                                sizeof(content_length_stringvalue));
-    content_length = fpx_strint(content_length_stringvalue);
+  struct _ws_broadcast *message = (struct _ws_broadcast *)malloc(
+      sizeof(struct _ws_broadcast) + header_len + payload_length);
+  if (NULL == message)
+    return NULL;
+
+  atomic_init(&message->references, 1);
+  message->length = header_len + payload_length;
+  message->header_length = header_len;
+
+  fpx_memcpy(message->data, header, header_len);
+  if (0 < payload_length)
+    fpx_memcpy(message->data + header_len, payload, payload_length);
+
+  return message;
+}
 
-    while (content_written < content_length) {
+static struct _ws_broadcast *_ws_broadcast_deflate(fpx_httpserver_t *srvptr,
+                                                   enum websocket_opcode opcode,
+                                                   const uint8_t *payload,
+                                                   size_t payload_length) {
+  // the compressed copy of a published message, or NULL if there is no use
+  // in having one
+  struct _fpx_httpserver_metadata *meta = srvptr->_internal;
+  struct _ws_broadcast *message = NULL;
 
-      int to_write = (content_length - content_written);
-      int remaining_space =
-          (sizeof(write_buffer) - (write_copy - write_buffer));
-      if (to_write > remaining_space)
-        to_write = remaining_space;
+  if (0 == srvptr->ws_deflate_window_bits ||
+      WS_DEFLATE_MIN_LENGTH > payload_length)
+    return NULL;
 
-      fpx_memcpy(write_copy, resptr->content.body + content_written, to_write);
-      write_copy += to_write;
-      content_written += to_write;
+  pthread_mutex_lock(&meta->publish_mutex);
 
-      sent_success =
-          send(client_fd, write_buffer, write_copy - write_buffer, send_flags);
+  if (NULL == meta->publish_deflater) {
+    fpx_deflate_t *deflater = (fpx_deflate_t *)malloc(sizeof(fpx_deflate_t));
 
-      write_copy = write_buffer;
+    if (NULL != deflater &&
+        0 != fpx_deflate_init(deflater, srvptr->ws_deflate_window_bits)) {
+      free(deflater);
+      deflater = NULL;
     }
-  } else {
-    sent_success =
-        send(client_fd, write_buffer, write_copy - write_buffer, send_flags);
-  }
 
-  if (-1 == sent_success) {
-    if (errno == EPIPE)
-      return -10;
+    meta->publish_deflater = deflater;
   }
 
-  return 0;
+  fpx_deflate_t *deflater = meta->publish_deflater;
+
+  if (NULL != deflater &&
+      0 == fpx_deflate_message(deflater, payload, payload_length, FALSE) &&
+      deflater->out_len < payload_length)
+    message = _ws_broadcast_new(opcode, TRUE, deflater->out, deflater->out_len);
+
+  pthread_mutex_unlock(&meta->publish_mutex);
+
+  return message;
 }
 
-static int _ws_frame_validate(fpx_websocketframe_t *incoming_frame,
-                              fpx_websocketclient_t *cliptr, int fd) {
-  if (FALSE == incoming_frame->mask_set) {
-    const uint8_t msg[] = "no mask set";
-    int sent = fpx_websocket_send_close(fd, 1002, msg, sizeof(msg) - 1, FALSE);
+static void _ws_broadcast_release(struct _ws_broadcast *message) {
+  if (1 == atomic_fetch_sub(&message->references, 1))
+    free(message);
 
-    if (0 != sent) {
-      FPX_ERROR("Received an unmasked websocket frame from a client, but could "
-                "not send a closing frame.\tErrno: %d",
-                sent);
-    } else {
-      cliptr->flags |= CLOSE_SENT;
-    }
+  return;
+}
 
-    return FALSE;
+static uint32_t _topic_hash(const char *name, size_t len) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= (uint8_t)name[i];
+    hash *= 16777619u;
   }
 
-  if (incoming_frame->reserved1 || incoming_frame->reserved2 ||
-      incoming_frame->reserved3) {
-    const uint8_t msg[] = "no extensions negotiated";
-    int sent = fpx_websocket_send_close(fd, 1002, msg, sizeof(msg) - 1, FALSE);
+  return hash;
+}
 
-    if (0 != sent) {
-      FPX_ERROR("Received a websocket frame with one or more reserved bits set "
-                "while but no extensions were negotiated, and failed to send a "
-                "closing frame.\tErrno: %d",
-                sent);
-    } else {
-      cliptr->flags |= CLOSE_SENT;
-    }
+static struct _topic *_topic_find(struct _thread *t, const char *name,
+                                  size_t len, uint8_t create) {
+  // returns NULL if the topic does not exist and `create` is not set,
+  // or if creating it fails
+  uint32_t hash = _topic_hash(name, len);
+  struct _topic **bucket = &t->topics[hash % TOPIC_BUCKETS];
 
-    return FALSE;
-  }
+  for (struct _topic *topic = *bucket; NULL != topic; topic = topic->next)
+    if (topic->hash == hash && topic->name_len == len &&
+        0 == memcmp(topic->name, name, len))
+      return topic;
 
-  return TRUE;
+  if (FALSE == create)
+    return NULL;
+
+  struct _topic *topic = (struct _topic *)calloc(1, sizeof(struct _topic));
+  if (NULL == topic)
+    return NULL;
+
+  topic->hash = hash;
+  topic->name_len = len;
+  fpx_memcpy(topic->name, name, len);
+
+  topic->next = *bucket;
+  *bucket = topic;
+
+  return topic;
 }
 
-static void _handle_control_frame(fpx_websocketframe_t *incoming_frame,
-                                  fpx_websocketclient_t *cliptr, int fd) {
-  switch (incoming_frame->opcode) {
-  case WEBSOCKET_CLOSE:
-    // close
+static int _topic_join(struct _thread *t, struct _client_meta *client,
+                       const char *name, size_t len) {
+  // returns 0 on success (also if `client` was subscribed already), or ENOMEM
+  struct _topic *topic = _topic_find(t, name, len, TRUE);
+  if (NULL == topic)
+    return ENOMEM;
 
-    cliptr->flags |= CLOSE_RECV;
+  fpx_websocketclient_t *ws = &client->ws;
 
-    if (FALSE == (cliptr->flags & CLOSE_SENT)) {
-      fpx_websocketframe_t close_frame;
+  for (int i = 0; i < ws->topic_count; ++i)
+    if (ws->topics[i] == topic)
+      return 0;
 
-      fpx_websocketframe_init(&close_frame);
+  if (ws->topic_count == ws->topic_capacity) {
+    int new_capacity = (0 == ws->topic_capacity) ? 4 : ws->topic_capacity * 2;
+    struct _topic **new_topics = (struct _topic **)realloc(
+        ws->topics, new_capacity * sizeof(struct _topic *));
 
-      close_frame.final = TRUE;
-      close_frame.opcode = WEBSOCKET_CLOSE;
+    if (NULL == new_topics)
+      goto failed;
 
-      fpx_websocketframe_append_payload(&close_frame, incoming_frame->payload,
-                                        incoming_frame->payload_length);
+    ws->topics = new_topics;
+    ws->topic_capacity = new_capacity;
+  }
 
-      int sent_status = fpx_websocketframe_send(&close_frame, fd);
-      if (sent_status > 0) {
-        // error happened
-        if (sent_status == EPIPE)
-          FPX_WARN("Broken client pipe\n");
-        else
-          perror("fpx_websocketframe_send()");
-      }
+  if (topic->subscriber_count == topic->subscriber_capacity) {
+    int new_capacity =
+        (0 == topic->subscriber_capacity) ? 8 : topic->subscriber_capacity * 2;
+    struct _client_meta **new_subscribers = (struct _client_meta **)realloc(
+        topic->subscribers, new_capacity * sizeof(struct _client_meta *));
 
-      fpx_websocketframe_destroy(&close_frame);
-    }
-    break;
+    if (NULL == new_subscribers)
+      goto failed;
 
-  case WEBSOCKET_PING:
-    // ping
+    topic->subscribers = new_subscribers;
+    topic->subscriber_capacity = new_capacity;
+  }
 
-    {
-      fpx_websocketframe_t pong_frame;
-      fpx_websocketframe_init(&pong_frame);
+  ws->topics[ws->topic_count++] = topic;
+  topic->subscribers[topic->subscriber_count++] = client;
 
-      pong_frame.final = TRUE;
-      pong_frame.opcode = WEBSOCKET_PONG;
+  return 0;
 
-      fpx_websocketframe_append_payload(&pong_frame, incoming_frame->payload,
-                                        incoming_frame->payload_length);
+failed:
+  if (0 == topic->subscriber_count && topic != t->delivering)
+    _topic_drop(t, topic);
 
-      int sent_status = fpx_websocketframe_send(&pong_frame, fd);
-      if (sent_status > 0) {
-        // error happened
-        if (sent_status == EPIPE)
-          FPX_WARN("Broken client pipe");
-        else
-          perror("fpx_websocketframe_send()");
-      }
+  return ENOMEM;
+}
 
-      fpx_websocketframe_destroy(&pong_frame);
-    }
-    break;
+static void _topic_leave(struct _thread *t, struct _client_meta *client,
+                         struct _topic *topic) {
+  // both lists are unordered, so the last entry fills the gap
+  fpx_websocketclient_t *ws = &client->ws;
 
-  case WEBSOCKET_PONG:
-    // pong
+  for (int i = 0; i < ws->topic_count; ++i) {
+    if (ws->topics[i] != topic)
+      continue;
+
+    ws->topics[i] = ws->topics[--ws->topic_count];
     break;
+  }
 
-  default:
-    // ???? what
+  for (int i = 0; i < topic->subscriber_count; ++i) {
+    if (topic->subscribers[i] != client)
+      continue;
+
+    topic->subscribers[i] = topic->subscribers[--topic->subscriber_count];
     break;
   }
 
+  if (0 == topic->subscriber_count && topic != t->delivering)
+    _topic_drop(t, topic);
+
   return;
 }
 
-static int _ws_handle_client(struct _thread *thread, int idx) {
-  // we enter this function assuming the client socket is ready to be read from
+static void _topic_leave_all(struct _thread *t, struct _client_meta *client) {
+  fpx_websocketclient_t *ws = &client->ws;
 
-  struct _client_meta *cliptr = &(thread->client_data[idx]);
+  while (0 < ws->topic_count)
+    _topic_leave(t, client, ws->topics[ws->topic_count - 1]);
 
-  // read from socket
-  int fd = thread->pfds[idx].fd;
+  free(ws->topics);
+  ws->topics = NULL;
+  ws->topic_capacity = 0;
 
-  // READ READ READ
-  // https://datatracker.ietf.org/doc/html/rfc6455#section-5.2
+  return;
+}
 
-  fpx_websocketframe_t incoming_frame;
-  fpx_websocketframe_init(&incoming_frame);
+static void _topic_drop(struct _thread *t, struct _topic *topic) {
+  // unlinks and frees the topic; it must not have any subscribers left
+  struct _topic **link = &t->topics[topic->hash % TOPIC_BUCKETS];
 
-  int parse_result = _ws_parse_request(fd, &incoming_frame);
-  if (parse_result == -1) {
-    _disconnect_client(thread, idx, TRUE);
-    return -1;
-  }
+  while (*link != topic)
+    link = &(*link)->next;
 
-  if (0 > parse_result) {
-    const uint8_t *msg = NULL;
-    switch (parse_result) {
-    case -1:
-      // too short
-      msg = (uint8_t *)"frame too short";
-      break;
+  *link = topic->next;
 
-    case -2:
-      // unmasked
-      msg = (uint8_t *)"client frame unmasked";
-      break;
+  free(topic->subscribers);
+  free(topic);
 
-    case -3:
-      msg = (uint8_t *)"incomplete frame received";
-      break;
-    }
+  return;
+}
 
-    fpx_websocket_send_close(fd, 1002, msg, fpx_getstringlength((char *)msg),
-                             FALSE);
-  }
+static void _topic_deliver(struct _thread *t, struct _topic *topic,
+                           struct _ws_broadcast *plain,
+                           struct _ws_broadcast *deflated) {
+  // sends the message to every subscriber. clients that fall too far behind
+  // are disconnected, which takes them out of `subscribers`, so we walk
+  // backwards and keep the topic around even if it runs empty
+  t->delivering = topic;
 
-  if (FALSE == (cliptr->ws.flags & CLOSE_SENT)) {
-    if (FALSE == _ws_frame_validate(&incoming_frame, &cliptr->ws, fd)) {
-      fpx_websocketframe_destroy(&incoming_frame);
-      return -1;
-    }
-  }
+  for (int i = topic->subscriber_count - 1; i >= 0; --i)
+    _ws_deliver(t, topic->subscribers[i], plain, deflated);
 
-  if (0 > parse_result)
-    return -1;
+  t->delivering = NULL;
 
-  time(&cliptr->last_time);
+  if (0 == topic->subscriber_count)
+    _topic_drop(t, topic);
 
-  for (uint64_t i = 0; i < incoming_frame.payload_length; ++i)
-    incoming_frame.payload[i] ^= incoming_frame.masking_key[i % 4];
+  return;
+}
 
-  if (FALSE == (incoming_frame.opcode & 0x80) &&
-      FALSE == (cliptr->ws.flags & CLOSE_SENT)) {
-    // NOT a control frame
-    cliptr->ws.callback(&incoming_frame, fd, &(cliptr->in_address));
-  } else if (125 >= incoming_frame.payload_length) {
-    // 125 is max payload length for control frames
-    _handle_control_frame(&incoming_frame, &cliptr->ws, fd);
-  }
+static void _ws_deliver(struct _thread *t, struct _client_meta *client,
+                        struct _ws_broadcast *plain,
+                        struct _ws_broadcast *deflated) {
+  // sends a framed message to one client; as far as the socket takes it
+  // right away, the rest is queued. `deflated` is compressed with the
+  // server's window, and may be NULL
+  struct _ws_broadcast *message = plain;
+  size_t offset = 0;
 
-  if ((cliptr->ws.flags & (CLOSE_SENT | CLOSE_RECV)) ==
-      (CLOSE_SENT | CLOSE_RECV))
-    // we close
-    _disconnect_client(thread, idx, TRUE);
+  if (client->ws.flags & CLOSE_SENT)
+    return;
 
-  fpx_websocketframe_destroy(&incoming_frame);
+  if (NULL != deflated && client->ws.deflate &&
+      client->ws.deflate_server_bits >= t->server->ws_deflate_window_bits) {
+    message = deflated;
 
-  return 0;
-}
+    // the client's window now holds a message ours does not
+    client->ws.deflate_fresh = TRUE;
+  }
+
+  if (NULL == client->output.head) {
+#if defined(_WIN32) || defined(_WIN64)
+    int send_flags = 0;
+#else
+    int send_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#endif
 
-// return 0 on success; -1 on passed nullptrs; -2 if the data is bad; -3 if data
-// too long
-static int _ws_parse_request(int fd, fpx_websocketframe_t *output) {
-  uint8_t readbuf[BUFFER_DEFAULT] = {0};
+    struct iovec iov = {message->data, message->length};
+    long written = _send_iov(client->fd, &iov, 1, send_flags);
 
-  int minimum_length = 1 + // meta-byte
-                       1 + // length-byte
-                       4;  // masking key
+    if (0 > written) {
+      _disconnect_client(t, client->slot, TRUE);
+      return;
+    }
 
-  int amount_read = recv(fd, (char *)readbuf, sizeof(readbuf), 0);
+    offset = written;
 
-  if (minimum_length > amount_read) {
-    return -1;
+    if (offset == message->length)
+      return;
   }
 
-  output->final = (readbuf[0] >> 7) & 0x01; // MSB; 1 or 0
-  output->reserved1 = (readbuf[0] >> 6) & 0x01;
-  output->reserved2 = (readbuf[0] >> 5) & 0x01;
-  output->reserved3 = (readbuf[0] >> 4) & 0x01;
-
-  output->opcode = (readbuf[0] & 0xf);
+  if (0 > _pending_append_shared(&client->output, message, offset)) {
+    FPX_WARN("Client is too far behind; disconnecting\n");
+    _disconnect_client(t, client->slot, TRUE);
+    return;
+  }
 
-  output->mask_set = (readbuf[1] >> 7) & 0x01;
+  _watch_writable(t, client, TRUE);
 
-  uint8_t length_first = readbuf[1] & 0x7f;
+  return;
+}
 
-  if (FALSE == output->mask_set)
-    return -2;
+static int _ws_send_message(struct _thread *t, struct _client_meta *client,
+                            enum websocket_opcode opcode,
+                            const uint8_t *payload, size_t payload_length) {
+  // sends a message of our own, compressed for permessage-deflate clients;
+  // only on the thread that owns `client`. returns what _ws_write() does
+  fpx_websocketclient_t *ws = &client->ws;
+  fpx_websocketframe_t frame;
+  fpx_websocketframe_init(&frame);
+
+  frame.final = TRUE;
+  frame.opcode = opcode;
+  frame.payload = (uint8_t *)payload;
+  frame.payload_length = payload_length;
+
+  if (FALSE == ws->deflate || 0 == payload_length)
+    return _ws_write(t, client, &frame);
+
+  if (0 == ws->deflate_own_bits) {
+    // every message on its own; only worth it for the longer ones
+    fpx_deflate_t *deflater = NULL;
+
+    if (WS_DEFLATE_MIN_LENGTH <= payload_length)
+      deflater = _ws_deflater(t, ws->deflate_server_bits);
+
+    if (NULL != deflater &&
+        0 == fpx_deflate_message(deflater, payload, payload_length, FALSE) &&
+        deflater->out_len < payload_length) {
+      frame.reserved1 = TRUE;
+      frame.payload = deflater->out;
+      frame.payload_length = deflater->out_len;
+    }
 
-  uint8_t *readbuf_copy = readbuf + 2;
-  uint64_t p_length;
+    return _ws_write(t, client, &frame);
+  }
 
-  {
-    // check payload length
+  if (NULL == ws->deflater) {
+    ws->deflater = (fpx_deflate_t *)malloc(sizeof(fpx_deflate_t));
 
-    if (126 > length_first) {
-      p_length = length_first;
+    if (NULL != ws->deflater &&
+        0 != fpx_deflate_init(ws->deflater, ws->deflate_own_bits)) {
+      free(ws->deflater);
+      ws->deflater = NULL;
+    }
 
-    } else if (126 == length_first) {
-      if (amount_read < minimum_length + 2)
-        return -1;
+    ws->deflate_fresh = TRUE;
+  }
 
-      uint16_t extended = *((uint16_t *)readbuf_copy);
-      fpx_endian_swap_if_little(&extended, sizeof(extended));
-      p_length = extended;
+  // with context takeover, even short messages shrink a lot. everything goes
+  // out compressed, so that both windows keep seeing the same bytes
+  if (NULL == ws->deflater ||
+      0 != fpx_deflate_message(ws->deflater, payload, payload_length,
+                               FALSE == ws->deflate_fresh)) {
+    ws->deflate_fresh = TRUE;
+    return _ws_write(t, client, &frame);
+  }
 
-      readbuf_copy += sizeof(extended);
-    } else {
-      if (amount_read < minimum_length + 8)
-        return -1;
+  frame.reserved1 = TRUE;
+  frame.payload = ws->deflater->out;
+  frame.payload_length = ws->deflater->out_len;
 
-      uint64_t extended = *((uint64_t *)readbuf_copy);
-      fpx_endian_swap_if_little(&extended, sizeof(extended));
-      p_length = extended;
+  int retval = _ws_write(t, client, &frame);
+  ws->deflate_fresh = (0 != retval);
 
-      readbuf_copy += sizeof(extended);
-    }
-  }
+  return retval;
+}
 
-  fpx_memcpy(output->masking_key, readbuf_copy, sizeof(output->masking_key));
-  readbuf_copy += 4;
+static int _ws_write(struct _thread *t, struct _client_meta *client,
+                     const fpx_websocketframe_t *frame) {
+  // sends a frame of our own to a client without waiting on the socket;
+  // if output is queued already, the whole frame goes behind it. returns 0
+  // on success, ENOBUFS if the client is too far behind, or the value of
+  // `errno` on other failure
+  uint8_t header[FPX_WEBSOCKET_HEADER_MAX];
+  int header_len = fpx_websocketframe_write_header(frame, header);
+
+  struct iovec iov[2] = {
+      {header, header_len},
+      {frame->payload, frame->payload_length},
+  };
+
+  if (NULL == client->output.head) {
+#if defined(_WIN32) || defined(_WIN64)
+    int send_flags = 0;
+#else
+    int send_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#endif
 
-  int length_so_far = readbuf_copy - readbuf;
-  size_t left_to_read = p_length;
+    if (0 > _send_iov(client->fd, iov, 2, send_flags))
+      return errno;
+  }
 
-  int recv_size;
-  do {
-    fpx_websocketframe_append_payload(output, readbuf + length_so_far,
-                                      amount_read - length_so_far);
-    left_to_read -= (amount_read - length_so_far);
+  int retval = _pending_append(&client->output, iov, 2);
 
-    length_so_far = 0;
+  if (-2 == retval)
+    return ENOMEM;
 
-    if (sizeof(readbuf) > left_to_read)
-      recv_size = left_to_read;
-    else
-      recv_size = sizeof(readbuf);
-  } while (0 < left_to_read &&
-           -1 != (amount_read = recv(fd, (char *)readbuf, recv_size, 0)));
+  if (-3 == retval)
+    return ENOBUFS;
 
-  if (0 < left_to_read)
-    return -3;
+  if (NULL != client->output.head)
+    _watch_writable(t, client, TRUE);
 
   return 0;
 }
@@ -0,0 +1,66 @@
+//
+//  "test.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+// Benchmarks the websocket masking kernel against the byte-at-a-time loop
+// it replaced; src/test/httpserver.cpp checks that the two agree.
+// Build with ./compile.sh
+
+#include "../../../include/networking/http/websockets.h"
+#include "../../../include/test/bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const uint8_t key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+static void _mask_bytes(uint8_t *data, size_t len, uint64_t offset) {
+  for (size_t i = 0; i < len; ++i)
+    data[i] ^= key[(offset + i) % 4];
+}
+
+int main(void) {
+  const size_t sizes[] = { 7, 64, 125, 1024, 16384, 1 << 20 };
+  const size_t max_size = sizes[sizeof(sizes) / sizeof(*sizes) - 1] + 3;
+
+  uint8_t *a = malloc(max_size);
+  uint8_t *b = malloc(max_size);
+  if (NULL == a || NULL == b)
+    return 1;
+
+  for (size_t i = 0; i < max_size; ++i)
+    a[i] = b[i] = (uint8_t)(i * 31 + 7);
+
+  bench_report_header("size", "byte loop", "kernel");
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+    size_t len = sizes[s];
+    size_t rounds = BENCH_BYTES / len;
+    volatile uint8_t sink = 0;
+
+    double start = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      _mask_bytes(a, len, r);
+      sink ^= a[r % len];
+    }
+    double loop_time = bench_now() - start;
+
+    start = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      fpx_websocket_mask(b, len, key, r);
+      sink ^= b[r % len];
+    }
+    double kernel_time = bench_now() - start;
+
+    bench_report_bytes(len, (double)rounds * len, loop_time, kernel_time);
+
+    (void)sink;
+  }
+
+  free(a);
+  free(b);
+
+  return 0;
+}
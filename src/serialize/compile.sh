@@ -0,0 +1,15 @@
+#!/bin/bash
+
+CFLAGS="-g -O3 -DNDEBUG"
+
+gcc \
+  test.c \
+  json.c \
+  ../alloc/bump.c \
+  ../c-utils/format.c \
+  ../c-utils/endian.c \
+  ../mem/mem.c \
+  -I../../include \
+  $CFLAGS \
+  -o s.out \
+  -lm
@@ -1,9 +1,10 @@
 #include "serialize/json.h"
-#include "alloc/arena.h"
+#include "alloc/bump.h"
 #include "c-utils/format.h"
 #include "fpx_debug.h"
 #include "string/string.h"
 
+#include <math.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +12,11 @@
 #include <strings.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define JSON_X86
+#include <immintrin.h>
+#endif
+
 #define FREE_SAFE(_ptr)                                                        \
   if (NULL != _ptr) {                                                          \
     free(_ptr);                                                                \
@@ -21,12 +27,6 @@
   (character == 0x20 || character == 0x0A || character == 0x0D ||              \
    character == 0x09)
 
-#define TRIM_WHITESPACE(_dataptr, _limitptr)                                   \
-  {                                                                            \
-    for (; (_dataptr < _limitptr) && IS_WHITESPACE(*_dataptr); ++_dataptr)     \
-      ;                                                                        \
-  }
-
 #define SYNTAX_EXPECT(ptr, expect)
 
 #if !defined(NDEBUG) || defined(DEBUG)
@@ -37,107 +37,310 @@
           __FILE__, __LINE__, expect, *ptr, ptr);
 #endif
 
-// expects first character to be '{'
+#define SCRATCH_MIN_ENTRIES 64 /* first allocation of a scratch stack */
+#define INDEX_BLOCK 64 /* bytes the structural index looks at in one go */
+#define INDEX_MAX_LENGTH UINT32_MAX /* tape entries are 32-bit offsets */
+#define TAPE_ENTRIES 4096 /* tape window; refilled as the tree is built */
+#define STRING_PIECE 4096 /* arena bytes taken at a time to pack strings in */
+
+// Fpx_Json_Writer.levels flags
+#define LEVEL_OBJECT 0x01      /* the container is an object */
+#define LEVEL_HAS_ENTRIES 0x02 /* something was written into it already */
+
+#define MAX_SAFE_INTEGER 9007199254740992.0 /* 2^53 */
+
+#define OBJECT_INDEX_MIN 16 /* members an object needs to get a hash index */
+#define POINTER_TOKEN_BUFFER 256 /* escaped pointer tokens up to this fit */
+
+/* 32-bit FNV-1a, like the http header index */
+#define KEY_HASH_OFFSET 2166136261u
+#define KEY_HASH_PRIME 16777619u
+
+#define STREAM_MAX_DEPTH 1024       /* default Fpx_Json_Stream.max_depth */
+#define STREAM_MAX_TOKEN (16 << 20) /* default Fpx_Json_Stream.max_token */
+#define STREAM_MIN_STACK 32         /* first allocation of the nesting stack */
+#define STREAM_MIN_TOKEN 256        /* first allocation of the token buffer */
+
+// Fpx_Json_Stream.state
+enum {
+  STREAM_VALUE = 0,    // a value has to come next
+  STREAM_ARRAY_FIRST,  // right after '['; a value or ']'
+  STREAM_OBJECT_FIRST, // right after '{'; a key or '}'
+  STREAM_KEY,          // right after ',' in an object
+  STREAM_COLON,        // right after a key
+  STREAM_AFTER_VALUE,  // ',' or the end of the container
+  STREAM_STRING,
+  STREAM_NUMBER,
+  STREAM_LITERAL,
+};
+
+// Fpx_Json_Stream.escape, inside of a string
+enum {
+  ESCAPE_NONE = 0,
+  ESCAPE_START,     // right after '\'
+  ESCAPE_HEX,       // in the four digits of "\u"
+  ESCAPE_LOW_SLASH, // the '\' of the low half of a surrogate pair
+  ESCAPE_LOW_U,     // the 'u' of the low half of a surrogate pair
+};
+
+#define IS_NUMBER_CHAR(character)                                              \
+  ((character >= '0' && character <= '9') || character == '-' ||              \
+   character == '+' || character == '.' || character == 'e' ||                \
+   character == 'E')
+
+// the characters of one 64-byte block, one bit per byte
+typedef struct {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t whitespace;
+  uint64_t op; // { } [ ] : ,
+} _json_block;
+
+// what the structural index carries from one block into the next
+typedef struct {
+  uint64_t escaped;   // the first byte is escaped by a backslash
+  uint64_t in_string; // all ones when the block starts inside a string
+  uint64_t scalar;    // the last byte was part of a number or literal
+} _json_index_state;
+
+// one slot of an object's hash index
+struct _json_index_slot {
+  uint32_t hash;
+  uint32_t member; // index in members, plus one; 0 means the slot is empty
+};
+
+// hash index over the keys of an object. objects with at least
+// OBJECT_INDEX_MIN members have room for a pointer to one right in front of
+// their members; it stays NULL until fpx_json_object_get() builds the index
+struct _json_index {
+  uint32_t mask; // slots in the index, minus one
+  struct _json_index_slot slots[];
+};
+
+typedef struct {
+  fpx_bump *arena;
+
+  const char *data;
+  size_t len;
+
+  // offsets of every structural character outside of strings, of both
+  // quotes around every string, and of the first byte of every number and
+  // literal, in order. the tree is built by walking this; it only holds a
+  // window of TAPE_ENTRIES, which gets indexed a bit further when needed
+  uint32_t *tape;
+  size_t tape_len;
+  size_t tape_pos;
+
+  size_t indexed; // bytes of data that went through stage 1 so far
+  _json_index_state index_state;
+  uint32_t root; // offset of the first thing in the document
+
+  // entries of the containers that are still being parsed. a container's own
+  // entries sit on top of the stack, and move to the arena once it is closed
+  Fpx_Json_Member *members;
+  size_t member_count;
+  size_t member_capacity;
+
+  Fpx_Json_Value *values;
+  size_t value_count;
+  size_t value_capacity;
+
+  // strings are packed one after the other into a piece of the arena, so
+  // they do not take an allocation (and its alignment) each
+  char *strings;
+  size_t strings_left;
+} _json_parser;
+
+// makes sure `count` tape entries from the current one on are there
+// returns FALSE when the document ends before that
+static inline int _json_tape_fill(_json_parser *, size_t count);
+static int _json_tape_refill(_json_parser *, size_t count);
+
+static size_t _json_index_block(_json_index_state *, const _json_block *,
+                                uint32_t offset, uint32_t *tape);
+
+#if defined(JSON_X86)
+static void _json_classify_sse2(const uint8_t *, _json_block *);
+static void _json_classify_avx2(const uint8_t *, _json_block *);
+
+// SSE2 is part of x86_64, so this is right even before _pick_kernels()
+static void (*_json_classify)(const uint8_t *,
+                              _json_block *) = _json_classify_sse2;
+#else
+static void _json_classify_bytes(const uint8_t *, _json_block *);
+
+static void (*_json_classify)(const uint8_t *,
+                              _json_block *) = _json_classify_bytes;
+#endif
+
+// the character at the current tape entry, or '\0' past the end of it
+static char _json_peek(_json_parser *);
+
+// how many bytes from `data` on are printable ASCII other than '\\'. it may
+// read past `limit`, but never past `readable`
+static size_t _json_plain_span(const char *data, const char *limit,
+                               const char *readable);
+
+// checks that only whitespace follows a number or literal ending at `end`
+static Fpx_Json_E_Result _json_atom_end(_json_parser *, const char *end);
+
+// expects the current character to be '{'
 // returns FPX_JSON_SYNTAX_ERROR otherwise
-static Fpx_Json_E_Result _json_object_parse(const char **data,
-                                            const char *limit, fpx_arena *arena,
-                                            void *output);
+static Fpx_Json_E_Result _json_object_parse(_json_parser *,
+                                            Fpx_Json_Object *output);
 
-static Fpx_Json_E_Result _json_member_parse(const char **data,
-                                            const char *limit, fpx_arena *arena,
-                                            void *output);
+static Fpx_Json_E_Result _json_member_parse(_json_parser *,
+                                            Fpx_Json_Member *output);
 
-static Fpx_Json_E_Result _json_value_parse(const char **data, const char *limit,
-                                           fpx_arena *arena, void *output);
+static Fpx_Json_E_Result _json_value_parse(_json_parser *,
+                                           Fpx_Json_Value *output);
 
-// expects first character to be '"'
+// expects the current character to be '"'
 // returns FPX_JSON_SYNTAX_ERROR otherwise
-static Fpx_Json_E_Result _json_string_parse(const char **string,
-                                            const char *limit, fpx_arena *arena,
-                                            void *output);
+static Fpx_Json_E_Result _json_string_parse(_json_parser *,
+                                            Fpx_Json_String *output);
 
 // expects first character to be either '-' or a number [0-9]
 // returns FPX_JSON_SYNTAX_ERROR otherwise
 static Fpx_Json_E_Result _json_number_parse(const char **string,
-                                            const char *limit, void *output);
+                                            const char *limit, double *output);
 
 // expects first chatacter to be either 't' or 'f'
 // returns FPX_JSON_SYNTAX_ERROR otherwise
 static Fpx_Json_E_Result _json_bool_parse(const char **data, const char *limit,
-                                          void *output);
+                                          bool *output);
 
 // expects first chatacter to be 'n'
 // returns FPX_JSON_SYNTAX_ERROR otherwise
 static Fpx_Json_E_Result _json_null_validate(const char **data,
                                              const char *limit);
 
-// expects first character to be '['
+// expects the current character to be '['
 // returns FPX_JSON_SYNTAX_ERROR otherwise
-static Fpx_Json_E_Result _json_array_parse(const char **string,
-                                           const char *limit, fpx_arena *arena,
-                                           void *output);
+static Fpx_Json_E_Result _json_array_parse(_json_parser *,
+                                           Fpx_Json_Array *output);
 
-static void _json_object_print(Fpx_Json_Object *);
-static void _json_array_print(Fpx_Json_Array *);
-static void _json_value_print(Fpx_Json_Value *);
+static int _json_member_push(_json_parser *, const Fpx_Json_Member *);
+static char *_json_string_space(_json_parser *, size_t size);
+static int _json_value_push(_json_parser *, const Fpx_Json_Value *);
 
-Fpx_Json_Entity fpx_json_read(const char *json_data, size_t len) {
-  Fpx_Json_Entity retval = {0};
+static uint32_t _json_key_hash(const char *key, size_t key_len);
+static int _json_key_equals(const Fpx_Json_String *, const char *key,
+                            size_t key_len);
 
-  if (NULL == json_data || 0 == len)
-    return retval;
+// returns the index of the member, or -1
+static ssize_t _json_object_scan(const Fpx_Json_Object *, const char *key,
+                                 size_t key_len);
 
-  const char *current_char = json_data;
-  const char *limit = json_data + len;
+// returns the new index, or NULL if the arena is out of memory
+static struct _json_index *_json_object_index(fpx_bump *,
+                                              const Fpx_Json_Object *);
 
-  // int page_size = 0;
+// one reference token of a JSON Pointer, still escaped
+static Fpx_Json_Value *_json_pointer_step(Fpx_Json_Entity *,
+                                          Fpx_Json_Value *,
+                                          const char *token, size_t len);
 
-  // #if defined(_WIN32) || defined(_WIN64)
-  //   page_size = 4096;
-  // #else
-  //   page_size = getpagesize();
-  // #endif
+static void _json_writer_put(Fpx_Json_Writer *, const char *, size_t);
+static void _json_writer_drain(Fpx_Json_Writer *);
 
-  // REALLY nasty! maybe see if there's a better way
-  len *= 2;
+// a line break, and the indentation for the current depth
+static void _json_writer_newline(Fpx_Json_Writer *);
 
-  // size_t page_diff = 0;
+// the comma and indentation for a new entry in the current container
+// returns FPX_JSON_RESULT_SYNTAX_ERROR if there can be no value here
+static Fpx_Json_E_Result _json_writer_entry(Fpx_Json_Writer *);
+
+static Fpx_Json_E_Result _json_writer_begin(Fpx_Json_Writer *, uint8_t level,
+                                            char bracket);
+static Fpx_Json_E_Result _json_writer_end(Fpx_Json_Writer *, uint8_t level,
+                                          char bracket);
+
+static void _json_writer_escaped(Fpx_Json_Writer *, const char *, size_t);
+
+// how many bytes from `data` on can go into a JSON string as they are
+static size_t _json_escape_span(const char *data, const char *limit);
+
+// every function below returns where it stopped in the chunk, or NULL
+// after setting stream->error
+
+// one character outside of strings, numbers and literals
+static const char *_json_stream_structural(Fpx_Json_Stream *,
+                                           const char *data);
+static const char *_json_stream_value(Fpx_Json_Stream *, const char *data);
+static const char *_json_stream_string(Fpx_Json_Stream *, const char *data,
+                                       const char *limit);
+static const char *_json_stream_escape(Fpx_Json_Stream *, const char *data);
+static const char *_json_stream_number(Fpx_Json_Stream *, const char *data,
+                                       const char *limit);
+static const char *_json_stream_literal(Fpx_Json_Stream *, const char *data,
+                                        const char *limit);
+
+static int _json_stream_push(Fpx_Json_Stream *, uint8_t is_object);
+static const char *_json_stream_close(Fpx_Json_Stream *, const char *data,
+                                      uint8_t is_object);
+
+// a complete number, from the chunk or from the token buffer
+static int _json_stream_number_done(Fpx_Json_Stream *, const char *,
+                                    size_t len);
+
+static int _json_stream_token_append(Fpx_Json_Stream *, const char *,
+                                     size_t len);
+static int _json_stream_token_codepoint(Fpx_Json_Stream *, uint32_t);
+
+// turns what a callback returned into stream->error
+static int _json_stream_called(Fpx_Json_Stream *, int result);
+
+static void _json_object_print(Fpx_Json_Object *);
+static void _json_array_print(Fpx_Json_Array *);
+static void _json_value_print(Fpx_Json_Value *);
+
+#if defined(JSON_X86)
+__attribute__((constructor)) static void _pick_kernels(void) {
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+    _json_classify = _json_classify_avx2;
+}
+#endif
 
-  // trim leading whitespace
-  TRIM_WHITESPACE(current_char, limit);
+Fpx_Json_Entity fpx_json_read(const char *json_data, size_t len) {
+  Fpx_Json_Entity retval = {0};
 
-  size_t alloc_size = 0;
+  if (NULL == json_data || 0 == len || INDEX_MAX_LENGTH < len)
+    return retval;
 
-  const char *start_character = current_char;
+  uint32_t tape[TAPE_ENTRIES];
 
-  // pass NULL for arena, and size_t in output. this means that the code will do
-  // a dry-run of the JSON parser, and return the size required for an
-  // allocation
-  Fpx_Json_E_Result root_val =
-      _json_value_parse(&current_char, limit, NULL, &alloc_size);
+  _json_parser parser = {0};
+  parser.data = json_data;
+  parser.len = len;
+  parser.tape = tape;
 
-  if (FPX_JSON_RESULT_SUCCESS > root_val) {
-    retval.isValid = false;
+  // stage 1: find where everything is, a block at a time. it only ever runs
+  // a window ahead of stage 2, so the tape stays small and in cache
+  if (FALSE == _json_tape_fill(&parser, 1)) // nothing but whitespace
     return retval;
-  }
 
-  // // allocate the rest of the page, just in case i guess
-  // if (alloc_size % page_size != 0) {
-  //   page_diff = (page_size - (alloc_size % page_size));
-  //   alloc_size += page_diff;
-  // }
+  parser.root = parser.tape[0];
 
-  retval.arena = fpx_arena_create(alloc_size);
+  // stage 2: the tree is built straight into the arena, in one walk over the
+  // tape. it is usually about as big as the text it came from; when it is
+  // not, the arena just chains on another chunk
+  parser.arena = fpx_bump_create(len);
+  if (NULL == parser.arena)
+    return retval;
 
-  current_char = start_character;
+  Fpx_Json_E_Result parse_res = _json_value_parse(&parser, &retval.root);
 
-  Fpx_Json_E_Result real_parse_res =
-      _json_value_parse(&current_char, limit, retval.arena, &retval.root);
+  free(parser.members);
+  free(parser.values);
 
-  retval.isValid = (FPX_JSON_RESULT_SUCCESS == real_parse_res);
+  retval.arena = parser.arena;
+  retval.isValid = (FPX_JSON_RESULT_SUCCESS == parse_res);
 
   if (false == retval.isValid) {
-    fpx_arena_destroy(retval.arena);
+    fpx_bump_destroy(retval.arena);
     memset(&retval, 0, sizeof(retval));
   }
 
@@ -149,7 +352,7 @@ Fpx_Json_E_Result fpx_json_destroy(Fpx_Json_Entity *entity) {
     return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
   if (entity->arena) {
-    fpx_arena_destroy(entity->arena);
+    fpx_bump_destroy(entity->arena);
   }
 
   memset(entity, 0, sizeof *(entity));
@@ -167,686 +370,2281 @@ void fpx_json_print(Fpx_Json_Entity *json) {
   return;
 }
 
-// STATIC FUNCTIONS BELOW -------------------------
-
-static Fpx_Json_E_Result _json_object_parse(const char **string,
-                                            const char *limit, fpx_arena *arena,
-                                            void *output) {
-  if (NULL == string || NULL == *string || NULL == limit || NULL == output)
-    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+Fpx_Json_Value *fpx_json_object_get(Fpx_Json_Entity *entity,
+                                    Fpx_Json_Object *object, const char *key,
+                                    size_t key_len) {
+  if (NULL == object || (NULL == key && 0 < key_len))
+    return NULL;
 
-  const char *data = *string;
+  struct _json_index *index = NULL;
 
-  bool dry_run = false;
+  if (OBJECT_INDEX_MIN <= object->memberCount && NULL != entity &&
+      NULL != entity->arena) {
+    struct _json_index **link = (struct _json_index **)object->members - 1;
 
-  if (NULL == arena)
-    dry_run = true;
+    if (NULL == *link)
+      *link = _json_object_index(entity->arena, object);
 
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    for (; *data != '}' && data < limit; ++data)                               \
-      ;                                                                        \
-    if (data != limit)                                                         \
-      ++data;                                                                  \
-    *string = data;                                                            \
-    return _return_value;                                                      \
+    index = *link;
   }
 
-  if (limit - data < 2) {
-    // no room for "{}"
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
-  }
+  // small objects, or no arena to put the index in
+  if (NULL == index) {
+    ssize_t member = _json_object_scan(object, key, key_len);
 
-  if (*data != '{') {
-    SYNTAX_EXPECT(data, '{');
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
+    return (0 > member) ? NULL : object->members[member].value;
   }
 
-  ++data;
-
-  TRIM_WHITESPACE(data, limit);
-
-  if (*data == '}') {
-    memset(output, 0, sizeof(Fpx_Json_Object));
-    RETURN(FPX_JSON_RESULT_SUCCESS);
-  }
+  uint32_t hash = _json_key_hash(key, key_len);
 
-  if (data >= limit)
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+  for (uint32_t slot = hash & index->mask;; slot = (slot + 1) & index->mask) {
+    const struct _json_index_slot *entry = &index->slots[slot];
 
-  Fpx_Json_Object new_obj = {0};
+    if (0 == entry->member)
+      return NULL;
 
-  uint8_t member_increment = 8;
-  uint16_t member_capacity = 0;
+    Fpx_Json_Member *member = &object->members[entry->member - 1];
 
-  do {
-    if (member_capacity == new_obj.memberCount) {
-      new_obj.members = (Fpx_Json_Member *)realloc(
-          new_obj.members,
-          sizeof(Fpx_Json_Member) * (new_obj.memberCount + member_increment));
-      member_capacity += member_increment;
-    }
+    if (hash == entry->hash && _json_key_equals(&member->key, key, key_len))
+      return member->value;
+  }
+}
 
-    Fpx_Json_E_Result member_result = _json_member_parse(
-        &data, limit, arena,
-        (dry_run) ? (output) : (&new_obj.members[new_obj.memberCount]));
+Fpx_Json_Value *fpx_json_pointer_get(Fpx_Json_Entity *entity,
+                                     Fpx_Json_Value *from,
+                                     const char *pointer, size_t len) {
+  if (NULL == from)
+    from = (NULL != entity && entity->isValid) ? &entity->root : NULL;
 
-    if (FPX_JSON_RESULT_SUCCESS > member_result) {
-      free(new_obj.members);
-      return member_result;
-    }
+  if (NULL == from || (NULL == pointer && 0 < len))
+    return NULL;
 
-    new_obj.memberCount++;
+  if (0 == len)
+    return from;
 
-    TRIM_WHITESPACE(data, limit);
-    if (*data != ',' && *data != '}') {
-      free(new_obj.members);
-      SYNTAX_EXPECT(data, ',');
-      SYNTAX_EXPECT(data, '}');
-      return FPX_JSON_RESULT_SYNTAX_ERROR;
-    }
-    if (*data == ',')
-      ++data;
+  if ('/' != pointer[0])
+    return NULL;
 
-    TRIM_WHITESPACE(data, limit);
-  } while (data < limit && *data != '}');
+  const char *limit = pointer + len;
+  const char *token = pointer + 1;
 
-  if (!dry_run) {
-    *(Fpx_Json_Object *)output = new_obj;
+  while (NULL != from) {
+    const char *end = memchr(token, '/', limit - token);
+    if (NULL == end)
+      end = limit;
 
-    ((Fpx_Json_Object *)output)->members =
-        fpx_arena_alloc(arena, new_obj.memberCount * sizeof(Fpx_Json_Member));
+    from = _json_pointer_step(entity, from, token, end - token);
 
-    if (NULL == ((Fpx_Json_Object *)output)->members) {
-      free(new_obj.members);
-      RETURN(FPX_JSON_RESULT_MEMORY_ERROR);
-    }
+    if (end == limit)
+      break;
 
-    memcpy(((Fpx_Json_Object *)output)->members, new_obj.members,
-           new_obj.memberCount * sizeof(Fpx_Json_Member));
-  } else {
-    *(size_t *)output += (new_obj.memberCount * sizeof(Fpx_Json_Member));
+    token = end + 1;
   }
 
-  free(new_obj.members);
-
-  RETURN(FPX_JSON_RESULT_SUCCESS);
-
-#undef RETURN
+  return from;
 }
 
-static Fpx_Json_E_Result _json_member_parse(const char **dataptr,
-                                            const char *limit,
-                                            fpx_arena *alloc_arena,
-                                            void *output) {
-  if (NULL == dataptr || NULL == *dataptr || NULL == limit || NULL == output)
+Fpx_Json_E_Result fpx_json_serialize(const Fpx_Json_Entity *entity,
+                                     char *output, size_t buflen,
+                                     size_t *written, unsigned int indent) {
+  if (NULL == entity || false == entity->isValid)
     return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  bool dry_run = false;
+  Fpx_Json_Writer writer;
 
-  if (NULL == alloc_arena)
-    dry_run = true;
+  Fpx_Json_E_Result result =
+      fpx_json_writer_init(&writer, output, buflen, NULL, NULL);
+  if (FPX_JSON_RESULT_SUCCESS > result)
+    return result;
 
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    *dataptr = data;                                                           \
-    return _return_value;                                                      \
-  }
+  fpx_json_writer_set_indent(&writer, indent);
+  fpx_json_writer_value(&writer, &entity->root);
 
-  const char *data = *dataptr;
+  result = fpx_json_writer_finish(&writer);
 
-  Fpx_Json_Member new_member = {0};
+  if (NULL != written)
+    *written = writer.length;
 
-  if (dry_run) {
-    *(size_t *)output += sizeof(*new_member.value);
-  } else {
-    new_member.value = fpx_arena_alloc(alloc_arena, sizeof(*new_member.value));
+  return result;
+}
 
-    if (NULL == new_member.value) {
-      return FPX_JSON_RESULT_MEMORY_ERROR;
-    }
-  }
+Fpx_Json_E_Result fpx_json_writer_init(Fpx_Json_Writer *writer, char *buffer,
+                                       size_t buflen, Fpx_Json_Flush flush,
+                                       void *context) {
+  if (NULL == writer || NULL == buffer || 0 == buflen)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  Fpx_Json_E_Result key_result = _json_string_parse(
-      &data, limit, alloc_arena, (dry_run) ? (output) : (&new_member.key));
+  memset(writer, 0, sizeof(*writer));
 
-  if (FPX_JSON_RESULT_SUCCESS > key_result)
-    return key_result;
+  writer->buffer = buffer;
+  writer->capacity = buflen;
+  writer->flush = flush;
+  writer->context = context;
 
-  TRIM_WHITESPACE(data, limit);
-  if (*data != ':') {
-    SYNTAX_EXPECT(data, ':');
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
-  }
+  return FPX_JSON_RESULT_SUCCESS;
+}
 
-  ++data;
-  TRIM_WHITESPACE(data, limit);
+Fpx_Json_E_Result fpx_json_writer_set_indent(Fpx_Json_Writer *writer,
+                                             unsigned int indent) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  // parse value
-  Fpx_Json_E_Result val_res = _json_value_parse(
-      &data, limit, alloc_arena, (dry_run) ? (output) : (new_member.value));
+  writer->indent = indent;
 
-  if (FPX_JSON_RESULT_SUCCESS > val_res)
-    return val_res;
+  return writer->error;
+}
 
-  if (!dry_run) {
-    *(Fpx_Json_Member *)output = new_member;
-  }
+Fpx_Json_E_Result fpx_json_writer_begin_object(Fpx_Json_Writer *writer) {
+  return _json_writer_begin(writer, LEVEL_OBJECT, '{');
+}
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+Fpx_Json_E_Result fpx_json_writer_end_object(Fpx_Json_Writer *writer) {
+  return _json_writer_end(writer, LEVEL_OBJECT, '}');
+}
 
-#undef RETURN
+Fpx_Json_E_Result fpx_json_writer_begin_array(Fpx_Json_Writer *writer) {
+  return _json_writer_begin(writer, 0, '[');
+}
+
+Fpx_Json_E_Result fpx_json_writer_end_array(Fpx_Json_Writer *writer) {
+  return _json_writer_end(writer, 0, ']');
 }
 
-static Fpx_Json_E_Result _json_value_parse(const char **dataptr,
-                                           const char *limit, fpx_arena *arena,
-                                           void *output) {
-  if (NULL == dataptr || NULL == *dataptr || NULL == output)
+Fpx_Json_E_Result fpx_json_writer_key(Fpx_Json_Writer *writer,
+                                      const char *key, size_t len) {
+  if (NULL == writer)
     return FPX_JSON_RESULT_ARGUMENT_ERROR;
-  const char *data = *dataptr;
 
-  bool dry_run = false;
-  if (NULL == arena)
-    dry_run = true;
+  if (FPX_JSON_RESULT_SUCCESS > writer->error)
+    return writer->error;
 
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    *dataptr = data;                                                           \
-    return _return_value;                                                      \
-  }
+  if (NULL == key && 0 < len)
+    return (writer->error = FPX_JSON_RESULT_ARGUMENT_ERROR);
 
-  Fpx_Json_Value new_val = {0};
-  Fpx_Json_E_ValueType type = FPX_JSON_VALUE_INVALID;
-  switch (*data) {
-  case '-':
-  case '0':
-  case '1':
-  case '2':
-  case '3':
-  case '4':
-  case '5':
-  case '6':
-  case '7':
-  case '8':
-  case '9':
-  case 'i': // infinity
-  case 'I': // infinity
-    type = FPX_JSON_VALUE_NUMBER;
-    double double_temp = 0.0f;
-    Fpx_Json_E_Result num_res = _json_number_parse(
-        &data, limit, (dry_run) ? (&double_temp) : (&new_val.number));
-    if (FPX_JSON_RESULT_SUCCESS > num_res)
-      return num_res;
-    break;
+  uint8_t *level = &writer->levels[writer->depth];
 
-  case 't':
-  case 'f':
-    type = FPX_JSON_VALUE_BOOL;
-    bool bool_temp = false;
-    Fpx_Json_E_Result bool_res = _json_bool_parse(
-        &data, limit, (dry_run) ? (&bool_temp) : (&new_val.boolean));
-    if (FPX_JSON_RESULT_SUCCESS > bool_res)
-      return bool_res;
-    break;
+  if (0 == (*level & LEVEL_OBJECT) || writer->after_key)
+    return (writer->error = FPX_JSON_RESULT_SYNTAX_ERROR);
 
-  case 'n':
-    type = FPX_JSON_VALUE_NULL;
-    Fpx_Json_E_Result null_res = _json_null_validate(&data, limit);
-    if (FPX_JSON_RESULT_SUCCESS > null_res)
-      return null_res;
-    break;
+  if (*level & LEVEL_HAS_ENTRIES)
+    _json_writer_put(writer, ",", 1);
 
-  case '{':
-    type = FPX_JSON_VALUE_OBJECT;
-    Fpx_Json_E_Result mem_res = _json_object_parse(
-        &data, limit, arena, (dry_run) ? (output) : (&new_val.object));
-    if (FPX_JSON_RESULT_SUCCESS > mem_res)
-      return mem_res;
-    break;
+  *level |= LEVEL_HAS_ENTRIES;
 
-  case '[':
-    type = FPX_JSON_VALUE_ARRAY;
-    Fpx_Json_E_Result arr_res = _json_array_parse(
-        &data, limit, arena, (dry_run) ? (output) : (&new_val.array));
-    if (FPX_JSON_RESULT_SUCCESS > arr_res)
-      return arr_res;
-    break;
+  if (writer->indent)
+    _json_writer_newline(writer);
 
-  case '"':
-    type = FPX_JSON_VALUE_STRING;
-    Fpx_Json_E_Result str_res = _json_string_parse(
-        &data, limit, arena, (dry_run) ? (output) : (&new_val.string));
-    if (FPX_JSON_RESULT_SUCCESS > str_res)
-      return str_res;
-    break;
+  _json_writer_escaped(writer, key, len);
 
-  default:
-    FPX_ERROR("General syntax error while checking for JSON value\n");
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
-  }
+  if (writer->indent)
+    _json_writer_put(writer, ": ", 2);
+  else
+    _json_writer_put(writer, ":", 1);
 
-  new_val.valueType = type;
+  writer->after_key = true;
 
-  if (!dry_run)
-    *(Fpx_Json_Value *)output = new_val;
+  return writer->error;
+}
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+Fpx_Json_E_Result fpx_json_writer_string(Fpx_Json_Writer *writer,
+                                         const char *string, size_t len) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-#undef RETURN
-}
+  if (NULL == string && 0 < len && FPX_JSON_RESULT_SUCCESS == writer->error)
+    writer->error = FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-static Fpx_Json_E_Result _json_string_parse(const char **in_string,
-                                            const char *limit, fpx_arena *arena,
-                                            void *output) {
-  Fpx_Json_String retval = {0};
+  if (FPX_JSON_RESULT_SUCCESS > _json_writer_entry(writer))
+    return writer->error;
 
-  const char *data = *in_string;
-  bool dry_run = false;
+  _json_writer_escaped(writer, string, len);
 
-  if (NULL == arena)
-    dry_run = true;
+  return writer->error;
+}
 
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    if (data != limit)                                                         \
-      ++data;                                                                  \
-    *in_string = data;                                                         \
-    return _return_value;                                                      \
-  }
+Fpx_Json_E_Result fpx_json_writer_number(Fpx_Json_Writer *writer,
+                                         double value) {
+  if (false == isfinite(value))
+    return fpx_json_writer_null(writer);
 
-  if (limit - data < 2) {
-    // no room for ""
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
-  }
+  // whole numbers are common, and a lot cheaper to format as integers
+  if (-MAX_SAFE_INTEGER <= value && value <= MAX_SAFE_INTEGER &&
+      value == (double)(int64_t)value)
+    return fpx_json_writer_int(writer, (int64_t)value);
 
-  if (*data != '\"') {
-    SYNTAX_EXPECT(data, '"');
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
-  }
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  ++data;
+  if (FPX_JSON_RESULT_SUCCESS > _json_writer_entry(writer))
+    return writer->error;
 
-  // empty string
-  if (*data == '\"') {
-    if (!dry_run) {
-      ((Fpx_Json_String *)output)->size = 0;
-      ((Fpx_Json_String *)output)->data = NULL;
-    }
+  char digits[FPX_DOUBLE_MAX_LENGTH + 1];
+  int len = fpx_doublestr(value, digits, sizeof(digits));
 
-    RETURN(FPX_JSON_RESULT_SUCCESS);
-  }
+  if (0 < len)
+    _json_writer_put(writer, digits, len);
 
-  const char *next_dbl_quote = data;
+  return writer->error;
+}
 
-  bool escaped = false;
-  for (; next_dbl_quote <= limit; ++next_dbl_quote) {
-    if (!escaped) {
-      if (*next_dbl_quote == '\\') {
-        escaped = true;
-        continue;
-      } else if (*next_dbl_quote == '"')
-        break;
-    } else {
-      escaped = false;
-      continue;
-    }
-  }
+Fpx_Json_E_Result fpx_json_writer_int(Fpx_Json_Writer *writer,
+                                      int64_t value) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  if (*next_dbl_quote != '\"')
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+  if (FPX_JSON_RESULT_SUCCESS > _json_writer_entry(writer))
+    return writer->error;
 
-  size_t clone_idx = 0;
-  retval.data = (char *)calloc(next_dbl_quote - data, 1);
+  char digits[FPX_INT64_MAX_LENGTH + 1];
+  int len = fpx_int64str(value, digits, sizeof(digits));
 
-  for (; data < next_dbl_quote; ++data) {
-    if (*data == '\\') {
-      ++data;
-      uint8_t to_clone = ' '; // filler in case of weird logic error
+  if (0 < len)
+    _json_writer_put(writer, digits, len);
 
-      if (*data == '"' || *data == '\\' || *data == '/')
-        to_clone = *data;
-      else if (*data == 'r')
-        to_clone = '\r';
-      else if (*data == 'n')
-        to_clone = '\n';
-      else if (*data == 't')
-        to_clone = '\t';
-      else if (*data == 'b')
-        to_clone = '\b';
-      else if (*data == 'f')
-        to_clone = '\f';
+  return writer->error;
+}
 
-      if (*data != 'u')
-        retval.data[clone_idx++] = to_clone;
-      else {
-        // ESCAPE UNICODE 2 BYTES
+Fpx_Json_E_Result fpx_json_writer_bool(Fpx_Json_Writer *writer, bool value) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-        // if unicode escape sequence reaches past the next double quote:
-        if (data + 5 > next_dbl_quote) {
-          free(retval.data);
-          return FPX_JSON_RESULT_SYNTAX_ERROR;
-        }
+  if (FPX_JSON_RESULT_SUCCESS > _json_writer_entry(writer))
+    return writer->error;
 
-        // should be good for both endiannesses
-        for (size_t _iter = 0; _iter < 2; ++_iter) {
-          uint8_t byteval = 0;
+  if (value)
+    _json_writer_put(writer, "true", 4);
+  else
+    _json_writer_put(writer, "false", 5);
 
-          for (size_t _iter2 = 0; _iter2 < 2; ++_iter2) {
-            byteval <<= 4;
-            ++data;
-            uint8_t nibble = 0;
-            if (*data >= 'A' && *data <= 'F')
-              nibble = *data - 55;
-            else if (*data >= 'a' && *data <= 'f')
-              nibble = *data - 87;
+  return writer->error;
+}
 
-            byteval |= nibble & 0x0f;
-          }
+Fpx_Json_E_Result fpx_json_writer_null(Fpx_Json_Writer *writer) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-          retval.data[clone_idx++] = byteval;
-        }
-      }
-    } else if (*data >= ' ' && *data <= '~') {
-      retval.data[clone_idx++] = *data;
-    }
-  }
+  if (FPX_JSON_RESULT_SUCCESS > _json_writer_entry(writer))
+    return writer->error;
 
-  void *temp = NULL;
-  if (!dry_run) {
-    temp = fpx_arena_alloc(arena, clone_idx + 1);
+  _json_writer_put(writer, "null", 4);
 
-    if (NULL == temp) {
-      free(retval.data);
-      return FPX_JSON_RESULT_MEMORY_ERROR;
-    }
+  return writer->error;
+}
 
-    memcpy(temp, retval.data, clone_idx);
-  }
+Fpx_Json_E_Result fpx_json_writer_value(Fpx_Json_Writer *writer,
+                                        const Fpx_Json_Value *value) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  free(retval.data);
-  retval.size = clone_idx;
-  retval.data = temp;
+  if (NULL == value) {
+    if (FPX_JSON_RESULT_SUCCESS == writer->error)
+      writer->error = FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  if (dry_run) {
-    *(size_t *)output += clone_idx + 1;
-  } else {
-    retval.data[clone_idx] = 0;
-    *(Fpx_Json_String *)output = retval;
+    return writer->error;
   }
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+  switch (value->valueType) {
+  case FPX_JSON_VALUE_OBJECT:
+    fpx_json_writer_begin_object(writer);
 
-#undef RETURN
-}
+    for (size_t i = 0; i < value->object.memberCount; ++i) {
+      const Fpx_Json_Member *member = &value->object.members[i];
 
-static Fpx_Json_E_Result _json_number_parse(const char **string,
-                                            const char *limit, void *output) {
-  const char *data = *string;
+      fpx_json_writer_key(writer, member->key.data, member->key.size);
+      fpx_json_writer_value(writer, member->value);
+    }
 
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    *string = data;                                                            \
-    return _return_value;                                                      \
-  }
+    return fpx_json_writer_end_object(writer);
 
-  uint8_t min_space = 1;
-  if (*data == 'i' || *data == 'I') {
-    min_space = 8;
-    if (0 != strncasecmp("infinity", data, 8)) {
-      return FPX_JSON_RESULT_SYNTAX_ERROR;
-    }
-  } else if (*data == '-')
-    min_space = 2;
-  else if (*data < '0' || *data > '9') {
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
-  }
+  case FPX_JSON_VALUE_ARRAY:
+    fpx_json_writer_begin_array(writer);
 
-  if (limit - data < min_space)
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    for (size_t i = 0; i < value->array.count; ++i)
+      fpx_json_writer_value(writer, &value->array.values[i]);
 
-  const char *number_end = NULL;
+    return fpx_json_writer_end_array(writer);
 
-  *(double *)output = strtod(data, (char **)&number_end);
+  case FPX_JSON_VALUE_STRING:
+    return fpx_json_writer_string(writer, value->string.data,
+                                  value->string.size);
 
-  if (number_end >= limit)
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+  case FPX_JSON_VALUE_NUMBER:
+    return fpx_json_writer_number(writer, value->number);
 
-  data = number_end;
+  case FPX_JSON_VALUE_BOOL:
+    return fpx_json_writer_bool(writer, value->boolean);
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+  case FPX_JSON_VALUE_NULL:
+    return fpx_json_writer_null(writer);
 
-#undef RETURN
+  default:
+    if (FPX_JSON_RESULT_SUCCESS == writer->error)
+      writer->error = FPX_JSON_RESULT_ARGUMENT_ERROR;
+
+    return writer->error;
+  }
 }
 
-static Fpx_Json_E_Result _json_bool_parse(const char **string,
-                                          const char *limit, void *output) {
-  if (NULL == string || NULL == *string || NULL == limit || NULL == output)
+Fpx_Json_E_Result fpx_json_writer_finish(Fpx_Json_Writer *writer) {
+  if (NULL == writer)
     return FPX_JSON_RESULT_ARGUMENT_ERROR;
-  const char *data = *string;
-
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    *string = data;                                                            \
-    return _return_value;                                                      \
-  }
 
-  uint8_t min_space = 4;
+  if (FPX_JSON_RESULT_SUCCESS > writer->error)
+    return writer->error;
 
-  if (*data == 'f')
-    min_space = 5;
-  else if (*data != 't') {
-    SYNTAX_EXPECT(data, 't');
-    SYNTAX_EXPECT(data, 'f');
+  if (0 != writer->depth || 0 == (writer->levels[0] & LEVEL_HAS_ENTRIES))
     return FPX_JSON_RESULT_SYNTAX_ERROR;
+
+  if (NULL != writer->flush) {
+    if (0 < writer->length)
+      _json_writer_drain(writer);
+  } else if (writer->length < writer->capacity) {
+    writer->buffer[writer->length] = 0;
   }
 
-  if (limit - data < min_space)
-    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+  return writer->error;
+}
 
-  if (*data == 't' && 0 == strncmp("true", data, 4)) {
-    data += 4;
-    *(bool *)output = true;
-  } else if (*data == 'f' && 0 == strncmp("false", data, 5)) {
-    data += 5;
-    *(bool *)output = false;
-  } else {
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
-  }
+Fpx_Json_E_Result fpx_json_stream_init(Fpx_Json_Stream *stream,
+                                       const Fpx_Json_Callbacks *callbacks,
+                                       void *context) {
+  if (NULL == stream || NULL == callbacks)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+  memset(stream, 0, sizeof(*stream));
 
-#undef RETURN
+  stream->callbacks = callbacks;
+  stream->context = context;
+
+  stream->max_depth = STREAM_MAX_DEPTH;
+  stream->max_token = STREAM_MAX_TOKEN;
+
+  stream->state = STREAM_VALUE;
+  stream->gap = true;
+
+  return FPX_JSON_RESULT_SUCCESS;
 }
 
-static Fpx_Json_E_Result _json_null_validate(const char **string,
-                                             const char *limit) {
-  if (NULL == string || NULL == *string || NULL == limit)
+Fpx_Json_E_Result fpx_json_stream_feed(Fpx_Json_Stream *stream,
+                                       const char *chunk, size_t len) {
+  if (NULL == stream || (NULL == chunk && 0 < len))
     return FPX_JSON_RESULT_ARGUMENT_ERROR;
-  const char *data = *string;
 
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    *string = data;                                                            \
-    return _return_value;                                                      \
-  }
+  if (FPX_JSON_RESULT_SUCCESS > stream->error)
+    return stream->error;
 
-  if (*data != 'n') {
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
-  }
+  const char *data = chunk;
+  const char *limit = chunk + len;
+  const char *last = data;
 
-  if (0 != strncmp("null", data, 4)) {
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  while (NULL != data && data < limit) {
+    last = data;
+
+    switch (stream->state) {
+    case STREAM_STRING:
+      data = _json_stream_string(stream, data, limit);
+      break;
+
+    case STREAM_NUMBER:
+      data = _json_stream_number(stream, data, limit);
+      break;
+
+    case STREAM_LITERAL:
+      data = _json_stream_literal(stream, data, limit);
+      break;
+
+    default:
+      if (IS_WHITESPACE(*data)) {
+        stream->gap = true;
+        ++data;
+        break;
+      }
+
+      data = _json_stream_structural(stream, data);
+      break;
+    }
   }
 
-  data += 4;
+  if (NULL == data) {
+    // at most one token ahead of where the error is
+    stream->offset += last - chunk;
+    return stream->error;
+  }
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+  stream->offset += len;
 
-#undef RETURN
+  return FPX_JSON_RESULT_SUCCESS;
 }
 
-static Fpx_Json_E_Result _json_array_parse(const char **string,
-                                           const char *limit, fpx_arena *arena,
-                                           void *output) {
-  if (NULL == string || NULL == *string || NULL == limit || NULL == output)
+Fpx_Json_E_Result fpx_json_stream_finish(Fpx_Json_Stream *stream) {
+  if (NULL == stream)
     return FPX_JSON_RESULT_ARGUMENT_ERROR;
-  const char *data = *string;
 
-  bool dry_run = false;
+  if (FPX_JSON_RESULT_SUCCESS > stream->error)
+    return stream->error;
 
-  if (NULL == arena)
-    dry_run = true;
-
-#define RETURN(_return_value)                                                  \
-  {                                                                            \
-    for (; *data != ']' && data < limit; ++data)                               \
-      ;                                                                        \
-    if (data != limit)                                                         \
-      ++data;                                                                  \
-    *string = data;                                                            \
-    return _return_value;                                                      \
+  // a number only ends at the first thing that is not part of it
+  if (STREAM_NUMBER == stream->state) {
+    if (0 > _json_stream_number_done(stream, stream->token, stream->token_len))
+      return stream->error;
   }
 
-  if (*data != '[') {
-    SYNTAX_EXPECT(data, '[');
-    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  if (STREAM_AFTER_VALUE != stream->state || 0 < stream->depth) {
+    stream->error = (0 == stream->values && STREAM_VALUE == stream->state)
+                        ? FPX_JSON_RESULT_SYNTAX_ERROR
+                        : FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
   }
 
-  ++data;
+  return stream->error;
+}
+
+Fpx_Json_E_Result fpx_json_stream_destroy(Fpx_Json_Stream *stream) {
+  if (NULL == stream)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+
+  free(stream->stack);
+  free(stream->token);
+
+  memset(stream, 0, sizeof(*stream));
+
+  return FPX_JSON_RESULT_SUCCESS;
+}
+
+// STATIC FUNCTIONS BELOW -------------------------
+
+static Fpx_Json_E_Result _json_object_parse(_json_parser *parser,
+                                            Fpx_Json_Object *output) {
+  if (NULL == parser || NULL == output)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  TRIM_WHITESPACE(data, limit);
+  if ('{' != _json_peek(parser)) {
+    SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], '{');
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
 
-  if (*data == ']') {
-    if (!dry_run)
-      memset(output, 0, sizeof(Fpx_Json_Array));
+  ++parser->tape_pos;
 
-    RETURN(FPX_JSON_RESULT_SUCCESS);
+  if ('}' == _json_peek(parser)) {
+    ++parser->tape_pos;
+    memset(output, 0, sizeof(Fpx_Json_Object));
+    return FPX_JSON_RESULT_SUCCESS;
   }
 
-  uint8_t value_increment = 8;
-  uint16_t value_capacity = 0;
+  // this object's members go on top of the ones of the objects around it
+  size_t first_member = parser->member_count;
+  Fpx_Json_E_Result result = FPX_JSON_RESULT_SUCCESS;
+
+  while (FPX_JSON_RESULT_SUCCESS == result) {
+    // parsed into a local first; a nested object can move the stack
+    Fpx_Json_Member new_member;
 
-  Fpx_Json_Array new_arr = {0};
+    result = _json_member_parse(parser, &new_member);
+    if (FPX_JSON_RESULT_SUCCESS > result)
+      break;
 
-  do {
-    if (value_capacity == new_arr.count) {
-      new_arr.values = (Fpx_Json_Value *)realloc(
-          new_arr.values,
-          sizeof(Fpx_Json_Value) * (new_arr.count + value_increment));
-      value_capacity += value_increment;
+    if (0 > _json_member_push(parser, &new_member)) {
+      result = FPX_JSON_RESULT_MEMORY_ERROR;
+      break;
     }
 
-    Fpx_Json_E_Result val_res = _json_value_parse(
-        &data, limit, arena,
-        (dry_run) ? (output) : (&new_arr.values[new_arr.count]));
+    char next = _json_peek(parser);
 
-    if (FPX_JSON_RESULT_SUCCESS > val_res) {
-      free(new_arr.values);
-      return val_res;
-    }
+    if ('\0' == next) {
+      result = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    } else if (',' == next) {
+      ++parser->tape_pos;
 
-    TRIM_WHITESPACE(data, limit);
-    if (*data != ',' && *data != ']') {
-      free(new_arr.values);
-      SYNTAX_EXPECT(data, ']');
-      SYNTAX_EXPECT(data, ',');
-      return FPX_JSON_RESULT_SYNTAX_ERROR;
+      // a trailing comma is let through
+      if ('}' == _json_peek(parser)) {
+        ++parser->tape_pos;
+        break;
+      }
+    } else if ('}' == next) {
+      ++parser->tape_pos;
+      break;
+    } else {
+      SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], ',');
+      SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], '}');
+      result = FPX_JSON_RESULT_SYNTAX_ERROR;
     }
-    if (*data == ',')
-      ++data;
+  }
 
-    TRIM_WHITESPACE(data, limit);
+  size_t count = parser->member_count - first_member;
+  parser->member_count = first_member;
 
-    new_arr.count++;
-  } while (data < limit && *data != ']');
+  if (FPX_JSON_RESULT_SUCCESS > result)
+    return result;
 
-  if (!dry_run) {
-    ((Fpx_Json_Array *)output)->values =
-        fpx_arena_alloc(arena, sizeof(Fpx_Json_Value) * new_arr.count);
+  // the pointer to the hash index goes in front of the members; it is built
+  // on the first lookup, if there ever is one
+  size_t link = (OBJECT_INDEX_MIN <= count) ? sizeof(struct _json_index *) : 0;
 
-    if (NULL == ((Fpx_Json_Array *)output)->values) {
-      free(new_arr.values);
-      return FPX_JSON_RESULT_MEMORY_ERROR;
-    }
+  char *block =
+      fpx_bump_alloc(parser->arena, link + count * sizeof(Fpx_Json_Member));
 
-    memcpy(((Fpx_Json_Array *)output)->values, new_arr.values,
-           new_arr.count * sizeof(Fpx_Json_Value));
-    ((Fpx_Json_Array *)output)->count = new_arr.count;
-  } else {
-    *(size_t *)output += sizeof(Fpx_Json_Value) * new_arr.count;
-  }
+  if (NULL == block)
+    return FPX_JSON_RESULT_MEMORY_ERROR;
 
-  free(new_arr.values);
+  if (0 < link)
+    *(struct _json_index **)block = NULL;
 
-  RETURN(FPX_JSON_RESULT_SUCCESS);
+  output->members = (Fpx_Json_Member *)(block + link);
+
+  memcpy(output->members, &parser->members[first_member],
+         count * sizeof(Fpx_Json_Member));
+  output->memberCount = count;
+
+  return FPX_JSON_RESULT_SUCCESS;
 }
 
-static void _json_object_print(Fpx_Json_Object *obj) {
-  if (NULL == obj)
-    return;
+static Fpx_Json_E_Result _json_member_parse(_json_parser *parser,
+                                            Fpx_Json_Member *output) {
+  if (NULL == parser || NULL == output)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  printf("{");
-  for (size_t i = 0; i < obj->memberCount; ++i) {
-    Fpx_Json_Member *m = &obj->members[i];
+  Fpx_Json_Member new_member = {0};
 
-    printf("\"%s\":", m->key.data);
+  new_member.value = fpx_bump_alloc(parser->arena, sizeof(*new_member.value));
 
-    _json_value_print(m->value);
+  if (NULL == new_member.value) {
+    return FPX_JSON_RESULT_MEMORY_ERROR;
+  }
 
-    if (i < (obj->memberCount - 1))
-      printf(",");
+  Fpx_Json_E_Result key_result = _json_string_parse(parser, &new_member.key);
+
+  if (FPX_JSON_RESULT_SUCCESS > key_result)
+    return key_result;
+
+  char next = _json_peek(parser);
+  if ('\0' == next)
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+  if (':' != next) {
+    SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], ':');
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
   }
-  printf("}");
 
-  return;
-}
+  ++parser->tape_pos;
 
-static void _json_array_print(Fpx_Json_Array *arr) {
-  if (NULL == arr)
-    return;
+  // parse value
+  Fpx_Json_E_Result val_res = _json_value_parse(parser, new_member.value);
 
-  printf("[");
-  for (size_t i = 0; i < arr->count; ++i) {
-    _json_value_print(&arr->values[i]);
+  if (FPX_JSON_RESULT_SUCCESS > val_res)
+    return val_res;
 
-    if (i < (arr->count - 1))
-      printf(",");
-  }
-  printf("]");
+  *output = new_member;
+
+  return FPX_JSON_RESULT_SUCCESS;
 }
 
-static void _json_value_print(Fpx_Json_Value *val) {
-  if (NULL == val)
-    return;
+static Fpx_Json_E_Result _json_value_parse(_json_parser *parser,
+                                           Fpx_Json_Value *output) {
+  if (NULL == parser || NULL == output)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
 
-  switch (val->valueType) {
-  case FPX_JSON_VALUE_BOOL:
-    printf("%s", (val->boolean) ? "true" : "false");
+  if (FALSE == _json_tape_fill(parser, 1))
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+
+  // numbers and literals are parsed from here
+  const char *data = parser->data + parser->tape[parser->tape_pos];
+  const char *limit = parser->data + parser->len;
+
+  Fpx_Json_Value new_val = {0};
+  Fpx_Json_E_ValueType type = FPX_JSON_VALUE_INVALID;
+  Fpx_Json_E_Result result = FPX_JSON_RESULT_SUCCESS;
+
+  switch (*data) {
+  case '-':
+  case '0':
+  case '1':
+  case '2':
+  case '3':
+  case '4':
+  case '5':
+  case '6':
+  case '7':
+  case '8':
+  case '9':
+  case 'i': // infinity
+  case 'I': // infinity
+    type = FPX_JSON_VALUE_NUMBER;
+    result = _json_number_parse(&data, limit, &new_val.number);
+    if (FPX_JSON_RESULT_SUCCESS > result)
+      return result;
+    result = _json_atom_end(parser, data);
     break;
 
-  case FPX_JSON_VALUE_NULL:
-    printf("null");
+  case 't':
+  case 'f':
+    type = FPX_JSON_VALUE_BOOL;
+    result = _json_bool_parse(&data, limit, &new_val.boolean);
+    if (FPX_JSON_RESULT_SUCCESS > result)
+      return result;
+    result = _json_atom_end(parser, data);
     break;
 
-  case FPX_JSON_VALUE_NUMBER:
-    printf("%lf", val->number);
+  case 'n':
+    type = FPX_JSON_VALUE_NULL;
+    result = _json_null_validate(&data, limit);
+    if (FPX_JSON_RESULT_SUCCESS > result)
+      return result;
+    result = _json_atom_end(parser, data);
     break;
 
-  case FPX_JSON_VALUE_STRING:
-    printf("\"%s\"", val->string.data);
+  case '{':
+    type = FPX_JSON_VALUE_OBJECT;
+    result = _json_object_parse(parser, &new_val.object);
     break;
 
-  case FPX_JSON_VALUE_OBJECT:
-    _json_object_print(&val->object);
+  case '[':
+    type = FPX_JSON_VALUE_ARRAY;
+    result = _json_array_parse(parser, &new_val.array);
     break;
 
-  case FPX_JSON_VALUE_ARRAY:
-    _json_array_print(&val->array);
+  case '"':
+    type = FPX_JSON_VALUE_STRING;
+    result = _json_string_parse(parser, &new_val.string);
     break;
 
   default:
-    break;
+    FPX_ERROR("General syntax error while checking for JSON value\n");
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
   }
 
-  return;
+  if (FPX_JSON_RESULT_SUCCESS > result)
+    return result;
+
+  new_val.valueType = type;
+
+  *output = new_val;
+
+  return FPX_JSON_RESULT_SUCCESS;
+}
+
+static Fpx_Json_E_Result _json_string_parse(_json_parser *parser,
+                                            Fpx_Json_String *output) {
+  Fpx_Json_String retval = {0};
+
+  if ('"' != _json_peek(parser)) {
+    SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], '"');
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  // nothing inside a string is on the tape, so the closing quote is the
+  // very next entry
+  if (FALSE == _json_tape_fill(parser, 2))
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+
+  const char *data = parser->data + parser->tape[parser->tape_pos] + 1;
+  const char *next_dbl_quote =
+      parser->data + parser->tape[parser->tape_pos + 1];
+
+  parser->tape_pos += 2;
+
+  // empty string
+  if (data == next_dbl_quote) {
+    output->size = 0;
+    output->data = NULL;
+
+    return FPX_JSON_RESULT_SUCCESS;
+  }
+
+  // unescaping never makes a string longer, so this is enough
+  size_t clone_idx = 0;
+  size_t reserved = next_dbl_quote - data + 1;
+  retval.data = _json_string_space(parser, reserved);
+
+  if (NULL == retval.data)
+    return FPX_JSON_RESULT_MEMORY_ERROR;
+
+  for (; data < next_dbl_quote; ++data) {
+    size_t plain =
+        _json_plain_span(data, next_dbl_quote, parser->data + parser->len);
+
+    // printable ASCII without escapes goes over as is
+    if (0 < plain) {
+      memcpy(retval.data + clone_idx, data, plain);
+      clone_idx += plain;
+      data += plain;
+
+      if (data == next_dbl_quote)
+        break;
+    }
+
+    if (*data == '\\') {
+      ++data;
+      uint8_t to_clone = ' '; // filler in case of weird logic error
+
+      if (*data == '"' || *data == '\\' || *data == '/')
+        to_clone = *data;
+      else if (*data == 'r')
+        to_clone = '\r';
+      else if (*data == 'n')
+        to_clone = '\n';
+      else if (*data == 't')
+        to_clone = '\t';
+      else if (*data == 'b')
+        to_clone = '\b';
+      else if (*data == 'f')
+        to_clone = '\f';
+
+      if (*data != 'u')
+        retval.data[clone_idx++] = to_clone;
+      else {
+        // ESCAPE UNICODE 2 BYTES
+
+        // if unicode escape sequence reaches past the next double quote:
+        if (data + 5 > next_dbl_quote) {
+          return FPX_JSON_RESULT_SYNTAX_ERROR;
+        }
+
+        // should be good for both endiannesses
+        for (size_t _iter = 0; _iter < 2; ++_iter) {
+          uint8_t byteval = 0;
+
+          for (size_t _iter2 = 0; _iter2 < 2; ++_iter2) {
+            byteval <<= 4;
+            ++data;
+            uint8_t nibble = 0;
+            if (*data >= 'A' && *data <= 'F')
+              nibble = *data - 55;
+            else if (*data >= 'a' && *data <= 'f')
+              nibble = *data - 87;
+
+            byteval |= nibble & 0x0f;
+          }
+
+          retval.data[clone_idx++] = byteval;
+        }
+      }
+    } else if (*data >= ' ' && *data <= '~') {
+      retval.data[clone_idx++] = *data;
+    }
+  }
+
+  retval.data[clone_idx] = 0;
+  retval.size = clone_idx;
+
+  // what unescaping saved goes back for the next string
+  parser->strings -= reserved - (clone_idx + 1);
+  parser->strings_left += reserved - (clone_idx + 1);
+
+  *output = retval;
+
+  return FPX_JSON_RESULT_SUCCESS;
+}
+
+static Fpx_Json_E_Result _json_number_parse(const char **string,
+                                            const char *limit, double *output) {
+  const char *data = *string;
+
+#define RETURN(_return_value)                                                  \
+  {                                                                            \
+    *string = data;                                                            \
+    return _return_value;                                                      \
+  }
+
+  uint8_t min_space = 1;
+  if (*data == 'i' || *data == 'I') {
+    min_space = 8;
+    if (limit - data < min_space || 0 != strncasecmp("infinity", data, 8)) {
+      return FPX_JSON_RESULT_SYNTAX_ERROR;
+    }
+  } else if (*data == '-')
+    min_space = 2;
+  else if (*data < '0' || *data > '9') {
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  if (limit - data < min_space)
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+
+  size_t used = 0;
+
+  int result = fpx_strdouble(data, limit - data, output, &used);
+
+  if (-3 == result)
+    return FPX_JSON_RESULT_MEMORY_ERROR;
+  if (0 != result)
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+
+  if (data + used >= limit)
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+
+  data += used;
+
+  RETURN(FPX_JSON_RESULT_SUCCESS);
+
+#undef RETURN
+}
+
+static Fpx_Json_E_Result _json_bool_parse(const char **string,
+                                          const char *limit, bool *output) {
+  if (NULL == string || NULL == *string || NULL == limit || NULL == output)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+  const char *data = *string;
+
+#define RETURN(_return_value)                                                  \
+  {                                                                            \
+    *string = data;                                                            \
+    return _return_value;                                                      \
+  }
+
+  uint8_t min_space = 4;
+
+  if (*data == 'f')
+    min_space = 5;
+  else if (*data != 't') {
+    SYNTAX_EXPECT(data, 't');
+    SYNTAX_EXPECT(data, 'f');
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  if (limit - data < min_space)
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+
+  if (*data == 't' && 0 == strncmp("true", data, 4)) {
+    data += 4;
+    *output = true;
+  } else if (*data == 'f' && 0 == strncmp("false", data, 5)) {
+    data += 5;
+    *output = false;
+  } else {
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  RETURN(FPX_JSON_RESULT_SUCCESS);
+
+#undef RETURN
+}
+
+static Fpx_Json_E_Result _json_null_validate(const char **string,
+                                             const char *limit) {
+  if (NULL == string || NULL == *string || NULL == limit)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+  const char *data = *string;
+
+#define RETURN(_return_value)                                                  \
+  {                                                                            \
+    *string = data;                                                            \
+    return _return_value;                                                      \
+  }
+
+  if (*data != 'n') {
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  if (limit - data < 4)
+    return FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+
+  if (0 != strncmp("null", data, 4)) {
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  data += 4;
+
+  RETURN(FPX_JSON_RESULT_SUCCESS);
+
+#undef RETURN
+}
+
+static Fpx_Json_E_Result _json_array_parse(_json_parser *parser,
+                                           Fpx_Json_Array *output) {
+  if (NULL == parser || NULL == output)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+
+  if ('[' != _json_peek(parser)) {
+    SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], '[');
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  ++parser->tape_pos;
+
+  if (']' == _json_peek(parser)) {
+    ++parser->tape_pos;
+    memset(output, 0, sizeof(Fpx_Json_Array));
+    return FPX_JSON_RESULT_SUCCESS;
+  }
+
+  // this array's values go on top of the ones of the arrays around it
+  size_t first_value = parser->value_count;
+  Fpx_Json_E_Result result = FPX_JSON_RESULT_SUCCESS;
+
+  while (FPX_JSON_RESULT_SUCCESS == result) {
+    // parsed into a local first; a nested array can move the stack
+    Fpx_Json_Value new_val;
+
+    result = _json_value_parse(parser, &new_val);
+    if (FPX_JSON_RESULT_SUCCESS > result)
+      break;
+
+    if (0 > _json_value_push(parser, &new_val)) {
+      result = FPX_JSON_RESULT_MEMORY_ERROR;
+      break;
+    }
+
+    char next = _json_peek(parser);
+
+    if ('\0' == next) {
+      result = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    } else if (',' == next) {
+      ++parser->tape_pos;
+
+      // a trailing comma is let through
+      if (']' == _json_peek(parser)) {
+        ++parser->tape_pos;
+        break;
+      }
+    } else if (']' == next) {
+      ++parser->tape_pos;
+      break;
+    } else {
+      SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], ']');
+      SYNTAX_EXPECT(parser->data + parser->tape[parser->tape_pos], ',');
+      result = FPX_JSON_RESULT_SYNTAX_ERROR;
+    }
+  }
+
+  size_t count = parser->value_count - first_value;
+  parser->value_count = first_value;
+
+  if (FPX_JSON_RESULT_SUCCESS > result)
+    return result;
+
+  output->values =
+      fpx_bump_alloc(parser->arena, count * sizeof(Fpx_Json_Value));
+
+  if (NULL == output->values)
+    return FPX_JSON_RESULT_MEMORY_ERROR;
+
+  memcpy(output->values, &parser->values[first_value],
+         count * sizeof(Fpx_Json_Value));
+  output->count = count;
+
+  return FPX_JSON_RESULT_SUCCESS;
+}
+
+static char _json_peek(_json_parser *parser) {
+  if (FALSE == _json_tape_fill(parser, 1))
+    return '\0';
+
+  return parser->data[parser->tape[parser->tape_pos]];
+}
+
+static Fpx_Json_E_Result _json_atom_end(_json_parser *parser,
+                                        const char *end) {
+  // a document that is just a number or literal is the first entry; what
+  // comes after the root has never been looked at
+  if (parser->root == parser->tape[parser->tape_pos]) {
+    ++parser->tape_pos;
+    return FPX_JSON_RESULT_SUCCESS;
+  }
+
+  // the next thing on the tape is past the number or literal
+  size_t next = (_json_tape_fill(parser, 2))
+                    ? parser->tape[parser->tape_pos + 1]
+                    : parser->len;
+
+  for (; end < parser->data + next; ++end) {
+    if (!IS_WHITESPACE(*end))
+      return FPX_JSON_RESULT_SYNTAX_ERROR;
+  }
+
+  // the same goes the other way; "12" followed by "x" is not "12x"
+  if (end > parser->data + next)
+    return FPX_JSON_RESULT_SYNTAX_ERROR;
+
+  ++parser->tape_pos;
+
+  return FPX_JSON_RESULT_SUCCESS;
+}
+
+static int _json_member_push(_json_parser *parser,
+                             const Fpx_Json_Member *member) {
+  if (parser->member_count == parser->member_capacity) {
+    size_t capacity = (0 < parser->member_capacity)
+                          ? parser->member_capacity * 2
+                          : SCRATCH_MIN_ENTRIES;
+
+    Fpx_Json_Member *grown = (Fpx_Json_Member *)realloc(
+        parser->members, capacity * sizeof(Fpx_Json_Member));
+    if (NULL == grown)
+      return -1;
+
+    parser->members = grown;
+    parser->member_capacity = capacity;
+  }
+
+  parser->members[parser->member_count++] = *member;
+
+  return 0;
+}
+
+static char *_json_string_space(_json_parser *parser, size_t size) {
+  if (parser->strings_left < size) {
+    // the rest of the current piece is left unused
+    size_t piece = (STRING_PIECE > size) ? STRING_PIECE : size;
+
+    char *grown = (char *)fpx_bump_alloc(parser->arena, piece);
+    if (NULL == grown)
+      return NULL;
+
+    parser->strings = grown;
+    parser->strings_left = piece;
+  }
+
+  char *space = parser->strings;
+
+  parser->strings += size;
+  parser->strings_left -= size;
+
+  return space;
+}
+
+static int _json_value_push(_json_parser *parser, const Fpx_Json_Value *value) {
+  if (parser->value_count == parser->value_capacity) {
+    size_t capacity = (0 < parser->value_capacity) ? parser->value_capacity * 2
+                                                   : SCRATCH_MIN_ENTRIES;
+
+    Fpx_Json_Value *grown = (Fpx_Json_Value *)realloc(
+        parser->values, capacity * sizeof(Fpx_Json_Value));
+    if (NULL == grown)
+      return -1;
+
+    parser->values = grown;
+    parser->value_capacity = capacity;
+  }
+
+  parser->values[parser->value_count++] = *value;
+
+  return 0;
+}
+
+static void _json_object_print(Fpx_Json_Object *obj) {
+  if (NULL == obj)
+    return;
+
+  printf("{");
+  for (size_t i = 0; i < obj->memberCount; ++i) {
+    Fpx_Json_Member *m = &obj->members[i];
+
+    printf("\"%s\":", m->key.data);
+
+    _json_value_print(m->value);
+
+    if (i < (obj->memberCount - 1))
+      printf(",");
+  }
+  printf("}");
+
+  return;
+}
+
+static void _json_array_print(Fpx_Json_Array *arr) {
+  if (NULL == arr)
+    return;
+
+  printf("[");
+  for (size_t i = 0; i < arr->count; ++i) {
+    _json_value_print(&arr->values[i]);
+
+    if (i < (arr->count - 1))
+      printf(",");
+  }
+  printf("]");
+}
+
+static void _json_value_print(Fpx_Json_Value *val) {
+  if (NULL == val)
+    return;
+
+  switch (val->valueType) {
+  case FPX_JSON_VALUE_BOOL:
+    printf("%s", (val->boolean) ? "true" : "false");
+    break;
+
+  case FPX_JSON_VALUE_NULL:
+    printf("null");
+    break;
+
+  case FPX_JSON_VALUE_NUMBER:
+    printf("%lf", val->number);
+    break;
+
+  case FPX_JSON_VALUE_STRING:
+    printf("\"%s\"", val->string.data);
+    break;
+
+  case FPX_JSON_VALUE_OBJECT:
+    _json_object_print(&val->object);
+    break;
+
+  case FPX_JSON_VALUE_ARRAY:
+    _json_array_print(&val->array);
+    break;
+
+  default:
+    break;
+  }
+
+  return;
+}
+
+static size_t _json_plain_span(const char *data, const char *limit,
+                               const char *readable) {
+  const char *start = data;
+
+#if defined(JSON_X86)
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i del = _mm_set1_epi8(0x7f);
+
+  // most strings are shorter than a block; rather than going through those
+  // a byte at a time, the rest of the document is read along and masked off
+  for (; data < limit && readable - data >= 16; data += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)data);
+
+    // signed, so this also catches everything from 0x80 up
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmplt_epi8(v, space)),
+        _mm_cmpeq_epi8(v, del));
+
+    int mask = _mm_movemask_epi8(special);
+    if (limit - data < 16)
+      mask |= 1 << (limit - data);
+
+    if (0 != mask)
+      return (data - start) + __builtin_ctz(mask);
+  }
+#else
+  (void)readable;
+#endif
+
+  for (; data < limit && *data != '\\' && *data >= ' ' && *data <= '~'; ++data)
+    ;
+
+  return data - start;
+}
+
+static inline int _json_tape_fill(_json_parser *parser, size_t count) {
+  // nearly always the case; the rest is kept out of line
+  if (parser->tape_len - parser->tape_pos >= count)
+    return TRUE;
+
+  return _json_tape_refill(parser, count);
+}
+
+static int _json_tape_refill(_json_parser *parser, size_t count) {
+  // what is left of the window goes to the front
+  parser->tape_len -= parser->tape_pos;
+  memmove(parser->tape, parser->tape + parser->tape_pos,
+          parser->tape_len * sizeof(uint32_t));
+  parser->tape_pos = 0;
+
+  _json_block block;
+  uint8_t last[INDEX_BLOCK];
+
+  // a block never adds more than INDEX_BLOCK entries
+  while (parser->indexed < parser->len &&
+         parser->tape_len + INDEX_BLOCK <= TAPE_ENTRIES) {
+    const uint8_t *current = (const uint8_t *)parser->data + parser->indexed;
+    size_t remaining = parser->len - parser->indexed;
+
+    if (remaining < INDEX_BLOCK) {
+      // spaces change nothing about what comes before them
+      memset(last, ' ', sizeof(last));
+      memcpy(last, current, remaining);
+      current = last;
+    }
+
+    _json_classify(current, &block);
+    parser->tape_len +=
+        _json_index_block(&parser->index_state, &block, parser->indexed,
+                          parser->tape + parser->tape_len);
+
+    parser->indexed += INDEX_BLOCK;
+  }
+
+  return (parser->tape_len >= count);
+}
+
+static size_t _json_index_block(_json_index_state *state,
+                                const _json_block *block, uint32_t offset,
+                                uint32_t *tape) {
+  // a backslash escapes the byte after it, unless it is escaped itself.
+  // runs of them are rare enough to just walk
+  uint64_t escaped = state->escaped;
+  uint64_t backslash = block->backslash & ~state->escaped;
+
+  state->escaped = 0;
+
+  while (backslash) {
+    uint64_t bit = backslash & (0 - backslash);
+
+    // the last byte escapes the first one of the next block
+    if (bit >> 63)
+      state->escaped = 1;
+
+    escaped |= bit << 1;
+    backslash &= ~(bit | (bit << 1));
+  }
+
+  uint64_t quote = block->quote & ~escaped;
+
+  // every bit from an opening quote up to (not including) the closing one
+  uint64_t in_string = quote;
+  in_string ^= in_string << 1;
+  in_string ^= in_string << 2;
+  in_string ^= in_string << 4;
+  in_string ^= in_string << 8;
+  in_string ^= in_string << 16;
+  in_string ^= in_string << 32;
+  in_string ^= state->in_string;
+
+  state->in_string = (uint64_t)((int64_t)in_string >> 63);
+
+  uint64_t op = block->op & ~in_string;
+
+  // numbers and literals: whatever is left outside of strings
+  uint64_t scalar =
+      ~(block->op | quote | block->whitespace | in_string);
+  uint64_t scalar_start = scalar & ~((scalar << 1) | state->scalar);
+
+  state->scalar = scalar >> 63;
+
+  uint64_t structural = op | quote | scalar_start;
+  size_t count = 0;
+
+  while (structural) {
+    tape[count++] = offset + (uint32_t)__builtin_ctzll(structural);
+    structural &= structural - 1;
+  }
+
+  return count;
+}
+
+#if defined(JSON_X86)
+static void _json_classify_sse2(const uint8_t *data, _json_block *block) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  // '[' and ']' are '{' and '}' without 0x20
+  const __m128i brace_open = _mm_set1_epi8('{');
+  const __m128i brace_close = _mm_set1_epi8('}');
+
+  memset(block, 0, sizeof(*block));
+
+  for (int i = 0; i < INDEX_BLOCK / 16; ++i) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i * 16));
+    __m128i folded = _mm_or_si128(v, case_bit);
+
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+    __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, brace_open),
+                                           _mm_cmpeq_epi8(folded, brace_close)),
+                              _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                                           _mm_cmpeq_epi8(v, comma)));
+
+    int shift = i * 16;
+    block->quote |=
+        (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote))
+        << shift;
+    block->backslash |=
+        (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash))
+        << shift;
+    block->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << shift;
+    block->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+  }
+}
+
+__attribute__((target("avx2"))) static void
+_json_classify_avx2(const uint8_t *data, _json_block *block) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i colon = _mm256_set1_epi8(':');
+  const __m256i comma = _mm256_set1_epi8(',');
+  const __m256i case_bit = _mm256_set1_epi8(0x20);
+  const __m256i brace_open = _mm256_set1_epi8('{');
+  const __m256i brace_close = _mm256_set1_epi8('}');
+
+  memset(block, 0, sizeof(*block));
+
+  for (int i = 0; i < INDEX_BLOCK / 32; ++i) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(data + i * 32));
+    __m256i folded = _mm256_or_si256(v, case_bit);
+
+    __m256i ws = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                        _mm256_cmpeq_epi8(v, tab)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+    __m256i op =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, brace_open),
+                                        _mm256_cmpeq_epi8(folded, brace_close)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+                                        _mm256_cmpeq_epi8(v, comma)));
+
+    int shift = i * 32;
+    block->quote |=
+        (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote))
+        << shift;
+    block->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                            _mm256_cmpeq_epi8(v, backslash))
+                        << shift;
+    block->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << shift;
+    block->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+  }
+}
+#else
+static void _json_classify_bytes(const uint8_t *data, _json_block *block) {
+  memset(block, 0, sizeof(*block));
+
+  for (size_t i = 0; i < INDEX_BLOCK; ++i) {
+    uint64_t bit = 1ULL << i;
+
+    switch (data[i]) {
+    case '"':
+      block->quote |= bit;
+      break;
+    case '\\':
+      block->backslash |= bit;
+      break;
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      block->whitespace |= bit;
+      break;
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',':
+      block->op |= bit;
+      break;
+    }
+  }
+}
+#endif
+
+static void _json_writer_put(Fpx_Json_Writer *writer, const char *data,
+                             size_t len) {
+  while (0 < len && FPX_JSON_RESULT_SUCCESS == writer->error) {
+    if (writer->length == writer->capacity) {
+      _json_writer_drain(writer);
+      continue;
+    }
+
+    size_t room = writer->capacity - writer->length;
+    size_t count = (len < room) ? len : room;
+
+    memcpy(writer->buffer + writer->length, data, count);
+    writer->length += count;
+
+    data += count;
+    len -= count;
+  }
+}
+
+static void _json_writer_drain(Fpx_Json_Writer *writer) {
+  if (NULL == writer->flush) {
+    writer->error = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    return;
+  }
+
+  if (0 != writer->flush(writer->context, writer->buffer, writer->length)) {
+    writer->error = FPX_JSON_RESULT_MEMORY_ERROR;
+    return;
+  }
+
+  writer->written += writer->length;
+  writer->length = 0;
+}
+
+static void _json_writer_newline(Fpx_Json_Writer *writer) {
+  static const char spaces[] = "                                ";
+
+  _json_writer_put(writer, "\n", 1);
+
+  size_t left = (size_t)writer->indent * writer->depth;
+
+  while (0 < left) {
+    size_t count = (left < sizeof(spaces) - 1) ? left : sizeof(spaces) - 1;
+
+    _json_writer_put(writer, spaces, count);
+    left -= count;
+  }
+}
+
+static Fpx_Json_E_Result _json_writer_entry(Fpx_Json_Writer *writer) {
+  if (FPX_JSON_RESULT_SUCCESS > writer->error)
+    return writer->error;
+
+  uint8_t *level = &writer->levels[writer->depth];
+
+  if (0 == writer->depth) {
+    // there is only one value at the top
+    if (*level & LEVEL_HAS_ENTRIES)
+      return (writer->error = FPX_JSON_RESULT_SYNTAX_ERROR);
+  } else if (*level & LEVEL_OBJECT) {
+    // the key already took care of the comma and indentation
+    if (false == writer->after_key)
+      return (writer->error = FPX_JSON_RESULT_SYNTAX_ERROR);
+  } else {
+    if (*level & LEVEL_HAS_ENTRIES)
+      _json_writer_put(writer, ",", 1);
+
+    if (writer->indent)
+      _json_writer_newline(writer);
+  }
+
+  *level |= LEVEL_HAS_ENTRIES;
+  writer->after_key = false;
+
+  return writer->error;
+}
+
+static Fpx_Json_E_Result _json_writer_begin(Fpx_Json_Writer *writer,
+                                            uint8_t level, char bracket) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+
+  if (FPX_JSON_RESULT_SUCCESS > _json_writer_entry(writer))
+    return writer->error;
+
+  if (FPX_JSON_WRITER_MAX_DEPTH == writer->depth)
+    return (writer->error = FPX_JSON_RESULT_SYNTAX_ERROR);
+
+  _json_writer_put(writer, &bracket, 1);
+
+  writer->levels[++writer->depth] = level;
+
+  return writer->error;
+}
+
+static Fpx_Json_E_Result _json_writer_end(Fpx_Json_Writer *writer,
+                                          uint8_t level, char bracket) {
+  if (NULL == writer)
+    return FPX_JSON_RESULT_ARGUMENT_ERROR;
+
+  if (FPX_JSON_RESULT_SUCCESS > writer->error)
+    return writer->error;
+
+  uint8_t current = writer->levels[writer->depth];
+
+  if (0 == writer->depth || level != (current & LEVEL_OBJECT) ||
+      writer->after_key)
+    return (writer->error = FPX_JSON_RESULT_SYNTAX_ERROR);
+
+  --writer->depth;
+
+  // empty containers stay on one line
+  if (writer->indent && (current & LEVEL_HAS_ENTRIES))
+    _json_writer_newline(writer);
+
+  _json_writer_put(writer, &bracket, 1);
+
+  return writer->error;
+}
+
+static void _json_writer_escaped(Fpx_Json_Writer *writer, const char *string,
+                                 size_t len) {
+  static const char hex[] = "0123456789abcdef";
+
+  const char *limit = string + len;
+
+  _json_writer_put(writer, "\"", 1);
+
+  while (0 < len) {
+    size_t plain = _json_escape_span(string, limit);
+
+    _json_writer_put(writer, string, plain);
+    string += plain;
+    len -= plain;
+
+    if (0 == len)
+      break;
+
+    char escape[6] = {'\\', 0, '0', '0', 0, 0};
+    size_t escape_len = 2;
+
+    switch (*string) {
+    case '"':
+    case '\\':
+      escape[1] = *string;
+      break;
+    case '\b':
+      escape[1] = 'b';
+      break;
+    case '\f':
+      escape[1] = 'f';
+      break;
+    case '\n':
+      escape[1] = 'n';
+      break;
+    case '\r':
+      escape[1] = 'r';
+      break;
+    case '\t':
+      escape[1] = 't';
+      break;
+    default:
+      // the rest of the control characters
+      escape[1] = 'u';
+      escape[4] = hex[(uint8_t)*string >> 4];
+      escape[5] = hex[(uint8_t)*string & 0x0f];
+      escape_len = 6;
+      break;
+    }
+
+    _json_writer_put(writer, escape, escape_len);
+    ++string;
+    --len;
+  }
+
+  _json_writer_put(writer, "\"", 1);
+}
+
+static size_t _json_escape_span(const char *data, const char *limit) {
+  const char *start = data;
+
+#if defined(JSON_X86)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+
+  for (; limit - data >= 16; data += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)data);
+
+    // unsigned v <= 0x1f; UTF-8 goes out as it came in
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+        _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+
+    int mask = _mm_movemask_epi8(special);
+    if (0 != mask)
+      return (data - start) + __builtin_ctz(mask);
+  }
+#endif
+
+  for (; data < limit && *data != '"' && *data != '\\' &&
+         (uint8_t)*data >= ' ';
+       ++data)
+    ;
+
+  return data - start;
+}
+
+static const char *_json_stream_structural(Fpx_Json_Stream *stream,
+                                           const char *data) {
+  uint8_t in_object =
+      (0 < stream->depth) ? stream->stack[stream->depth - 1] : FALSE;
+
+  switch (stream->state) {
+  case STREAM_VALUE:
+    return _json_stream_value(stream, data);
+
+  case STREAM_ARRAY_FIRST:
+    if (']' == *data)
+      return _json_stream_close(stream, data, FALSE);
+
+    return _json_stream_value(stream, data);
+
+  case STREAM_OBJECT_FIRST:
+    if ('}' == *data)
+      return _json_stream_close(stream, data, TRUE);
+
+    // fall through
+  case STREAM_KEY:
+    if ('"' != *data)
+      break;
+
+    stream->state = STREAM_STRING;
+    stream->in_key = true;
+    return data + 1;
+
+  case STREAM_COLON:
+    if (':' != *data)
+      break;
+
+    stream->state = STREAM_VALUE;
+    return data + 1;
+
+  case STREAM_AFTER_VALUE:
+    if (0 == stream->depth) {
+      // the next top-level value; "1 2" is two values, "12" is one
+      if (false == stream->gap)
+        break;
+
+      return _json_stream_value(stream, data);
+    }
+
+    if (',' == *data) {
+      stream->state = (in_object) ? STREAM_KEY : STREAM_VALUE;
+      return data + 1;
+    }
+
+    if ('}' == *data || ']' == *data)
+      return _json_stream_close(stream, data, ('}' == *data));
+
+    break;
+  }
+
+  stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+  return NULL;
+}
+
+static const char *_json_stream_value(Fpx_Json_Stream *stream,
+                                      const char *data) {
+  const Fpx_Json_Callbacks *callbacks = stream->callbacks;
+
+  switch (*data) {
+  case '{':
+    if (0 > _json_stream_push(stream, TRUE))
+      return NULL;
+
+    if (NULL != callbacks->start_object &&
+        0 > _json_stream_called(stream,
+                                callbacks->start_object(stream->context)))
+      return NULL;
+
+    stream->state = STREAM_OBJECT_FIRST;
+    return data + 1;
+
+  case '[':
+    if (0 > _json_stream_push(stream, FALSE))
+      return NULL;
+
+    if (NULL != callbacks->start_array &&
+        0 > _json_stream_called(stream,
+                                callbacks->start_array(stream->context)))
+      return NULL;
+
+    stream->state = STREAM_ARRAY_FIRST;
+    return data + 1;
+
+  case '"':
+    stream->state = STREAM_STRING;
+    stream->in_key = false;
+    return data + 1;
+
+  case 't':
+    stream->literal = "true";
+    break;
+
+  case 'f':
+    stream->literal = "false";
+    break;
+
+  case 'n':
+    stream->literal = "null";
+    break;
+
+  default:
+    if ('-' == *data || ('0' <= *data && '9' >= *data)) {
+      stream->state = STREAM_NUMBER;
+      return data;
+    }
+
+    stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+    return NULL;
+  }
+
+  stream->state = STREAM_LITERAL;
+  stream->literal_matched = 0;
+
+  return data;
+}
+
+static const char *_json_stream_string(Fpx_Json_Stream *stream,
+                                       const char *data, const char *limit) {
+  while (data < limit) {
+    if (ESCAPE_NONE != stream->escape) {
+      data = _json_stream_escape(stream, data);
+      if (NULL == data)
+        return NULL;
+
+      continue;
+    }
+
+    size_t plain = _json_escape_span(data, limit);
+    const char *string = data;
+
+    data += plain;
+
+    if (data == limit) {
+      // the rest of the string is in a later chunk
+      if (0 > _json_stream_token_append(stream, string, plain))
+        return NULL;
+
+      return data;
+    }
+
+    if ('\\' == *data) {
+      if (0 > _json_stream_token_append(stream, string, plain))
+        return NULL;
+
+      stream->escape = ESCAPE_START;
+      ++data;
+      continue;
+    }
+
+    if ('"' != *data) {
+      // control characters have to be escaped
+      stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+      return NULL;
+    }
+
+    size_t len = plain;
+
+    if (0 < stream->token_len) {
+      if (0 > _json_stream_token_append(stream, string, plain))
+        return NULL;
+
+      string = stream->token;
+      len = stream->token_len;
+    } else if (len > stream->max_token) {
+      // the whole string is in this chunk, and is not copied; it is still
+      // held to the same limit
+      stream->error = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+      return NULL;
+    }
+
+    stream->token_len = 0;
+
+    const Fpx_Json_Callbacks *callbacks = stream->callbacks;
+    int result = 0;
+
+    if (stream->in_key) {
+      stream->state = STREAM_COLON;
+
+      if (NULL != callbacks->key)
+        result = callbacks->key(stream->context, string, len);
+    } else {
+      stream->state = STREAM_AFTER_VALUE;
+      stream->gap = false;
+      stream->values += (0 == stream->depth);
+
+      if (NULL != callbacks->string)
+        result = callbacks->string(stream->context, string, len);
+    }
+
+    if (0 > _json_stream_called(stream, result))
+      return NULL;
+
+    return data + 1;
+  }
+
+  return data;
+}
+
+static const char *_json_stream_escape(Fpx_Json_Stream *stream,
+                                       const char *data) {
+  char character = *data;
+  uint8_t value = 0;
+
+  switch (stream->escape) {
+  case ESCAPE_START:
+    stream->escape = ESCAPE_NONE;
+
+    switch (character) {
+    case '"':
+    case '\\':
+    case '/':
+      break;
+    case 'b':
+      character = '\b';
+      break;
+    case 'f':
+      character = '\f';
+      break;
+    case 'n':
+      character = '\n';
+      break;
+    case 'r':
+      character = '\r';
+      break;
+    case 't':
+      character = '\t';
+      break;
+    case 'u':
+      stream->escape = ESCAPE_HEX;
+      stream->hex_count = 0;
+      stream->code_unit = 0;
+      return data + 1;
+    default:
+      stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+      return NULL;
+    }
+
+    if (0 > _json_stream_token_append(stream, &character, 1))
+      return NULL;
+
+    return data + 1;
+
+  case ESCAPE_HEX:
+    if ('0' <= character && '9' >= character)
+      value = character - '0';
+    else if ('a' <= (character | 0x20) && 'f' >= (character | 0x20))
+      value = (character | 0x20) - 'a' + 10;
+    else {
+      stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+      return NULL;
+    }
+
+    stream->code_unit = (stream->code_unit << 4) | value;
+
+    if (4 > ++stream->hex_count)
+      return data + 1;
+
+    stream->escape = ESCAPE_NONE;
+
+    if (0 != stream->high_surrogate) {
+      // only the low half of the pair can come here
+      if (0xDC00 > stream->code_unit || 0xDFFF < stream->code_unit) {
+        stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+        return NULL;
+      }
+
+      uint32_t codepoint = 0x10000 +
+                           ((stream->high_surrogate - 0xD800) << 10) +
+                           (stream->code_unit - 0xDC00);
+      stream->high_surrogate = 0;
+
+      if (0 > _json_stream_token_codepoint(stream, codepoint))
+        return NULL;
+    } else if (0xD800 <= stream->code_unit && 0xDBFF >= stream->code_unit) {
+      stream->high_surrogate = stream->code_unit;
+      stream->escape = ESCAPE_LOW_SLASH;
+    } else if (0xDC00 <= stream->code_unit && 0xDFFF >= stream->code_unit) {
+      stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+      return NULL;
+    } else if (0 > _json_stream_token_codepoint(stream, stream->code_unit)) {
+      return NULL;
+    }
+
+    return data + 1;
+
+  case ESCAPE_LOW_SLASH:
+  case ESCAPE_LOW_U:
+    if (character != ((ESCAPE_LOW_SLASH == stream->escape) ? '\\' : 'u')) {
+      stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+      return NULL;
+    }
+
+    if (ESCAPE_LOW_SLASH == stream->escape) {
+      stream->escape = ESCAPE_LOW_U;
+    } else {
+      stream->escape = ESCAPE_HEX;
+      stream->hex_count = 0;
+      stream->code_unit = 0;
+    }
+
+    return data + 1;
+  }
+
+  stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+  return NULL;
+}
+
+static const char *_json_stream_number(Fpx_Json_Stream *stream,
+                                       const char *data, const char *limit) {
+  const char *number = data;
+
+  for (; data < limit && IS_NUMBER_CHAR(*data); ++data)
+    ;
+
+  size_t len = data - number;
+
+  if (data == limit) {
+    // there may be more of it in the next chunk
+    if (0 > _json_stream_token_append(stream, number, len))
+      return NULL;
+
+    return data;
+  }
+
+  if (0 < stream->token_len) {
+    if (0 > _json_stream_token_append(stream, number, len))
+      return NULL;
+
+    number = stream->token;
+    len = stream->token_len;
+  } else if (len > stream->max_token) {
+    stream->error = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    return NULL;
+  }
+
+  if (0 > _json_stream_number_done(stream, number, len))
+    return NULL;
+
+  return data;
+}
+
+static const char *_json_stream_literal(Fpx_Json_Stream *stream,
+                                        const char *data, const char *limit) {
+  const char *literal = stream->literal;
+
+  for (; data < limit && 0 != literal[stream->literal_matched];
+       ++data, ++stream->literal_matched) {
+    if (*data != literal[stream->literal_matched]) {
+      stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+      return NULL;
+    }
+  }
+
+  if (0 != literal[stream->literal_matched])
+    return data;
+
+  // "truex" is not valid either; that is up to whatever comes next
+  const Fpx_Json_Callbacks *callbacks = stream->callbacks;
+  int result = 0;
+
+  if ('n' == *literal) {
+    if (NULL != callbacks->null)
+      result = callbacks->null(stream->context);
+  } else if (NULL != callbacks->boolean) {
+    result = callbacks->boolean(stream->context, ('t' == *literal));
+  }
+
+  stream->state = STREAM_AFTER_VALUE;
+  stream->gap = false;
+  stream->values += (0 == stream->depth);
+
+  if (0 > _json_stream_called(stream, result))
+    return NULL;
+
+  return data;
+}
+
+static int _json_stream_push(Fpx_Json_Stream *stream, uint8_t is_object) {
+  if (stream->depth == stream->max_depth) {
+    stream->error = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    return -1;
+  }
+
+  if (stream->depth == stream->stack_capacity) {
+    size_t capacity = (0 < stream->stack_capacity)
+                          ? stream->stack_capacity * 2
+                          : STREAM_MIN_STACK;
+
+    uint8_t *grown = (uint8_t *)realloc(stream->stack, capacity);
+    if (NULL == grown) {
+      stream->error = FPX_JSON_RESULT_MEMORY_ERROR;
+      return -1;
+    }
+
+    stream->stack = grown;
+    stream->stack_capacity = capacity;
+  }
+
+  stream->stack[stream->depth++] = is_object;
+
+  return 0;
+}
+
+static const char *_json_stream_close(Fpx_Json_Stream *stream,
+                                      const char *data, uint8_t is_object) {
+  if (0 == stream->depth || is_object != stream->stack[stream->depth - 1]) {
+    stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+    return NULL;
+  }
+
+  --stream->depth;
+
+  stream->state = STREAM_AFTER_VALUE;
+  stream->gap = false;
+  stream->values += (0 == stream->depth);
+
+  const Fpx_Json_Callbacks *callbacks = stream->callbacks;
+  int result = 0;
+
+  if (is_object && NULL != callbacks->end_object)
+    result = callbacks->end_object(stream->context);
+  else if (!is_object && NULL != callbacks->end_array)
+    result = callbacks->end_array(stream->context);
+
+  if (0 > _json_stream_called(stream, result))
+    return NULL;
+
+  return data + 1;
+}
+
+static int _json_stream_number_done(Fpx_Json_Stream *stream,
+                                    const char *number, size_t len) {
+  // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  size_t i = 0;
+
+  if (i < len && '-' == number[i])
+    ++i;
+
+  if (i < len && '0' == number[i]) {
+    ++i;
+  } else if (i < len && '1' <= number[i] && '9' >= number[i]) {
+    for (; i < len && '0' <= number[i] && '9' >= number[i]; ++i)
+      ;
+  } else {
+    i = len + 1;
+  }
+
+  if (i < len && '.' == number[i]) {
+    size_t digits = ++i;
+
+    for (; i < len && '0' <= number[i] && '9' >= number[i]; ++i)
+      ;
+
+    if (i == digits)
+      i = len + 1;
+  }
+
+  if (i < len && ('e' == number[i] || 'E' == number[i])) {
+    ++i;
+
+    if (i < len && ('+' == number[i] || '-' == number[i]))
+      ++i;
+
+    size_t digits = i;
+
+    for (; i < len && '0' <= number[i] && '9' >= number[i]; ++i)
+      ;
+
+    if (i == digits)
+      i = len + 1;
+  }
+
+  double value = 0;
+  size_t used = 0;
+
+  if (i != len || 0 != fpx_strdouble(number, len, &value, &used) ||
+      used != len) {
+    stream->error = FPX_JSON_RESULT_SYNTAX_ERROR;
+    return -1;
+  }
+
+  stream->token_len = 0;
+  stream->state = STREAM_AFTER_VALUE;
+  stream->gap = false;
+  stream->values += (0 == stream->depth);
+
+  if (NULL != stream->callbacks->number)
+    return _json_stream_called(
+        stream, stream->callbacks->number(stream->context, value));
+
+  return 0;
+}
+
+static int _json_stream_token_append(Fpx_Json_Stream *stream,
+                                     const char *data, size_t len) {
+  if (0 == len)
+    return 0;
+
+  if (stream->max_token - stream->token_len < len) {
+    stream->error = FPX_JSON_RESULT_OUT_OF_BOUNDS_ERROR;
+    return -1;
+  }
+
+  if (stream->token_capacity - stream->token_len < len) {
+    size_t capacity = (0 < stream->token_capacity) ? stream->token_capacity
+                                                   : STREAM_MIN_TOKEN;
+
+    while (capacity - stream->token_len < len)
+      capacity *= 2;
+
+    char *grown = (char *)realloc(stream->token, capacity);
+    if (NULL == grown) {
+      stream->error = FPX_JSON_RESULT_MEMORY_ERROR;
+      return -1;
+    }
+
+    stream->token = grown;
+    stream->token_capacity = capacity;
+  }
+
+  memcpy(stream->token + stream->token_len, data, len);
+  stream->token_len += len;
+
+  return 0;
+}
+
+static int _json_stream_token_codepoint(Fpx_Json_Stream *stream,
+                                        uint32_t codepoint) {
+  char utf8[4];
+  size_t len = 0;
+
+  if (0x80 > codepoint) {
+    utf8[len++] = codepoint;
+  } else if (0x800 > codepoint) {
+    utf8[len++] = 0xC0 | (codepoint >> 6);
+    utf8[len++] = 0x80 | (codepoint & 0x3F);
+  } else if (0x10000 > codepoint) {
+    utf8[len++] = 0xE0 | (codepoint >> 12);
+    utf8[len++] = 0x80 | ((codepoint >> 6) & 0x3F);
+    utf8[len++] = 0x80 | (codepoint & 0x3F);
+  } else {
+    utf8[len++] = 0xF0 | (codepoint >> 18);
+    utf8[len++] = 0x80 | ((codepoint >> 12) & 0x3F);
+    utf8[len++] = 0x80 | ((codepoint >> 6) & 0x3F);
+    utf8[len++] = 0x80 | (codepoint & 0x3F);
+  }
+
+  return _json_stream_token_append(stream, utf8, len);
+}
+
+static int _json_stream_called(Fpx_Json_Stream *stream, int result) {
+  if (0 == result)
+    return 0;
+
+  stream->error = FPX_JSON_RESULT_ABORTED;
+  return -1;
+}
+
+static uint32_t _json_key_hash(const char *key, size_t key_len) {
+  uint32_t hash = KEY_HASH_OFFSET;
+
+  for (size_t i = 0; i < key_len; ++i)
+    hash = (hash ^ (uint8_t)key[i]) * KEY_HASH_PRIME;
+
+  return hash;
+}
+
+static int _json_key_equals(const Fpx_Json_String *string, const char *key,
+                            size_t key_len) {
+  // empty keys have no data
+  return string->size == key_len &&
+         (0 == key_len || 0 == memcmp(string->data, key, key_len));
+}
+
+static ssize_t _json_object_scan(const Fpx_Json_Object *object,
+                                 const char *key, size_t key_len) {
+  const Fpx_Json_Member *members = object->members;
+
+  for (size_t i = 0; i < object->memberCount; ++i) {
+    // most keys differ in length or in the first byte already
+    if (members[i].key.size != key_len)
+      continue;
+
+    if (0 == key_len)
+      return i;
+
+    if (members[i].key.data[0] == key[0] &&
+        0 == memcmp(members[i].key.data, key, key_len))
+      return i;
+  }
+
+  return -1;
+}
+
+static struct _json_index *_json_object_index(fpx_bump *arena,
+                                              const Fpx_Json_Object *object) {
+  // at most half full, so probes stay short
+  uint32_t slots = OBJECT_INDEX_MIN;
+  while (slots < object->memberCount * 2)
+    slots *= 2;
+
+  size_t size =
+      sizeof(struct _json_index) + slots * sizeof(struct _json_index_slot);
+  struct _json_index *table = (struct _json_index *)fpx_bump_alloc(arena, size);
+
+  if (NULL == table)
+    return NULL;
+
+  memset(table, 0, size);
+
+  uint32_t mask = slots - 1;
+  struct _json_index_slot *index = table->slots;
+
+  for (size_t i = 0; i < object->memberCount; ++i) {
+    const Fpx_Json_String *key = &object->members[i].key;
+    uint32_t hash = _json_key_hash(key->data, key->size);
+    uint32_t slot = hash & mask;
+
+    for (; 0 != index[slot].member; slot = (slot + 1) & mask) {
+      const Fpx_Json_String *other =
+          &object->members[index[slot].member - 1].key;
+
+      // a key that is there twice: the first one is what a scan would find
+      if (hash == index[slot].hash &&
+          _json_key_equals(other, key->data, key->size))
+        break;
+    }
+
+    if (0 == index[slot].member) {
+      index[slot].hash = hash;
+      index[slot].member = i + 1;
+    }
+  }
+
+  table->mask = mask;
+
+  return table;
+}
+
+static Fpx_Json_Value *_json_pointer_step(Fpx_Json_Entity *entity,
+                                          Fpx_Json_Value *value,
+                                          const char *token, size_t len) {
+  if (FPX_JSON_VALUE_ARRAY == value->valueType) {
+    // digits only, and no leading zeroes; "-" (past the end) is never there
+    if (0 == len || (1 < len && '0' == token[0]))
+      return NULL;
+
+    size_t index = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+      if ('0' > token[i] || '9' < token[i])
+        return NULL;
+
+      index = index * 10 + (token[i] - '0');
+
+      if (index >= value->array.count)
+        return NULL;
+    }
+
+    return &value->array.values[index];
+  }
+
+  if (FPX_JSON_VALUE_OBJECT != value->valueType)
+    return NULL;
+
+  if (NULL == memchr(token, '~', len))
+    return fpx_json_object_get(entity, &value->object, token, len);
+
+  // "~0" is '~' and "~1" is '/'
+  char buffer[POINTER_TOKEN_BUFFER];
+  char *key = (len <= sizeof(buffer)) ? buffer : (char *)malloc(len);
+
+  if (NULL == key)
+    return NULL;
+
+  size_t key_len = 0;
+  Fpx_Json_Value *found = NULL;
+
+  for (size_t i = 0; i < len; ++i) {
+    if ('~' != token[i]) {
+      key[key_len++] = token[i];
+      continue;
+    }
+
+    if (i + 1 == len || ('0' != token[i + 1] && '1' != token[i + 1]))
+      goto cleanup;
+
+    key[key_len++] = ('0' == token[++i]) ? '~' : '/';
+  }
+
+  found = fpx_json_object_get(entity, &value->object, key, key_len);
+
+cleanup:
+  if (buffer != key)
+    free(key);
+
+  return found;
 }
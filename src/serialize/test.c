@@ -1,19 +1,31 @@
-#include "serialize/json.h"
+//
+//  "test.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+// Parses the JSON files given as arguments and prints them back, then
+// measures how fast each one parses. The files are also repeated into one
+// array of about 256 KiB, the size of a typical API payload.
+// Build with ./compile.sh, run with ./s.out input*.json
+
+#include "../../include/serialize/json.h"
+#include "../../include/test/bench.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int main(int argc, char **argv) {
-
-  if (argc < 2) {
-    fprintf(stderr, "requires JSON input file as argument\n");
-    return EXIT_FAILURE;
-  }
+#define PARSE_BYTES (64 << 20) /* bytes parsed per measurement */
+#define BIG_DOCUMENT (4 << 20)
+#define STREAM_CHUNK (64 << 10) /* what a read() off a socket might give */
+#define LOOKUP_ROUNDS (1 << 22)  /* member lookups per measurement */
 
-  FILE *json_file = fopen(argv[1], "rb");
+static char *_read_file(const char *path, size_t *len) {
+  FILE *json_file = fopen(path, "rb");
   if (NULL == json_file) {
     perror("fopen()");
-    return EXIT_FAILURE;
+    return NULL;
   }
 
   fseek(json_file, 0, SEEK_END);
@@ -21,30 +33,290 @@ int main(int argc, char **argv) {
   long file_size = ftell(json_file);
   if (0 > file_size) {
     perror("ftell()");
-    return EXIT_FAILURE;
+    fclose(json_file);
+    return NULL;
   }
 
-  char *test_string = (char *)malloc(file_size);
+  char *data = (char *)malloc(file_size + 1);
 
   rewind(json_file);
 
-  if ((unsigned long)file_size > fread(test_string, 1, file_size, json_file)) {
+  if (NULL == data ||
+      (unsigned long)file_size > fread(data, 1, file_size, json_file)) {
     printf("feof: %d | ferror: %d\n", feof(json_file), ferror(json_file));
-    return EXIT_FAILURE;
+    fclose(json_file);
+    free(data);
+    return NULL;
   }
 
   fclose(json_file);
 
-  Fpx_Json_Entity new_entity = fpx_json_read(test_string, file_size);
+  *len = file_size;
+  return data;
+}
+
+static int _bench(const char *name, const char *data, size_t len) {
+  size_t rounds = PARSE_BYTES / len + 1;
+
+  double start = bench_now();
+  for (size_t r = 0; r < rounds; ++r) {
+    Fpx_Json_Entity entity = fpx_json_read(data, len);
+    if (false == entity.isValid) {
+      printf("%s: JSON parse failed\n", name);
+      return 1;
+    }
+    fpx_json_destroy(&entity);
+  }
+  double elapsed = bench_now() - start;
+
+  printf("%-24s %9zu bytes %9.0f MB/s %9.1f us\n", name, len,
+         (double)rounds * len / (1 << 20) / elapsed, elapsed * 1e6 / rounds);
+
+  return 0;
+}
+
+static int _count_event(void *context) {
+  ++*(size_t *)context;
+  return 0;
+}
+
+static int _count_string(void *context, const char *string, size_t len) {
+  (void)string;
+  (void)len;
+  return _count_event(context);
+}
+
+static int _count_number(void *context, double number) {
+  (void)number;
+  return _count_event(context);
+}
+
+static int _count_bool(void *context, bool boolean) {
+  (void)boolean;
+  return _count_event(context);
+}
+
+static int _bench_stream(const char *name, const char *data, size_t len) {
+  const Fpx_Json_Callbacks callbacks = {
+      _count_event,  _count_event,  _count_event, _count_event,
+      _count_string, _count_string, _count_number, _count_bool,
+      _count_event,
+  };
+
+  size_t events = 0;
+  size_t rounds = PARSE_BYTES / len + 1;
+
+  double start = bench_now();
+  for (size_t r = 0; r < rounds; ++r) {
+    Fpx_Json_Stream stream;
+    fpx_json_stream_init(&stream, &callbacks, &events);
+
+    for (size_t at = 0; at < len; at += STREAM_CHUNK) {
+      size_t chunk = (len - at < STREAM_CHUNK) ? len - at : STREAM_CHUNK;
+      fpx_json_stream_feed(&stream, data + at, chunk);
+    }
+
+    Fpx_Json_E_Result result = fpx_json_stream_finish(&stream);
+    fpx_json_stream_destroy(&stream);
+
+    if (FPX_JSON_RESULT_SUCCESS != result) {
+      printf("%s: JSON stream failed (%d)\n", name, result);
+      return 1;
+    }
+  }
+  double elapsed = bench_now() - start;
+
+  printf("%-24s %9zu bytes %9.0f MB/s %9.1f us  (stream, %zu events)\n",
+         name, len, (double)rounds * len / (1 << 20) / elapsed,
+         elapsed * 1e6 / rounds, events / rounds);
+
+  return 0;
+}
+
+// an object of `members` keys, every one of which gets looked up in turn
+static int _bench_lookup(size_t members) {
+  char *data = (char *)malloc(members * 32 + 16);
+  size_t len = 0;
+
+  if (NULL == data)
+    return 1;
+
+  data[len++] = '{';
+  for (size_t i = 0; i < members; ++i)
+    len += sprintf(data + len, "%s\"feature_flag_%zu\":%zu", (i) ? "," : "",
+                   i, i);
+  data[len++] = '}';
+
+  Fpx_Json_Entity entity = fpx_json_read(data, len);
+  if (false == entity.isValid) {
+    printf("lookup: JSON parse failed\n");
+    return 1;
+  }
+
+  // keys are made up front, so only the lookups are measured
+  char(*keys)[32] = (char(*)[32])malloc(members * sizeof(*keys));
+  size_t *key_lens = (size_t *)malloc(members * sizeof(size_t));
+  size_t found = 0;
+
+  if (NULL == keys || NULL == key_lens)
+    return 1;
+
+  for (size_t i = 0; i < members; ++i)
+    key_lens[i] = sprintf(keys[i], "feature_flag_%zu", i);
+
+  double start = bench_now();
+  for (size_t r = 0; r < LOOKUP_ROUNDS; ++r) {
+    size_t i = r % members;
+    found += (NULL != fpx_json_object_get(&entity, &entity.root.object,
+                                          keys[i], key_lens[i]));
+  }
+  double elapsed = bench_now() - start;
+
+  free(keys);
+  free(key_lens);
 
-  // printf("%s\n", ((new_entity.isValid) ? "JSON parse valid!" : "JSON parse
-  // failed"));
+  printf("lookup in %4zu members %9.1f ns per key  (%zu of %d found)\n",
+         members, elapsed * 1e9 / LOOKUP_ROUNDS, found, LOOKUP_ROUNDS);
 
-  fpx_json_print(&new_entity);
+  fpx_json_destroy(&entity);
+  free(data);
 
-  fpx_json_destroy(&new_entity);
+  return 0;
+}
+
+static int _bench_serialize(const char *name, const char *data, size_t len,
+                            unsigned int indent) {
+  Fpx_Json_Entity entity = fpx_json_read(data, len);
+  if (false == entity.isValid) {
+    printf("%s: JSON parse failed\n", name);
+    return 1;
+  }
+
+  // pretty output can be a good deal bigger than what came in
+  size_t buflen = len * 4 + 64;
+  char *output = (char *)malloc(buflen);
+  if (NULL == output)
+    return 1;
+
+  size_t written = 0;
+  size_t rounds = PARSE_BYTES / len + 1;
+
+  double start = bench_now();
+  for (size_t r = 0; r < rounds; ++r) {
+    if (FPX_JSON_RESULT_SUCCESS !=
+        fpx_json_serialize(&entity, output, buflen, &written, indent)) {
+      printf("%s: JSON serialize failed\n", name);
+      return 1;
+    }
+  }
+  double elapsed = bench_now() - start;
+
+  printf("%-24s %9zu bytes %9.0f MB/s %9.1f us  (%s)\n", name, written,
+         (double)rounds * written / (1 << 20) / elapsed,
+         elapsed * 1e6 / rounds, (indent) ? "pretty" : "compact");
+
+  free(output);
+  fpx_json_destroy(&entity);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+
+  if (argc < 2) {
+    fprintf(stderr, "requires JSON input file(s) as argument\n");
+    return EXIT_FAILURE;
+  }
+
+  char *big = (char *)malloc(BIG_DOCUMENT + (1 << 16));
+  size_t big_len = 0;
+  if (NULL == big)
+    return EXIT_FAILURE;
+
+  big[big_len++] = '[';
+
+  for (int i = 1; i < argc; ++i) {
+    size_t len = 0;
+    char *data = _read_file(argv[i], &len);
+    if (NULL == data)
+      return EXIT_FAILURE;
+
+    Fpx_Json_Entity new_entity = fpx_json_read(data, len);
+
+    printf("%s: %s\n", argv[i],
+           (new_entity.isValid) ? "JSON parse valid!" : "JSON parse failed");
+
+    fpx_json_print(&new_entity);
+
+    // what comes out should read back as the same thing
+    char *written = (char *)malloc(len * 4 + 64);
+    size_t written_len = 0;
+
+    if (NULL != written && new_entity.isValid) {
+      for (unsigned int indent = 0; indent <= 2; indent += 2) {
+        fpx_json_serialize(&new_entity, written, len * 4 + 64, &written_len,
+                           indent);
+
+        Fpx_Json_Entity reread = fpx_json_read(written, written_len);
+        printf("%s: serialized (indent %u) and read back %s\n", argv[i],
+               indent, (reread.isValid) ? "fine" : "BADLY");
+        fpx_json_destroy(&reread);
+      }
+    }
+
+    free(written);
+    fpx_json_destroy(&new_entity);
+
+    while (big_len < BIG_DOCUMENT / (argc - 1) * i) {
+      if (1 < big_len)
+        big[big_len++] = ',';
+      memcpy(big + big_len, data, len);
+      big_len += len;
+    }
+
+    free(data);
+  }
+
+  big[big_len++] = ']';
+  // a number right at the end of the input does not parse
+  big[big_len++] = '\n';
+
+  printf("\n");
+
+  for (int i = 1; i < argc; ++i) {
+    size_t len = 0;
+    char *data = _read_file(argv[i], &len);
+    if (NULL == data)
+      return EXIT_FAILURE;
+
+    int result = _bench(argv[i], data, len);
+    free(data);
+
+    if (0 != result)
+      return EXIT_FAILURE;
+  }
+
+  if (0 != _bench("all of them, repeated", big, big_len))
+    return EXIT_FAILURE;
+
+  if (0 != _bench_stream("all of them, repeated", big, big_len))
+    return EXIT_FAILURE;
+
+  printf("\n");
+
+  for (size_t members = 4; members <= 1024; members *= 4) {
+    if (0 != _bench_lookup(members))
+      return EXIT_FAILURE;
+  }
+
+  printf("\n");
+
+  for (unsigned int indent = 0; indent <= 2; indent += 2) {
+    if (0 != _bench_serialize("all of them, repeated", big, big_len, indent))
+      return EXIT_FAILURE;
+  }
 
-  free(test_string);
+  free(big);
 
   return 0;
 }
@@ -0,0 +1,13 @@
+#!/bin/bash
+
+CFLAGS="-g -O3"
+
+gcc \
+  test.c \
+  string.c \
+  strbuf.c \
+  ../alloc/arena.c \
+  ../mem/mem.c \
+  -I../../include \
+  $CFLAGS \
+  -o c.out
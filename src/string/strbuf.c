@@ -0,0 +1,204 @@
+//
+//  "strbuf.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+#include "string/string.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// START OF FPXLIBC LINK-TIME DEPENDENCIES
+#include "alloc/arena.h" // requires arena*.o
+#include "mem/mem.h"     // requires mem*.o
+// END OF FPXLIBC LINK-TIME DEPENDENCIES
+
+#define STRBUF_MIN_ALLOC 32 /* the first allocation is at least this big */
+#define INT_DIGITS_MAX 20   /* digits in the longest int64_t, INT64_MIN */
+
+static int _grow(fpx_strbuf_t *, size_t wanted);
+
+int fpx_strbuf_init(fpx_strbuf_t *buf, fpx_arena *arena) {
+  if (NULL == buf)
+    return -1;
+
+  fpx_memset(buf, 0, sizeof(*buf));
+  buf->arena = arena;
+
+  return 0;
+}
+
+int fpx_strbuf_reserve(fpx_strbuf_t *buf, size_t additional) {
+  if (NULL == buf)
+    return -1;
+
+  // one more for the NULL-byte
+  if (buf->len + additional + 1 <= buf->allocated)
+    return 0;
+
+  return _grow(buf, buf->len + additional + 1);
+}
+
+int fpx_strbuf_append(fpx_strbuf_t *buf, const char *data, size_t len) {
+  if (NULL == buf || (NULL == data && 0 < len))
+    return -1;
+
+  if (0 > fpx_strbuf_reserve(buf, len))
+    return -2;
+
+  fpx_memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+  buf->data[buf->len] = '\0';
+
+  return 0;
+}
+
+int fpx_strbuf_append_view(fpx_strbuf_t *buf, fpx_strview_t view) {
+  return fpx_strbuf_append(buf, view.data, view.len);
+}
+
+int fpx_strbuf_append_char(fpx_strbuf_t *buf, char c) {
+  if (NULL == buf)
+    return -1;
+
+  if (0 > fpx_strbuf_reserve(buf, 1))
+    return -2;
+
+  buf->data[buf->len++] = c;
+  buf->data[buf->len] = '\0';
+
+  return 0;
+}
+
+int fpx_strbuf_append_int(fpx_strbuf_t *buf, int64_t value) {
+  char digits[INT_DIGITS_MAX + 1];
+  size_t start = sizeof(digits);
+
+  // counting down from the magnitude as unsigned also covers INT64_MIN
+  uint64_t magnitude = (0 > value) ? 0 - (uint64_t)value : (uint64_t)value;
+
+  do {
+    digits[--start] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (0 < magnitude);
+
+  if (0 > value)
+    digits[--start] = '-';
+
+  return fpx_strbuf_append(buf, digits + start, sizeof(digits) - start);
+}
+
+int fpx_strbuf_appendf(fpx_strbuf_t *buf, const char *format, ...) {
+  if (NULL == buf || NULL == format)
+    return -1;
+
+  va_list args;
+
+  // try to fit it in what is left first; most of the time that is enough
+  size_t room = (0 < buf->allocated) ? buf->allocated - buf->len : 0;
+
+  va_start(args, format);
+  int needed = vsnprintf((0 < room) ? buf->data + buf->len : NULL, room,
+                         format, args);
+  va_end(args);
+
+  if (0 > needed)
+    return -3;
+
+  if ((size_t)needed >= room) {
+    if (0 > fpx_strbuf_reserve(buf, needed))
+      return -2;
+
+    va_start(args, format);
+    vsnprintf(buf->data + buf->len, needed + 1, format, args);
+    va_end(args);
+  }
+
+  buf->len += needed;
+
+  return 0;
+}
+
+fpx_strview_t fpx_strbuf_view(const fpx_strbuf_t *buf) {
+  fpx_strview_t view = {NULL, 0};
+
+  if (NULL != buf) {
+    view.data = buf->data;
+    view.len = buf->len;
+  }
+
+  return view;
+}
+
+int fpx_strbuf_clear(fpx_strbuf_t *buf) {
+  if (NULL == buf)
+    return -1;
+
+  buf->len = 0;
+
+  if (0 < buf->allocated)
+    buf->data[0] = '\0';
+
+  return 0;
+}
+
+int fpx_strbuf_destroy(fpx_strbuf_t *buf) {
+  if (NULL == buf)
+    return -1;
+
+  // an arena block is left for the arena's owner to reset
+  if (FALSE == buf->in_arena)
+    free(buf->data);
+
+  fpx_arena *arena = buf->arena;
+  fpx_memset(buf, 0, sizeof(*buf));
+  buf->arena = arena;
+
+  return 0;
+}
+
+static int _grow(fpx_strbuf_t *buf, size_t wanted) {
+  // doubling keeps appends amortized constant, and keeps the number of blocks
+  // left behind in an arena low
+  size_t allocated = (STRBUF_MIN_ALLOC > buf->allocated * 2)
+                         ? STRBUF_MIN_ALLOC
+                         : buf->allocated * 2;
+
+  if (allocated < wanted)
+    allocated = wanted;
+
+  char *grown = NULL;
+
+  if (NULL != buf->arena)
+    grown = (char *)fpx_arena_alloc(buf->arena, allocated);
+
+  if (NULL != grown) {
+    if (0 < buf->len)
+      fpx_memcpy(grown, buf->data, buf->len);
+
+    if (FALSE == buf->in_arena)
+      free(buf->data);
+
+    buf->in_arena = TRUE;
+  } else if (FALSE == buf->in_arena) {
+    grown = (char *)realloc(buf->data, allocated);
+    if (NULL == grown)
+      return -2;
+  } else {
+    // the arena is full; carry on on the heap
+    grown = (char *)malloc(allocated);
+    if (NULL == grown)
+      return -2;
+
+    fpx_memcpy(grown, buf->data, buf->len);
+    buf->in_arena = FALSE;
+  }
+
+  buf->data = grown;
+  buf->allocated = allocated;
+  buf->data[buf->len] = '\0';
+
+  return 0;
+}
@@ -4,11 +4,70 @@
 //  Author: Erynn 'foorpyxof' Scholtes
 //
 
-#include "string.h"
+#include "string/string.h"
 #include "mem/mem.h"
 
 #include <stdlib.h>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define STRING_X86
+#include <immintrin.h>
+
+// the length kernels read whole aligned vectors around the string on purpose;
+// those never cross into another page, but they do leave the object
+#define NO_ASAN __attribute__((no_sanitize_address))
+#endif
+
+#define CASE_FLIP 0x20 /* the bit between 'A' and 'a' */
+
+static long _find_bytes(const uint8_t *haystack, size_t haystack_len,
+                        const uint8_t *needle, size_t needle_len, size_t start);
+static void _fold_bytes(uint8_t *dst, const uint8_t *src, size_t len,
+                        uint8_t from);
+
+#if defined(STRING_X86)
+static size_t _length_sse2(const char *str);
+static long _find_sse2(const uint8_t *haystack, size_t haystack_len,
+                       const uint8_t *needle, size_t needle_len);
+static void _fold_sse2(uint8_t *dst, const uint8_t *src, size_t len,
+                       uint8_t from);
+
+static size_t _length_avx2(const char *str);
+static long _find_avx2(const uint8_t *haystack, size_t haystack_len,
+                       const uint8_t *needle, size_t needle_len);
+static void _fold_avx2(uint8_t *dst, const uint8_t *src, size_t len,
+                       uint8_t from);
+
+// SSE2 is part of x86_64, so these are right even before _pick_kernels()
+static size_t (*_length)(const char *) = _length_sse2;
+static long (*_find)(const uint8_t *, size_t, const uint8_t *,
+                     size_t) = _find_sse2;
+static void (*_fold)(uint8_t *, const uint8_t *, size_t,
+                     uint8_t) = _fold_sse2;
+
+__attribute__((constructor)) static void _pick_kernels(void) {
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    _length = _length_avx2;
+    _find = _find_avx2;
+    _fold = _fold_avx2;
+  }
+
+  return;
+}
+#else
+static size_t _length_bytes(const char *str);
+static long _find_scalar(const uint8_t *haystack, size_t haystack_len,
+                         const uint8_t *needle, size_t needle_len);
+
+static size_t (*_length)(const char *) = _length_bytes;
+static long (*_find)(const uint8_t *, size_t, const uint8_t *,
+                     size_t) = _find_scalar;
+static void (*_fold)(uint8_t *, const uint8_t *, size_t,
+                     uint8_t) = _fold_bytes;
+#endif
+
 #ifndef __FPXLIBC_ASM
 int fpx_getstringlength(const char *stringToCheck) {
   /**
@@ -19,10 +78,7 @@ int fpx_getstringlength(const char *stringToCheck) {
   if (!stringToCheck)
     return 0;
 
-  int i;
-  for (i = 0; stringToCheck[i] != '\0'; ++i)
-    ;
-  return i;
+  return (int)_length(stringToCheck);
 }
 #endif // __FPXLIBC_ASM
 
@@ -46,34 +102,10 @@ int fpx_substringindex(const char *haystack, const char *needle) {
    * If not found, returns -1.
    */
 
-  const int haystackLen = fpx_getstringlength(haystack);
-  const int needleLen = fpx_getstringlength(needle);
-  const char *needleStart = needle;
-  char lost = 0;
-  int foundSubstringIndex = 0;
-
-  for (int i = 0; i < haystackLen; i++) {
-    if (*haystack == *needle) {
-      needle++;
-      if (*haystack == *needleStart && !(*(haystack - 1) == *needleStart) &&
-          lost) {
-        foundSubstringIndex = i;
-        lost = 0;
-      }
-    } else if (*haystack == *needleStart) {
-      needle = needleStart + 1;
-      foundSubstringIndex = i;
-    } else {
-      needle = needleStart;
-      lost = 1;
-    }
-    haystack++;
-    if (needle - needleStart == needleLen) {
-      return foundSubstringIndex;
-    }
-  }
+  if (!(haystack && needle))
+    return -1;
 
-  return -1;
+  return (int)fpx_strview_find(fpx_strview(haystack), fpx_strview(needle));
 }
 
 char *fpx_substr_replace(const char *haystack, const char *needle,
@@ -84,35 +116,24 @@ char *fpx_substr_replace(const char *haystack, const char *needle,
    *
    * Returns new heap-allocated, null-terminated char[] when finished.
    *
-   * Otherwise, returns original haystack string if substring was not found.
+   * Otherwise, returns a heap-allocated copy of the haystack string if the
+   * substring was not found.
    */
 
-  const int needleLen = fpx_getstringlength(needle);
-  const int replacementLen = fpx_getstringlength(replacement);
-  const int haystackStartIndex = fpx_substringindex(haystack, needle);
-  const int returnedHaystackLen =
-      fpx_getstringlength(haystack) + replacementLen - needleLen;
+  fpx_strview_t haystackView = fpx_strview(haystack);
+  fpx_strview_t needleView = fpx_strview(needle);
+  fpx_strview_t replacementView = fpx_strview(replacement);
 
-  // allocate string to return on the heap
-  char *returnedHaystack = (char *)malloc(returnedHaystackLen + 1);
+  // room for the replacement, even if it turns out not to be needed
+  size_t returnedHaystackLen = haystackView.len + replacementView.len;
 
-  // if haystack doesn't contain needle, return haystack back to the caller
-  if (haystackStartIndex < 0)
-    return (char *)malloc(fpx_getstringlength(haystack) + 1);
+  char *returnedHaystack = (char *)malloc(returnedHaystackLen + 1);
+  if (NULL == returnedHaystack)
+    return NULL;
 
-  /*
-   * perform magic
-   * (fill new string allocated earlier that contains the desired result)
-   */
-  for (int i = 0; i < returnedHaystackLen + 1; i++) {
-    if (i < haystackStartIndex) {
-      returnedHaystack[i] = haystack[i];
-    } else if (i >= haystackStartIndex + fpx_getstringlength(replacement)) {
-      returnedHaystack[i] = haystack[i + needleLen - replacementLen];
-    } else {
-      returnedHaystack[i] = replacement[i - haystackStartIndex];
-    }
-  }
+  fpx_strview_replace(haystackView, needleView, replacementView,
+                      returnedHaystack, returnedHaystackLen,
+                      &returnedHaystackLen);
 
   /*
    * add null-byte (\0) to the end of the char array, to denote the end of the
@@ -138,10 +159,10 @@ char *fpx_string_to_upper(const char *input, int doReturn) {
   char *inputCopy =
       (doReturn) ? (char *)malloc(inputLength + 1) : (char *)input;
 
-  for (int i = 0; i < inputLength; i++) {
-    inputCopy[i] =
-        (input[i] > 96 && input[i] < 123) ? (input[i] - 32) : input[i];
-  }
+  if (NULL == inputCopy)
+    return NULL;
+
+  _fold((uint8_t *)inputCopy, (const uint8_t *)input, inputLength, 'a');
 
   if (doReturn) {
     inputCopy[inputLength] = '\0';
@@ -166,10 +187,10 @@ char *fpx_string_to_lower(const char *input, int doReturn) {
   char *inputCopy =
       (doReturn) ? (char *)malloc(inputLength + 1) : (char *)input;
 
-  for (int i = 0; i < inputLength; i++) {
-    inputCopy[i] =
-        (input[i] > 64 && input[i] < 91) ? (input[i] + 32) : input[i];
-  }
+  if (NULL == inputCopy)
+    return NULL;
+
+  _fold((uint8_t *)inputCopy, (const uint8_t *)input, inputLength, 'A');
 
   if (doReturn) {
     inputCopy[inputLength] = '\0';
@@ -178,3 +199,305 @@ char *fpx_string_to_lower(const char *input, int doReturn) {
 
   return NULL;
 }
+
+fpx_strview_t fpx_strview(const char *cstring) {
+  fpx_strview_t view = {cstring, 0};
+
+  if (NULL != cstring)
+    view.len = fpx_getstringlength(cstring);
+
+  return view;
+}
+
+fpx_strview_t fpx_strview_slice(fpx_strview_t view, size_t start,
+                                size_t len) {
+  if (start > view.len)
+    start = view.len;
+
+  if (len > view.len - start)
+    len = view.len - start;
+
+  fpx_strview_t slice = {view.data + start, len};
+  return slice;
+}
+
+int fpx_strview_equals(fpx_strview_t a, fpx_strview_t b) {
+  if (a.len != b.len)
+    return FALSE;
+
+  return (0 == fpx_memcmp(a.data, b.data, a.len)) ? TRUE : FALSE;
+}
+
+int fpx_strview_equals_nocase(fpx_strview_t a, fpx_strview_t b) {
+  if (a.len != b.len)
+    return FALSE;
+
+  for (size_t i = 0; i < a.len; ++i) {
+    uint8_t x = a.data[i], y = b.data[i];
+
+    if (x == y)
+      continue;
+
+    // only a letter and its other case differ in just that bit
+    if ((x ^ y) != CASE_FLIP || (uint8_t)((x | CASE_FLIP) - 'a') >= 26)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+int64_t fpx_strview_find(fpx_strview_t haystack, fpx_strview_t needle) {
+  if (0 == needle.len)
+    return 0;
+
+  if (NULL == haystack.data || NULL == needle.data ||
+      needle.len > haystack.len)
+    return -1;
+
+  return _find((const uint8_t *)haystack.data, haystack.len,
+               (const uint8_t *)needle.data, needle.len);
+}
+
+int fpx_strview_replace(fpx_strview_t haystack, fpx_strview_t needle,
+                        fpx_strview_t replacement, char *output,
+                        size_t output_len, size_t *output_written) {
+  if (NULL == output || (NULL == haystack.data && 0 < haystack.len) ||
+      (NULL == replacement.data && 0 < replacement.len))
+    return -1;
+
+  int64_t at = fpx_strview_find(haystack, needle);
+
+  if (0 > at) {
+    if (output_len < haystack.len)
+      return -2;
+
+    fpx_memcpy(output, haystack.data, haystack.len);
+
+    if (NULL != output_written)
+      *output_written = haystack.len;
+
+    return 1;
+  }
+
+  size_t after = at + needle.len;
+  size_t total = at + replacement.len + (haystack.len - after);
+
+  if (output_len < total)
+    return -2;
+
+  fpx_memcpy(output, haystack.data, at);
+  fpx_memcpy(output + at, replacement.data, replacement.len);
+  fpx_memcpy(output + at + replacement.len, haystack.data + after,
+             haystack.len - after);
+
+  if (NULL != output_written)
+    *output_written = total;
+
+  return 0;
+}
+
+int fpx_strview_to_upper(fpx_strview_t view, char *output) {
+  if (NULL == output || (NULL == view.data && 0 < view.len))
+    return -1;
+
+  _fold((uint8_t *)output, (const uint8_t *)view.data, view.len, 'a');
+
+  return 0;
+}
+
+int fpx_strview_to_lower(fpx_strview_t view, char *output) {
+  if (NULL == output || (NULL == view.data && 0 < view.len))
+    return -1;
+
+  _fold((uint8_t *)output, (const uint8_t *)view.data, view.len, 'A');
+
+  return 0;
+}
+
+static long _find_bytes(const uint8_t *haystack, size_t haystack_len,
+                        const uint8_t *needle, size_t needle_len,
+                        size_t start) {
+  const uint8_t first = needle[0];
+  const uint8_t last = needle[needle_len - 1];
+
+  for (size_t i = start; i + needle_len <= haystack_len; ++i) {
+    if (haystack[i] == first && haystack[i + needle_len - 1] == last &&
+        0 == fpx_memcmp(haystack + i, needle, needle_len))
+      return (long)i;
+  }
+
+  return -1;
+}
+
+static void _fold_bytes(uint8_t *dst, const uint8_t *src, size_t len,
+                        uint8_t from) {
+  // `from` is 'A' to lower the string, or 'a' to raise it
+  for (size_t i = 0; i < len; ++i)
+    dst[i] = ((uint8_t)(src[i] - from) < 26) ? src[i] ^ CASE_FLIP : src[i];
+
+  return;
+}
+
+#if defined(STRING_X86)
+NO_ASAN static size_t _length_sse2(const char *str) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t misalign = (uintptr_t)str & 15;
+  const __m128i *block = (const __m128i *)(str - misalign);
+
+  // drop the bytes in front of the string from the first block
+  unsigned int mask =
+      (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(*block, zero)) >>
+      misalign;
+  if (mask)
+    return __builtin_ctz(mask);
+
+  for (++block;; ++block) {
+    mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(*block, zero));
+    if (mask)
+      return (const char *)block - str + __builtin_ctz(mask);
+  }
+}
+
+static long _find_sse2(const uint8_t *haystack, size_t haystack_len,
+                       const uint8_t *needle, size_t needle_len) {
+  // only positions where both the first and the last byte of the needle
+  // match get compared in full
+  const __m128i first = _mm_set1_epi8((char)needle[0]);
+  const __m128i last = _mm_set1_epi8((char)needle[needle_len - 1]);
+  size_t i = 0;
+
+  for (; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+    __m128i block_first = _mm_loadu_si128((const __m128i *)(haystack + i));
+    __m128i block_last =
+        _mm_loadu_si128((const __m128i *)(haystack + i + needle_len - 1));
+
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+
+    for (; mask; mask &= mask - 1) {
+      size_t at = i + __builtin_ctz(mask);
+      if (0 == fpx_memcmp(haystack + at + 1, needle + 1, needle_len - 1))
+        return (long)at;
+    }
+  }
+
+  return _find_bytes(haystack, haystack_len, needle, needle_len, i);
+}
+
+static void _fold_sse2(uint8_t *dst, const uint8_t *src, size_t len,
+                       uint8_t from) {
+  // shifts the 26 letters to the bottom of the signed range, so that one
+  // signed compare picks them out
+  const __m128i shift = _mm_set1_epi8((char)(0x80 - from));
+  const __m128i limit = _mm_set1_epi8((char)(0x80 + 26));
+  const __m128i flip = _mm_set1_epi8(CASE_FLIP);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i letters = _mm_cmplt_epi8(_mm_add_epi8(v, shift), limit);
+    _mm_storeu_si128((__m128i *)(dst + i),
+                     _mm_xor_si128(v, _mm_and_si128(letters, flip)));
+  }
+
+  _fold_bytes(dst + i, src + i, len - i, from);
+
+  return;
+}
+
+NO_ASAN __attribute__((target("avx2"))) static size_t
+_length_avx2(const char *str) {
+  const __m256i zero = _mm256_setzero_si256();
+  size_t misalign = (uintptr_t)str & 31;
+  const __m256i *block = (const __m256i *)(str - misalign);
+
+  unsigned int mask =
+      (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(*block, zero)) >>
+      misalign;
+  if (mask)
+    return __builtin_ctz(mask);
+
+  // one more on its own if needed, so the loop can take 64 aligned bytes
+  if ((uintptr_t)++block & 32) {
+    mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(*block, zero));
+    if (mask)
+      return (const char *)block - str + __builtin_ctz(mask);
+    ++block;
+  }
+
+  for (;; block += 2) {
+    // the smaller byte of the two is zero if either one is
+    __m256i low = _mm256_min_epu8(block[0], block[1]);
+    if (!_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, zero)))
+      continue;
+
+    mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block[0], zero));
+    if (mask)
+      return (const char *)block - str + __builtin_ctz(mask);
+
+    mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block[1], zero));
+    return (const char *)(block + 1) - str + __builtin_ctz(mask);
+  }
+}
+
+__attribute__((target("avx2"))) static long
+_find_avx2(const uint8_t *haystack, size_t haystack_len, const uint8_t *needle,
+           size_t needle_len) {
+  const __m256i first = _mm256_set1_epi8((char)needle[0]);
+  const __m256i last = _mm256_set1_epi8((char)needle[needle_len - 1]);
+  size_t i = 0;
+
+  for (; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+    __m256i block_first = _mm256_loadu_si256((const __m256i *)(haystack + i));
+    __m256i block_last =
+        _mm256_loadu_si256((const __m256i *)(haystack + i + needle_len - 1));
+
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+
+    for (; mask; mask &= mask - 1) {
+      size_t at = i + __builtin_ctz(mask);
+      if (0 == fpx_memcmp(haystack + at + 1, needle + 1, needle_len - 1))
+        return (long)at;
+    }
+  }
+
+  long found = _find_sse2(haystack + i, haystack_len - i, needle, needle_len);
+
+  return (found < 0) ? -1 : (long)i + found;
+}
+
+__attribute__((target("avx2"))) static void
+_fold_avx2(uint8_t *dst, const uint8_t *src, size_t len, uint8_t from) {
+  const __m256i shift = _mm256_set1_epi8((char)(0x80 - from));
+  const __m256i limit = _mm256_set1_epi8((char)(0x80 + 26));
+  const __m256i flip = _mm256_set1_epi8(CASE_FLIP);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+    // AVX2 only has a signed greater-than
+    __m256i letters = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(v, shift));
+    _mm256_storeu_si256((__m256i *)(dst + i),
+                        _mm256_xor_si256(v, _mm256_and_si256(letters, flip)));
+  }
+
+  _fold_sse2(dst + i, src + i, len - i, from);
+
+  return;
+}
+#else
+static size_t _length_bytes(const char *str) {
+  size_t i = 0;
+  while (str[i] != '\0')
+    ++i;
+
+  return i;
+}
+
+static long _find_scalar(const uint8_t *haystack, size_t haystack_len,
+                         const uint8_t *needle, size_t needle_len) {
+  return _find_bytes(haystack, haystack_len, needle, needle_len, 0);
+}
+#endif // STRING_X86
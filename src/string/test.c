@@ -0,0 +1,125 @@
+//
+//  "test.c"
+//  Part of fpxlibc (https://git.goodgirl.dev/foorpyxof/fpxlibc)
+//  Author: Erynn 'foorpyxof' Scholtes
+//
+
+// Benchmarks fpx_getstringlength, fpx_substringindex and
+// fpx_string_to_lower against plain byte loops and the C library;
+// src/test/string.cpp fuzzes them against the same. Build with ./compile.sh
+
+#include "../../include/fpx_types.h"
+#include "../../include/string/string.h"
+#include "../../include/test/bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LENGTH 3000
+
+static int _length_bytes(const char *str) {
+  int i = 0;
+  while (str[i])
+    ++i;
+  return i;
+}
+
+static int _find_bytes(const char *haystack, const char *needle) {
+  int haystack_len = _length_bytes(haystack);
+  int needle_len = _length_bytes(needle);
+
+  for (int i = 0; i + needle_len <= haystack_len; ++i) {
+    if (0 == memcmp(haystack + i, needle, needle_len))
+      return i;
+  }
+
+  return -1;
+}
+
+static void _lower_bytes(char *str) {
+  for (; *str; ++str) {
+    if (*str >= 'A' && *str <= 'Z')
+      *str += 'a' - 'A';
+  }
+}
+
+int main(void) {
+  char *str = malloc(MAX_LENGTH + 1);
+  if (NULL == str)
+    return 1;
+
+  // a header-like line, with the needle at the very end
+  const int sizes[] = { 8, 32, 128, 1024, 3000 };
+  printf("%6s %10s %12s %12s %12s\n", "size", "", "byte loop", "libc",
+         "fpxlibc");
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+    int len = sizes[s];
+    for (int i = 0; i < len; ++i)
+      str[i] = 'a' + i % 23;
+    memcpy(str + len - 3, "XyZ", 4);
+
+    size_t rounds = BENCH_BYTES / len;
+    volatile long sink = 0;
+    double t[3];
+
+    t[0] = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      BENCH_CLOBBER(str);
+      sink += _length_bytes(str);
+    }
+    t[1] = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      BENCH_CLOBBER(str);
+      sink += strlen(str);
+    }
+    t[2] = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      BENCH_CLOBBER(str);
+      sink += fpx_getstringlength(str);
+    }
+    double fpx_time = bench_now() - t[2];
+
+    double mbytes = (double)rounds * len / (1 << 20);
+    printf("%6d %10s %7.0f MB/s %7.0f MB/s %7.0f MB/s\n", len, "length",
+           mbytes / (t[1] - t[0]), mbytes / (t[2] - t[1]), mbytes / fpx_time);
+
+    t[0] = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      BENCH_CLOBBER(str);
+      sink += _find_bytes(str, "XyZ");
+    }
+    t[1] = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      BENCH_CLOBBER(str);
+      sink += strstr(str, "XyZ") - str;
+    }
+    t[2] = bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+      BENCH_CLOBBER(str);
+      sink += fpx_substringindex(str, "XyZ");
+    }
+    fpx_time = bench_now() - t[2];
+
+    printf("%6d %10s %7.0f MB/s %7.0f MB/s %7.0f MB/s\n", len, "substring",
+           mbytes / (t[1] - t[0]), mbytes / (t[2] - t[1]), mbytes / fpx_time);
+
+    t[0] = bench_now();
+    for (size_t r = 0; r < rounds; ++r)
+      _lower_bytes(str);
+    t[1] = bench_now();
+    for (size_t r = 0; r < rounds; ++r)
+      fpx_string_to_lower(str, FALSE);
+    fpx_time = bench_now() - t[1];
+
+    printf("%6d %10s %7.0f MB/s %12s %7.0f MB/s\n", len, "lowercase",
+           mbytes / (t[1] - t[0]), "", mbytes / fpx_time);
+
+    (void)sink;
+  }
+
+  free(str);
+
+  return 0;
+}
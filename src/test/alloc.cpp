@@ -1,5 +1,6 @@
 extern "C" {
 #include "alloc/arena.h"
+#include "alloc/bump.h"
 }
 
 #include "test/test-definitions.hpp"
@@ -31,5 +32,18 @@ int main() {
   FPX_EXPECT(data, "a")
   EMPTY_LINE
 
+  // a bump allocator chains on a new chunk instead of running out
+  fpx_bump *bump = fpx_bump_create(4096);
+  char *first = (char *)fpx_bump_alloc(bump, 3000);
+  char *second = (char *)fpx_bump_alloc(bump, 3000);
+  snprintf(first, 3000, "%s", "first chunk");
+  snprintf(second, 3000, "%s", "second chunk");
+
+  FPX_EXPECT(first, "first chunk")
+  FPX_EXPECT(second, "second chunk")
+  EMPTY_LINE
+
+  fpx_bump_destroy(bump);
+
   return 0;
 }
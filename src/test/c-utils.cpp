@@ -2,12 +2,18 @@
 
 extern "C" {
 #include "c-utils/crypto.h"
+#include "c-utils/deflate.h"
 #include "c-utils/endian.h"
 #include "c-utils/format.h"
 #include "mem/mem.h"
 #include "networking/netutils.h"
 }
 
+#include <random>
+
+#define ROUND_TRIPS 1000000
+#define HASH_MESSAGES 1024
+
 int main() {
   {
     printf("Endian-swapper test:\n");
@@ -63,6 +69,35 @@ int main() {
 
   EMPTY_LINE
 
+  {
+    printf("64-bit int-to-string test:\n");
+
+    char output7[FPX_INT64_MAX_LENGTH + 1] = {0};
+    fpx_int64str(INT64_MIN, output7, sizeof(output7));
+    FPX_EXPECT(output7, "-9223372036854775808")
+    fpx_uint64str(UINT64_MAX, output7, sizeof(output7));
+    FPX_EXPECT(output7, "18446744073709551615")
+  }
+
+  EMPTY_LINE
+
+  {
+    printf("double-to-string test:\n");
+
+    char output8[FPX_DOUBLE_MAX_LENGTH + 1] = {0};
+    fpx_doublestr(0.1, output8, sizeof(output8));
+    FPX_EXPECT(output8, "0.1")
+    fpx_doublestr(-1.5e300, output8, sizeof(output8));
+    FPX_EXPECT(output8, "-1.5e+300")
+
+    double parsed = 0;
+    fpx_strdouble("2.5e-3", 6, &parsed, NULL);
+    fpx_doublestr(parsed, output8, sizeof(output8));
+    FPX_EXPECT(output8, "0.0025")
+  }
+
+  EMPTY_LINE
+
   {
     printf("hex-string test:\n");
 
@@ -162,6 +197,22 @@ int main() {
     FPX_EXPECT(
         output3,
         "5eafc33ce66722eb020d6fe703b0b3e97afbc7aa9a011fd9e8bafe684f97d541")
+
+    // the same input, fed to a context a few bytes at a time
+    SHA256_Context ctx;
+    uint8_t digest[32];
+    char output4[65] = {0};
+    fpx_sha256_init(&ctx);
+    for (size_t i = 0; i < sizeof(input3) - 1; i += 7)
+      fpx_sha256_update(&ctx, input3 + i,
+                        (sizeof(input3) - 1 - i < 7) ? sizeof(input3) - 1 - i
+                                                     : 7);
+    fpx_sha256_final(&ctx, digest);
+    for (int i = 0; i < 32; ++i)
+      fpx_hexstr(&digest[i], 1, &output4[i * 2], 2);
+    FPX_EXPECT(
+        output4,
+        "5eafc33ce66722eb020d6fe703b0b3e97afbc7aa9a011fd9e8bafe684f97d541")
   }
 
   EMPTY_LINE
@@ -290,5 +341,210 @@ int main() {
                         "90d39cf859809759b17d052450f0c98626c5a7aefd")
   }
 
+  EMPTY_LINE
+
+  {
+    printf("deflate round-trip test:\n");
+
+    const char *messages[] = {
+        "{\"type\":\"tick\",\"seq\":1,\"price\":1000.25}",
+        "{\"type\":\"tick\",\"seq\":2,\"price\":1001.25}",
+        "{\"type\":\"tick\",\"seq\":3,\"price\":1002.25}",
+        "",
+        "abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc"};
+    const size_t message_count = sizeof(messages) / sizeof(messages[0]);
+
+    uint8_t window_sizes[] = {9, 15};
+
+    // one long message, bigger than the largest window
+    size_t long_length = 100000;
+    uint8_t *long_message = (uint8_t *)malloc(long_length);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < long_length; ++i) {
+      state = state * 1103515245 + 12345;
+      long_message[i] = (i % 1000 < 500) ? (uint8_t)('a' + i % 7)
+                                         : (uint8_t)(state >> 24);
+    }
+
+    for (size_t w = 0; w < sizeof(window_sizes); ++w) {
+      for (uint8_t keep_context = FALSE; keep_context <= TRUE;
+           ++keep_context) {
+        fpx_deflate_t deflater;
+        fpx_inflate_t inflater;
+        fpx_deflate_init(&deflater, window_sizes[w]);
+        fpx_inflate_init(&inflater, keep_context ? window_sizes[w] : 0);
+
+        size_t matches = 0;
+        for (size_t i = 0; i <= message_count; ++i) {
+          const uint8_t *data = (i < message_count)
+                                    ? (const uint8_t *)messages[i]
+                                    : long_message;
+          size_t length = (i < message_count) ? strlen(messages[i])
+                                              : long_length;
+
+          if (0 != fpx_deflate_message(&deflater, data, length,
+                                       keep_context))
+            break;
+          if (0 != fpx_inflate_message(&inflater, deflater.out,
+                                       deflater.out_len, 0))
+            break;
+
+          if (inflater.out_len == length &&
+              (0 == length || 0 == memcmp(inflater.out, data, length)))
+            ++matches;
+        }
+
+        char output9[64] = {0};
+        snprintf(output9, sizeof(output9), "window %u, takeover %u: %zu/%zu",
+                 window_sizes[w], keep_context, matches, message_count + 1);
+
+        char expected9[64] = {0};
+        snprintf(expected9, sizeof(expected9),
+                 "window %u, takeover %u: %zu/%zu", window_sizes[w],
+                 keep_context, message_count + 1, message_count + 1);
+
+        FPX_EXPECT(output9, expected9)
+
+        fpx_deflate_destroy(&deflater);
+        fpx_inflate_destroy(&inflater);
+      }
+    }
+
+    free(long_message);
+  }
+
+  EMPTY_LINE
+
+  {
+    printf("inflate malformed input test:\n");
+
+    fpx_inflate_t inflater;
+    fpx_inflate_init(&inflater, 15);
+
+    // block type 3 is reserved
+    const uint8_t reserved[] = {0x07, 0x00};
+    // a distance that reaches back before the start of the output
+    const uint8_t too_far[] = {0x03, 0x02};
+
+    char output10[16] = {0};
+    snprintf(output10, sizeof(output10), "%d",
+             fpx_inflate_message(&inflater, reserved, sizeof(reserved), 0));
+    FPX_EXPECT(output10, "-4")
+
+    fpx_inflate_destroy(&inflater);
+    fpx_inflate_init(&inflater, 15);
+
+    snprintf(output10, sizeof(output10), "%d",
+             fpx_inflate_message(&inflater, too_far, sizeof(too_far), 0));
+    FPX_EXPECT(output10, "-4")
+
+    fpx_inflate_destroy(&inflater);
+  }
+
+  EMPTY_LINE
+
+  {
+    printf("number round-trip test:\n");
+
+    std::mt19937_64 random_bits(1234);
+    size_t mismatches = 0;
+    char text[64];
+
+    for (int i = 0; i < ROUND_TRIPS; ++i) {
+      // finite values only, over the whole exponent range
+      uint64_t bits;
+      do
+        bits = random_bits();
+      while (0x7FF == ((bits >> 52) & 0x7FF));
+
+      double value, parsed;
+      fpx_memcpy(&value, &bits, sizeof(value));
+      size_t used;
+
+      int len = fpx_doublestr(value, text, sizeof(text));
+      if (0 > len || strtod(text, NULL) != value ||
+          0 != fpx_strdouble(text, len, &parsed, &used) || parsed != value ||
+          (size_t)len != used)
+        ++mismatches;
+
+      // 17 significant digits, which are not the shortest most of the time
+      len = snprintf(text, sizeof(text), "%.16e", value);
+      if (0 != fpx_strdouble(text, len, &parsed, NULL) ||
+          parsed != strtod(text, NULL))
+        ++mismatches;
+
+      int64_t number = (int64_t)(random_bits() >> (random_bits() % 64));
+      if (i & 1)
+        number = -number;
+
+      int64_t number_parsed;
+      len = fpx_int64str(number, text, sizeof(text));
+      if (0 != fpx_strint64(text, len, &number_parsed, NULL) ||
+          number_parsed != number || number != strtoll(text, NULL, 10))
+        ++mismatches;
+    }
+
+    char output11[32] = {0};
+    snprintf(output11, sizeof(output11), "%zu mismatches", mismatches);
+    FPX_EXPECT(output11, "0 mismatches")
+  }
+
+  EMPTY_LINE
+
+  {
+    printf("one-shot, streaming and batched hash test:\n");
+
+    static const uint8_t *inputs[HASH_MESSAGES];
+    static size_t lengths[HASH_MESSAGES];
+    static uint8_t many1[HASH_MESSAGES][20], many256[HASH_MESSAGES][32];
+
+    std::mt19937 random_number(1234);
+    uint8_t data[HASH_MESSAGES + 300];
+    for (size_t i = 0; i < sizeof(data); ++i)
+      data[i] = (uint8_t)random_number();
+
+    for (int i = 0; i < HASH_MESSAGES; ++i) {
+      inputs[i] = data + i;
+      lengths[i] = random_number() % 300;
+    }
+
+    fpx_sha1_digest_many(inputs, lengths, HASH_MESSAGES, many1);
+    fpx_sha256_digest_many(inputs, lengths, HASH_MESSAGES, many256);
+
+    size_t mismatches = 0;
+
+    for (int i = 0; i < HASH_MESSAGES; ++i) {
+      uint8_t one1[20], one256[32], stream1[20], stream256[32];
+      SHA1_Context ctx1;
+      SHA256_Context ctx256;
+
+      fpx_sha1_digest(inputs[i], lengths[i], one1, 0);
+      fpx_sha256_digest(inputs[i], lengths[i], one256, 0);
+
+      // the same message, fed in pieces of random size
+      fpx_sha1_init(&ctx1);
+      fpx_sha256_init(&ctx256);
+      for (size_t done = 0; done < lengths[i];) {
+        size_t piece = random_number() % 100;
+        if (piece > lengths[i] - done)
+          piece = lengths[i] - done;
+
+        fpx_sha1_update(&ctx1, inputs[i] + done, piece);
+        fpx_sha256_update(&ctx256, inputs[i] + done, piece);
+        done += piece;
+      }
+      fpx_sha1_final(&ctx1, stream1);
+      fpx_sha256_final(&ctx256, stream256);
+
+      if (memcmp(one1, stream1, 20) || memcmp(one1, many1[i], 20) ||
+          memcmp(one256, stream256, 32) || memcmp(one256, many256[i], 32))
+        ++mismatches;
+    }
+
+    char output12[32] = {0};
+    snprintf(output12, sizeof(output12), "%zu mismatches", mismatches);
+    FPX_EXPECT(output12, "0 mismatches")
+  }
+
   return 0;
 }
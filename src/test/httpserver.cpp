@@ -8,7 +8,9 @@ extern "C" {
 #include "networking/http/websockets.h"
 #include "string/string.h"
 
+#include <arpa/inet.h>
 #include <fcntl.h>
+#include <netinet/in.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -17,6 +19,10 @@ extern "C" {
 
 #define IP "0.0.0.0"
 #define PORT 8080
+
+#define TEST_PORT 18081      /* the poll backend gets the port after this */
+#define WARMUP_REQUESTS 8    /* fill the thread's pool of parsers and arenas */
+#define MEASURED_REQUESTS 64 /* may not allocate anything */
 }
 
 #include "test/test-definitions.hpp"
@@ -159,7 +165,158 @@ void source_callback(const fpx_httprequest_t *reqptr,
   return;
 }
 
+void echo_callback(const fpx_httprequest_t *reqptr,
+                   fpx_httpresponse_t *resptr) {
+  fpx_httpresponse_add_header(resptr, "content-type", "text/plain");
+  fpx_httpresponse_add_header(resptr, "x-echo", "yes");
+  fpx_httpresponse_append_body(resptr, reqptr->content.body,
+                               reqptr->content.body_len);
+}
+
+struct test_server {
+  fpx_httpserver_t server;
+  uint16_t port;
+};
+
+void *listen_thread(void *arg) {
+  struct test_server *test = (struct test_server *)arg;
+  fpx_httpserver_listen(&test->server, "127.0.0.1", test->port);
+  return NULL;
+}
+
+int keep_alive_request(int fd) {
+  // sends one keep-alive request and reads the whole response back;
+  // returns 0 on success
+  static const char request[] = "POST /echo HTTP/1.1\r\n"
+                                "Host: localhost\r\n"
+                                "X-Request: keep-alive test\r\n"
+                                "Content-Length: 11\r\n"
+                                "\r\n"
+                                "hello world";
+
+  if (sizeof(request) - 1 != send(fd, request, sizeof(request) - 1, 0))
+    return -1;
+
+  char response[1024];
+  size_t length = 0;
+  char *body = NULL;
+
+  while (NULL == body || length < (size_t)(body - response) + 11) {
+    long amount = recv(fd, response + length, sizeof(response) - 1 - length, 0);
+    if (1 > amount)
+      return -1;
+
+    length += amount;
+    response[length] = 0;
+
+    if (NULL == body && NULL != (body = strstr(response, "\r\n\r\n")))
+      body += 4;
+  }
+
+  if (0 != strncmp(response, "HTTP/1.1 200", 12) ||
+      0 != memcmp(body, "hello world", 11))
+    return -1;
+
+  return 0;
+}
+
+long warm_request_allocations(enum fpx_httpserver_backend backend,
+                              uint16_t port) {
+  // returns how often the measured requests allocated, or -1 if they failed
+  static struct test_server servers[2];
+  struct test_server *test = &servers[backend];
+  fpx_httpserver_t *server = &test->server;
+
+  fpx_httpserver_init(server, 1, 0, 4);
+  server->backend = backend;
+  fpx_httpserver_create_endpoint(server, "/echo", HTTP_POST, echo_callback);
+  test->port = port;
+
+  pthread_t listener;
+  pthread_create(&listener, NULL, listen_thread, test);
+  pthread_detach(listener);
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int fd = -1;
+
+  for (int attempt = 0; attempt < 100 && -1 == fd; ++attempt) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (0 != connect(fd, (struct sockaddr *)&address, sizeof(address))) {
+      close(fd);
+      fd = -1;
+      usleep(10000);
+    }
+  }
+
+  if (-1 == fd)
+    return -1;
+
+  for (int i = 0; i < WARMUP_REQUESTS; ++i)
+    if (0 != keep_alive_request(fd))
+      return -1;
+
+  uint64_t before = fpx_http_allocation_count();
+
+  for (int i = 0; i < MEASURED_REQUESTS; ++i)
+    if (0 != keep_alive_request(fd))
+      return -1;
+
+  uint64_t after = fpx_http_allocation_count();
+
+  close(fd);
+  fpx_httpserver_close(server);
+
+  return (long)(after - before);
+}
+
 int main() {
+  {
+    printf("warm keep-alive allocation test:\n");
+
+    char output[64] = {0};
+    snprintf(output, sizeof(output), "epoll %ld, poll %ld",
+             warm_request_allocations(EpollBackend, TEST_PORT),
+             warm_request_allocations(PollBackend, TEST_PORT + 1));
+    FPX_EXPECT(output, "epoll 0, poll 0")
+  }
+
+  EMPTY_LINE
+
+  {
+    printf("websocket mask test:\n");
+
+    const uint8_t key[4] = {0x37, 0xfa, 0x21, 0x3d};
+    uint8_t expected[512], got[512];
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < sizeof(expected); ++i)
+      expected[i] = got[i] = (uint8_t)(i * 31 + 7);
+
+    // odd offsets and lengths, against a byte at a time
+    for (size_t off = 0; off < 4; ++off) {
+      for (size_t len = 0; len < 300; ++len) {
+        for (size_t i = 0; i < len; ++i)
+          expected[off + i] ^= key[(off + len + i) % 4];
+
+        fpx_websocket_mask(got + off, len, key, off + len);
+        if (0 != memcmp(expected, got, sizeof(expected)))
+          ++mismatches;
+      }
+    }
+
+    char output[32] = {0};
+    snprintf(output, sizeof(output), "%zu mismatches", mismatches);
+    FPX_EXPECT(output, "0 mismatches")
+  }
+
+  EMPTY_LINE
+
   {
     FILE *fpipe = NULL;
     char command[512] = {0};
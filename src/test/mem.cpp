@@ -4,6 +4,112 @@ extern "C" {
 
 #include "test/test-definitions.hpp"
 
+#include <random>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+#define CHECK_SMALL 300 /* every size up to here is checked */
+#define CHECK_LARGE 48 /* random sizes above CHECK_SMALL */
+#define CHECK_LARGE_MAX (40 << 10) /* past the AVX2 loops and ERMS */
+#define CHECK_OFFSETS 64
+#define CHECK_SOURCES 3 /* random source offsets per destination offset */
+#define GUARD 64 /* bytes either side that must stay untouched */
+#define CHECK_BUFFER (2 * CHECK_LARGE_MAX + 2 * CHECK_OFFSETS + 2 * GUARD)
+
+static std::mt19937_64 random_bits(1234);
+static size_t mismatches = 0;
+
+static void fill(uint8_t *a, uint8_t *b, size_t length) {
+  uint64_t bits = 0;
+
+  for (size_t i = 0; i < length; ++i, bits >>= 8) {
+    if (0 == i % 8)
+      bits = random_bits();
+
+    a[i] = (uint8_t)bits;
+    if (NULL != b)
+      b[i] = (uint8_t)bits;
+  }
+}
+
+static int sign(int value) {
+  return (value > 0) - (value < 0);
+}
+
+static void mismatch(const char *what, size_t len, size_t dst_off,
+                     size_t src_off) {
+  if (mismatches++ < 16)
+    printf(" %s mismatch: size %zu, offsets %zu/%zu\n", what, len, dst_off,
+           src_off);
+}
+
+static void check_against_libc(size_t len, size_t dst_off, size_t src_off,
+                               uint8_t *expected, uint8_t *got,
+                               uint8_t *src) {
+  // only the part these calls can reach (plus the guards) gets refilled
+  size_t span = len + 2 * CHECK_OFFSETS + 2 * GUARD;
+  uint8_t *want_dst = expected + GUARD + dst_off;
+  uint8_t *got_dst = got + GUARD + dst_off;
+  uint8_t *from = src + GUARD + src_off;
+
+  fill(expected, got, span);
+  fill(from, NULL, len);
+
+  memcpy(want_dst, from, len);
+  if (fpx_memcpy(got_dst, from, len) != got_dst ||
+      0 != memcmp(expected, got, span))
+    mismatch("memcpy", len, dst_off, src_off);
+
+  uint8_t value = (uint8_t)random_bits();
+  memset(want_dst, value, len);
+  if (fpx_memset(got_dst, value, len) != got_dst ||
+      0 != memcmp(expected, got, span))
+    mismatch("memset", len, dst_off, src_off);
+
+  // both ends inside one buffer: dst_off < src_off moves forward, the other
+  // way around backward, and a distance of len / 2 overlaps by half
+  size_t distances[] = {0, len / 2};
+  for (size_t d = 0; d < 2; ++d) {
+    size_t low = GUARD + dst_off, high = GUARD + src_off + distances[d];
+
+    fill(expected, got, span + len / 2);
+    memmove(expected + low, expected + high, len);
+    if (fpx_memmove(got + low, got + high, len) != got + low ||
+        0 != memcmp(expected, got, span + len / 2))
+      mismatch("memmove forward", len, dst_off, src_off);
+
+    fill(expected, got, span + len / 2);
+    memmove(expected + high, expected + low, len);
+    if (fpx_memmove(got + high, got + low, len) != got + high ||
+        0 != memcmp(expected, got, span + len / 2))
+      mismatch("memmove backward", len, dst_off, src_off);
+  }
+
+  // `got_dst` holds a copy of `from`, so they compare equal until one byte
+  // is changed: at the start, the end, and somewhere in between
+  memcpy(got_dst, from, len);
+  if (0 != fpx_memcmp(got_dst, from, len))
+    mismatch("memcmp equal", len, dst_off, src_off);
+
+  if (0 == len)
+    return;
+
+  size_t positions[] = {0, len - 1, random_bits() % len, random_bits() % len};
+  for (size_t p = 0; p < 4; ++p) {
+    uint8_t saved = got_dst[positions[p]];
+    got_dst[positions[p]] ^= (uint8_t)(random_bits() | 1);
+
+    if (sign(fpx_memcmp(got_dst, from, len)) !=
+            sign(memcmp(got_dst, from, len)) ||
+        sign(fpx_memcmp(from, got_dst, len)) !=
+            sign(memcmp(from, got_dst, len)))
+      mismatch("memcmp", len, dst_off, src_off);
+
+    got_dst[positions[p]] = saved;
+  }
+}
+
 int main() {
   char *testptr = (char *)malloc(16);
   char arr[16];
@@ -22,5 +128,54 @@ int main() {
   fpx_memset(testptr, 'w', 15);
   FPX_EXPECT("wwwwwwwwwwwwwww", testptr)
 
-  return 0;
+  EMPTY_LINE
+
+  fpx_memcpy(testptr, arr, sizeof(arr));
+  fpx_memmove(testptr + 1, testptr, 14);
+  FPX_EXPECT("aabcdefghijklmn", testptr)
+
+  free(testptr);
+
+  EMPTY_LINE
+
+  {
+    printf("libc agreement test:\n");
+
+    uint8_t *expected = (uint8_t *)malloc(CHECK_BUFFER);
+    uint8_t *got = (uint8_t *)malloc(CHECK_BUFFER);
+    uint8_t *src = (uint8_t *)malloc(CHECK_BUFFER);
+
+    // covers every path for the small sizes, head and tail alignment
+    // included: each destination offset against the same source offset and
+    // a few random ones
+    for (size_t len = 0; len <= CHECK_SMALL; ++len) {
+      for (size_t dst_off = 0; dst_off < CHECK_OFFSETS; ++dst_off) {
+        check_against_libc(len, dst_off, dst_off, expected, got, src);
+
+        for (size_t i = 0; i < CHECK_SOURCES; ++i)
+          check_against_libc(len, dst_off, random_bits() % CHECK_OFFSETS,
+                             expected, got, src);
+      }
+    }
+
+    // the large sizes go through every destination offset once
+    for (size_t i = 0; i < CHECK_LARGE; ++i) {
+      size_t len =
+          CHECK_SMALL + 1 + random_bits() % (CHECK_LARGE_MAX - CHECK_SMALL);
+      if (i < 3)
+        len = 4095 + i; /* right at the ERMS threshold */
+
+      for (size_t dst_off = 0; dst_off < CHECK_OFFSETS; ++dst_off)
+        check_against_libc(len, dst_off, random_bits() % CHECK_OFFSETS,
+                           expected, got, src);
+    }
+
+    free(expected);
+    free(got);
+    free(src);
+
+    FPX_EXPECT(std::to_string(mismatches).c_str(), "0")
+  }
+
+  return (0 == mismatches) ? 0 : 1;
 }
@@ -1,8 +1,118 @@
 #include "test/test-definitions.hpp"
 extern "C" {
+#include "alloc/arena.h"
 #include "string/string.h"
 }
 
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define FUZZ_ROUNDS 200000
+
+static int failures = 0;
+
+static void check(const char *what, const std::string &got,
+                  const char *expected) {
+  std::cout << what << std::endl;
+  FPX_EXPECT(got.c_str(), expected)
+  EMPTY_LINE
+
+  if (got != expected)
+    ++failures;
+}
+
+static std::string view_string(fpx_strview_t view) {
+  return std::string(view.data, view.len);
+}
+
+static void ascii_lower(char *str) {
+  for (; *str; ++str) {
+    if (*str >= 'A' && *str <= 'Z')
+      *str += 'a' - 'A';
+  }
+}
+
+static void ascii_upper(char *str) {
+  for (; *str; ++str) {
+    if (*str >= 'a' && *str <= 'z')
+      *str -= 'a' - 'A';
+  }
+}
+
+static int fuzz_against_libc(void) {
+  // strings are placed right in front of an unmapped page, so any read past
+  // the terminator crashes; returns the amount of mismatches
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  char *map = (char *)mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == map)
+    return -1;
+  mprotect(map + page, page, PROT_NONE);
+
+  // a small alphabet makes partial needle matches common
+  static const char alphabet[] = "aAbBzZ@[`{\x80\xff";
+  std::mt19937 random_number(1234);
+  auto random_char = [&]() {
+    return alphabet[random_number() % (sizeof(alphabet) - 1)];
+  };
+
+  char *expected = (char *)malloc(page);
+  char needle[16];
+  int mismatches = 0;
+
+  for (int round = 0; round < FUZZ_ROUNDS; ++round) {
+    int len = random_number() % ((round % 16) ? 96 : page - 1);
+    char *str = map + page - len - 1;
+
+    for (int i = 0; i < len; ++i)
+      str[i] = random_char();
+    str[len] = '\0';
+
+    if (fpx_getstringlength(str) != len)
+      ++mismatches;
+
+    int needle_len = random_number() % 6;
+    for (int i = 0; i < needle_len; ++i)
+      needle[i] = random_char();
+    needle[needle_len] = '\0';
+
+    // also look for a piece of the string itself, so there is a match
+    if (len > 0 && random_number() % 2) {
+      int from = random_number() % len;
+      needle_len = random_number() % (len - from + 1);
+      if (needle_len > (int)sizeof(needle) - 1)
+        needle_len = sizeof(needle) - 1;
+      memcpy(needle, str + from, needle_len);
+      needle[needle_len] = '\0';
+    }
+
+    const char *found = strstr(str, needle);
+    if (fpx_substringindex(str, needle) != (found ? found - str : -1))
+      ++mismatches;
+
+    memcpy(expected, str, len + 1);
+    ascii_lower(expected);
+    char *lowered = fpx_string_to_lower(str, TRUE);
+    fpx_string_to_lower(str, FALSE);
+    if (memcmp(lowered, expected, len + 1) || memcmp(str, expected, len + 1))
+      ++mismatches;
+    free(lowered);
+
+    ascii_upper(expected);
+    fpx_string_to_upper(str, FALSE);
+    if (memcmp(str, expected, len + 1))
+      ++mismatches;
+  }
+
+  free(expected);
+  munmap(map, 2 * page);
+
+  return mismatches;
+}
+
 int main() {
 
   const char *testString = "hELLo friENd";
@@ -21,4 +131,121 @@ int main() {
   fpx_strcpy(array, (char *)"lalalala");
 
   FPX_EXPECT(array, "lalalala")
+  EMPTY_LINE
+
+  // views
+  fpx_strview_t hello = FPX_STRVIEW_LITERAL("hello world");
+  fpx_strview_t world = FPX_STRVIEW_LITERAL("world");
+  fpx_strview_t worlds = FPX_STRVIEW_LITERAL("worlds");
+  fpx_strview_t there = FPX_STRVIEW_LITERAL("there");
+  fpx_strview_t everyone = FPX_STRVIEW_LITERAL("everyone");
+  fpx_strview_t empty = FPX_STRVIEW_LITERAL("");
+
+  check("find", std::to_string(fpx_strview_find(hello, world)), "6");
+  check("find, not found", std::to_string(fpx_strview_find(hello, worlds)),
+        "-1");
+  check("find, needle longer than haystack",
+        std::to_string(fpx_strview_find(world, hello)), "-1");
+  check("find, empty needle", std::to_string(fpx_strview_find(hello, empty)),
+        "0");
+
+  char output[32];
+  size_t written = 0;
+  int result = fpx_strview_replace(hello, world, there, output,
+                                   sizeof(output), &written);
+  check("replace", std::to_string(result) + " " + std::string(output, written),
+        "0 hello there");
+
+  result = fpx_strview_replace(hello, worlds, there, output, sizeof(output),
+                               &written);
+  check("replace, not found",
+        std::to_string(result) + " " + std::string(output, written),
+        "1 hello world");
+
+  result = fpx_strview_replace(hello, worlds, there, output, hello.len - 1,
+                               &written);
+  check("replace, not found, output too small", std::to_string(result), "-2");
+
+  result = fpx_strview_replace(hello, world, everyone, output, hello.len + 2,
+                               &written);
+  check("replace, output too small", std::to_string(result), "-2");
+
+  check("slice", view_string(fpx_strview_slice(hello, 6, 3)), "wor");
+  check("slice, length past the end",
+        view_string(fpx_strview_slice(hello, 6, 100)), "world");
+  check("slice, start past the end",
+        std::to_string(fpx_strview_slice(hello, 100, 3).len), "0");
+
+  fpx_strview_t upper = FPX_STRVIEW_LITERAL("HeLLO WORLD");
+  check("equals_nocase, letters",
+        std::to_string(fpx_strview_equals_nocase(hello, upper)), "1");
+
+  // '@' and '`', and '[' and '{', differ in the same bit as 'A' and 'a'
+  fpx_strview_t at = FPX_STRVIEW_LITERAL("a@[");
+  fpx_strview_t backtick = FPX_STRVIEW_LITERAL("A`[");
+  fpx_strview_t brace = FPX_STRVIEW_LITERAL("a@{");
+  check("equals_nocase, '@' and '`'",
+        std::to_string(fpx_strview_equals_nocase(at, backtick)), "0");
+  check("equals_nocase, '[' and '{'",
+        std::to_string(fpx_strview_equals_nocase(at, brace)), "0");
+
+  // builders
+  fpx_strbuf_t buf;
+
+  fpx_strbuf_init(&buf, NULL);
+  fpx_strbuf_append_int(&buf, INT64_MIN);
+  fpx_strbuf_append_char(&buf, ' ');
+  fpx_strbuf_append_int(&buf, INT64_MAX);
+  fpx_strbuf_append_char(&buf, ' ');
+  fpx_strbuf_append_int(&buf, 0);
+  check("append_int", buf.data,
+        "-9223372036854775808 9223372036854775807 0");
+
+  // fill the first allocation up to the byte before the NULL-terminator
+  fpx_strbuf_clear(&buf);
+  size_t allocated = buf.allocated;
+  std::string exact(allocated - 1, 'x');
+
+  fpx_strbuf_appendf(&buf, "%s", exact.c_str());
+  check("appendf, exactly filling the buffer",
+        std::to_string(buf.allocated == allocated) + " " +
+            std::to_string(buf.len) + " " +
+            std::to_string(view_string(fpx_strbuf_view(&buf)) == exact),
+        (std::string("1 ") + std::to_string(allocated - 1) + " 1").c_str());
+
+  fpx_strbuf_appendf(&buf, "%d", 7);
+  check("appendf, one past it",
+        std::to_string(buf.allocated > allocated) + " " +
+            std::to_string(buf.data == exact + "7"),
+        "1 1");
+
+  fpx_strbuf_destroy(&buf);
+
+  // the builder starts in the arena, and moves to the heap once it is full
+  fpx_arena *arena = fpx_arena_create(1024);
+  fpx_strbuf_init(&buf, arena);
+
+  std::string expected;
+  int was_in_arena = FALSE;
+
+  for (int i = 0; i < 200; ++i) {
+    fpx_strbuf_appendf(&buf, "%d,", i);
+    fpx_strbuf_append_view(&buf, FPX_STRVIEW_LITERAL("abc;"));
+    expected += std::to_string(i) + ",abc;";
+
+    was_in_arena |= buf.in_arena;
+  }
+
+  check("strbuf, from the arena to the heap",
+        std::to_string(was_in_arena) + " " + std::to_string(buf.in_arena) +
+            " " + std::to_string(buf.data == expected),
+        "1 0 1");
+
+  fpx_strbuf_destroy(&buf);
+  fpx_arena_destroy(arena);
+
+  check("length, substring and case against libc, fuzzed",
+        std::to_string(fuzz_against_libc()), "0");
+
+  return (0 == failures) ? 0 : 1;
 }